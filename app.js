@@ -1,12 +1,38 @@
 const SERVICE_UUID = "9d35a5d1-8e8a-4e6b-b44a-9f5bb48f7c01";
 const DATA_CHAR_UUID = "9d35a5d1-8e8a-4e6b-b44a-9f5bb48f7c02";
 const CONFIG_CHAR_UUID = "9d35a5d1-8e8a-4e6b-b44a-9f5bb48f7c03";
+const EXPORT_CHAR_UUID = "9d35a5d1-8e8a-4e6b-b44a-9f5bb48f7c04";
+// Vario notifications: u8 version, u8 seq, i32 altitude cm, i16 climb cm/s.
+const VARIO_CHAR_UUID = "9d35a5d1-8e8a-4e6b-b44a-9f5bb48f7c05";
+const VARIO_FRAME_VERSION = 0x01;
+const VARIO_FRAME_BYTES = 8;
+// Binary export frame: u8 id, u8 flags, u16 length, u32 seq (little endian).
+const EXPORT_HEADER_BYTES = 8;
+const EXPORT_FLAG_LAST = 0x01;
+const EXPORT_FLAG_LZ = 0x02;
+// Binary live metrics: u8 version, u32 local seconds since 2024-01-01, then
+// items of u8 sensor id, u8 count and count x (u8 key id, scaled int).
+const METRIC_FRAME_VERSION = 0x81;
+const METRIC_EPOCH_BASE_MS = Date.UTC(2024, 0, 1);
+const METRIC_FRAME_SENSORS = ["bme680", "bmp280", "gy63", "analog", "dht11", "dht22", "digital", "ds18b20", "random"];
+const METRIC_FRAME_KEYS = {
+  1: { key: "t", scale: 100, wide: false },
+  2: { key: "p", scale: 100, wide: true },
+  3: { key: "h", scale: 100, wide: false },
+  4: { key: "g", scale: 1000, wide: true },
+  5: { key: "iaq", scale: 10, wide: false },
+  6: { key: "ia", scale: 1, wide: false },
+  7: { key: "co2eq", scale: 10, wide: true },
+  8: { key: "breath_voc", scale: 1000, wide: true },
+};
 
 const MAX_CONNECTIONS = 4;
-const CSV_ACK_EVERY = 1;
+const CSV_WINDOW = 8;
+const CSV_ACK_EVERY = 4;
 const HISTORY_TICK_MS = 60;
 const HISTORY_MAX_ROWS = 200;
 const HISTORY_CHART_MAX = 800;
+const HISTORY_WINDOW_MS = 60 * 60 * 1000;
 const AUTO_RECONNECT = true;
 const RECONNECT_BASE_DELAY = 1000;
 const RECONNECT_MAX_DELAY = 15000;
@@ -27,6 +53,7 @@ const SENSOR_PIN_FIELDS = {
   ],
   onewire: [
     { key: "onewire", label: "Pin One Wire" },
+    { key: "onewireBits", label: "Resolution DS18B20 (bits)", min: "9", max: "12", placeholder: "12" },
   ],
   analog: [
     { key: "analog", label: "Pin analogique" },
@@ -88,6 +115,7 @@ const RESERVED_KEYS = new Set([
   "addr",
   "i2c",
   "flash",
+  "power",
   "fs",
   "csv_chunk",
   "csvchunk",
@@ -122,6 +150,8 @@ const configModalSensor = document.getElementById("configModalSensor");
 const configModalPins = document.getElementById("configModalPins");
 const configModalFrequency = document.getElementById("configModalFrequency");
 const configModalStoreFlash = document.getElementById("configModalStoreFlash");
+const configModalDeepSleep = document.getElementById("configModalDeepSleep");
+const configModalVario = document.getElementById("configModalVario");
 const configModalStatus = document.getElementById("configModalStatus");
 const configModalDetected = document.getElementById("configModalDetected");
 const configModalClose = document.getElementById("configModalClose");
@@ -231,6 +261,26 @@ if (configModalStoreFlash) {
   });
 }
 
+if (configModalDeepSleep) {
+  configModalDeepSleep.addEventListener("change", (event) => {
+    const entry = getActiveModalEntry();
+    if (!entry) return;
+    const draft = ensureConfigDraft(entry);
+    draft.deepSleep = event.target.checked;
+    draft.touched = true;
+  });
+}
+
+if (configModalVario) {
+  configModalVario.addEventListener("change", (event) => {
+    const entry = getActiveModalEntry();
+    if (!entry) return;
+    const draft = ensureConfigDraft(entry);
+    draft.vario = event.target.checked;
+    draft.touched = true;
+  });
+}
+
 if (configModalForm) {
   configModalForm.addEventListener("submit", (event) => {
     event.preventDefault();
@@ -339,10 +389,18 @@ function normalizePin(value) {
   return num;
 }
 
+// 1-Wire probes share a bus: "temperature@<ROM>" keeps one metric per probe,
+// labelled with the end of its ROM.
+const ONEWIRE_ROM_RE = /^[0-9a-f]{16}$/i;
+
 function baseProfileForKey(key) {
-  const base = METRIC_PROFILES[key] || METRIC_PROFILES.generic || { label: key, unit: "", min: 0, max: 100 };
+  const at = key.indexOf("@");
+  const rom = at > 0 ? key.slice(at + 1) : "";
+  const baseKey = at > 0 ? key.slice(0, at) : key;
+  const base = METRIC_PROFILES[baseKey] || METRIC_PROFILES.generic || { label: baseKey, unit: "", min: 0, max: 100 };
+  const label = base.label || baseKey;
   return {
-    label: base.label || key,
+    label: rom ? `${label} ${rom.slice(-4).toUpperCase()}` : label,
     unit: base.unit || "",
     min: Number.isFinite(base.min) ? base.min : 0,
     max: Number.isFinite(base.max) ? base.max : 100,
@@ -412,6 +470,7 @@ function ensureConfigDraft(entry) {
         sda: "",
         scl: "",
         onewire: "",
+        onewireBits: "",
         analog: "",
         digital: "",
         button: "",
@@ -419,6 +478,8 @@ function ensureConfigDraft(entry) {
       },
       frequency: "",
       storeFlash: false,
+      deepSleep: false,
+      vario: false,
       status: null,
       touched: false,
     };
@@ -432,6 +493,7 @@ function ensureConfigDraft(entry) {
       sda: "",
       scl: "",
       onewire: "",
+      onewireBits: "",
       analog: "",
       digital: "",
       button: "",
@@ -510,14 +572,23 @@ function extractConfigFromObject(source) {
     ?? parseBoolean(source.flash);
   if (storeFlash !== null) config.storeFlash = storeFlash;
 
+  const deepSleep = parseBoolean(source.deep_sleep) ?? parseBoolean(source.deepSleep);
+  if (deepSleep !== null) config.deepSleep = deepSleep;
+
+  const vario = parseBoolean(source.vario);
+  if (vario !== null) config.vario = vario;
+
   const pins = {};
   if (source.i2c && typeof source.i2c === "object") {
     if (source.i2c.sda !== undefined) pins.sda = source.i2c.sda;
     if (source.i2c.scl !== undefined) pins.scl = source.i2c.scl;
+    const i2cHz = toNumber(source.i2c.hz);
+    if (i2cHz !== null) config.i2cHz = i2cHz;
   }
   if (source.onewire !== undefined) {
     if (typeof source.onewire === "object") {
       if (source.onewire.pin !== undefined) pins.onewire = source.onewire.pin;
+      if (source.onewire.resolution !== undefined) pins.onewireBits = source.onewire.resolution;
     } else {
       pins.onewire = source.onewire;
     }
@@ -622,6 +693,19 @@ function extractFlashFromObject(source) {
   return Object.keys(flash).length > 0 ? flash : null;
 }
 
+function extractPowerFromObject(source) {
+  if (!source || typeof source !== "object") return null;
+  const power = {};
+  if (typeof source.sleep === "string") power.sleep = source.sleep;
+  const avgUa = toNumber(source.avg_ua ?? source.avgUa);
+  if (avgUa !== null) power.avgUa = avgUa;
+  const sleepPct = toNumber(source.sleep_pct ?? source.sleepPct);
+  if (sleepPct !== null) power.sleepPct = sleepPct;
+  const windowS = toNumber(source.window_s ?? source.windowS);
+  if (windowS !== null) power.windowS = windowS;
+  return Object.keys(power).length > 0 ? power : null;
+}
+
 function normalizeFlashField(field) {
   if (!field) return null;
   switch (field) {
@@ -673,6 +757,8 @@ function applyConfigUpdate(entry, config, options = {}) {
     if (shouldApply) draft.name = config.name;
   }
 
+  if (Number.isFinite(config.i2cHz)) entry.i2cHz = config.i2cHz;
+
   if (config.sensorType) {
     entry.sensor = config.sensorType;
     if (shouldApply) draft.sensorType = config.sensorType;
@@ -707,11 +793,22 @@ function applyConfigUpdate(entry, config, options = {}) {
     if (shouldApply) draft.storeFlash = !!config.storeFlash;
   }
 
+  if (config.deepSleep !== undefined) {
+    if (shouldApply) draft.deepSleep = !!config.deepSleep;
+  }
+
+  if (config.vario !== undefined) {
+    entry.varioEnabled = !!config.vario;
+    if (!entry.varioEnabled) entry.vario = null;
+    if (shouldApply) draft.vario = !!config.vario;
+  }
+
   if (config.pins && shouldApply) {
     draft.pins = {
       sda: draft.pins?.sda ?? "",
       scl: draft.pins?.scl ?? "",
       onewire: draft.pins?.onewire ?? "",
+      onewireBits: draft.pins?.onewireBits ?? "",
       analog: draft.pins?.analog ?? "",
       digital: draft.pins?.digital ?? "",
       button: draft.pins?.button ?? "",
@@ -726,6 +823,8 @@ function applyConfigUpdate(entry, config, options = {}) {
     renderModalPinFields(draft);
     if (configModalFrequency) configModalFrequency.value = draft.frequency || "";
     if (configModalStoreFlash) configModalStoreFlash.checked = !!draft.storeFlash;
+    if (configModalDeepSleep) configModalDeepSleep.checked = !!draft.deepSleep;
+    if (configModalVario) configModalVario.checked = !!draft.vario;
   }
 
   renderAll();
@@ -751,10 +850,11 @@ function renderModalPinFields(draft) {
 
     const input = document.createElement("input");
     input.type = "number";
-    input.min = "0";
+    input.min = field.min || "0";
+    if (field.max) input.max = field.max;
     input.inputMode = "numeric";
     input.id = `config-modal-pin-${field.key}`;
-    input.placeholder = "GPIO12";
+    input.placeholder = field.placeholder || "GPIO12";
     input.value = pins[field.key] ?? "";
     input.addEventListener("input", (event) => {
       pins[field.key] = event.target.value;
@@ -779,6 +879,8 @@ function openConfigModal(entry) {
   if (configModalSensor) configModalSensor.value = draft.sensorType || "i2c";
   if (configModalFrequency) configModalFrequency.value = draft.frequency || "";
   if (configModalStoreFlash) configModalStoreFlash.checked = !!draft.storeFlash;
+  if (configModalDeepSleep) configModalDeepSleep.checked = !!draft.deepSleep;
+  if (configModalVario) configModalVario.checked = !!draft.vario;
 
   renderModalPinFields(draft);
   renderModalDetectedSensors(entry);
@@ -847,6 +949,10 @@ async function requestConfig(entry) {
           entry.flash = parsed.flash;
           updated = true;
         }
+        if (parsed.power) {
+          entry.power = parsed.power;
+          updated = true;
+        }
         if (updated) {
           renderAll();
         }
@@ -939,6 +1045,14 @@ function buildConfigPayload(entry, draft) {
         warnings.push("Pin One Wire manquant.");
       }
     }
+    if (String(pins.onewireBits || "").trim()) {
+      const bits = toNumber(pins.onewireBits);
+      if (Number.isInteger(bits) && bits >= 9 && bits <= 12) {
+        payload.onewire = { ...(payload.onewire || {}), resolution: bits };
+      } else {
+        warnings.push("Resolution DS18B20 invalide (9 a 12 bits).");
+      }
+    }
   } else if (sensorType === "analog") {
     const hasPin = String(pins.analog || "").trim();
     if (hasPin) {
@@ -993,6 +1107,8 @@ function buildConfigPayload(entry, draft) {
   }
 
   payload.store_flash = !!draft.storeFlash;
+  payload.deep_sleep = !!draft.deepSleep;
+  payload.vario = !!draft.vario;
 
   if (Object.keys(payload).length === 0) {
     return { payload: null, warnings };
@@ -1039,6 +1155,33 @@ async function sendConfig(entry, draft) {
   }
 }
 
+async function resumeCsvExport(entry) {
+  const resume = entry.csvResume;
+  entry.csvResume = null;
+  if (!resume || !entry.csvInProgress) return;
+  // Unknown or expired streams restart from scratch under a new id.
+  const payload = {
+    action: "flash_export",
+    format: "csv",
+    window: CSV_WINDOW,
+    resume_id: resume.id,
+    offset: resume.offset,
+  };
+  if (entry.exportChar) {
+    payload.framing = "binary";
+    payload.format = "lz";
+  }
+  try {
+    await enqueueBle(entry, async () => {
+      await sendBlePayload(entry, payload);
+    });
+    setDraftStatus(entry, "info", "Reprise export...");
+    scheduleCsvTimeout(entry);
+  } catch (err) {
+    console.error("Export resume failed", err);
+  }
+}
+
 async function sendFlashCommand(entry, action, successMessage) {
   if (!entry.connected || !entry.configChar) {
     setDraftStatus(entry, "error", "ESP32 non connecte.");
@@ -1052,6 +1195,7 @@ async function sendFlashCommand(entry, action, successMessage) {
     }
     resetCsvTransfer(entry);
     entry.csvData = null;
+    entry.csvDoneId = null;
     entry.csvInProgress = true;
     entry.csvMode = "download";
     ensureCsvTransfer(entry);
@@ -1062,6 +1206,11 @@ async function sendFlashCommand(entry, action, successMessage) {
   const payload = { action };
   if (action === "flash_export") {
     payload.format = "csv";
+    payload.window = CSV_WINDOW;
+    if (entry.exportChar) {
+      payload.framing = "binary";
+      payload.format = "lz";
+    }
   }
 
   try {
@@ -1132,6 +1281,20 @@ async function sendTimeSync(entry, options = {}) {
   }
 }
 
+// Firmware without binary metrics ignores the action and keeps sending JSON.
+async function requestBinaryMetrics(entry) {
+  if (!entry.connected || !entry.configChar) return false;
+  try {
+    await enqueueBle(entry, async () => {
+      await sendBlePayload(entry, { action: "metric_format", format: "binary" });
+    });
+    return true;
+  } catch (err) {
+    console.warn("Metric format request failed", err);
+    return false;
+  }
+}
+
 async function toggleRecording(entry) {
   const draft = ensureConfigDraft(entry);
   const previousValue = !!draft.storeFlash;
@@ -1310,6 +1473,7 @@ async function startHistoryStream(entry) {
   }
   entry.csvInProgress = true;
   entry.csvMode = "history";
+  entry.csvDoneId = null;
   resetCsvTransfer(entry);
   resetHistory(entry);
   entry.metrics = {};
@@ -1323,7 +1487,16 @@ async function startHistoryStream(entry) {
 
   try {
     await enqueueBle(entry, async () => {
-      await sendBlePayload(entry, { action: "flash_stream" });
+      const request = {
+        action: "flash_stream",
+        window: CSV_WINDOW,
+        from_ms: Date.now() - HISTORY_WINDOW_MS,
+      };
+      if (entry.exportChar) {
+        request.framing = "binary";
+        request.format = "lz";
+      }
+      await sendBlePayload(entry, request);
     });
   } catch (err) {
     console.error("History stream failed", err);
@@ -1402,6 +1575,30 @@ async function connectWithDevice(device, entry) {
     handleNotification(device.id, event.target.value);
   });
 
+  // Older firmware has no binary export characteristic: stay on JSON blocks.
+  let exportChar = null;
+  try {
+    exportChar = await service.getCharacteristic(EXPORT_CHAR_UUID);
+    await exportChar.startNotifications();
+    exportChar.addEventListener("characteristicvaluechanged", (event) => {
+      handleExportNotification(device.id, event.target.value);
+    });
+  } catch (err) {
+    exportChar = null;
+  }
+
+  // Same for the vario characteristic.
+  let varioChar = null;
+  try {
+    varioChar = await service.getCharacteristic(VARIO_CHAR_UUID);
+    await varioChar.startNotifications();
+    varioChar.addEventListener("characteristicvaluechanged", (event) => {
+      handleVarioNotification(device.id, event.target.value);
+    });
+  } catch (err) {
+    varioChar = null;
+  }
+
   const record = entry || {
     id: device.id,
     metrics: {},
@@ -1412,6 +1609,8 @@ async function connectWithDevice(device, entry) {
   record.device = device;
   record.dataChar = dataChar;
   record.configChar = configChar;
+  record.exportChar = exportChar;
+  record.varioChar = varioChar;
   record.connected = true;
   record.reconnecting = false;
   record.autoReconnect = true;
@@ -1427,6 +1626,8 @@ async function connectWithDevice(device, entry) {
   renderAll();
   await requestConfig(record);
   await sendTimeSync(record, { silent: true });
+  await requestBinaryMetrics(record);
+  if (record.csvResume) await resumeCsvExport(record);
   return record;
 }
 
@@ -1459,13 +1660,20 @@ function handleDisconnect(deviceId) {
   if (!entry) return;
   entry.connected = false;
   entry.bleQueue = Promise.resolve();
-  entry.csvInProgress = false;
-  entry.csvMode = null;
+  if (entry.csvInProgress && entry.csvMode === "download" && entry.csvWindow) {
+    // The firmware keeps the stream for a while: ask for the rest on reconnect.
+    entry.csvResume = { id: entry.csvWindow.id, offset: entry.csvWindow.next };
+    entry.csvWindow.nacked.clear();
+  } else {
+    entry.csvResume = null;
+    entry.csvInProgress = false;
+    entry.csvMode = null;
+    resetCsvTransfer(entry);
+  }
   entry.historyLoading = false;
   entry.historyStreamDone = true;
   entry.historyStopSent = false;
   stopHistoryProcessor(entry);
-  resetCsvTransfer(entry);
   renderAll();
   scheduleReconnect(entry);
 }
@@ -1474,16 +1682,142 @@ function handleNotification(deviceId, valueView) {
   const entry = devices.get(deviceId);
   if (!entry) return;
 
+  if (valueView.byteLength > 0 && valueView.getUint8(0) === METRIC_FRAME_VERSION) {
+    decodeMetricFrame(valueView).forEach((item) => {
+      applyParsedPayload(entry, parsePayload(item));
+    });
+    return;
+  }
+
   const raw = decodeValue(valueView);
   const parts = splitBleMessages(raw);
   if (parts.length === 0) return;
 
   parts.forEach((part) => {
-    const parsed = parsePayload(part);
-    applyParsedPayload(entry, parsed);
+    expandMetricBatch(part).forEach((item) => {
+      const parsed = parsePayload(item);
+      applyParsedPayload(entry, parsed);
+    });
+  });
+}
+
+// Turns a binary metric frame into the equivalent {"s","m","ts"} payloads.
+function decodeMetricFrame(view) {
+  const items = [];
+  if (view.byteLength < 5) return items;
+  const stamp = view.getUint32(1, true);
+  let ts = null;
+  if (stamp > 0) {
+    const d = new Date(METRIC_EPOCH_BASE_MS + stamp * 1000);
+    const pad = (n) => String(n).padStart(2, "0");
+    ts = `${pad(d.getUTCDate())}/${pad(d.getUTCMonth() + 1)}/${pad(d.getUTCFullYear() % 100)} `
+      + `${pad(d.getUTCHours())}:${pad(d.getUTCMinutes())}:${pad(d.getUTCSeconds())}`;
+  }
+  let pos = 5;
+  while (pos + 2 <= view.byteLength) {
+    const sensor = METRIC_FRAME_SENSORS[view.getUint8(pos) - 1] || null;
+    const count = view.getUint8(pos + 1);
+    pos += 2;
+    const m = {};
+    for (let i = 0; i < count && pos < view.byteLength; i += 1) {
+      const spec = METRIC_FRAME_KEYS[view.getUint8(pos)];
+      if (!spec) return items;
+      const width = spec.wide ? 4 : 2;
+      if (pos + 1 + width > view.byteLength) return items;
+      const raw = spec.wide ? view.getInt32(pos + 1, true) : view.getInt16(pos + 1, true);
+      pos += 1 + width;
+      // The type's minimum marks a missing value.
+      if (raw === (spec.wide ? -0x80000000 : -0x8000)) continue;
+      m[spec.key] = raw / spec.scale;
+    }
+    if (sensor) {
+      const item = { s: sensor, m };
+      if (ts) item.ts = ts;
+      items.push(JSON.stringify(item));
+    }
+  }
+  return items;
+}
+
+// Batched metrics: {"b":[{"s":..,"a":..,"m":{..}},...],"ts":..} carries one tick of
+// several sensors; each item is handled like a single-sensor notification.
+function expandMetricBatch(raw) {
+  if (!raw || !raw.startsWith("{\"b\":")) return [raw];
+  try {
+    const obj = JSON.parse(raw);
+    if (!Array.isArray(obj.b)) return [raw];
+    return obj.b.map((item) => JSON.stringify(obj.ts !== undefined ? { ...item, ts: obj.ts } : item));
+  } catch (err) {
+    return [raw];
+  }
+}
+
+// Up to 20 frames per second: only the vario line is updated, not the
+// whole card.
+function handleVarioNotification(deviceId, view) {
+  const entry = devices.get(deviceId);
+  if (!entry || view.byteLength < VARIO_FRAME_BYTES) return;
+  if (view.getUint8(0) !== VARIO_FRAME_VERSION) return;
+  entry.vario = {
+    altitudeCm: view.getInt32(2, true),
+    climbCmS: view.getInt16(6, true),
+    at: Date.now(),
+  };
+  if (entry.varioLine && entry.varioLine.isConnected) {
+    entry.varioLine.textContent = formatVarioSummary(entry.vario);
+  }
+}
+
+function formatVarioSummary(vario) {
+  if (!vario) return "--";
+  const climb = vario.climbCmS / 100;
+  const sign = climb > 0 ? "+" : "";
+  return `${sign}${climb.toFixed(2)} m/s, ${(vario.altitudeCm / 100).toFixed(1)} m`;
+}
+
+function handleExportNotification(deviceId, view) {
+  const entry = devices.get(deviceId);
+  if (!entry || view.byteLength < EXPORT_HEADER_BYTES) return;
+  const length = view.getUint16(2, true);
+  if (EXPORT_HEADER_BYTES + length > view.byteLength) return;
+  const flags = view.getUint8(1);
+  let bytes = new Uint8Array(view.buffer, view.byteOffset + EXPORT_HEADER_BYTES, length);
+  if (flags & EXPORT_FLAG_LZ) bytes = lzDecompress(bytes);
+  handleCsvChunk(entry, {
+    id: view.getUint8(0),
+    seq: view.getUint32(4, true),
+    last: (flags & EXPORT_FLAG_LAST) !== 0,
+    total: null,
+    data: decoder.decode(bytes),
+    binary: true,
   });
 }
 
+// LZSS block as written by LzBlockEncoder: a flag byte per eight items
+// (LSB first, 1 = match), matches are 11-bit distance - 1 / 5-bit length - 3.
+function lzDecompress(input) {
+  const out = [];
+  let i = 0;
+  while (i < input.length) {
+    const flags = input[i++];
+    for (let bit = 0; bit < 8 && i < input.length; bit += 1) {
+      if (flags & (1 << bit)) {
+        if (i + 1 >= input.length) break;
+        const b0 = input[i];
+        const b1 = input[i + 1];
+        i += 2;
+        const distance = (b0 | ((b1 >> 5) << 8)) + 1;
+        const length = (b1 & 0x1f) + 3;
+        if (distance > out.length) break;
+        for (let k = 0; k < length; k += 1) out.push(out[out.length - distance]);
+      } else {
+        out.push(input[i++]);
+      }
+    }
+  }
+  return Uint8Array.from(out);
+}
+
 function splitBleMessages(raw) {
   if (!raw) return [];
   let text = String(raw).trim();
@@ -1527,13 +1861,15 @@ function applyParsedPayload(entry, parsed) {
     || parsed.csvChunk
     || parsed.config
     || parsed.flash
+    || parsed.power
   );
 
   if (parsed.sensor) {
     entry.sensor = parsed.sensor;
     upsertRecognizedSensor(entry, parsed.sensor, parsed.addr || entry.address || null);
   }
-  if (parsed.addr) entry.address = parsed.addr;
+  const probeRom = parsed.addr && ONEWIRE_ROM_RE.test(parsed.addr) ? parsed.addr.toLowerCase() : "";
+  if (parsed.addr && !probeRom) entry.address = parsed.addr;
   if (parsed.name) {
     entry.name = parsed.name;
     if (entry.configDraft && !entry.configDraft.touched) {
@@ -1546,6 +1882,9 @@ function applyParsedPayload(entry, parsed) {
   if (parsed.flash) {
     entry.flash = parsed.flash;
   }
+  if (parsed.power) {
+    entry.power = parsed.power;
+  }
   if (parsed.ack === "name") {
     const type = parsed.status === "ok" ? "ok" : "error";
     const message = parsed.message || (type === "ok" ? "Nom mis a jour." : "Erreur de configuration.");
@@ -1610,7 +1949,7 @@ function applyParsedPayload(entry, parsed) {
   keys.forEach((key) => {
     const value = parsed.metrics[key];
     if (!Number.isFinite(value)) return;
-    const metric = ensureMetric(entry, key);
+    const metric = ensureMetric(entry, probeRom ? `${key}@${probeRom}` : key);
     metric.latest = value;
     metric.values.push({ ts: Date.now(), value });
     if (metric.values.length > 120) metric.values.shift();
@@ -1677,6 +2016,8 @@ function resetCsvTransfer(entry) {
     clearTimeout(entry.csvTransfer.timeoutId);
   }
   entry.csvTransfer = null;
+  entry.csvWindow = null;
+  entry.historyPartial = "";
 }
 
 function scheduleCsvTimeout(entry) {
@@ -1703,7 +2044,11 @@ function scheduleCsvTimeout(entry) {
 
 function handleCsvChunk(entry, chunk) {
   if (!chunk) return;
-  if (chunk.lineMode && entry.csvMode === "history") {
+  // Binary blocks are windowed like line blocks but cut lines anywhere.
+  const windowed = chunk.lineMode || chunk.binary;
+  // Late retransmits of a finished stream.
+  if (windowed && entry.csvDoneId != null && entry.csvDoneId === chunk.id) return;
+  if (windowed && entry.csvMode === "history") {
     handleHistoryBlock(entry, chunk);
     return;
   }
@@ -1722,11 +2067,8 @@ function handleCsvChunk(entry, chunk) {
   }
   if (isLast) transfer.lastSeq = seq;
 
-  if (chunk.lineMode) {
-    const shouldAck = isLast || (CSV_ACK_EVERY > 0 && ((seq + 1) % CSV_ACK_EVERY === 0));
-    if (shouldAck) {
-      sendCsvAck(entry, transfer.id, seq);
-    }
+  if (windowed) {
+    trackCsvWindow(entry, chunk);
   }
 
   let complete = false;
@@ -1743,6 +2085,7 @@ function handleCsvChunk(entry, chunk) {
       .slice(0, lastIndex + 1)
       .map((val) => val || "")
       .join(chunk.lineMode ? "\n" : "");
+    if (windowed) entry.csvDoneId = chunk.id;
     entry.csvInProgress = false;
     entry.csvMode = null;
     resetCsvTransfer(entry);
@@ -1769,15 +2112,25 @@ function handleHistoryBlock(entry, chunk) {
   if (!entry.historyQueue) entry.historyQueue = [];
   entry.historyLoading = true;
   ensureHistoryProcessor(entry);
-  const data = chunk.data ? String(chunk.data) : "";
-  const lines = data.split("\n").map((line) => line.trim()).filter((line) => line);
-  lines.forEach((line) => {
-    if (/^date(?:_time)?,/i.test(line)) return;
-    entry.historyQueue.push(line);
+  trackCsvWindow(entry, chunk).forEach((ready) => {
+    let data = ready.data ? String(ready.data) : "";
+    if (ready.binary) {
+      // Keep the cut line for the next block.
+      data = (entry.historyPartial || "") + data;
+      const cut = ready.last === true ? data.length : data.lastIndexOf("\n") + 1;
+      entry.historyPartial = data.slice(cut);
+      data = data.slice(0, cut);
+    }
+    const lines = data.split("\n").map((line) => line.trim()).filter((line) => line);
+    lines.forEach((line) => {
+      if (/^date(?:_time)?,/i.test(line)) return;
+      entry.historyQueue.push(line);
+    });
+    if (ready.last === true) {
+      entry.historyStreamDone = true;
+      entry.csvDoneId = chunk.id;
+    }
   });
-  if (chunk.last === true) {
-    entry.historyStreamDone = true;
-  }
   if (entry.historyStreamDone && entry.historyQueue.length === 0) {
     entry.historyLoading = false;
     entry.historyLoaded = true;
@@ -1791,14 +2144,49 @@ function handleHistoryBlock(entry, chunk) {
       });
     }
   }
-  const shouldAck = chunk.last === true
-    || (CSV_ACK_EVERY > 0 && ((chunk.seq + 1) % CSV_ACK_EVERY === 0));
-  if (shouldAck) {
-    sendCsvAck(entry, chunk.id, chunk.seq);
-  }
   renderAll();
 }
 
+// Sliding-window receiver: acks are cumulative, every gap is nacked once,
+// and the blocks that became contiguous are returned in order.
+function trackCsvWindow(entry, chunk) {
+  const id = chunk.id;
+  const seq = chunk.seq;
+  if (!Number.isFinite(seq)) return [chunk];
+  let win = entry.csvWindow;
+  if (!win || win.id !== id) {
+    win = { id, next: 0, held: new Map(), nacked: new Set() };
+    entry.csvWindow = win;
+  }
+  const ready = [];
+  if (seq < win.next || win.held.has(seq)) {
+    // Duplicate: our ack was probably lost, repeat it.
+    if (win.next > 0) sendCsvAck(entry, id, win.next - 1);
+    return ready;
+  }
+  win.held.set(seq, chunk);
+  for (let missing = win.next; missing < seq; missing += 1) {
+    if (win.held.has(missing) || win.nacked.has(missing)) continue;
+    win.nacked.add(missing);
+    sendCsvNack(entry, id, missing);
+  }
+  const before = win.next;
+  while (win.held.has(win.next)) {
+    ready.push(win.held.get(win.next));
+    win.held.delete(win.next);
+    win.nacked.delete(win.next);
+    win.next += 1;
+  }
+  if (win.next > before) {
+    const reachedLast = ready.some((block) => block.last === true);
+    const crossed = Math.floor(win.next / CSV_ACK_EVERY) > Math.floor(before / CSV_ACK_EVERY);
+    if (reachedLast || crossed || win.held.size > 0) {
+      sendCsvAck(entry, id, win.next - 1);
+    }
+  }
+  return ready;
+}
+
 function handleHistoryInline(entry, csvText) {
   resetHistory(entry);
   ensureHistoryProcessor(entry);
@@ -1831,6 +2219,14 @@ function sendCsvAck(entry, id, seq) {
   });
 }
 
+function sendCsvNack(entry, id, seq) {
+  if (!entry || !entry.connected || !entry.configChar) return;
+  if (!Number.isFinite(id) || !Number.isFinite(seq)) return;
+  enqueueBle(entry, async () => {
+    await sendBlePayload(entry, { action: "csv_nack", id, seq });
+  });
+}
+
 function parsePayload(raw) {
   let sensor = null;
   let addr = null;
@@ -1842,11 +2238,12 @@ function parsePayload(raw) {
   let csvChunk = null;
   let config = null;
   let flash = null;
+  let power = null;
   let timestamp = null;
   const metrics = {};
   const profiles = {};
 
-  if (!raw) return { sensor, addr, name, ack, status, message, csv, csvChunk, config, flash, timestamp, metrics, profiles };
+  if (!raw) return { sensor, addr, name, ack, status, message, csv, csvChunk, config, flash, power, timestamp, metrics, profiles };
 
   if (raw.startsWith("{")) {
     try {
@@ -1856,6 +2253,7 @@ function parsePayload(raw) {
       if (obj.s && !sensor) sensor = String(obj.s).toLowerCase();
       if (obj.name) name = String(obj.name);
       if (obj.addr) addr = String(obj.addr);
+      if (obj.a && !addr) addr = String(obj.a);
       if (obj.i2c) addr = String(obj.i2c);
       if (obj.ack) ack = String(obj.ack).toLowerCase();
       if (obj.status) status = String(obj.status).toLowerCase();
@@ -1907,6 +2305,9 @@ function parsePayload(raw) {
       const extractedFlash = extractFlashFromObject(flashSource);
       if (extractedFlash) flash = extractedFlash;
 
+      const extractedPower = extractPowerFromObject((configSource && configSource.power) || obj.power);
+      if (extractedPower) power = extractedPower;
+
       if (!flash) {
         const flatFlash = extractFlashFromObject({
           total: obj.flash_total ?? obj.fs_total,
@@ -1971,7 +2372,7 @@ function parsePayload(raw) {
         });
       }
 
-      return { sensor, addr, name, ack, status, message, csv, csvChunk, config, flash, timestamp, metrics, profiles };
+      return { sensor, addr, name, ack, status, message, csv, csvChunk, config, flash, power, timestamp, metrics, profiles };
     } catch (err) {
       // ignore
     }
@@ -2087,7 +2488,7 @@ function parsePayload(raw) {
     metrics[metricKey] = value;
   });
 
-  return { sensor, addr, name, ack, status, message, csv, csvChunk, config, flash, timestamp, metrics, profiles };
+  return { sensor, addr, name, ack, status, message, csv, csvChunk, config, flash, power, timestamp, metrics, profiles };
 }
 
 function ensureMetric(entry, key) {
@@ -2150,7 +2551,11 @@ function renderConfig(list) {
       <div><strong>Adresse:</strong> ${addrLabel}</div>
       <div><strong>Reconnu(s):</strong> ${recognizedLabel}</div>
       <div><strong>FS:</strong> ${flashLabel}</div>
+      <div><strong>Conso:</strong> ${formatPowerSummary(entry.power)}</div>
+      ${entry.sensor === "i2c" && entry.i2cHz ? `<div><strong>Bus I2C:</strong> ${Math.round(entry.i2cHz / 1000)} kHz</div>` : ""}
+      ${entry.varioEnabled ? `<div><strong>Vario:</strong> <span class="vario-line">${formatVarioSummary(entry.vario)}</span></div>` : ""}
     `;
+    entry.varioLine = meta.querySelector(".vario-line");
 
     const fsUsage = document.createElement("div");
     fsUsage.className = "fs-usage";
@@ -2432,6 +2837,20 @@ function formatFlashSummary(flash) {
   return parts.join(" · ");
 }
 
+function formatPowerSummary(power) {
+  if (!power || !Number.isFinite(power.avgUa)) return "Indisponible";
+  const current = power.avgUa >= 1000
+    ? `${(power.avgUa / 1000).toFixed(2)} mA`
+    : `${Math.round(power.avgUa)} uA`;
+  const parts = [`~${current} (estime)`];
+  if (power.sleep === "light" && Number.isFinite(power.sleepPct)) {
+    parts.push(`veille ${power.sleepPct.toFixed(1)}%`);
+  } else if (power.sleep === "off") {
+    parts.push("veille desactivee");
+  }
+  return parts.join(" · ");
+}
+
 function safeFileName(value) {
   const raw = String(value || "esp32").trim();
   const cleaned = raw.replace(/[^a-z0-9_-]+/gi, "_").replace(/^_+|_+$/g, "");
@@ -0,0 +1,333 @@
+#include "BinaryLogger.h"
+#include "TsBlock.h"
+#include <new>
+
+static const uint8_t kMagic[4] = {'P', 'H', 'X', 'B'};
+
+static size_t putVarint(uint8_t *out, uint64_t value) {
+  size_t n = 0;
+  while (value >= 0x80) {
+    out[n++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[n++] = (uint8_t)value;
+  return n;
+}
+
+BinaryLogger::BinaryLogger(fs::FS &fs, const char *path)
+    : fs_(fs), path_(path) {}
+
+BinaryLogger::~BinaryLogger() {
+  end();
+  delete block_;
+}
+
+bool BinaryLogger::setBuffered(size_t bufferBytes, uint32_t maxAgeMs) {
+  end();
+  return out_.setBuffer(bufferBytes, maxAgeMs);
+}
+
+bool BinaryLogger::setBlocks(bool enabled) {
+  end();
+  if (!enabled) {
+    delete block_;
+    block_ = nullptr;
+    version_ = kVersion;
+    return true;
+  }
+  if (!block_) block_ = new (std::nothrow) TsBlockEncoder();
+  if (!block_) return false;
+  block_->begin();
+  version_ = kBlockVersion;
+  return true;
+}
+
+bool BinaryLogger::isHeader(const uint8_t *data, size_t len) {
+  return headerVersion(data, len) != 0;
+}
+
+uint8_t BinaryLogger::headerVersion(const uint8_t *data, size_t len) {
+  if (len < kHeaderBytes || memcmp(data, kMagic, sizeof(kMagic)) != 0) return 0;
+  return data[4] == kVersion || data[4] == kBlockVersion ? data[4] : 0;
+}
+
+bool BinaryLogger::begin() {
+  if (out_.isOpen()) return true;
+  if (!ensureHeader()) return false;
+  // The first record after (re)opening always carries an absolute timestamp.
+  anchored_ = false;
+  return out_.open(fs_, path_);
+}
+
+size_t BinaryLogger::append(const BinaryLogRecord &record) {
+  if (!begin()) return 0;
+  if (version_ == kBlockVersion) {
+    const size_t before = size();
+    if (block_->empty()) blockStartMs_ = millis();
+    if (!block_->append(record)) {
+      if (!closeBlock()) return 0;
+      blockStartMs_ = millis();
+      if (!block_->append(record)) return 0;
+    }
+    // A row can take less than a byte; never report 0, which means failure.
+    const size_t grown = size() - before;
+    return grown > 0 ? grown : 1;
+  }
+  uint8_t out[9 + kMaxRecordBytes];
+  size_t n = 0;
+  if (!anchored_ || record.timestampMs < lastTs_) {
+    out[n++] = kAnchorTag;
+    for (uint8_t i = 0; i < 8; i++) out[n++] = (uint8_t)(record.timestampMs >> (8 * i));
+    lastTs_ = record.timestampMs;
+    anchored_ = true;
+  }
+  out[n++] = record.sensorId == kAnchorTag ? 0 : record.sensorId;
+  n += putVarint(out + n, record.timestampMs - lastTs_);
+  const uint8_t addrLen = record.addrLen > BinaryLogRecord::kMaxAddr ? BinaryLogRecord::kMaxAddr : record.addrLen;
+  out[n++] = addrLen;
+  memcpy(out + n, record.addr, addrLen);
+  n += addrLen;
+  const uint16_t mask = record.mask & (uint16_t)((1UL << BinaryLogRecord::kMaxValues) - 1);
+  out[n++] = (uint8_t)mask;
+  out[n++] = (uint8_t)(mask >> 8);
+  for (uint8_t i = 0; i < BinaryLogRecord::kMaxValues; i++) {
+    if (!(mask & (1U << i))) continue;
+    uint32_t bits;
+    memcpy(&bits, &record.values[i], sizeof(bits));
+    for (uint8_t b = 0; b < 4; b++) out[n++] = (uint8_t)(bits >> (8 * b));
+  }
+  lastTs_ = record.timestampMs;
+  return write(out, n) ? n : 0;
+}
+
+void BinaryLogger::anchorNext() {
+  if (version_ == kBlockVersion) {
+    closeBlock();
+  } else {
+    anchored_ = false;
+  }
+}
+
+uint32_t BinaryLogger::position() {
+  if (version_ != kBlockVersion) return (uint32_t)size();
+  return (uint32_t)(committedSize() << 8) | block_->rows();
+}
+
+bool BinaryLogger::flush() {
+  const bool closed = closeBlock();
+  return out_.flush() && closed;
+}
+
+bool BinaryLogger::closeBlock() {
+  if (version_ != kBlockVersion || block_->empty()) return true;
+  if (!out_.isOpen()) return false;
+  uint8_t header[TsBlockEncoder::kHeaderBytes];
+  block_->writeHeader(header);
+  const size_t bytes = block_->payloadBytes();
+  const bool ok = write(header, sizeof(header)) && write(block_->payload(), bytes);
+  block_->begin();
+  return ok;
+}
+
+bool BinaryLogger::poll() {
+  if (version_ == kBlockVersion && !block_->empty()
+      && (uint32_t)(millis() - blockStartMs_) >= out_.maxAgeMs()) {
+    closeBlock();
+  }
+  return out_.poll();
+}
+
+void BinaryLogger::end() {
+  if (!out_.isOpen()) return;
+  closeBlock();
+  out_.close();
+}
+
+size_t BinaryLogger::size() {
+  size_t open = 0;
+  if (version_ == kBlockVersion && !block_->empty()) {
+    open = TsBlockEncoder::kHeaderBytes + block_->payloadBytes();
+  }
+  return committedSize() + open;
+}
+
+size_t BinaryLogger::committedSize() {
+  if (out_.isOpen()) return out_.size();
+  if (!fs_.exists(path_)) return 0;
+  File file = fs_.open(path_, "r");
+  if (!file) return 0;
+  size_t out = file.size();
+  file.close();
+  return out;
+}
+
+bool BinaryLogger::ensureHeader() {
+  if (fs_.exists(path_)) {
+    File file = fs_.open(path_, "r");
+    if (!file) return false;
+    uint8_t header[kHeaderBytes];
+    const size_t n = file.read(header, sizeof(header));
+    file.close();
+    if (headerVersion(header, n) == version_) return true;
+    String badPath = String(path_);
+    badPath.replace(".bin", "_bad.bin");
+    if (badPath == path_) badPath += ".bad";
+    if (fs_.exists(badPath)) fs_.remove(badPath);
+    fs_.rename(path_, badPath);
+  }
+  File file = fs_.open(path_, "w");
+  if (!file) return false;
+  uint8_t header[kHeaderBytes] = {0};
+  memcpy(header, kMagic, sizeof(kMagic));
+  header[4] = version_;
+  const bool ok = file.write(header, sizeof(header)) == sizeof(header);
+  file.close();
+  return ok;
+}
+
+bool BinaryLogger::write(const uint8_t *data, size_t len) {
+  return out_.write(data, len);
+}
+
+BinaryLogReader::~BinaryLogReader() {
+  close();
+  delete block_;
+  free(blockData_);
+}
+
+bool BinaryLogReader::open(fs::FS &fs, const char *path) {
+  close();
+  if (!fs.exists(path)) return false;
+  file_ = fs.open(path, "r");
+  if (!file_) return false;
+  uint8_t header[BinaryLogger::kHeaderBytes];
+  const size_t n = file_.read(header, sizeof(header));
+  version_ = BinaryLogger::headerVersion(header, n);
+  if (version_ == 0) {
+    close();
+    return false;
+  }
+  if (version_ == BinaryLogger::kBlockVersion) {
+    if (!block_) block_ = new (std::nothrow) TsBlockDecoder();
+    if (!blockData_) blockData_ = (uint8_t *)malloc(TsBlockEncoder::kMaxPayload);
+    if (!block_ || !blockData_) {
+      close();
+      return false;
+    }
+    block_->begin(blockData_, 0, 0, 0);
+  }
+  lastTs_ = 0;
+  return true;
+}
+
+bool BinaryLogReader::available() {
+  if (!file_) return false;
+  if (version_ == BinaryLogger::kBlockVersion && block_->remaining() > 0) return true;
+  return file_.available() > 0;
+}
+
+bool BinaryLogReader::loadBlock() {
+  uint8_t header[TsBlockEncoder::kHeaderBytes];
+  blockOffset_ = (uint32_t)file_.position();
+  if (file_.read(header, sizeof(header)) != sizeof(header)) return false;
+  uint16_t bytes = 0;
+  uint16_t rows = 0;
+  uint64_t firstTs = 0;
+  if (!TsBlockDecoder::parseHeader(header, bytes, rows, firstTs)) return false;
+  if (file_.read(blockData_, bytes) != bytes) return false;
+  block_->begin(blockData_, bytes, rows, firstTs);
+  return true;
+}
+
+bool BinaryLogReader::next(BinaryLogRecord &record) {
+  if (version_ == BinaryLogger::kBlockVersion) {
+    if (!file_) return false;
+    while (block_->remaining() == 0) {
+      if (file_.available() <= 0 || !loadBlock()) return false;
+    }
+    if (!block_->next(record)) return false;
+    lastTs_ = record.timestampMs;
+    return true;
+  }
+  while (available()) {
+    const int tag = file_.read();
+    if (tag < 0) return false;
+    if (tag == BinaryLogger::kAnchorTag) {
+      uint8_t raw[8];
+      if (file_.read(raw, sizeof(raw)) != sizeof(raw)) return false;
+      lastTs_ = 0;
+      for (uint8_t i = 0; i < 8; i++) lastTs_ |= (uint64_t)raw[i] << (8 * i);
+      continue;
+    }
+    uint64_t delta = 0;
+    if (!readVarint(delta)) return false;
+    const int addrLen = file_.read();
+    if (addrLen < 0 || addrLen > BinaryLogRecord::kMaxAddr) return false;
+    record.sensorId = (uint8_t)tag;
+    record.addrLen = (uint8_t)addrLen;
+    if (addrLen > 0 && file_.read(record.addr, addrLen) != (size_t)addrLen) return false;
+    uint8_t maskRaw[2];
+    if (file_.read(maskRaw, sizeof(maskRaw)) != sizeof(maskRaw)) return false;
+    record.mask = (uint16_t)(maskRaw[0] | (maskRaw[1] << 8));
+    for (uint8_t i = 0; i < BinaryLogRecord::kMaxValues; i++) {
+      if (!(record.mask & (1U << i))) {
+        record.values[i] = NAN;
+        continue;
+      }
+      uint8_t raw[4];
+      if (file_.read(raw, sizeof(raw)) != sizeof(raw)) return false;
+      const uint32_t bits = (uint32_t)raw[0] | ((uint32_t)raw[1] << 8) | ((uint32_t)raw[2] << 16) | ((uint32_t)raw[3] << 24);
+      memcpy(&record.values[i], &bits, sizeof(bits));
+    }
+    lastTs_ += delta;
+    record.timestampMs = lastTs_;
+    return true;
+  }
+  return false;
+}
+
+bool BinaryLogReader::seek(uint32_t offset, uint64_t lastTs) {
+  if (!file_) return false;
+  if (version_ == BinaryLogger::kBlockVersion) {
+    const uint32_t blockOffset = offset >> 8;
+    uint16_t row = offset & 0xFF;
+    if (blockOffset < BinaryLogger::kHeaderBytes || blockOffset > file_.size()) return false;
+    if (!file_.seek(blockOffset)) return false;
+    block_->begin(blockData_, 0, 0, 0);
+    blockOffset_ = blockOffset;
+    lastTs_ = lastTs;
+    if (row == 0) return true;
+    if (!loadBlock()) return false;
+    BinaryLogRecord skipped;
+    while (row-- > 0) {
+      if (!block_->next(skipped)) return false;
+      lastTs_ = skipped.timestampMs;
+    }
+    return true;
+  }
+  if (offset < BinaryLogger::kHeaderBytes || offset > file_.size()) return false;
+  lastTs_ = lastTs;
+  return file_.seek(offset);
+}
+
+uint32_t BinaryLogReader::position() const {
+  if (!file_) return 0;
+  if (version_ != BinaryLogger::kBlockVersion) return (uint32_t)file_.position();
+  if (block_->remaining() == 0) return (uint32_t)file_.position() << 8;
+  return (blockOffset_ << 8) | block_->decoded();
+}
+
+void BinaryLogReader::close() {
+  if (file_) file_.close();
+}
+
+bool BinaryLogReader::readVarint(uint64_t &out) {
+  out = 0;
+  for (uint8_t shift = 0; shift < 64; shift += 7) {
+    const int b = file_.read();
+    if (b < 0) return false;
+    out |= (uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
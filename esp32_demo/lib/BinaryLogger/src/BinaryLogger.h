@@ -0,0 +1,105 @@
+#pragma once
+
+#include <Arduino.h>
+#include <BufferedFile.h>
+#include <FS.h>
+
+class TsBlockEncoder;
+class TsBlockDecoder;
+
+struct BinaryLogRecord {
+  static const uint8_t kMaxValues = 16;
+  static const uint8_t kMaxAddr = 8;
+
+  uint64_t timestampMs = 0;
+  uint8_t sensorId = 0;
+  uint8_t addrLen = 0;
+  uint8_t addr[kMaxAddr] = {0};
+  uint16_t mask = 0;
+  float values[kMaxValues] = {0};
+};
+
+// Record layout: sensor id, varint timestamp delta, address, presence mask,
+// then one little-endian float per present value. An anchor record carrying
+// the absolute timestamp precedes the first record and any clock step back.
+// Version 2 files hold TsBlock blocks instead (see TsBlock.h).
+class BinaryLogger {
+ public:
+  static const uint8_t kVersion = 1;
+  static const uint8_t kBlockVersion = 2;
+  static const size_t kHeaderBytes = 8;
+  static const uint8_t kAnchorTag = 0xFF;
+  static const size_t kMaxRecordBytes = 1 + 10 + 1 + BinaryLogRecord::kMaxAddr + 2 + BinaryLogRecord::kMaxValues * 4;
+
+  BinaryLogger(fs::FS &fs, const char *path);
+  ~BinaryLogger();
+
+  bool setBuffered(size_t bufferBytes, uint32_t maxAgeMs);
+  // Switches between record (v1) and block (v2) files; takes effect on the
+  // next begin(). Block rows stay in RAM until the block fills, flush() or
+  // poll() after the buffer age.
+  bool setBlocks(bool enabled);
+  uint8_t version() const { return version_; }
+
+  bool begin();
+  size_t append(const BinaryLogRecord &record);
+  // Makes the next record start with an anchor (v1) or a new block (v2)
+  // so position() is seekable.
+  void anchorNext();
+  // Reader position of the next record: a byte offset in v1 files, the
+  // block offset << 8 | row in v2 files.
+  uint32_t position();
+  bool flush();
+  bool poll();
+  void end();
+  size_t size();
+
+  static bool isHeader(const uint8_t *data, size_t len);
+  // 0 when data is not a binary log header.
+  static uint8_t headerVersion(const uint8_t *data, size_t len);
+
+ private:
+  fs::FS &fs_;
+  const char *path_;
+  BufferedFile out_;
+  uint64_t lastTs_ = 0;
+  bool anchored_ = false;
+  uint8_t version_ = kVersion;
+  TsBlockEncoder *block_ = nullptr;
+  uint32_t blockStartMs_ = 0;
+
+  bool ensureHeader();
+  bool write(const uint8_t *data, size_t len);
+  bool closeBlock();
+  size_t committedSize();
+};
+
+class BinaryLogReader {
+ public:
+  BinaryLogReader() = default;
+  BinaryLogReader(const BinaryLogReader &) = delete;
+  BinaryLogReader &operator=(const BinaryLogReader &) = delete;
+  ~BinaryLogReader();
+
+  bool open(fs::FS &fs, const char *path);
+  bool available();
+  bool next(BinaryLogRecord &record);
+  // Jumps to an offset written right before an anchored record, or to any
+  // record boundary when the timestamp preceding it is supplied. v2 files
+  // take the block offset << 8 | row form returned by position().
+  bool seek(uint32_t offset, uint64_t lastTs = 0);
+  uint32_t position() const;
+  uint64_t lastTimestamp() const { return lastTs_; }
+  void close();
+
+ private:
+  File file_;
+  uint64_t lastTs_ = 0;
+  uint8_t version_ = BinaryLogger::kVersion;
+  TsBlockDecoder *block_ = nullptr;
+  uint8_t *blockData_ = nullptr;
+  uint32_t blockOffset_ = 0;
+
+  bool readVarint(uint64_t &out);
+  bool loadBlock();
+};
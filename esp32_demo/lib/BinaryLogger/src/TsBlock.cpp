@@ -0,0 +1,276 @@
+#include "TsBlock.h"
+
+static uint8_t leadingZeros32(uint32_t x) {
+  uint8_t n = 0;
+  while (n < 32 && !(x & (0x80000000UL >> n))) n++;
+  return n;
+}
+
+static uint8_t trailingZeros32(uint32_t x) {
+  uint8_t n = 0;
+  while (n < 32 && !(x & (1UL << n))) n++;
+  return n;
+}
+
+static bool sameSeries(const TsSeries &s, const BinaryLogRecord &record, uint16_t mask, uint8_t addrLen) {
+  return s.sensorId == record.sensorId && s.mask == mask && s.addrLen == addrLen
+      && memcmp(s.addr, record.addr, addrLen) == 0;
+}
+
+void TsBlockEncoder::begin() {
+  bits_ = 0;
+  overflow_ = false;
+  rows_ = 0;
+  firstTs_ = 0;
+  lastTs_ = 0;
+  seriesCount_ = 0;
+}
+
+void TsBlockEncoder::putBits(uint64_t value, uint8_t count) {
+  if (bits_ + count > kMaxPayload * 8) {
+    overflow_ = true;
+    return;
+  }
+  while (count > 0) {
+    count--;
+    const uint8_t mask = (uint8_t)(0x80 >> (bits_ & 7));
+    if ((value >> count) & 1) {
+      payload_[bits_ >> 3] |= mask;
+    } else {
+      payload_[bits_ >> 3] &= (uint8_t)~mask;
+    }
+    bits_++;
+  }
+}
+
+void TsBlockEncoder::putDod(int64_t dod) {
+  if (dod == 0) {
+    putBits(0, 1);
+  } else if (dod >= -64 && dod < 64) {
+    putBits(0x2, 2);
+    putBits((uint64_t)dod, 7);
+  } else if (dod >= -256 && dod < 256) {
+    putBits(0x6, 3);
+    putBits((uint64_t)dod, 9);
+  } else if (dod >= -2048 && dod < 2048) {
+    putBits(0xE, 4);
+    putBits((uint64_t)dod, 12);
+  } else {
+    putBits(0xF, 4);
+    putBits((uint64_t)dod, 64);
+  }
+}
+
+void TsBlockEncoder::putValue(TsSeries &s, uint8_t i, uint32_t bits) {
+  const uint32_t x = bits ^ s.prev[i];
+  s.prev[i] = bits;
+  if (x == 0) {
+    putBits(0, 1);
+    return;
+  }
+  const uint8_t lead = leadingZeros32(x);
+  const uint8_t trail = trailingZeros32(x);
+  if (s.len[i] > 0 && lead >= s.lead[i] && trail >= 32 - s.lead[i] - s.len[i]) {
+    putBits(0x2, 2);
+    putBits(x >> (32 - s.lead[i] - s.len[i]), s.len[i]);
+    return;
+  }
+  const uint8_t len = 32 - lead - trail;
+  putBits(0x3, 2);
+  putBits(lead, 5);
+  putBits(len - 1, 5);
+  putBits(x >> trail, len);
+  s.lead[i] = lead;
+  s.len[i] = len;
+}
+
+bool TsBlockEncoder::append(const BinaryLogRecord &record) {
+  if (rows_ >= kMaxRows) return false;
+  const uint8_t addrLen = record.addrLen > BinaryLogRecord::kMaxAddr ? BinaryLogRecord::kMaxAddr : record.addrLen;
+  const uint16_t mask = record.mask & (uint16_t)((1UL << BinaryLogRecord::kMaxValues) - 1);
+  uint8_t slot = 0;
+  while (slot < seriesCount_ && !sameSeries(series_[slot], record, mask, addrLen)) slot++;
+  if (slot == kMaxSeries) return false;
+
+  const size_t startBits = bits_;
+  const uint64_t startLastTs = lastTs_;
+  const uint8_t startSeries = seriesCount_;
+  TsSeries saved;
+  if (slot < seriesCount_) saved = series_[slot];
+  if (rows_ == 0) {
+    firstTs_ = record.timestampMs;
+    lastTs_ = record.timestampMs;
+  }
+
+  TsSeries &s = series_[slot];
+  putBits(slot, kSlotBits);
+  if (slot == seriesCount_) {
+    putBits(record.sensorId, 8);
+    putBits(addrLen, 4);
+    for (uint8_t i = 0; i < addrLen; i++) putBits(record.addr[i], 8);
+    putBits(mask, 16);
+    s = TsSeries();
+    s.sensorId = record.sensorId;
+    s.addrLen = addrLen;
+    memcpy(s.addr, record.addr, addrLen);
+    s.mask = mask;
+    s.ts = lastTs_;
+    seriesCount_++;
+  }
+
+  const int64_t delta = (int64_t)(record.timestampMs - s.ts);
+  putDod(delta - s.delta);
+  s.delta = delta;
+  s.ts = record.timestampMs;
+  for (uint8_t i = 0; i < BinaryLogRecord::kMaxValues; i++) {
+    if (!(mask & (1U << i))) continue;
+    uint32_t bits;
+    memcpy(&bits, &record.values[i], sizeof(bits));
+    putValue(s, i, bits);
+  }
+
+  if (overflow_) {
+    bits_ = startBits;
+    overflow_ = false;
+    lastTs_ = startLastTs;
+    seriesCount_ = startSeries;
+    if (slot < startSeries) series_[slot] = saved;
+    return false;
+  }
+  lastTs_ = record.timestampMs;
+  rows_++;
+  return true;
+}
+
+void TsBlockEncoder::writeHeader(uint8_t *out) const {
+  const uint16_t bytes = (uint16_t)payloadBytes();
+  out[0] = (uint8_t)bytes;
+  out[1] = (uint8_t)(bytes >> 8);
+  out[2] = (uint8_t)rows_;
+  out[3] = (uint8_t)(rows_ >> 8);
+  for (uint8_t i = 0; i < 8; i++) out[4 + i] = (uint8_t)(firstTs_ >> (8 * i));
+}
+
+bool TsBlockDecoder::parseHeader(const uint8_t *data, uint16_t &payloadBytes, uint16_t &rows, uint64_t &firstTs) {
+  payloadBytes = (uint16_t)(data[0] | (data[1] << 8));
+  rows = (uint16_t)(data[2] | (data[3] << 8));
+  firstTs = 0;
+  for (uint8_t i = 0; i < 8; i++) firstTs |= (uint64_t)data[4 + i] << (8 * i);
+  return payloadBytes <= TsBlockEncoder::kMaxPayload && rows <= TsBlockEncoder::kMaxRows;
+}
+
+void TsBlockDecoder::begin(const uint8_t *payload, size_t len, uint16_t rows, uint64_t firstTs) {
+  payload_ = payload;
+  bitsLen_ = len * 8;
+  bits_ = 0;
+  rows_ = rows;
+  remaining_ = rows;
+  lastTs_ = firstTs;
+  seriesCount_ = 0;
+}
+
+bool TsBlockDecoder::getBits(uint8_t count, uint64_t &out) {
+  if (bits_ + count > bitsLen_) return false;
+  out = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    out = (out << 1) | ((payload_[bits_ >> 3] >> (7 - (bits_ & 7))) & 1);
+    bits_++;
+  }
+  return true;
+}
+
+bool TsBlockDecoder::getDod(int64_t &out) {
+  static const uint8_t kWidths[] = {7, 9, 12, 64};
+  uint64_t bit = 0;
+  uint8_t prefix = 0;
+  while (prefix < 4) {
+    if (!getBits(1, bit)) return false;
+    if (!bit) break;
+    prefix++;
+  }
+  if (prefix == 0) {
+    out = 0;
+    return true;
+  }
+  const uint8_t width = kWidths[prefix - 1];
+  uint64_t raw = 0;
+  if (!getBits(width, raw)) return false;
+  // Sign-extend from width bits.
+  if (width < 64 && (raw & (1ULL << (width - 1)))) raw |= ~0ULL << width;
+  out = (int64_t)raw;
+  return true;
+}
+
+bool TsBlockDecoder::getValue(TsSeries &s, uint8_t i, uint32_t &bits) {
+  uint64_t v = 0;
+  if (!getBits(1, v)) return false;
+  if (v) {
+    uint64_t fresh = 0;
+    if (!getBits(1, fresh)) return false;
+    if (fresh) {
+      uint64_t lead = 0;
+      uint64_t len = 0;
+      if (!getBits(5, lead) || !getBits(5, len)) return false;
+      len += 1;
+      if (lead + len > 32) return false;
+      s.lead[i] = (uint8_t)lead;
+      s.len[i] = (uint8_t)len;
+    } else if (s.len[i] == 0) {
+      return false;
+    }
+    uint64_t meaningful = 0;
+    if (!getBits(s.len[i], meaningful)) return false;
+    s.prev[i] ^= (uint32_t)meaningful << (32 - s.lead[i] - s.len[i]);
+  }
+  bits = s.prev[i];
+  return true;
+}
+
+bool TsBlockDecoder::next(BinaryLogRecord &record) {
+  if (remaining_ == 0) return false;
+  uint64_t slot = 0;
+  if (!getBits(TsBlockEncoder::kSlotBits, slot)) return false;
+  if (slot == seriesCount_) {
+    if (seriesCount_ >= TsBlockEncoder::kMaxSeries) return false;
+    TsSeries &s = series_[seriesCount_];
+    s = TsSeries();
+    uint64_t v = 0;
+    if (!getBits(8, v)) return false;
+    s.sensorId = (uint8_t)v;
+    if (!getBits(4, v) || v > BinaryLogRecord::kMaxAddr) return false;
+    s.addrLen = (uint8_t)v;
+    for (uint8_t i = 0; i < s.addrLen; i++) {
+      if (!getBits(8, v)) return false;
+      s.addr[i] = (uint8_t)v;
+    }
+    if (!getBits(16, v)) return false;
+    s.mask = (uint16_t)v;
+    s.ts = lastTs_;
+    slot = seriesCount_++;
+  } else if (slot > seriesCount_) {
+    return false;
+  }
+
+  TsSeries &s = series_[slot];
+  int64_t dod = 0;
+  if (!getDod(dod)) return false;
+  s.delta += dod;
+  s.ts += (uint64_t)s.delta;
+  record.timestampMs = s.ts;
+  record.sensorId = s.sensorId;
+  record.addrLen = s.addrLen;
+  memcpy(record.addr, s.addr, s.addrLen);
+  record.mask = s.mask;
+  for (uint8_t i = 0; i < BinaryLogRecord::kMaxValues; i++) {
+    if (!(s.mask & (1U << i))) {
+      record.values[i] = NAN;
+      continue;
+    }
+    uint32_t bits = 0;
+    if (!getValue(s, i, bits)) return false;
+    memcpy(&record.values[i], &bits, sizeof(bits));
+  }
+  lastTs_ = s.ts;
+  remaining_--;
+  return true;
+}
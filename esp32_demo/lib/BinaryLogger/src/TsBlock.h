@@ -0,0 +1,87 @@
+#pragma once
+
+#include <Arduino.h>
+#include "BinaryLogger.h"
+
+// Gorilla-style block of sensor rows. Rows keep their append order; each
+// row names one of up to kMaxSeries series (sensor, address, value mask)
+// declared inline on first use. Per series, timestamps are stored as
+// delta-of-delta and each value as the XOR with the series' previous one:
+//   series   4 bits slot; the next unused slot declares a new series:
+//            sensor 8, addr len 4, addr, mask 16
+//   dod      0 | 10 +7 | 110 +9 | 1110 +12 | 1111 +64 (two's complement)
+//   value    0 (same) | 10 + bits in the previous window
+//            | 11 + leading zeros 5 + length-1 5 + bits
+// Header (little endian): u16 payload bytes, u16 rows, u64 first timestamp.
+// A block starts with no series, so it decodes on its own.
+struct TsSeries {
+  uint8_t sensorId = 0;
+  uint8_t addrLen = 0;
+  uint8_t addr[BinaryLogRecord::kMaxAddr] = {0};
+  uint16_t mask = 0;
+  uint64_t ts = 0;
+  int64_t delta = 0;
+  uint32_t prev[BinaryLogRecord::kMaxValues] = {0};
+  uint8_t lead[BinaryLogRecord::kMaxValues] = {0};
+  uint8_t len[BinaryLogRecord::kMaxValues] = {0};
+};
+
+class TsBlockEncoder {
+ public:
+  static const size_t kHeaderBytes = 12;
+  static const size_t kMaxPayload = 512;
+  // One per probe on a full 1-Wire bus, plus the slot width to match.
+  static const uint8_t kMaxSeries = 16;
+  static const uint8_t kSlotBits = 4;
+  static_assert(kMaxSeries <= (1U << kSlotBits), "series slots do not fit kSlotBits");
+  static const uint16_t kMaxRows = 255;
+
+  void begin();
+  // False when the row does not fit; the block is then left unchanged.
+  bool append(const BinaryLogRecord &record);
+  void writeHeader(uint8_t *out) const;
+
+  const uint8_t *payload() const { return payload_; }
+  size_t payloadBytes() const { return (bits_ + 7) / 8; }
+  uint16_t rows() const { return rows_; }
+  bool empty() const { return rows_ == 0; }
+
+ private:
+  uint8_t payload_[kMaxPayload];
+  size_t bits_ = 0;
+  bool overflow_ = false;
+  uint16_t rows_ = 0;
+  uint64_t firstTs_ = 0;
+  uint64_t lastTs_ = 0;
+  uint8_t seriesCount_ = 0;
+  TsSeries series_[kMaxSeries];
+
+  void putBits(uint64_t value, uint8_t count);
+  void putDod(int64_t dod);
+  void putValue(TsSeries &s, uint8_t i, uint32_t bits);
+};
+
+class TsBlockDecoder {
+ public:
+  static bool parseHeader(const uint8_t *data, uint16_t &payloadBytes, uint16_t &rows, uint64_t &firstTs);
+
+  // payload must stay valid until the last next().
+  void begin(const uint8_t *payload, size_t len, uint16_t rows, uint64_t firstTs);
+  bool next(BinaryLogRecord &record);
+  uint16_t remaining() const { return remaining_; }
+  uint16_t decoded() const { return rows_ - remaining_; }
+
+ private:
+  const uint8_t *payload_ = nullptr;
+  size_t bitsLen_ = 0;
+  size_t bits_ = 0;
+  uint16_t rows_ = 0;
+  uint16_t remaining_ = 0;
+  uint64_t lastTs_ = 0;
+  uint8_t seriesCount_ = 0;
+  TsSeries series_[TsBlockEncoder::kMaxSeries];
+
+  bool getBits(uint8_t count, uint64_t &out);
+  bool getDod(int64_t &out);
+  bool getValue(TsSeries &s, uint8_t i, uint32_t &bits);
+};
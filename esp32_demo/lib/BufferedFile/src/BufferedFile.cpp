@@ -0,0 +1,61 @@
+#include "BufferedFile.h"
+
+BufferedFile::~BufferedFile() {
+  close();
+  free(buffer_);
+}
+
+bool BufferedFile::setBuffer(size_t bufferBytes, uint32_t maxAgeMs) {
+  free(buffer_);
+  buffer_ = nullptr;
+  bufferCap_ = 0;
+  bufferLen_ = 0;
+  maxAgeMs_ = maxAgeMs;
+  if (bufferBytes == 0) return true;
+  buffer_ = (uint8_t *)malloc(bufferBytes);
+  if (!buffer_) return false;
+  bufferCap_ = bufferBytes;
+  return true;
+}
+
+bool BufferedFile::open(fs::FS &fs, const char *path) {
+  if (file_) return true;
+  file_ = fs.open(path, "a");
+  return (bool)file_;
+}
+
+bool BufferedFile::write(const uint8_t *data, size_t len) {
+  if (!buffer_) return file_.write(data, len) == len;
+  if (bufferLen_ + len > bufferCap_ && !flush()) return false;
+  if (len > bufferCap_) return file_.write(data, len) == len;
+  if (bufferLen_ == 0) oldestMs_ = millis();
+  memcpy(buffer_ + bufferLen_, data, len);
+  bufferLen_ += len;
+  return true;
+}
+
+bool BufferedFile::flush() {
+  if (bufferLen_ == 0) return true;
+  if (!file_) return false;
+  const size_t written = file_.write(buffer_, bufferLen_);
+  file_.flush();
+  const bool ok = written == bufferLen_;
+  bufferLen_ = 0;
+  return ok;
+}
+
+bool BufferedFile::poll() {
+  if (bufferLen_ == 0) return true;
+  if ((uint32_t)(millis() - oldestMs_) < maxAgeMs_) return true;
+  return flush();
+}
+
+void BufferedFile::close() {
+  if (!file_) return;
+  flush();
+  file_.close();
+}
+
+size_t BufferedFile::size() {
+  return file_.size() + bufferLen_;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+// One append handle shared by the loggers. With a buffer, writes are
+// batched in RAM until it is full, the oldest pending byte is older than
+// maxAgeMs, or flush() is called; a write larger than the whole buffer goes
+// straight to the file. Without one every write goes straight through.
+class BufferedFile {
+ public:
+  BufferedFile() = default;
+  BufferedFile(const BufferedFile &) = delete;
+  BufferedFile &operator=(const BufferedFile &) = delete;
+  ~BufferedFile();
+
+  // Drops anything pending; close() first to keep it.
+  bool setBuffer(size_t bufferBytes, uint32_t maxAgeMs);
+  bool buffered() const { return buffer_ != nullptr; }
+  uint32_t maxAgeMs() const { return maxAgeMs_; }
+
+  bool open(fs::FS &fs, const char *path);
+  bool isOpen() const { return (bool)file_; }
+  bool write(const uint8_t *data, size_t len);
+  bool flush();
+  // Flushes once the oldest pending byte reaches maxAgeMs.
+  bool poll();
+  void close();
+  // Bytes on flash plus bytes pending; the handle must be open.
+  size_t size();
+
+ private:
+  File file_;
+  uint8_t *buffer_ = nullptr;
+  size_t bufferCap_ = 0;
+  size_t bufferLen_ = 0;
+  uint32_t maxAgeMs_ = 0;
+  uint32_t oldestMs_ = 0;
+};
@@ -4,11 +4,36 @@
 CsvLogger::CsvLogger(fs::FS &fs, const char *path, const char *header)
     : fs_(fs), path_(path), header_(header) {}
 
+CsvLogger::~CsvLogger() {
+  end();
+}
+
+bool CsvLogger::setBuffered(size_t bufferBytes, uint32_t maxAgeMs) {
+  end();
+  return out_.setBuffer(bufferBytes, maxAgeMs);
+}
+
 bool CsvLogger::begin(bool repair) {
-  return ensureHeader(repair);
+  if (!out_.buffered()) return ensureHeader(repair);
+  if (out_.isOpen()) return true;
+  if (!ensureHeader(repair)) return false;
+  return out_.open(fs_, path_);
+}
+
+bool CsvLogger::flush() {
+  return out_.flush();
+}
+
+bool CsvLogger::poll() {
+  return out_.poll();
+}
+
+void CsvLogger::end() {
+  out_.close();
 }
 
 size_t CsvLogger::size() {
+  if (out_.isOpen()) return out_.size();
   if (!fs_.exists(path_)) return 0;
   File file = fs_.open(path_, "r");
   if (!file) return 0;
@@ -18,6 +43,16 @@ size_t CsvLogger::size() {
 }
 
 bool CsvLogger::appendRow(const char *col1, const char *col2, const char *col3) {
+  if (out_.buffered()) {
+    if (!begin(true)) return false;
+    const char *cols[] = {col1, col2, col3};
+    for (size_t i = 0; i < 3; i++) {
+      const char *col = cols[i] ? cols[i] : "";
+      if (!bufferWrite(col, strlen(col))) return false;
+      if (!bufferWrite(i < 2 ? "," : "\n", 1)) return false;
+    }
+    return true;
+  }
   if (!ensureHeader(true)) return false;
   File file = fs_.open(path_, "a");
   if (!file) return false;
@@ -32,6 +67,11 @@ bool CsvLogger::appendRow(const char *col1, const char *col2, const char *col3)
 }
 
 bool CsvLogger::appendLine(const char *line) {
+  if (out_.buffered()) {
+    if (!begin(true)) return false;
+    const char *text = line ? line : "";
+    return bufferWrite(text, strlen(text)) && bufferWrite("\n", 1);
+  }
   if (!ensureHeader(true)) return false;
   File file = fs_.open(path_, "a");
   if (!file) return false;
@@ -41,6 +81,10 @@ bool CsvLogger::appendLine(const char *line) {
   return true;
 }
 
+bool CsvLogger::bufferWrite(const char *data, size_t len) {
+  return out_.write((const uint8_t *)data, len);
+}
+
 bool CsvLogger::ensureHeader(bool repair) {
   if (!fs_.exists(path_)) {
     File file = fs_.open(path_, "w");
@@ -98,6 +142,7 @@ bool CsvLogger::rewriteWithHeader() {
 bool CsvLogger::rotateBadFile(const String &firstLine) {
   String badPath = String(path_);
   badPath.replace(".csv", "_bad.csv");
+  if (badPath == path_) badPath += ".bad";
   if (fs_.exists(badPath)) fs_.remove(badPath);
   fs_.rename(path_, badPath);
   File file = fs_.open(path_, "w");
@@ -1,22 +1,34 @@
 #pragma once
 
 #include <Arduino.h>
+#include <BufferedFile.h>
 #include <FS.h>
 
 class CsvLogger {
  public:
   CsvLogger(fs::FS &fs, const char *path, const char *header);
+  ~CsvLogger();
+
+  // Buffered mode: the header is checked once in begin(), one handle stays
+  // open and rows are batched in RAM until the buffer is full, the oldest
+  // pending row is older than maxAgeMs, or flush() is called.
+  bool setBuffered(size_t bufferBytes, uint32_t maxAgeMs);
 
   bool begin(bool repair = true);
   bool appendRow(const char *col1, const char *col2, const char *col3);
   bool appendLine(const char *line);
+  bool flush();
+  bool poll();
+  void end();
   size_t size();
 
  private:
   fs::FS &fs_;
   const char *path_;
   const char *header_;
+  BufferedFile out_;
 
+  bool bufferWrite(const char *data, size_t len);
   bool ensureHeader(bool repair);
   bool rewriteWithHeader();
   bool rotateBadFile(const String &firstLine);
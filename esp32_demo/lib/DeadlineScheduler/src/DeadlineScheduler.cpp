@@ -0,0 +1,78 @@
+#include "DeadlineScheduler.h"
+
+int DeadlineScheduler::find(Job job) const {
+  for (uint8_t i = 0; i < count_; i++) {
+    if (heap_[i].job == job) return i;
+  }
+  return -1;
+}
+
+void DeadlineScheduler::siftUp(uint8_t index) {
+  while (index > 0) {
+    const uint8_t parent = (uint8_t)((index - 1) / 2);
+    if (!before(heap_[index], heap_[parent])) break;
+    const Entry tmp = heap_[index];
+    heap_[index] = heap_[parent];
+    heap_[parent] = tmp;
+    index = parent;
+  }
+}
+
+void DeadlineScheduler::siftDown(uint8_t index) {
+  for (;;) {
+    const uint8_t left = (uint8_t)(index * 2 + 1);
+    const uint8_t right = (uint8_t)(left + 1);
+    uint8_t smallest = index;
+    if (left < count_ && before(heap_[left], heap_[smallest])) smallest = left;
+    if (right < count_ && before(heap_[right], heap_[smallest])) smallest = right;
+    if (smallest == index) return;
+    const Entry tmp = heap_[index];
+    heap_[index] = heap_[smallest];
+    heap_[smallest] = tmp;
+    index = smallest;
+  }
+}
+
+void DeadlineScheduler::removeAt(uint8_t index) {
+  count_--;
+  if (index == count_) return;
+  heap_[index] = heap_[count_];
+  siftDown(index);
+  siftUp(index);
+}
+
+bool DeadlineScheduler::scheduleAt(uint32_t deadlineMs, Job job) {
+  if (!job) return false;
+  const int existing = find(job);
+  if (existing >= 0) removeAt((uint8_t)existing);
+  if (count_ >= kMaxJobs) return false;
+  heap_[count_].deadlineMs = deadlineMs;
+  heap_[count_].job = job;
+  siftUp(count_);
+  count_++;
+  return true;
+}
+
+void DeadlineScheduler::cancel(Job job) {
+  const int existing = find(job);
+  if (existing >= 0) removeAt((uint8_t)existing);
+}
+
+uint32_t DeadlineScheduler::msUntilNext(uint32_t nowMs) const {
+  if (count_ == 0) return kIdle;
+  const int32_t left = (int32_t)(heap_[0].deadlineMs - nowMs);
+  return left > 0 ? (uint32_t)left : 0;
+}
+
+uint32_t DeadlineScheduler::runDue(uint32_t nowMs) {
+  // Only the jobs due on entry run; each is removed before it is called so
+  // it can reschedule itself.
+  Job due[kMaxJobs];
+  uint8_t dueCount = 0;
+  while (count_ > 0 && (int32_t)(heap_[0].deadlineMs - nowMs) <= 0) {
+    due[dueCount++] = heap_[0].job;
+    removeAt(0);
+  }
+  for (uint8_t i = 0; i < dueCount; i++) due[i]();
+  return msUntilNext(millis());
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Jobs keyed by their function: each job is pending at most once, and
+// scheduling it again moves its deadline. A job reschedules itself when it
+// is periodic. Deadlines are millis() values compared modulo 2^32, so they
+// must stay within ~24 days of now. Not thread-safe: one task owns it.
+class DeadlineScheduler {
+ public:
+  typedef void (*Job)();
+  static const uint8_t kMaxJobs = 16;
+  static const uint32_t kIdle = UINT32_MAX;
+
+  bool scheduleAt(uint32_t deadlineMs, Job job);
+  bool scheduleIn(uint32_t delayMs, Job job) { return scheduleAt(millis() + delayMs, job); }
+  void cancel(Job job);
+  bool pending(Job job) const { return find(job) >= 0; }
+
+  // Runs the jobs due at nowMs, earliest first, then returns the time
+  // until the next deadline or kIdle. Jobs a job schedules for nowMs or
+  // earlier run on the next call, so a job cannot starve the caller.
+  uint32_t runDue(uint32_t nowMs);
+  uint32_t msUntilNext(uint32_t nowMs) const;
+
+ private:
+  struct Entry {
+    uint32_t deadlineMs;
+    Job job;
+  };
+
+  Entry heap_[kMaxJobs];
+  uint8_t count_ = 0;
+
+  static bool before(const Entry &a, const Entry &b) { return (int32_t)(a.deadlineMs - b.deadlineMs) < 0; }
+  int find(Job job) const;
+  void removeAt(uint8_t index);
+  void siftUp(uint8_t index);
+  void siftDown(uint8_t index);
+};
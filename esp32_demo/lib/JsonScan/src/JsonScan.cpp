@@ -0,0 +1,221 @@
+#include "JsonScan.h"
+
+static bool isJsonSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool isLiteralEnd(char c) {
+  return isJsonSpace(c) || c == ',' || c == ':' || c == '}' || c == ']' || c == '{' || c == '[';
+}
+
+static char lowerAscii(char c) {
+  return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+// Trims the span and strips one leading sign; returns false without digits.
+static bool numberDigits(const JsonSpan &text, bool &negative, const char *&p, const char *&end) {
+  p = text.ptr;
+  end = text.ptr + text.len;
+  while (p < end && isJsonSpace(*p)) p++;
+  negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  return p < end && *p >= '0' && *p <= '9';
+}
+
+// Like strtoull: leading digits only, saturating.
+static uint64_t parseDigits(const char *p, const char *end) {
+  uint64_t value = 0;
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    const uint64_t digit = (uint64_t)(*p - '0');
+    if (value > (UINT64_MAX - digit) / 10) return UINT64_MAX;
+    value = value * 10 + digit;
+  }
+  return value;
+}
+
+bool JsonSpan::equals(const char *text) const {
+  if (!text) return false;
+  size_t i = 0;
+  for (; i < len; i++) {
+    if (text[i] == '\0' || text[i] != ptr[i]) return false;
+  }
+  return text[i] == '\0';
+}
+
+bool JsonToken::toInt(int &out) const {
+  if (!isScalar()) return false;
+  bool negative = false;
+  const char *p = nullptr;
+  const char *end = nullptr;
+  if (!numberDigits(text, negative, p, end)) return false;
+  const uint64_t value = parseDigits(p, end);
+  if (value > (uint64_t)INT32_MAX) return false;
+  out = negative ? -(int)value : (int)value;
+  return true;
+}
+
+bool JsonToken::toU32(uint32_t &out) const {
+  if (!isScalar()) return false;
+  bool negative = false;
+  const char *p = nullptr;
+  const char *end = nullptr;
+  if (!numberDigits(text, negative, p, end)) return false;
+  const uint64_t value = parseDigits(p, end);
+  if (negative && value != 0) return false;
+  if (value > UINT32_MAX) return false;
+  out = (uint32_t)value;
+  return true;
+}
+
+bool JsonToken::toU64(uint64_t &out) const {
+  if (!isScalar()) return false;
+  bool negative = false;
+  const char *p = nullptr;
+  const char *end = nullptr;
+  if (!numberDigits(text, negative, p, end)) return false;
+  if (negative) return false;
+  out = parseDigits(p, end);
+  return true;
+}
+
+bool JsonToken::toBool(bool &out) const {
+  if (!isScalar()) return false;
+  const char *p = text.ptr;
+  const char *end = text.ptr + text.len;
+  while (p < end && isJsonSpace(*p)) p++;
+  while (end > p && isJsonSpace(end[-1])) end--;
+  char word[6];
+  const size_t n = (size_t)(end - p);
+  if (n == 0 || n >= sizeof(word)) return false;
+  for (size_t i = 0; i < n; i++) word[i] = lowerAscii(p[i]);
+  word[n] = '\0';
+  if (strcmp(word, "true") == 0 || strcmp(word, "1") == 0 || strcmp(word, "yes") == 0 || strcmp(word, "on") == 0) {
+    out = true;
+    return true;
+  }
+  if (strcmp(word, "false") == 0 || strcmp(word, "0") == 0 || strcmp(word, "no") == 0 || strcmp(word, "off") == 0) {
+    out = false;
+    return true;
+  }
+  return false;
+}
+
+void JsonScanner::skipSpace() {
+  while (p_ < end_ && isJsonSpace(*p_)) p_++;
+}
+
+bool JsonScanner::readString(JsonSpan &out) {
+  const char quote = *p_++;
+  const char *start = p_;
+  while (p_ < end_ && *p_ != quote) {
+    if (*p_ == '\\') p_++;
+    if (p_ < end_) p_++;
+  }
+  if (p_ >= end_) return false;
+  out.ptr = start;
+  out.len = (size_t)(p_ - start);
+  p_++;
+  return true;
+}
+
+bool JsonScanner::readLiteral(JsonSpan &out) {
+  const char *start = p_;
+  while (p_ < end_ && !isLiteralEnd(*p_) && *p_ != '"' && *p_ != '\'') p_++;
+  out.ptr = start;
+  out.len = (size_t)(p_ - start);
+  return out.len > 0;
+}
+
+bool JsonScanner::skipArray(uint8_t depth) {
+  if (depth >= kMaxDepth) return false;
+  p_++;
+  for (;;) {
+    skipSpace();
+    if (p_ >= end_) return false;
+    const char c = *p_;
+    if (c == ']') {
+      p_++;
+      return true;
+    }
+    if (c == ',') {
+      p_++;
+      continue;
+    }
+    JsonSpan ignored;
+    if (c == '"' || c == '\'') {
+      if (!readString(ignored)) return false;
+    } else if (c == '[') {
+      if (!skipArray(depth + 1)) return false;
+    } else if (c == '{') {
+      if (!scanObject(ignored, depth + 1, nullptr, nullptr)) return false;
+    } else if (!readLiteral(ignored)) {
+      return false;
+    }
+  }
+}
+
+bool JsonScanner::scanObject(const JsonSpan &parent, uint8_t depth, JsonMemberFn fn, void *ctx) {
+  if (depth >= kMaxDepth) return false;
+  p_++;
+  for (;;) {
+    skipSpace();
+    if (p_ >= end_) return false;
+    if (*p_ == '}') {
+      p_++;
+      return true;
+    }
+    if (*p_ == ',') {
+      p_++;
+      continue;
+    }
+
+    JsonSpan key;
+    if (*p_ == '"' || *p_ == '\'') {
+      if (!readString(key)) return false;
+    } else if (!readLiteral(key)) {
+      return false;
+    }
+    skipSpace();
+    if (p_ >= end_ || *p_ != ':') return false;
+    p_++;
+    skipSpace();
+    if (p_ >= end_) return false;
+
+    JsonToken value;
+    const char *start = p_;
+    const char c = *p_;
+    if (c == '{') {
+      value.type = JsonType::Object;
+      // The span is only known once the object is closed, so the member is
+      // reported with the opening brace and its children follow.
+      value.text.ptr = start;
+      value.text.len = 1;
+      if (fn) fn(ctx, parent, key, value);
+      if (!scanObject(key, depth + 1, fn, ctx)) return false;
+      continue;
+    }
+    if (c == '[') {
+      if (!skipArray(depth + 1)) return false;
+      value.type = JsonType::Array;
+      value.text.ptr = start;
+      value.text.len = (size_t)(p_ - start);
+    } else if (c == '"' || c == '\'') {
+      value.type = JsonType::String;
+      if (!readString(value.text)) return false;
+    } else {
+      value.type = JsonType::Literal;
+      if (!readLiteral(value.text)) return false;
+    }
+    if (fn) fn(ctx, parent, key, value);
+  }
+}
+
+bool JsonScanner::scan(JsonMemberFn fn, void *ctx) {
+  skipSpace();
+  if (p_ >= end_ || *p_ != '{') return false;
+  const JsonSpan top;
+  return scanObject(top, 0, fn, ctx);
+}
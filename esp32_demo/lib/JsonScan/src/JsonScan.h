@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Spans point into the scanned buffer; nothing is copied or decoded.
+struct JsonSpan {
+  const char *ptr = nullptr;
+  size_t len = 0;
+
+  bool empty() const { return len == 0; }
+  bool equals(const char *text) const;
+};
+
+enum class JsonType : uint8_t {
+  String,   // quoted, span excludes the quotes, escapes left as-is
+  Literal,  // bare number, true/false/null or unquoted word
+  Object,   // span is the opening brace, members are reported next
+  Array,    // span covers the brackets
+};
+
+struct JsonToken {
+  JsonType type = JsonType::Literal;
+  JsonSpan text;
+
+  bool isScalar() const { return type == JsonType::String || type == JsonType::Literal; }
+  // Scalar conversions; quoted numbers are accepted like bare ones.
+  bool toInt(int &out) const;
+  bool toU32(uint32_t &out) const;
+  bool toU64(uint64_t &out) const;
+  bool toBool(bool &out) const;
+};
+
+// parent is the key of the enclosing object, empty at the top level.
+typedef void (*JsonMemberFn)(void *ctx, const JsonSpan &parent, const JsonSpan &key, const JsonToken &value);
+
+// Walks an object in one pass and reports every member, nested objects
+// included (the object member comes first, then its own members). Arrays
+// are reported but not entered. Single quotes and unquoted words are
+// accepted for hand-typed writes. Returns false on malformed input or
+// nesting deeper than kMaxDepth; members seen before the error were
+// already reported.
+class JsonScanner {
+ public:
+  static const uint8_t kMaxDepth = 8;
+
+  JsonScanner(const char *data, size_t len) : p_(data), end_(data + len) {}
+
+  bool scan(JsonMemberFn fn, void *ctx);
+
+ private:
+  const char *p_;
+  const char *end_;
+
+  void skipSpace();
+  bool readString(JsonSpan &out);
+  bool readLiteral(JsonSpan &out);
+  bool skipArray(uint8_t depth);
+  bool scanObject(const JsonSpan &parent, uint8_t depth, JsonMemberFn fn, void *ctx);
+};
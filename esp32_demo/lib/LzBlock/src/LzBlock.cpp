@@ -0,0 +1,89 @@
+#include "LzBlock.h"
+
+LzBlockEncoder::~LzBlockEncoder() {
+  end();
+}
+
+bool LzBlockEncoder::begin() {
+  if (ready()) return true;
+  head_ = (uint16_t *)malloc(sizeof(uint16_t) << kHashBits);
+  prev_ = (uint16_t *)malloc(sizeof(uint16_t) * kWindow);
+  if (head_ && prev_) return true;
+  end();
+  return false;
+}
+
+void LzBlockEncoder::end() {
+  free(head_);
+  free(prev_);
+  head_ = nullptr;
+  prev_ = nullptr;
+}
+
+uint16_t LzBlockEncoder::hash(const uint8_t *p) {
+  const uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+  return (uint16_t)((uint32_t)(v * 2654435761U) >> (32 - kHashBits));
+}
+
+void LzBlockEncoder::insert(const uint8_t *in, size_t inLen, size_t pos) {
+  if (pos + kMinMatch > inLen) return;
+  const uint16_t h = hash(in + pos);
+  prev_[pos] = head_[h];
+  head_[h] = (uint16_t)pos;
+}
+
+size_t LzBlockEncoder::compress(const uint8_t *in, size_t inLen, uint8_t *out, size_t outCap, size_t &consumed) {
+  consumed = 0;
+  if (!ready()) return 0;
+  if (inLen > kWindow) inLen = kWindow;
+  memset(head_, 0xFF, sizeof(uint16_t) << kHashBits);
+
+  size_t pos = 0;
+  size_t n = 0;
+  size_t flagAt = 0;
+  uint8_t bit = 8;
+  while (pos < inLen) {
+    // Room for the worst case: a new flag byte plus a match.
+    if (bit == 8) {
+      if (n + 3 > outCap) break;
+      flagAt = n++;
+      out[flagAt] = 0;
+      bit = 0;
+    } else if (n + 2 > outCap) {
+      break;
+    }
+
+    size_t bestLen = 0;
+    size_t bestDist = 0;
+    if (pos + kMinMatch <= inLen) {
+      const size_t maxLen = inLen - pos < kMaxMatch ? inLen - pos : kMaxMatch;
+      uint16_t cand = head_[hash(in + pos)];
+      for (uint16_t chain = 0; cand != kNone && chain < kMaxChain; chain++) {
+        size_t len = 0;
+        while (len < maxLen && in[cand + len] == in[pos + len]) len++;
+        if (len > bestLen) {
+          bestLen = len;
+          bestDist = pos - cand;
+          if (len == maxLen) break;
+        }
+        cand = prev_[cand];
+      }
+    }
+
+    if (bestLen >= kMinMatch) {
+      const size_t d = bestDist - 1;
+      out[n++] = (uint8_t)d;
+      out[n++] = (uint8_t)(((d >> 8) << 5) | (bestLen - kMinMatch));
+      out[flagAt] |= (uint8_t)(1U << bit);
+      for (size_t i = 0; i < bestLen; i++) insert(in, inLen, pos + i);
+      pos += bestLen;
+    } else {
+      out[n++] = in[pos];
+      insert(in, inLen, pos);
+      pos++;
+    }
+    bit++;
+  }
+  consumed = pos;
+  return n;
+}
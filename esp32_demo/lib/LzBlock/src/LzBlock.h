@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+
+// LZSS over one self-contained block: a flag byte announces the next eight
+// items (LSB first, 1 = match), a literal is one byte and a match is two:
+// 11-bit distance - 1 and 5-bit length - 3, so distance 1..2048, length 3..34.
+//   match[0] = (distance - 1) & 0xFF
+//   match[1] = ((distance - 1) >> 8) << 5 | (length - 3)
+// Every block starts with an empty dictionary, so a lost or resent block
+// never depends on another one. Output ends with the block.
+class LzBlockEncoder {
+ public:
+  static const size_t kWindow = 2048;
+  static const uint8_t kMinMatch = 3;
+  static const uint8_t kMaxMatch = 34;
+
+  ~LzBlockEncoder();
+
+  bool begin();
+  void end();
+  bool ready() const { return head_ != nullptr; }
+
+  // Compresses a prefix of in (at most kWindow bytes) into out and returns
+  // the output length; consumed tells how much of in that prefix covers.
+  size_t compress(const uint8_t *in, size_t inLen, uint8_t *out, size_t outCap, size_t &consumed);
+
+ private:
+  static const uint16_t kHashBits = 10;
+  static const uint16_t kMaxChain = 16;
+  static const uint16_t kNone = 0xFFFF;
+
+  uint16_t *head_ = nullptr;
+  uint16_t *prev_ = nullptr;
+
+  static uint16_t hash(const uint8_t *p);
+  void insert(const uint8_t *in, size_t inLen, size_t pos);
+};
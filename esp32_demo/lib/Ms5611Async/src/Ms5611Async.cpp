@@ -0,0 +1,158 @@
+#include "Ms5611Async.h"
+
+static const uint8_t CMD_RESET = 0x1E;
+static const uint8_t CMD_CONVERT_D1 = 0x40;
+static const uint8_t CMD_CONVERT_D2 = 0x50;
+static const uint8_t CMD_ADC_READ = 0x00;
+static const uint8_t CMD_PROM_READ = 0xA0;
+
+bool Ms5611Async::command(uint8_t cmd) {
+  wire_.beginTransmission(addr_);
+  wire_.write(cmd);
+  return wire_.endTransmission() == 0;
+}
+
+// A read issued before the conversion ended, or during one, returns 0.
+bool Ms5611Async::readAdc(uint32_t &value) {
+  if (!command(CMD_ADC_READ)) return false;
+  if (wire_.requestFrom((int)addr_, 3) != 3) return false;
+  value = 0;
+  for (uint8_t i = 0; i < 3; i++) {
+    if (!wire_.available()) return false;
+    value = (value << 8) | (uint8_t)wire_.read();
+  }
+  return value != 0;
+}
+
+bool Ms5611Async::checkCrc(const uint16_t *prom) {
+  uint16_t words[8];
+  memcpy(words, prom, sizeof(words));
+  const uint16_t expected = words[7] & 0x000F;
+  words[7] &= 0xFF00;
+  uint16_t rem = 0;
+  for (uint8_t i = 0; i < 16; i++) {
+    rem ^= (i & 1) ? (words[i >> 1] & 0x00FF) : (words[i >> 1] >> 8);
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      rem = (rem & 0x8000) ? (uint16_t)((rem << 1) ^ 0x3000) : (uint16_t)(rem << 1);
+    }
+  }
+  return ((rem >> 12) & 0x000F) == expected;
+}
+
+bool Ms5611Async::begin(uint8_t addr) {
+  addr_ = addr;
+  phase_ = Phase::Idle;
+  haveD2_ = false;
+  valid_ = false;
+  if (!command(CMD_RESET)) return false;
+  delay(3);
+  bool blank = true;
+  for (uint8_t i = 0; i < 8; i++) {
+    if (!command(CMD_PROM_READ + i * 2)) return false;
+    if (wire_.requestFrom((int)addr_, 2) != 2 || wire_.available() < 2) return false;
+    const uint8_t hi = (uint8_t)wire_.read();
+    const uint8_t lo = (uint8_t)wire_.read();
+    prom_[i] = (uint16_t)((hi << 8) | lo);
+    if (i >= 1 && i <= 6 && prom_[i] != 0 && prom_[i] != 0xFFFF) blank = false;
+  }
+  crcOk_ = checkCrc(prom_);
+  return !blank;
+}
+
+uint32_t Ms5611Async::conversionUs(Osr osr) {
+  switch (osr) {
+    case OSR_256: return 650;
+    case OSR_512: return 1250;
+    case OSR_1024: return 2400;
+    case OSR_2048: return 4650;
+    default: return 9200;
+  }
+}
+
+bool Ms5611Async::osrFromSamples(uint32_t samples, Osr &out) {
+  switch (samples) {
+    case 256: out = OSR_256; return true;
+    case 512: out = OSR_512; return true;
+    case 1024: out = OSR_1024; return true;
+    case 2048: out = OSR_2048; return true;
+    case 4096: out = OSR_4096; return true;
+    default: return false;
+  }
+}
+
+bool Ms5611Async::convert(uint8_t base, uint32_t nowUs) {
+  if (!command((uint8_t)(base + osr_))) return false;
+  dueUs_ = nowUs + conversionUs(osr_);
+  return true;
+}
+
+bool Ms5611Async::start(uint32_t nowUs) {
+  if (busy()) return false;
+  const bool needTemp = !haveD2_ || cyclesSinceTemp_ + 1 >= tempEvery_;
+  if (needTemp) {
+    if (!convert(CMD_CONVERT_D2, nowUs)) {
+      failures_++;
+      return false;
+    }
+    phase_ = Phase::Temperature;
+    return true;
+  }
+  if (!convert(CMD_CONVERT_D1, nowUs)) {
+    failures_++;
+    return false;
+  }
+  cyclesSinceTemp_++;
+  phase_ = Phase::Pressure;
+  return true;
+}
+
+bool Ms5611Async::poll(uint32_t nowUs) {
+  if (!busy() || (int32_t)(nowUs - dueUs_) < 0) return false;
+  uint32_t value = 0;
+  if (!readAdc(value)) {
+    phase_ = Phase::Idle;
+    failures_++;
+    return false;
+  }
+  if (phase_ == Phase::Temperature) {
+    d2_ = value;
+    haveD2_ = true;
+    cyclesSinceTemp_ = 0;
+    if (!convert(CMD_CONVERT_D1, nowUs)) {
+      phase_ = Phase::Idle;
+      failures_++;
+      return false;
+    }
+    phase_ = Phase::Pressure;
+    return false;
+  }
+  phase_ = Phase::Idle;
+  compute(value);
+  return true;
+}
+
+// Datasheet first and second order compensation, in 0.01 degC and 0.01 mbar.
+void Ms5611Async::compute(uint32_t d1) {
+  const int64_t dT = (int64_t)d2_ - ((int64_t)prom_[5] << 8);
+  int64_t temp = 2000 + ((dT * (int64_t)prom_[6]) >> 23);
+  int64_t off = ((int64_t)prom_[2] << 16) + (((int64_t)prom_[4] * dT) >> 7);
+  int64_t sens = ((int64_t)prom_[1] << 15) + (((int64_t)prom_[3] * dT) >> 8);
+  if (temp < 2000) {
+    const int64_t t2 = (dT * dT) >> 31;
+    const int64_t low = (temp - 2000) * (temp - 2000);
+    int64_t off2 = 5 * low / 2;
+    int64_t sens2 = 5 * low / 4;
+    if (temp < -1500) {
+      const int64_t veryLow = (temp + 1500) * (temp + 1500);
+      off2 += 7 * veryLow;
+      sens2 += 11 * veryLow / 2;
+    }
+    temp -= t2;
+    off -= off2;
+    sens -= sens2;
+  }
+  const int64_t p = ((((int64_t)d1 * sens) >> 21) - off) >> 15;
+  tempC_ = (float)temp / 100.0f;
+  pressHpa_ = (float)p / 100.0f;
+  valid_ = true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// MS5611 driver that never waits for a conversion: start() issues the
+// first command and returns, poll() reads each ADC result once its
+// conversion time has elapsed and issues the next command. A cycle is a
+// temperature (D2) then a pressure (D1) conversion; with
+// setTemperatureEvery(n) only every n-th cycle converts D2, which nearly
+// doubles the pressure rate in continuous use.
+class Ms5611Async {
+ public:
+  enum Osr : uint8_t { OSR_256 = 0, OSR_512 = 2, OSR_1024 = 4, OSR_2048 = 6, OSR_4096 = 8 };
+
+  explicit Ms5611Async(TwoWire &wire = Wire) : wire_(wire) {}
+
+  // Reset and PROM read; blocks ~3 ms for the reset. False when the chip
+  // does not answer or the PROM is blank.
+  bool begin(uint8_t addr);
+  // AN520 CRC of the PROM read by begin(); some clones get it wrong.
+  bool promCrcOk() const { return crcOk_; }
+  uint8_t address() const { return addr_; }
+
+  void setOversampling(Osr osr) { osr_ = osr; }
+  Osr oversampling() const { return osr_; }
+  void setTemperatureEvery(uint8_t cycles) { tempEvery_ = cycles ? cycles : 1; }
+
+  // False when a cycle is already running or the command was not acked.
+  bool start(uint32_t nowUs);
+  // True once per completed cycle. Before dueUs() it returns false without
+  // touching the bus; a failed ADC read ends the cycle (busy() is false).
+  bool poll(uint32_t nowUs);
+  bool busy() const { return phase_ != Phase::Idle; }
+  uint32_t dueUs() const { return dueUs_; }
+  uint32_t failures() const { return failures_; }
+
+  bool valid() const { return valid_; }
+  float temperatureC() const { return tempC_; }
+  float pressureHpa() const { return pressHpa_; }
+
+  // Datasheet maximum plus a small margin.
+  static uint32_t conversionUs(Osr osr);
+  // 256, 512, 1024, 2048 or 4096 samples.
+  static bool osrFromSamples(uint32_t samples, Osr &out);
+  static uint32_t samplesFromOsr(Osr osr) { return 256UL << (osr / 2); }
+
+ private:
+  enum class Phase : uint8_t { Idle, Temperature, Pressure };
+
+  TwoWire &wire_;
+  uint8_t addr_ = 0;
+  uint16_t prom_[8] = {0};
+  bool crcOk_ = false;
+  Osr osr_ = OSR_4096;
+  uint8_t tempEvery_ = 1;
+  uint8_t cyclesSinceTemp_ = 0;
+  Phase phase_ = Phase::Idle;
+  uint32_t dueUs_ = 0;
+  uint32_t d2_ = 0;
+  bool haveD2_ = false;
+  uint32_t failures_ = 0;
+  bool valid_ = false;
+  float tempC_ = NAN;
+  float pressHpa_ = NAN;
+
+  bool command(uint8_t cmd);
+  bool readAdc(uint32_t &value);
+  bool convert(uint8_t base, uint32_t nowUs);
+  void compute(uint32_t d1);
+  static bool checkCrc(const uint16_t *prom);
+};
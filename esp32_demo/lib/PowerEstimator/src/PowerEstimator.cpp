@@ -0,0 +1,39 @@
+#include "PowerEstimator.h"
+
+void PowerEstimator::begin(uint64_t nowUs) {
+  startUs_ = nowUs;
+  idleUs_ = 0;
+  sleepUs_ = 0;
+  busyUs_.store(0, std::memory_order_relaxed);
+}
+
+void PowerEstimator::addWait(uint64_t us, bool canSleep) {
+  const uint32_t busy = busyUs_.exchange(0, std::memory_order_relaxed);
+  if (busy >= us) return;
+  us -= busy;
+  if (canSleep) {
+    sleepUs_ += us;
+  } else {
+    idleUs_ += us;
+  }
+}
+
+uint32_t PowerEstimator::averageUa(uint64_t nowUs) const {
+  const uint64_t total = elapsedUs(nowUs);
+  if (total == 0) return model_.activeUa;
+  const uint64_t waited = idleUs_ + sleepUs_;
+  const uint64_t active = total > waited ? total - waited : 0;
+  // Millisecond resolution keeps the products well inside 64 bits.
+  const uint64_t charge = (active / 1000) * model_.activeUa
+    + (idleUs_ / 1000) * model_.idleUa
+    + (sleepUs_ / 1000) * model_.sleepUa;
+  const uint64_t totalMs = total / 1000;
+  return totalMs ? (uint32_t)(charge / totalMs) : model_.activeUa;
+}
+
+uint32_t PowerEstimator::sleepPermille(uint64_t nowUs) const {
+  const uint64_t total = elapsedUs(nowUs);
+  if (total == 0) return 0;
+  const uint64_t permille = sleepUs_ * 1000 / total;
+  return permille > 1000 ? 1000 : (uint32_t)permille;
+}
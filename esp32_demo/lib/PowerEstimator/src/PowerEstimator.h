@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+// Typical supply current of each state, in microamps.
+struct PowerModel {
+  uint32_t activeUa;  // CPU running
+  uint32_t idleUa;    // CPU halted, light sleep not allowed
+  uint32_t sleepUa;   // light sleep
+};
+
+// There is no current sensor on the board: wall time is split into
+// active, idle and light-sleep time and each share is weighted by its
+// PowerModel current. Time is counted from begin().
+class PowerEstimator {
+ public:
+  explicit PowerEstimator(const PowerModel &model) : model_(model) {}
+
+  void begin(uint64_t nowUs);
+  // Any task: time spent working while the owner task was waiting.
+  void addBusy(uint32_t us) { busyUs_.fetch_add(us, std::memory_order_relaxed); }
+  // Owner task, after each wait. Busy time reported since the previous
+  // wait is taken out of it.
+  void addWait(uint64_t us, bool canSleep);
+
+  uint32_t averageUa(uint64_t nowUs) const;
+  // Per mille of the elapsed time spent in light sleep.
+  uint32_t sleepPermille(uint64_t nowUs) const;
+  uint64_t elapsedUs(uint64_t nowUs) const { return nowUs > startUs_ ? nowUs - startUs_ : 0; }
+
+ private:
+  PowerModel model_;
+  uint64_t startUs_ = 0;
+  uint64_t idleUs_ = 0;
+  uint64_t sleepUs_ = 0;
+  std::atomic<uint32_t> busyUs_{0};
+};
@@ -0,0 +1,88 @@
+#include "RtcLog.h"
+
+static const uint8_t kTickEnd = 0x80;
+
+static void putLe(uint8_t *out, uint32_t value, uint8_t bytes) {
+  for (uint8_t i = 0; i < bytes; i++) out[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint32_t getLe(const uint8_t *in, uint8_t bytes) {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < bytes; i++) value |= (uint32_t)in[i] << (8 * i);
+  return value;
+}
+
+void RtcLog::attach() {
+  if (store_.magic == RtcLogStore::kMagic && store_.used <= RtcLogStore::kBytes) return;
+  clear();
+}
+
+void RtcLog::clear() {
+  store_.magic = RtcLogStore::kMagic;
+  store_.used = 0;
+  store_.rows = 0;
+  store_.baseMs = 0;
+}
+
+size_t RtcLog::packedSize(const BinaryLogRecord &record) {
+  size_t values = 0;
+  for (uint8_t i = 0; i < BinaryLogRecord::kMaxValues; i++) {
+    if (record.mask & (1U << i)) values++;
+  }
+  const uint8_t addrLen = record.addrLen > BinaryLogRecord::kMaxAddr ? BinaryLogRecord::kMaxAddr : record.addrLen;
+  return 1 + 4 + 1 + addrLen + 2 + values * 4;
+}
+
+bool RtcLog::append(const BinaryLogRecord &record, bool tickEnd) {
+  const size_t size = packedSize(record);
+  if (size > room()) return false;
+  if (store_.rows == 0) store_.baseMs = record.timestampMs;
+  if (record.timestampMs < store_.baseMs || record.timestampMs - store_.baseMs > UINT32_MAX) return false;
+
+  uint8_t *out = store_.data + store_.used;
+  *out++ = (uint8_t)((record.sensorId & 0x7F) | (tickEnd ? kTickEnd : 0));
+  putLe(out, (uint32_t)(record.timestampMs - store_.baseMs), 4);
+  out += 4;
+  const uint8_t addrLen = record.addrLen > BinaryLogRecord::kMaxAddr ? BinaryLogRecord::kMaxAddr : record.addrLen;
+  *out++ = addrLen;
+  memcpy(out, record.addr, addrLen);
+  out += addrLen;
+  putLe(out, record.mask, 2);
+  out += 2;
+  for (uint8_t i = 0; i < BinaryLogRecord::kMaxValues; i++) {
+    if (!(record.mask & (1U << i))) continue;
+    uint32_t bits = 0;
+    memcpy(&bits, &record.values[i], 4);
+    putLe(out, bits, 4);
+    out += 4;
+  }
+  store_.used = (uint16_t)(store_.used + size);
+  store_.rows++;
+  return true;
+}
+
+void RtcLog::forEach(RtcLogRowFn fn, void *ctx) const {
+  const uint8_t *in = store_.data;
+  const uint8_t *end = store_.data + store_.used;
+  for (uint16_t row = 0; row < store_.rows && end - in >= 8; row++) {
+    BinaryLogRecord record;
+    const bool tickEnd = (*in & kTickEnd) != 0;
+    record.sensorId = (uint8_t)(*in++ & 0x7F);
+    record.timestampMs = store_.baseMs + getLe(in, 4);
+    in += 4;
+    record.addrLen = *in++;
+    if (record.addrLen > BinaryLogRecord::kMaxAddr || end - in < record.addrLen + 2) return;
+    memcpy(record.addr, in, record.addrLen);
+    in += record.addrLen;
+    record.mask = (uint16_t)getLe(in, 2);
+    in += 2;
+    for (uint8_t i = 0; i < BinaryLogRecord::kMaxValues; i++) {
+      if (!(record.mask & (1U << i))) continue;
+      if (end - in < 4) return;
+      const uint32_t bits = getLe(in, 4);
+      memcpy(&record.values[i], &bits, 4);
+      in += 4;
+    }
+    fn(ctx, record, tickEnd);
+  }
+}
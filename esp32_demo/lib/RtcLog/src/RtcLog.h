@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Arduino.h>
+#include <BinaryLogger.h>
+
+// Storage for RtcLog. The caller declares it RTC_DATA_ATTR so it survives
+// deep sleep; it is zeroed on power-on.
+struct RtcLogStore {
+  static const uint32_t kMagic = 0x524C4F31;  // "RLO1"
+  static const size_t kBytes = 2048;
+
+  uint32_t magic;
+  uint16_t used;
+  uint16_t rows;
+  uint64_t baseMs;
+  uint8_t data[kBytes];
+};
+
+typedef void (*RtcLogRowFn)(void *ctx, const BinaryLogRecord &record, bool tickEnd);
+
+// Row layout: sensor id (bit 7 ends an acquisition tick), u32 ms since
+// baseMs, address length and bytes, u16 presence mask, then one float per
+// present value. All fields little-endian.
+class RtcLog {
+ public:
+  explicit RtcLog(RtcLogStore &store) : store_(store) {}
+
+  // Keeps the rows of a previous boot, resets anything else.
+  void attach();
+  void clear();
+
+  static size_t packedSize(const BinaryLogRecord &record);
+  size_t room() const { return RtcLogStore::kBytes - store_.used; }
+  uint16_t rows() const { return store_.rows; }
+  size_t used() const { return store_.used; }
+
+  // False when the row does not fit or its timestamp is too far from the
+  // first row; the caller flushes and retries.
+  bool append(const BinaryLogRecord &record, bool tickEnd);
+  // Oldest first.
+  void forEach(RtcLogRowFn fn, void *ctx) const;
+
+ private:
+  RtcLogStore &store_;
+};
@@ -0,0 +1,203 @@
+#include "SegmentLog.h"
+
+SegmentLog::SegmentLog(fs::FS &fs, const char *dir, size_t segmentBytes)
+    : fs_(fs), dir_(dir), segmentBytes_(segmentBytes) {
+  updateHeadPath();
+}
+
+bool SegmentLog::begin(uint32_t tail, uint32_t head) {
+  if (!fs_.exists(dir_) && !fs_.mkdir(dir_)) return false;
+  tail_ = tail ? tail : 1;
+  head_ = head < tail_ ? tail_ : head;
+  // A crash between remove() and persisting the tail leaves a gap at the front.
+  while (tail_ < head_ && segmentSize(tail_) == 0) tail_++;
+  bytes_ = 0;
+  for (uint32_t seq = tail_; seq <= head_; seq++) {
+    bytes_ += segmentSize(seq);
+  }
+  headBytes_ = segmentSize(head_);
+  lastIndexedKnown_ = false;
+  updateHeadPath();
+  return true;
+}
+
+void SegmentLog::setBudget(size_t budgetBytes) {
+  budget_ = budgetBytes;
+}
+
+bool SegmentLog::headFull() const {
+  return headBytes_ >= segmentBytes_;
+}
+
+void SegmentLog::noteAppended(size_t bytes) {
+  headBytes_ += bytes;
+  bytes_ += bytes;
+}
+
+void SegmentLog::advance() {
+  // Resync with the real file size, which also counts headers the writers add.
+  const size_t actual = segmentSize(head_);
+  bytes_ = bytes_ - headBytes_ + actual;
+  head_++;
+  headBytes_ = 0;
+  lastIndexedKnown_ = false;
+  updateHeadPath();
+}
+
+bool SegmentLog::dropOldest() {
+  if (tail_ >= head_) return false;
+  const size_t size = segmentSize(tail_);
+  removeSegment(tail_);
+  bytes_ = bytes_ > size ? bytes_ - size : 0;
+  tail_++;
+  return true;
+}
+
+bool SegmentLog::overBudget() const {
+  return budget_ > 0 && bytes_ > budget_;
+}
+
+void SegmentLog::clear() {
+  for (uint32_t seq = tail_; seq <= head_; seq++) {
+    removeSegment(seq);
+  }
+  head_++;
+  tail_ = head_;
+  bytes_ = 0;
+  headBytes_ = 0;
+  lastIndexedKnown_ = false;
+  updateHeadPath();
+}
+
+void SegmentLog::segmentPath(uint32_t seq, char *out, size_t outLen) const {
+  snprintf(out, outLen, "%s/%08lx", dir_, (unsigned long)seq);
+}
+
+size_t SegmentLog::segmentSize(uint32_t seq) const {
+  char path[32];
+  segmentPath(seq, path, sizeof(path));
+  if (!fs_.exists(path)) return 0;
+  File file = fs_.open(path, "r");
+  if (!file) return 0;
+  const size_t size = file.size();
+  file.close();
+  return size;
+}
+
+bool SegmentLog::appendIndex(uint64_t timestampMs, uint32_t offset) {
+  char path[40];
+  if (!lastIndexedKnown_) {
+    // After a reboot the head may already hold entries.
+    uint32_t lastOffset = 0;
+    if (!readIndexEntry(head_, true, lastIndexedMs_, lastOffset)) lastIndexedMs_ = 0;
+    lastIndexedKnown_ = true;
+  }
+  if (timestampMs < lastIndexedMs_) {
+    unsortedPath(head_, path, sizeof(path));
+    if (!fs_.exists(path)) {
+      File marker = fs_.open(path, "w");
+      if (!marker) return false;
+      marker.close();
+    }
+  } else {
+    lastIndexedMs_ = timestampMs;
+  }
+  indexPath(head_, path, sizeof(path));
+  File file = fs_.open(path, "a");
+  if (!file) return false;
+  uint8_t entry[kIndexEntryBytes];
+  for (uint8_t i = 0; i < 8; i++) entry[i] = (uint8_t)(timestampMs >> (8 * i));
+  for (uint8_t i = 0; i < 4; i++) entry[8 + i] = (uint8_t)(offset >> (8 * i));
+  const bool ok = file.write(entry, sizeof(entry)) == sizeof(entry);
+  file.close();
+  return ok;
+}
+
+static void decodeIndexEntry(const uint8_t *entry, uint64_t &timestampMs, uint32_t &offset) {
+  timestampMs = 0;
+  for (uint8_t i = 0; i < 8; i++) timestampMs |= (uint64_t)entry[i] << (8 * i);
+  offset = 0;
+  for (uint8_t i = 0; i < 4; i++) offset |= (uint32_t)entry[8 + i] << (8 * i);
+}
+
+bool SegmentLog::readIndexEntry(uint32_t seq, bool last, uint64_t &timestampMs, uint32_t &offset) const {
+  char path[40];
+  indexPath(seq, path, sizeof(path));
+  if (!fs_.exists(path)) return false;
+  File file = fs_.open(path, "r");
+  if (!file) return false;
+  const size_t count = file.size() / kIndexEntryBytes;
+  uint8_t entry[kIndexEntryBytes];
+  const bool ok = count > 0 && (!last || file.seek((count - 1) * kIndexEntryBytes))
+                  && file.read(entry, sizeof(entry)) == sizeof(entry);
+  file.close();
+  if (!ok) return false;
+  decodeIndexEntry(entry, timestampMs, offset);
+  return true;
+}
+
+bool SegmentLog::firstIndexed(uint32_t seq, uint64_t &timestampMs) const {
+  uint32_t offset = 0;
+  return readIndexEntry(seq, false, timestampMs, offset);
+}
+
+bool SegmentLog::seekIndex(uint32_t seq, uint64_t timestampMs, uint32_t &offset) const {
+  char path[40];
+  unsortedPath(seq, path, sizeof(path));
+  if (fs_.exists(path)) {
+    // Rows after a step back may sit anywhere in the segment; a search
+    // could land past some of them.
+    uint64_t firstMs = 0;
+    return readIndexEntry(seq, false, firstMs, offset);
+  }
+  indexPath(seq, path, sizeof(path));
+  if (!fs_.exists(path)) return false;
+  File file = fs_.open(path, "r");
+  if (!file) return false;
+  // Sorted entries: the last one at or before the target; readers filter
+  // the rows in front of it.
+  const size_t count = file.size() / kIndexEntryBytes;
+  size_t lo = 0;
+  size_t hi = count;
+  bool found = false;
+  uint8_t entry[kIndexEntryBytes];
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    file.seek(mid * kIndexEntryBytes);
+    if (file.read(entry, sizeof(entry)) != sizeof(entry)) break;
+    uint64_t ts = 0;
+    uint32_t entryOffset = 0;
+    decodeIndexEntry(entry, ts, entryOffset);
+    if (ts <= timestampMs) {
+      offset = entryOffset;
+      found = true;
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  file.close();
+  return found;
+}
+
+void SegmentLog::indexPath(uint32_t seq, char *out, size_t outLen) const {
+  snprintf(out, outLen, "%s/%08lx.idx", dir_, (unsigned long)seq);
+}
+
+void SegmentLog::unsortedPath(uint32_t seq, char *out, size_t outLen) const {
+  snprintf(out, outLen, "%s/%08lx.unsorted", dir_, (unsigned long)seq);
+}
+
+void SegmentLog::removeSegment(uint32_t seq) {
+  char path[40];
+  segmentPath(seq, path, sizeof(path));
+  if (fs_.exists(path)) fs_.remove(path);
+  indexPath(seq, path, sizeof(path));
+  if (fs_.exists(path)) fs_.remove(path);
+  unsortedPath(seq, path, sizeof(path));
+  if (fs_.exists(path)) fs_.remove(path);
+}
+
+void SegmentLog::updateHeadPath() {
+  segmentPath(head_, headPath_, sizeof(headPath_));
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+// Ring of numbered segment files in one directory. Segments tail..head exist
+// on flash and head is the one being appended to. Sequence numbers only grow,
+// so dropping the oldest segment is one remove() and never renames anything.
+class SegmentLog {
+ public:
+  SegmentLog(fs::FS &fs, const char *dir, size_t segmentBytes);
+
+  bool begin(uint32_t tail, uint32_t head);
+  void setBudget(size_t budgetBytes);
+
+  bool headFull() const;
+  void noteAppended(size_t bytes);
+  void advance();
+  bool dropOldest();
+  bool overBudget() const;
+  void clear();
+
+  uint32_t tail() const { return tail_; }
+  uint32_t head() const { return head_; }
+  size_t bytes() const { return bytes_; }
+  size_t budget() const { return budget_; }
+  size_t segmentBytes() const { return segmentBytes_; }
+  size_t headBytes() const { return headBytes_; }
+  uint32_t segmentCount() const { return head_ - tail_ + 1; }
+  const char *headPath() const { return headPath_; }
+  void segmentPath(uint32_t seq, char *out, size_t outLen) const;
+  size_t segmentSize(uint32_t seq) const;
+
+  // Sparse time index kept next to each segment as <segment>.idx: entries
+  // of (u64 timestamp ms, u32 byte offset) little endian, in append order.
+  // Offsets must point at a record a reader can start from. An entry older
+  // than the one before it (the clock was stepped back) leaves a
+  // <segment>.unsorted marker, and seeks in that segment start at its first
+  // entry.
+  bool appendIndex(uint64_t timestampMs, uint32_t offset);
+  bool firstIndexed(uint32_t seq, uint64_t &timestampMs) const;
+  bool seekIndex(uint32_t seq, uint64_t timestampMs, uint32_t &offset) const;
+
+ private:
+  fs::FS &fs_;
+  const char *dir_;
+  size_t segmentBytes_;
+  size_t budget_ = 0;
+  uint32_t tail_ = 1;
+  uint32_t head_ = 1;
+  size_t bytes_ = 0;
+  size_t headBytes_ = 0;
+  char headPath_[32];
+  // Newest timestamp in the head's index; 0 until read or appended.
+  uint64_t lastIndexedMs_ = 0;
+  bool lastIndexedKnown_ = false;
+
+  static const size_t kIndexEntryBytes = 12;
+
+  void indexPath(uint32_t seq, char *out, size_t outLen) const;
+  void unsortedPath(uint32_t seq, char *out, size_t outLen) const;
+  bool readIndexEntry(uint32_t seq, bool last, uint64_t &timestampMs, uint32_t &offset) const;
+  void removeSegment(uint32_t seq);
+  void updateHeadPath();
+};
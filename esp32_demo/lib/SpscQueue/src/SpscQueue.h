@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+// Fixed ring of N slots shared by exactly one producer task and one
+// consumer task, on either core. Items are moved into and out of slots
+// that live as long as the queue, so nothing is allocated per push. The
+// counters run free and only their difference matters.
+template <typename T, size_t N>
+class SpscQueue {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+ public:
+  static const size_t kCapacity = N;
+
+  // Producer side; false when full, the item is left untouched. keepFree
+  // slots stay empty for pushes that must not fail.
+  bool push(T &&item, size_t keepFree = 0) {
+    const uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) + keepFree >= N) return false;
+    slots_[head & (N - 1)] = std::move(item);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool push(const T &item) {
+    T copy = item;
+    return push(std::move(copy));
+  }
+
+  // Consumer side; false when empty.
+  bool pop(T &out) {
+    const uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (head_.load(std::memory_order_acquire) == tail) return false;
+    out = std::move(slots_[tail & (N - 1)]);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Either side; a snapshot that may be stale by the time it is used.
+  size_t size() const {
+    return (size_t)(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+  }
+  bool empty() const { return size() == 0; }
+
+ private:
+  T slots_[N];
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+};
@@ -0,0 +1,108 @@
+#include "VarioFilter.h"
+
+static const uint32_t TABLE_BASE_PA = 30000;
+static const uint8_t TABLE_STEP_SHIFT = 17;  // 512 Pa in Q8
+static const uint16_t TABLE_SIZE = 158;      // up to 110384 Pa
+// Climb rate spread assumed when the filter (re)starts.
+static const int32_t INITIAL_CLIMB_SIGMA_CMS = 200;
+
+struct AltitudeTable {
+  int32_t q8[TABLE_SIZE];
+
+  AltitudeTable() {
+    for (uint16_t i = 0; i < TABLE_SIZE; i++) {
+      const float pa = (float)(TABLE_BASE_PA + ((uint32_t)i << (TABLE_STEP_SHIFT - VarioFilter::kFracBits)));
+      const float meters = 44330.77f * (1.0f - powf(pa / 101325.0f, 0.190263f));
+      q8[i] = (int32_t)lroundf(meters * 100.0f * (1 << VarioFilter::kFracBits));
+    }
+  }
+};
+
+static const AltitudeTable &altitudeTable() {
+  static const AltitudeTable table;
+  return table;
+}
+
+static int32_t saturate32(int64_t value) {
+  if (value > INT32_MAX) return INT32_MAX;
+  if (value < INT32_MIN) return INT32_MIN;
+  return (int32_t)value;
+}
+
+// Variances stay strictly positive so the gains never divide by zero.
+static int32_t variance32(int64_t value) {
+  return value < 1 ? 1 : saturate32(value);
+}
+
+int32_t VarioFilter::altitudeQ8(uint32_t pressurePaQ8) {
+  const int32_t *table = altitudeTable().q8;
+  const uint32_t baseQ8 = TABLE_BASE_PA << kFracBits;
+  if (pressurePaQ8 <= baseQ8) return table[0];
+  const uint32_t offset = pressurePaQ8 - baseQ8;
+  const uint32_t index = offset >> TABLE_STEP_SHIFT;
+  if (index >= TABLE_SIZE - 1) return table[TABLE_SIZE - 1];
+  const int64_t frac = offset & ((1UL << TABLE_STEP_SHIFT) - 1);
+  return table[index] + (int32_t)(((int64_t)(table[index + 1] - table[index]) * frac) >> TABLE_STEP_SHIFT);
+}
+
+uint32_t VarioFilter::paQ8FromHpa(float hpa) {
+  if (!(hpa > 0.0f)) return 0;
+  if (hpa > 16000.0f) hpa = 16000.0f;
+  return (uint32_t)(hpa * (100.0f * (1 << kFracBits)) + 0.5f);
+}
+
+void VarioFilter::setNoise(uint16_t sigmaCm, uint16_t accelCmS2) {
+  if (sigmaCm == 0) sigmaCm = 1;
+  if (accelCmS2 == 0) accelCmS2 = 1;
+  if (accelCmS2 > kMaxAccelCmS2) accelCmS2 = kMaxAccelCmS2;
+  r_ = variance32(((int64_t)sigmaCm * sigmaCm) << kFracBits);
+  a2_ = ((int64_t)accelCmS2 * accelCmS2) << kFracBits;
+}
+
+// dt is Q16 seconds. Process noise for a constant acceleration variance
+// a2 over dt: [dt^3/3, dt^2/2; dt^2/2, dt] * a2.
+void VarioFilter::predict(uint32_t dtUs) {
+  const int64_t dt = ((uint64_t)dtUs * 4295ULL) >> 16;  // 4295 / 2^16 ~ 2^16 / 1e6
+  const int64_t q11 = (a2_ * dt) >> 16;
+  const int64_t t3 = (q11 * dt) >> 16;
+  const int64_t q01 = t3 >> 1;
+  const int64_t q00 = ((t3 * dt) >> 16) / 3;
+
+  h_ = saturate32(h_ + (((int64_t)v_ * dt) >> 16));
+  const int64_t dtP11 = ((int64_t)p11_ * dt) >> 16;
+  p00_ = variance32(p00_ + (((2 * (int64_t)p01_ + dtP11) * dt) >> 16) + q00);
+  p01_ = saturate32(p01_ + dtP11 + q01);
+  p11_ = variance32(p11_ + q11);
+}
+
+void VarioFilter::correct(int32_t altitudeQ8) {
+  const int64_t innovation = (int64_t)altitudeQ8 - h_;
+  const int64_t s = (int64_t)p00_ + r_;
+  const int64_t k0 = ((int64_t)p00_ << 16) / s;  // Q16, 0..1
+  const int64_t k1 = ((int64_t)p01_ << 16) / s;  // Q16, 1/s
+
+  h_ = saturate32(h_ + ((k0 * innovation) >> 16));
+  v_ = saturate32(v_ + ((k1 * innovation) >> 16));
+  const int32_t p01 = p01_;
+  p00_ = variance32(p00_ - ((k0 * p00_) >> 16));
+  p01_ = saturate32(p01_ - ((k0 * p01) >> 16));
+  p11_ = variance32(p11_ - ((k1 * p01) >> 16));
+}
+
+void VarioFilter::update(uint32_t pressurePaQ8, uint32_t nowUs) {
+  const int32_t z = altitudeQ8(pressurePaQ8);
+  const uint32_t dtUs = nowUs - lastUs_;
+  lastUs_ = nowUs;
+  updates_++;
+  if (!ready_ || dtUs > kMaxGapUs) {
+    h_ = z;
+    v_ = 0;
+    p00_ = r_;
+    p01_ = 0;
+    p11_ = variance32(((int64_t)INITIAL_CLIMB_SIGMA_CMS * INITIAL_CLIMB_SIGMA_CMS) << kFracBits);
+    ready_ = true;
+    return;
+  }
+  if (dtUs > 0) predict(dtUs);
+  correct(z);
+}
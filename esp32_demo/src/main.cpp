@@ -7,14 +7,25 @@
 #include <Adafruit_NeoPixel.h>
 #include <bsec2.h>
 #include <DHT.h>
-#include <MS5611.h>
 #include <Preferences.h>
 #include <LittleFS.h>
 #include <CsvLogger.h>
+#include <DeadlineScheduler.h>
+#include <BinaryLogger.h>
+#include <TsBlock.h>
+#include <SegmentLog.h>
+#include <JsonScan.h>
+#include <PowerEstimator.h>
+#include <RtcLog.h>
+#include <LzBlock.h>
+#include <Ms5611Async.h>
+#include <VarioFilter.h>
+#include <SpscQueue.h>
 #include <OneWire.h>
 #include <DallasTemperature.h>
 #include <ctype.h>
 #include <time.h>
+#include <sys/time.h>
 
 #if !defined(BME68X_DO_NOT_USE_FPU)
 const uint8_t bsec_config_iaq[] = {
@@ -27,6 +38,38 @@ const uint8_t bsec_config_iaq[] = {
 #include "esp_chip_info.h"
 #endif
 
+#ifndef USE_TASK_PIPELINE
+#define USE_TASK_PIPELINE 1
+#endif
+
+// -D BOOT_PROFILE=1 logs how long each boot phase took.
+#ifndef BOOT_PROFILE
+#define BOOT_PROFILE 0
+#endif
+
+// Milliseconds to wait for a USB CDC host before logging; 0 boots straight
+// through (logs printed before the host attaches are lost).
+#ifndef SERIAL_WAIT_MS
+#define SERIAL_WAIT_MS 0
+#endif
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+// Automatic light sleep between deadlines (-D VARIO_DISABLE_SLEEP=1 keeps
+// the chip awake, e.g. for USB serial debugging).
+#ifndef VARIO_DISABLE_SLEEP
+#define VARIO_DISABLE_SLEEP 0
+#endif
+#if !VARIO_DISABLE_SLEEP
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+#include "soc/soc_caps.h"
+#endif
+
 #if defined(USE_UART0_LOG)
 #undef Serial
 #define Serial Serial0
@@ -36,6 +79,8 @@ const uint8_t bsec_config_iaq[] = {
 static const char *UUID_SERVICE = "9d35a5d1-8e8a-4e6b-b44a-9f5bb48f7c01";
 static const char *UUID_DATA    = "9d35a5d1-8e8a-4e6b-b44a-9f5bb48f7c02"; // notify
 static const char *UUID_CONFIG  = "9d35a5d1-8e8a-4e6b-b44a-9f5bb48f7c03"; // write
+static const char *UUID_EXPORT  = "9d35a5d1-8e8a-4e6b-b44a-9f5bb48f7c04"; // notify, binary export
+static const char *UUID_VARIO   = "9d35a5d1-8e8a-4e6b-b44a-9f5bb48f7c05"; // notify, altitude/climb
 
 static char bleName[32];
 static char bleNameShort[16];
@@ -49,48 +94,210 @@ static const uint8_t I2C_ADDR_MS5611_A = 0x77;
 static const uint8_t I2C_ADDR_MS5611_B = 0x76;
 static const uint8_t REG_CHIP_ID = 0xD0;
 static const uint8_t CHIP_ID_BME68X = 0x61;
+static const uint8_t MS5611_CMD_PROM_C1 = 0xA2;
+// Sensors are probed in standard mode, then tuneI2cClock() steps up to the
+// fastest rate at which their ID reads still match. MS5611 is rated for
+// 400 kHz; BMP280/BME680 go further but the C3/H2 controllers stop at
+// 800 kHz, so Fast-mode Plus (1 MHz) is not attempted.
+static const uint32_t I2C_SAFE_HZ = 100000;
+static const uint32_t I2C_FAST_HZ = 400000;
+static const uint32_t I2C_MAX_HZ = 800000;
+static const uint8_t I2C_ID_ROUNDS = 3;
+// Single-file logs written by older firmware, moved into the ring at boot.
 static const char *LOG_PATH = "/log.csv";
+static const char *LOG_BIN_PATH = "/log.bin";
+static const char *LOG_DIR = "/log";
+static const size_t LOG_SEGMENT_BYTES = 16384;
+static const uint8_t LOG_BUDGET_AUTO_PERCENT = 75;
+static const uint8_t LOG_INDEX_EVERY = 32;
 static const char *LOG_HEADER = "date,temperature,humidity,pressure,iaq,accuracy,voc,eqco2,gas_kohm,generic,sensor,address";
+static const size_t LOG_BUFFER_BYTES = 1024;
+static const uint32_t LOG_FLUSH_MS = 15000;
+static const uint8_t LOG_FIELD_COUNT = 9;
+// Binary log sensor ids; index 0 is reserved for unknown sensors.
+static const char *const LOG_SENSOR_NAMES[] = {
+  "", "bme680", "bmp280", "gy63", "ds18b20", "dht11", "dht22", "digital", "analog", "random"
+};
 static const bool DEBUG_VERBOSE = true;
 static const uint8_t NEOPIXEL_COUNT = 1;
 static const uint8_t NEOPIXEL_BRIGHTNESS = 64;
 
 #define LOGVLN(msg) do { if (DEBUG_VERBOSE) { Serial.println(msg); } } while (0)
 
+// Where a line starts in the ring; offset 0 means "segment not opened yet".
+struct LogCursorMark {
+  uint32_t seq = 0;
+  uint32_t offset = 0;
+  uint64_t lastTs = 0;
+  bool headerSent = false;
+  // Bytes of the line at this mark already streamed (binary framing only).
+  uint32_t skip = 0;
+  uint32_t rows = 0;
+};
+
+// Where a client's last completed flash_export_new ended, kept in NVS.
+struct LogSyncPoint {
+  uint32_t seq = 0;
+  uint32_t offset = 0;
+  uint32_t rows = 0;
+};
+
+// Read position in the segment ring for exports and serial dumps.
+struct LogCursor {
+  uint32_t seq = 0;
+  File file;
+  BinaryLogReader bin;
+  bool binary = false;
+  bool segmentOpen = false;
+  bool headerSent = false;
+  // Local-time row range, inclusive; the defaults export everything.
+  uint64_t fromMs = 0;
+  uint64_t toMs = UINT64_MAX;
+  LogCursorMark lineMark;
+  // Data rows returned since logCursorOpen().
+  uint32_t rows = 0;
+};
+
 static NimBLECharacteristic *txChar = nullptr;
+static NimBLECharacteristic *exportChar = nullptr;
+static NimBLECharacteristic *varioChar = nullptr;
 static NimBLEServer *bleServer = nullptr;
 static uint8_t connectedCount = 0;
 static uint16_t bleMtu = 23;
-static uint32_t lastBeat = 0;
-static uint32_t lastSensorMs = 0;
-static uint32_t lastScanMs = 0;
+
+// Shared state the stages touch: sensor objects (acquisition), log files
+// (storage) and the BLE characteristics (publish). loop() takes the same
+// locks, always in this order. The mutexes are recursive so a stage that
+// holds one can call helpers that take it again.
+enum PipelineLock : uint8_t {
+  PIPELINE_LOCK_SENSORS,
+  PIPELINE_LOCK_LOGS,
+  PIPELINE_LOCK_BLE,
+  PIPELINE_LOCK_COUNT
+};
+
+#if USE_TASK_PIPELINE
+static SemaphoreHandle_t pipelineMutex[PIPELINE_LOCK_COUNT] = {nullptr};
+
+static void pipelineLock(PipelineLock lock) {
+  if (pipelineMutex[lock]) xSemaphoreTakeRecursive(pipelineMutex[lock], portMAX_DELAY);
+}
+
+static void pipelineUnlock(PipelineLock lock) {
+  if (pipelineMutex[lock]) xSemaphoreGiveRecursive(pipelineMutex[lock]);
+}
+#else
+static void pipelineLock(PipelineLock lock) { (void)lock; }
+static void pipelineUnlock(PipelineLock lock) { (void)lock; }
+#endif
+
+// Every notification goes through here: a characteristic holds a single
+// value, so a task preempting another between setValue() and notify()
+// would send its own payload twice and drop the other one. The pointer is
+// read under the lock because bleReset() clears it.
+static bool bleNotify(NimBLECharacteristic *const &chr, const uint8_t *data, size_t len) {
+  pipelineLock(PIPELINE_LOCK_BLE);
+  bool sent = false;
+  if (chr) {
+    chr->setValue(data, len);
+    sent = chr->notify();
+  }
+  pipelineUnlock(PIPELINE_LOCK_BLE);
+  return sent;
+}
+
+static bool bleNotify(NimBLECharacteristic *const &chr, const std::string &payload) {
+  return bleNotify(chr, (const uint8_t *)payload.data(), payload.size());
+}
+
+static bool bleNotify(NimBLECharacteristic *const &chr, const char *payload) {
+  return bleNotify(chr, (const uint8_t *)payload, strlen(payload));
+}
+// loop() sleeps until the next deadline or until another task wakes it.
+static DeadlineScheduler loopScheduler;
+static TaskHandle_t loopTaskHandle = nullptr;
+// Serial commands are only polled on wakeups. With light sleep the loop
+// sleeps until its next deadline and answers them then.
+static const uint32_t LOOP_IDLE_MAX_MS = 100;
+static const uint32_t LOG_POLL_MS = 1000;
+static const uint32_t CSV_PUMP_INTERVAL_MS = 10;
+static bool rescanRequested = false;
 static bool i2cScanPending = false;
 static bool sensorInitPending = true;
-static uint32_t sensorInitAt = 0;
 static bool i2cBusReady = false;
 static int activeI2cSda = -1;
 static int activeI2cScl = -1;
+static uint32_t i2cClockHz = I2C_SAFE_HZ;
+static uint32_t i2cStoredHz = 0;  // NVS "i2c_hz": last negotiated rate
 static bool bleResetPending = false;
 static uint32_t bleResetAt = 0;
 static bool csvExportInProgress = false;
 static uint32_t csvExportId = 0;
 static uint32_t csvExportStartedAt = 0;
-static File csvStreamFile;
 static bool csvStreamActive = false;
-static bool csvAwaitAck = false;
 static uint32_t csvStreamId = 0;
 static uint32_t csvStreamSeq = 0;
-static uint32_t csvStreamLastSent = 0;
-static uint32_t csvStreamLastAck = 0;
+static volatile uint32_t csvStreamAcked = 0;
+static volatile uint16_t csvRetransmitMask = 0;
+static uint8_t csvStreamWindow = 1;
+static bool csvStreamBinary = false;
+static bool csvStreamLz = false;
+static LzBlockEncoder csvLz;
 static bool csvStreamAllSent = false;
 static bool csvHasPendingLine = false;
 static std::string csvPendingLine;
+static LogCursorMark csvPendingMark;
 static uint32_t csvStreamLastActivityMs = 0;
-
-static const uint8_t CSV_ACK_WINDOW = 1;
+// Set while the link is down mid-stream; the client may resume until the
+// grace period runs out.
+static bool csvStreamSuspended = false;
+static uint32_t csvStreamSuspendedAt = 0;
+// Raised by onDisconnect() on the NimBLE host task; loop() suspends or
+// drops the export.
+static volatile bool csvLinkLost = false;
+// flash_export_new: sync point saved for csvSyncClient once the last block
+// is acknowledged.
+static bool csvSyncActive = false;
+static std::string csvSyncClient;
+static LogSyncPoint csvSyncTarget;
+
+// Sliding window for flash_stream/flash_export: up to csvStreamWindow blocks
+// in flight, cumulative csv_ack, csv_nack for one block. Unacked blocks are
+// kept as cursor marks and re-read from flash when they must be resent.
+static const uint8_t CSV_WINDOW_DEFAULT = 1;
+static const uint8_t CSV_WINDOW_MAX = 16;
+static const uint32_t CSV_RETRANSMIT_MS = 1000;
+static const uint32_t CSV_RESUME_GRACE_MS = 60000;
+// Binary framing on UUID_EXPORT: u8 id, u8 flags, u16 length, u32 seq (LE),
+// then raw CSV bytes filling the MTU; lines may straddle two blocks.
+static const size_t EXPORT_HEADER_BYTES = 8;
+static const size_t EXPORT_BLOCK_MAX = 512;
+static const uint8_t EXPORT_FLAG_LAST = 0x01;
+static const uint8_t EXPORT_FLAG_LZ = 0x02;
+// Raw CSV staged per compressed block; sensor rows shrink about 3-4x, so
+// this comfortably covers one MTU-sized frame.
+static const size_t EXPORT_LZ_STAGE_BYTES = 1024;
+struct CsvBlockSlot {
+  uint32_t seq = UINT32_MAX;
+  LogCursorMark mark;
+  uint32_t sentMs = 0;
+};
+static CsvBlockSlot csvBlockMap[CSV_WINDOW_MAX];
 static bool serialDumpInProgress = false;
-static CsvLogger csvLogger(LittleFS, LOG_PATH, LOG_HEADER);
+static SegmentLog logRing(LittleFS, LOG_DIR, LOG_SEGMENT_BYTES);
+static bool logRingReady = false;
+// Format of the head segment: 0 for CSV, else its BinaryLogger version.
+static uint8_t logRingHeadVersion = 0;
+static uint8_t logIndexCountdown = 0;
+// Both writers follow the ring's head path; they must be closed before it advances.
+static CsvLogger csvLogger(LittleFS, logRing.headPath(), LOG_HEADER);
+static BinaryLogger binLogger(LittleFS, logRing.headPath());
+static LogCursor csvStreamCursor;
+static uint32_t logRowBytesAvg = 0;
+static uint32_t logTickBytesAvg = 0;
+static uint32_t logTickBytes = 0;
 static bool immediateSamplePending = false;
+static uint32_t sampleDeadline = 0;
 
 #ifndef USE_COMPACT_METRICS
 #define USE_COMPACT_METRICS 1
@@ -98,13 +305,60 @@ static bool immediateSamplePending = false;
 
 static Adafruit_BMP280 *bmp280 = nullptr;
 static Bsec2 *bme680 = nullptr;
-static MS5611 *ms5611 = nullptr;
+static Ms5611Async *ms5611 = nullptr;
 static OneWire *oneWire = nullptr;
 static DallasTemperature *ds18b20 = nullptr;
+// DS18B20 conversions run while loop() goes on: a tick starts one and
+// oneWireJob() runs the tick again once the datasheet conversion time for
+// the configured resolution has elapsed.
+static const uint8_t DS18B20_MIN_BITS = 9;
+static const uint8_t DS18B20_MAX_BITS = 12;
+// ROMs found on the bus, enumerated once per initOneWire(). One skip-ROM
+// conversion covers them all, then each scratchpad is read by ROM. Each
+// probe is its own series in a tsz log block.
+static const uint8_t ONEWIRE_MAX_PROBES = 16;
+static_assert(ONEWIRE_MAX_PROBES <= TsBlockEncoder::kMaxSeries, "1-Wire probes would not fit one tsz block");
+static DeviceAddress oneWireRoms[ONEWIRE_MAX_PROBES];
+static uint8_t oneWireRomCount = 0;
+
+struct OneWireProbe {
+  char addr[20];  // ROM as 16 hex digits, the form flash rows parse back
+  float tempC;
+};
+static bool oneWireConverting = false;
+static bool oneWireReady = false;          // finished conversion not read yet
+static bool oneWireSamplePending = false;  // tick waiting on the conversion
+static volatile bool oneWireRestart = false;
+static uint32_t oneWireReadyAtMs = 0;
 static DHT *dht = nullptr;
 static uint8_t bmpAddr = 0;
 static uint8_t bmeAddr = 0;
 static uint8_t msAddr = 0;
+// MS5611 conversions never block loop(): ms5611Job() collects them on later
+// scheduler ticks. With ms5611_hz > 0 it also keeps converting at that rate
+// and readers take the latest result.
+static const uint32_t MS5611_MAX_HZ = 100;
+static bool ms5611Fresh = false;          // a cycle finished since the last read
+static bool ms5611SamplePending = false;  // tick waiting on a cycle
+static bool ms5611SampleReady = false;    // pipeline: that cycle ended, tick runs
+static volatile bool ms5611Restart = false;
+static uint32_t ms5611NextStartUs = 0;
+// Vario mode: every MS5611 cycle (VARIO_MS5611_HZ unless ms5611_hz is set)
+// or a BMP280 read at VARIO_BMP280_HZ feeds the Kalman filter, and
+// altitude and climb rate go out on UUID_VARIO.
+static const uint32_t VARIO_MS5611_HZ = 50;
+static const uint32_t VARIO_BMP280_HZ = 25;
+static const uint16_t VARIO_ACCEL_CMS2 = 50;
+static const uint16_t VARIO_BMP280_SIGMA_CM = 12;
+static const uint32_t VARIO_NOTIFY_MIN_MS = 50;
+static const uint32_t VARIO_LOG_MS = 10000;
+static VarioFilter vario;
+static volatile bool varioRestart = false;
+static uint32_t varioLastNotifyMs = 0;
+static uint8_t varioSeq = 0;
+static uint32_t varioLogAt = 0;
+static uint32_t varioLogUpdates = 0;
+static uint32_t varioFilterUs = 0;
 static int64_t lastBsecTimestampNs = 0;
 static Preferences prefs;
 static bool prefsReady = false;
@@ -133,6 +387,24 @@ struct Bme680Reading {
 static Bme680Reading bme680Latest;
 static bool bme680LatestValid = false;
 
+// Acquisition output, one ring entry per queueMetricPayload()/flashLogRow()
+// call. sensor == nullptr closes the tick. Names are static strings.
+struct MetricSample {
+  const char *sensor = nullptr;
+  char addr[20] = {0};
+  const char *key1 = nullptr;
+  float v1 = NAN;
+  const char *key2 = nullptr;
+  float v2 = NAN;
+};
+
+struct LogSample {
+  uint64_t localMs = 0;
+  const char *sensor = nullptr;
+  char addr[20] = {0};
+  float values[LOG_FIELD_COUNT];
+};
+
 enum DigitalSensorType {
   DIGITAL_SENSOR_NONE = 0,
   DIGITAL_SENSOR_DHT11,
@@ -141,18 +413,50 @@ enum DigitalSensorType {
 
 static DigitalSensorType digitalSensorType = DIGITAL_SENSOR_NONE;
 
+// Last probe result, kept in NVS. A boot with the same sensor mode and pins
+// re-creates these drivers directly instead of scanning the bus or waiting
+// out the DHT detection delays.
+enum SensorCacheKind : uint8_t {
+  SENSOR_CACHE_NONE = 0,
+  SENSOR_CACHE_I2C,
+  SENSOR_CACHE_DHT
+};
+
+struct SensorCache {
+  uint8_t kind = SENSOR_CACHE_NONE;
+  int8_t pinA = -1;  // SDA, or the DHT data pin
+  int8_t pinB = -1;  // SCL
+  uint8_t msAddr = 0;
+  uint8_t bmeAddr = 0;
+  uint8_t bmpAddr = 0;
+  uint8_t dhtType = 0;
+};
+
+static SensorCache sensorCache;
+// A cached DHT that keeps failing is probed again from scratch.
+static const uint8_t DHT_CACHE_MAX_FAILURES = 5;
+static bool dhtFromCache = false;
+static uint8_t dhtReadFailures = 0;
+
 struct DeviceConfig {
   std::string name;
   std::string sensor;
   int i2cSda = -1;
   int i2cScl = -1;
   int onewirePin = -1;
+  uint8_t onewireBits = 12;
   int analogPin = -1;
   int digitalPin = -1;
   int buttonPin = -1;
   int neopixelPin = -1;
   uint32_t frequencyMs = 1000;
   bool storeFlash = false;
+  bool deepSleep = false;
+  std::string logFormat = "csv";
+  uint32_t logBudgetKb = 0;
+  uint32_t ms5611Osr = 4096;
+  uint32_t ms5611Hz = 0;
+  bool vario = false;
 };
 
 struct ConfigUpdate {
@@ -165,6 +469,8 @@ struct ConfigUpdate {
   int i2cScl = -1;
   bool hasOneWire = false;
   int onewirePin = -1;
+  bool hasOneWireBits = false;
+  uint32_t onewireBits = 0;
   bool hasAnalog = false;
   int analogPin = -1;
   bool hasDigital = false;
@@ -177,6 +483,18 @@ struct ConfigUpdate {
   uint32_t frequencyMs = 0;
   bool hasStoreFlash = false;
   bool storeFlash = false;
+  bool hasDeepSleep = false;
+  bool deepSleep = false;
+  bool hasLogFormat = false;
+  std::string logFormat;
+  bool hasLogBudget = false;
+  uint32_t logBudgetKb = 0;
+  bool hasMs5611Osr = false;
+  uint32_t ms5611Osr = 0;
+  bool hasMs5611Hz = false;
+  uint32_t ms5611Hz = 0;
+  bool hasVario = false;
+  bool vario = false;
   bool hasAction = false;
   std::string action;
   std::string format;
@@ -184,6 +502,15 @@ struct ConfigUpdate {
   uint64_t epochMs = 0;
   bool hasTzOffset = false;
   int32_t tzOffsetMin = 0;
+  bool hasRange = false;
+  uint64_t fromMs = 0;
+  uint64_t toMs = UINT64_MAX;
+  uint32_t window = 0;
+  std::string framing;
+  bool hasResume = false;
+  uint32_t resumeId = 0;
+  uint32_t resumeOffset = 0;
+  std::string client;
   bool hasCsvAck = false;
   uint32_t csvAckId = 0;
   uint32_t csvAckSeq = 0;
@@ -197,7 +524,17 @@ static int32_t tzOffsetMin = 0;
 
 static void clearSensors();
 static void scanSensors();
+static void applyMs5611Config();
+static void ms5611Job();
+static void applyBmp280Sampling();
+static void startOneWireConversion();
+static void configureVario();
+static std::string i2cScan();
+static bool beginI2cBus();
+static void setI2cClock(uint32_t hz);
+static bool initI2cFromCache();
 static size_t estimateLineBytes();
+static size_t estimateTickBytes();
 static void applyTimeSync(uint64_t epochMs);
 static void applyTzOffset(int32_t offsetMin);
 static uint64_t currentEpochMs();
@@ -208,37 +545,160 @@ static void updateRecordingLed();
 static void handleButtonInput();
 static bool getFlashStats(size_t &total, size_t &used, size_t &freeSpace, size_t &logBytes);
 static bool buildFlashJson(std::string &out, bool withEstimates);
+static void buildPowerJson(std::string &out);
 static void sendFlashStatus();
 static size_t csvChunkBytes();
 static void sendCsvChunk(uint32_t exportId, uint32_t seq, uint32_t totalBytes, bool last, const std::string &chunk);
 static void endCsvStream();
-static void sendNextCsvBlock();
-static void sendCsvFromFlash();
+static void pumpCsvStream();
+static void sendCsvFromFlash(uint64_t fromMs, uint64_t toMs, uint32_t window, bool binaryFraming, bool compress,
+                             const LogCursorMark *start = nullptr);
 static void handleSerialCommands();
 static void dumpCsvToSerial();
 static void acquireAndPublishSample();
 static bool readBmp280(float &tempC, float &pressHpa);
 static bool readMs5611(float &tempC, float &pressHpa);
 static bool readBme680(Bme680Reading &reading);
-static bool readOneWire(float &tempC);
+static uint8_t readOneWire(OneWireProbe *probes);
+static void applyOneWireResolution();
+static bool startOneWireForSample();
+static void oneWireJob();
+static bool startMs5611ForSample();
+#if !USE_COMPACT_METRICS
 static void sendMetricPayload(const char *sensor, const char *addr, const char *key1, float v1, const char *key2, float v2);
+#endif
+static void queueMetricPayload(const char *sensor, const char *addr, const char *key1, float v1, const char *key2, float v2);
+static void flushMetricBatch();
 static void clearDigitalSensor();
 static void detectDigitalSensor();
 static bool readDigitalSensor(float &v1, float &v2, bool &paired, const char *&sensorName);
 static std::string normalizeSensor(const std::string &input);
 static void bsecBme680Callback(const bme68xData data, const bsecOutputs outputs, const Bsec2 bsec);
 static void scheduleImmediateSensorPush();
+#if USE_TASK_PIPELINE
+static void requestImmediateSample();
+#endif
+static void rescanJob();
+static void startLoopScheduler();
+static void setupPowerManagement();
+
+// Datasheet typicals; BLE connection events and sensor currents are not
+// modelled.
+#if defined(CONFIG_IDF_TARGET_ESP32H2)
+static const PowerModel POWER_MODEL = {14000, 8000, 85};
+#else
+static const PowerModel POWER_MODEL = {22000, 13000, 130};
+#endif
+static PowerEstimator powerEstimator(POWER_MODEL);
+static bool lightSleepReady = false;
+#if !VARIO_DISABLE_SLEEP
+static esp_pm_lock_handle_t noSleepLock = nullptr;
+static bool noSleepHeld = false;
+static volatile int buttonWakePin = -1;
+#endif
+
+#if !VARIO_DISABLE_SLEEP
+// Deep-sleep duty cycle for store-only nodes. Timer wakes take the fast
+// path at the top of setup(): read the sensor, pack the rows into RTC
+// memory and sleep again. Flash is only touched when the RTC buffer fills.
+static const uint32_t DEEP_SLEEP_IDLE_MS = 60000;
+static const uint32_t RTC_WAKE_MAGIC = 0x52574B31;  // "RWK1"
+static const uint8_t RTC_TICK_MAX_ROWS = 8;
+
+// What the fast path needs from DeviceConfig, so it can skip NVS.
+struct RtcWakeState {
+  uint32_t magic;
+  uint32_t frequencyMs;
+  uint32_t logBudgetKb;
+  uint64_t nextWakeMs;  // RTC clock ms of the next sample
+  int32_t tzOffsetMin;
+  uint32_t cycles;
+  uint32_t lastAwakeMs;
+  int8_t i2cSda;
+  int8_t i2cScl;
+  int8_t onewirePin;
+  uint8_t onewireBits;
+  int8_t analogPin;
+  int8_t digitalPin;
+  int8_t buttonPin;
+  uint16_t ms5611Osr;
+  bool timeSynced;
+  char sensor[12];
+  char logFormat[6];
+  SensorCache sensorCache;
+};
+
+RTC_DATA_ATTR static RtcWakeState rtcWake;
+RTC_DATA_ATTR static RtcLogStore rtcLogStore;
+static RtcLog rtcLog(rtcLogStore);
+static uint32_t deepSleepHoldUntil = 0;
+#endif
+
+static void wakeLoop() {
+  if (loopTaskHandle) xTaskNotifyGive(loopTaskHandle);
+}
+
+// One line per boot phase with -D BOOT_PROFILE=1. micros() starts with the
+// app, so ROM and bootloader time are not included.
+static void bootPhase(const char *phase, uint32_t startUs) {
+#if BOOT_PROFILE
+  const uint32_t nowUs = micros();
+  Serial.print("[BOOT] ");
+  Serial.print(phase);
+  Serial.print(" took_ms=");
+  Serial.print((nowUs - startUs) / 1000.0f, 1);
+  Serial.print(" at_ms=");
+  Serial.println(nowUs / 1000.0f, 1);
+#else
+  (void)phase;
+  (void)startUs;
+#endif
+}
+
+// Any client or user activity keeps the node awake for another idle window.
+static void holdDeepSleep() {
+#if !VARIO_DISABLE_SLEEP
+  deepSleepHoldUntil = millis() + DEEP_SLEEP_IDLE_MS;
+#endif
+}
+
+static void IRAM_ATTR wakeLoopFromIsr() {
+  if (!loopTaskHandle) return;
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(loopTaskHandle, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+#if !VARIO_DISABLE_SLEEP
+// Light sleep only wakes on GPIO levels: the button interrupt is armed for
+// the level opposite to the stable state and disarms itself when it fires.
+static void IRAM_ATTR onButtonWake() {
+  const int pin = buttonWakePin;
+  if (pin >= 0) gpio_intr_disable((gpio_num_t)pin);
+  wakeLoopFromIsr();
+}
+
+static void armButtonWake() {
+  const int pin = buttonWakePin;
+  if (pin < 0 || buttonLastRead != buttonStableState) return;
+  gpio_wakeup_enable((gpio_num_t)pin, buttonStableState == HIGH ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+  gpio_intr_enable((gpio_num_t)pin);
+}
+#endif
 
+// May run on the NimBLE host task: only flags here, loop() turns them
+// into deadlines.
 static void scheduleImmediateSensorPush() {
-  const uint32_t now = millis();
-  // Force loop condition (now - lastSensorMs) >= sensorIntervalMs on next iteration.
-  lastSensorMs = now - sensorIntervalMs;
+#if USE_TASK_PIPELINE
+  requestImmediateSample();
+#else
   immediateSamplePending = true;
-  if (sensorInitPending) sensorInitAt = now;
+#endif
   if (normalizeSensor(deviceConfig.sensor) == "i2c") {
     i2cScanPending = true;
-    lastScanMs = 0;
+    rescanRequested = true;
   }
+  wakeLoop();
 }
 
 static std::string trimCopy(const std::string &input) {
@@ -282,6 +742,70 @@ static std::string normalizeSensor(const std::string &input) {
   return raw;
 }
 
+static std::string normalizeLogFormat(const std::string &input) {
+  const std::string raw = lowerCopy(trimCopy(input));
+  if (raw == "bin" || raw == "binary") return "bin";
+  if (raw == "tsz" || raw == "gorilla") return "tsz";
+  return "csv";
+}
+
+// 0 for CSV, else the BinaryLogger version new rows are written with.
+static uint8_t logFormatVersion() {
+  if (deviceConfig.logFormat == "bin") return BinaryLogger::kVersion;
+  if (deviceConfig.logFormat == "tsz") return BinaryLogger::kBlockVersion;
+  return 0;
+}
+
+static uint8_t logSensorId(const char *sensor) {
+  if (!sensor) return 0;
+  for (uint8_t i = 1; i < sizeof(LOG_SENSOR_NAMES) / sizeof(LOG_SENSOR_NAMES[0]); i++) {
+    if (strcmp(sensor, LOG_SENSOR_NAMES[i]) == 0) return i;
+  }
+  return 0;
+}
+
+static const char *logSensorName(uint8_t id) {
+  if (id >= sizeof(LOG_SENSOR_NAMES) / sizeof(LOG_SENSOR_NAMES[0])) return "";
+  return LOG_SENSOR_NAMES[id];
+}
+
+static uint8_t parseHexAddress(const char *text, uint8_t *out, uint8_t maxLen) {
+  if (!text) return 0;
+  if (text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) text += 2;
+  uint8_t len = 0;
+  while (text[0] && text[1] && len < maxLen) {
+    if (!isxdigit((unsigned char)text[0]) || !isxdigit((unsigned char)text[1])) return 0;
+    char byteText[3] = {text[0], text[1], '\0'};
+    out[len++] = (uint8_t)strtoul(byteText, nullptr, 16);
+    text += 2;
+  }
+  return text[0] ? 0 : len;
+}
+
+// A 1-Wire ROM as formatHexAddress() writes it: 16 hex digits, no prefix.
+// I2C addresses keep their "0x" form and never match.
+static bool isOneWireRom(const char *addr) {
+  if (!addr) return false;
+  uint8_t digits = 0;
+  for (; addr[digits]; digits++) {
+    if (digits == 16 || !isxdigit((unsigned char)addr[digits])) return false;
+  }
+  return digits == 16;
+}
+
+static void formatHexAddress(const uint8_t *addr, uint8_t len, char *out, size_t outLen) {
+  if (!out || outLen == 0) return;
+  out[0] = '\0';
+  if (len == 1) {
+    snprintf(out, outLen, "0x%02X", addr[0]);
+    return;
+  }
+  size_t pos = 0;
+  for (uint8_t i = 0; i < len && pos + 3 <= outLen; i++) {
+    pos += snprintf(out + pos, outLen - pos, "%02X", addr[i]);
+  }
+}
+
 static std::string escapeJson(const std::string &input) {
   std::string out;
   out.reserve(input.size() + 8);
@@ -367,19 +891,142 @@ static bool ensureLittleFS() {
   return littlefsReady;
 }
 
-static bool getFlashStats(size_t &total, size_t &used, size_t &freeSpace, size_t &logBytes) {
+static size_t logBudgetBytes() {
+  if (deviceConfig.logBudgetKb > 0) return (size_t)deviceConfig.logBudgetKb * 1024;
+  if (!ensureLittleFS()) return 0;
+  return LittleFS.totalBytes() / 100 * LOG_BUDGET_AUTO_PERCENT;
+}
+
+static void saveLogRing() {
+  ensurePrefs();
+  if (!prefsReady) return;
+  prefs.putUInt("log_tail", logRing.tail());
+  prefs.putUInt("log_head", logRing.head());
+}
+
+// NVS keys are limited to 15 characters, so clients are stored by hash.
+static void logSyncKey(const std::string &client, char *out, size_t outLen) {
+  uint32_t hash = 2166136261UL;
+  for (char c : client) {
+    hash ^= (uint8_t)c;
+    hash *= 16777619UL;
+  }
+  snprintf(out, outLen, "sync_%08lx", (unsigned long)hash);
+}
+
+static bool loadLogSyncPoint(const std::string &client, LogSyncPoint &point) {
+  ensurePrefs();
+  if (!prefsReady) return false;
+  char key[16];
+  logSyncKey(client, key, sizeof(key));
+  return prefs.getBytes(key, &point, sizeof(point)) == sizeof(point);
+}
+
+static void saveLogSyncPoint(const std::string &client, const LogSyncPoint &point) {
+  ensurePrefs();
+  if (!prefsReady) return;
+  char key[16];
+  logSyncKey(client, key, sizeof(key));
+  prefs.putBytes(key, &point, sizeof(point));
+}
+
+static uint8_t logSegmentVersion(uint32_t seq) {
+  char path[32];
+  logRing.segmentPath(seq, path, sizeof(path));
+  if (!LittleFS.exists(path)) return 0;
+  File file = LittleFS.open(path, "r");
+  if (!file) return 0;
+  uint8_t header[BinaryLogger::kHeaderBytes];
+  const size_t n = file.read(header, sizeof(header));
+  file.close();
+  return BinaryLogger::headerVersion(header, n);
+}
+
+// Reader position just past the last row of a segment.
+static uint32_t logSegmentEnd(uint32_t seq) {
+  const uint32_t size = (uint32_t)logRing.segmentSize(seq);
+  return logSegmentVersion(seq) == BinaryLogger::kBlockVersion ? size << 8 : size;
+}
+
+// Drops whole segments from the old end until the ring fits its budget and
+// the filesystem keeps room for two more segments.
+static bool trimLogRing() {
+  // A suspended export still holds marks into the old end.
+  if (csvStreamActive) return false;
+  bool dropped = false;
+  while (logRing.tail() < logRing.head()) {
+    const size_t total = LittleFS.totalBytes();
+    const size_t used = LittleFS.usedBytes();
+    const size_t freeSpace = total > used ? total - used : 0;
+    if (!logRing.overBudget() && freeSpace >= 2 * LOG_SEGMENT_BYTES) break;
+    logRing.dropOldest();
+    dropped = true;
+  }
+  if (dropped && DEBUG_VERBOSE) {
+    Serial.print("[FLASH] Oldest segments dropped, tail=");
+    Serial.println((unsigned long)logRing.tail());
+  }
+  return dropped;
+}
+
+// Migrated files carry no time index, so new rows start a segment of their
+// own: a range scan stops at the first index entry past its end and would
+// otherwise skip the unindexed rows in front of it.
+static void migrateLegacyLogs() {
+  const char *paths[] = {LOG_PATH, LOG_BIN_PATH};
+  bool migrated = false;
+  for (const char *path : paths) {
+    if (!LittleFS.exists(path)) continue;
+    if (logRing.headBytes() > 0) logRing.advance();
+    if (!LittleFS.rename(path, logRing.headPath())) continue;
+    logRing.noteAppended(logRing.segmentSize(logRing.head()));
+    migrated = true;
+    Serial.print("[FLASH] Migrated ");
+    Serial.print(path);
+    Serial.print(" to ");
+    Serial.println(logRing.headPath());
+  }
+  if (migrated) {
+    logRing.advance();
+    logIndexCountdown = 0;
+  }
+}
+
+static bool ensureLogRing() {
+  if (logRingReady) return true;
   if (!ensureLittleFS()) return false;
+  ensurePrefs();
+  const uint32_t tail = prefsReady ? prefs.getUInt("log_tail", 1) : 1;
+  const uint32_t head = prefsReady ? prefs.getUInt("log_head", 1) : 1;
+  if (!logRing.begin(tail, head)) {
+    Serial.println("[FLASH] Log dir unavailable");
+    return false;
+  }
+  logRing.setBudget(logBudgetBytes());
+  migrateLegacyLogs();
+  logRingHeadVersion = logSegmentVersion(logRing.head());
+  trimLogRing();
+  saveLogRing();
+  logRingReady = true;
+  if (DEBUG_VERBOSE) {
+    Serial.print("[FLASH] Ring tail=");
+    Serial.print((unsigned long)logRing.tail());
+    Serial.print(" head=");
+    Serial.print((unsigned long)logRing.head());
+    Serial.print(" bytes=");
+    Serial.print((unsigned long)logRing.bytes());
+    Serial.print(" budget=");
+    Serial.println((unsigned long)logRing.budget());
+  }
+  return true;
+}
+
+static bool getFlashStats(size_t &total, size_t &used, size_t &freeSpace, size_t &logBytes) {
+  if (!ensureLogRing()) return false;
   total = LittleFS.totalBytes();
   used = LittleFS.usedBytes();
   freeSpace = total > used ? total - used : 0;
-  logBytes = 0;
-  if (LittleFS.exists(LOG_PATH)) {
-    File file = LittleFS.open(LOG_PATH, "r");
-    if (file) {
-      logBytes = file.size();
-      file.close();
-    }
-  }
+  logBytes = logRing.bytes();
   return true;
 }
 
@@ -393,34 +1040,48 @@ static bool buildFlashJson(std::string &out, bool withEstimates) {
   size_t estSamples = 0;
   uint64_t estSeconds = 0;
   if (withEstimates) {
+    // Time until the ring starts dropping its oldest segments.
+    const size_t budget = logRing.budget();
+    size_t room = freeSpace;
+    if (budget > 0) {
+      const size_t budgetRoom = budget > logBytes ? budget - logBytes : 0;
+      if (budgetRoom < room) room = budgetRoom;
+    }
     const size_t lineBytes = estimateLineBytes();
-    estSamples = lineBytes > 0 ? (freeSpace / lineBytes) : 0;
-    estSeconds = deviceConfig.frequencyMs
-      ? (uint64_t)estSamples * (uint64_t)deviceConfig.frequencyMs / 1000ULL
+    const size_t tickBytes = estimateTickBytes();
+    estSamples = lineBytes > 0 ? (room / lineBytes) : 0;
+    estSeconds = (deviceConfig.frequencyMs && tickBytes > 0)
+      ? (uint64_t)(room / tickBytes) * (uint64_t)deviceConfig.frequencyMs / 1000ULL
       : 0;
   }
-  char buf[240];
+  char buf[320];
   if (withEstimates) {
     snprintf(buf, sizeof(buf),
              "\"flash\":{\"total\":%lu,\"used\":%lu,\"free\":%lu,"
              "\"percent_used\":%lu,\"log_bytes\":%lu,"
+             "\"log_budget\":%lu,\"segments\":%lu,"
              "\"est_samples\":%lu,\"est_seconds\":%lu}",
              (unsigned long)total,
              (unsigned long)used,
              (unsigned long)freeSpace,
              percentUsed,
              (unsigned long)logBytes,
+             (unsigned long)logRing.budget(),
+             (unsigned long)logRing.segmentCount(),
              (unsigned long)estSamples,
              (unsigned long)estSeconds);
   } else {
     snprintf(buf, sizeof(buf),
              "\"flash\":{\"total\":%lu,\"used\":%lu,\"free\":%lu,"
-             "\"percent_used\":%lu,\"log_bytes\":%lu}",
+             "\"percent_used\":%lu,\"log_bytes\":%lu,"
+             "\"log_budget\":%lu,\"segments\":%lu}",
              (unsigned long)total,
              (unsigned long)used,
              (unsigned long)freeSpace,
              percentUsed,
-             (unsigned long)logBytes);
+             (unsigned long)logBytes,
+             (unsigned long)logRing.budget(),
+             (unsigned long)logRing.segmentCount());
   }
   out.assign(buf);
   return true;
@@ -434,13 +1095,27 @@ static void loadConfig() {
   deviceConfig.i2cSda = prefs.getInt("i2c_sda", I2C_SDA);
   deviceConfig.i2cScl = prefs.getInt("i2c_scl", I2C_SCL);
   deviceConfig.onewirePin = prefs.getInt("onewire_pin", -1);
+  deviceConfig.onewireBits = prefs.getUChar("onewire_bits", DS18B20_MAX_BITS);
+  if (deviceConfig.onewireBits < DS18B20_MIN_BITS || deviceConfig.onewireBits > DS18B20_MAX_BITS) {
+    deviceConfig.onewireBits = DS18B20_MAX_BITS;
+  }
   deviceConfig.analogPin = prefs.getInt("analog_pin", -1);
   deviceConfig.digitalPin = prefs.getInt("digital_pin", -1);
   deviceConfig.buttonPin = prefs.getInt("button_pin", -1);
   deviceConfig.neopixelPin = prefs.getInt("neopixel_pin", -1);
   deviceConfig.frequencyMs = prefs.getUInt("freq_ms", 1000);
   deviceConfig.storeFlash = prefs.getBool("store_flash", false);
+  deviceConfig.deepSleep = prefs.getBool("deep_sleep", false);
+  deviceConfig.logFormat = normalizeLogFormat(std::string(prefs.getString("log_format", "csv").c_str()));
+  deviceConfig.logBudgetKb = prefs.getUInt("log_budget_kb", 0);
+  deviceConfig.ms5611Osr = prefs.getUInt("ms5611_osr", 4096);
+  deviceConfig.ms5611Hz = prefs.getUInt("ms5611_hz", 0);
+  deviceConfig.vario = prefs.getBool("vario", false);
   sensorIntervalMs = deviceConfig.frequencyMs ? deviceConfig.frequencyMs : 1000;
+  i2cStoredHz = prefs.getUInt("i2c_hz", 0);
+  if (prefs.getBytesLength("sensor_cache") == sizeof(sensorCache)) {
+    prefs.getBytes("sensor_cache", &sensorCache, sizeof(sensorCache));
+  }
 }
 
 static void saveConfig() {
@@ -451,12 +1126,32 @@ static void saveConfig() {
   prefs.putInt("i2c_sda", deviceConfig.i2cSda);
   prefs.putInt("i2c_scl", deviceConfig.i2cScl);
   prefs.putInt("onewire_pin", deviceConfig.onewirePin);
+  prefs.putUChar("onewire_bits", deviceConfig.onewireBits);
   prefs.putInt("analog_pin", deviceConfig.analogPin);
   prefs.putInt("digital_pin", deviceConfig.digitalPin);
   prefs.putInt("button_pin", deviceConfig.buttonPin);
   prefs.putInt("neopixel_pin", deviceConfig.neopixelPin);
   prefs.putUInt("freq_ms", deviceConfig.frequencyMs);
   prefs.putBool("store_flash", deviceConfig.storeFlash);
+  prefs.putBool("deep_sleep", deviceConfig.deepSleep);
+  prefs.putString("log_format", deviceConfig.logFormat.c_str());
+  prefs.putUInt("log_budget_kb", deviceConfig.logBudgetKb);
+  prefs.putUInt("ms5611_osr", deviceConfig.ms5611Osr);
+  prefs.putUInt("ms5611_hz", deviceConfig.ms5611Hz);
+  prefs.putBool("vario", deviceConfig.vario);
+}
+
+// Rescans run on every connection: only write NVS when the result changed.
+static void storeSensorCache(const SensorCache &entry) {
+  if (memcmp(&entry, &sensorCache, sizeof(entry)) == 0) return;
+  sensorCache = entry;
+  ensurePrefs();
+  if (!prefsReady) return;
+  if (entry.kind == SENSOR_CACHE_NONE) {
+    prefs.remove("sensor_cache");
+  } else {
+    prefs.putBytes("sensor_cache", &sensorCache, sizeof(sensorCache));
+  }
 }
 
 static void sendNameAck(const char *status, const std::string &name, const char *message) {
@@ -479,8 +1174,7 @@ static void sendNameAck(const char *status, const std::string &name, const char
     Serial.print(" name=");
     Serial.println(name.c_str());
   }
-  txChar->setValue(payload);
-  txChar->notify();
+  bleNotify(txChar, payload);
 }
 
 static void sendConfigAck(const char *status, const char *message) {
@@ -497,8 +1191,7 @@ static void sendConfigAck(const char *status, const char *message) {
   }
   Serial.print("[BLE] ACK: ");
   Serial.println(payload);
-  txChar->setValue(payload);
-  txChar->notify();
+  bleNotify(txChar, payload);
 }
 
 static void sendFlashAck(const char *action, const char *status, const char *message) {
@@ -515,104 +1208,12 @@ static void sendFlashAck(const char *action, const char *status, const char *mes
   }
   Serial.print("[BLE] ACK: ");
   Serial.println(payload);
-  txChar->setValue(payload);
-  txChar->notify();
-}
-
-static bool extractJsonStringField(const std::string &json, const char *key, std::string &out) {
-  if (!key || !key[0]) return false;
-  const std::string pattern = std::string("\"") + key + "\"";
-  size_t pos = json.find(pattern);
-  if (pos == std::string::npos) return false;
-  pos = json.find(':', pos + pattern.size());
-  if (pos == std::string::npos) return false;
-  pos++;
-  while (pos < json.size() && isspace((unsigned char)json[pos])) pos++;
-  if (pos >= json.size()) return false;
-  const char quote = json[pos];
-  if (quote == '"' || quote == '\'') {
-    pos++;
-    size_t end = json.find(quote, pos);
-    if (end == std::string::npos) return false;
-    out = json.substr(pos, end - pos);
-    return !out.empty();
-  }
-  size_t end = pos;
-  while (end < json.size() && json[end] != ',' && json[end] != '}' && !isspace((unsigned char)json[end])) end++;
-  out = json.substr(pos, end - pos);
-  return !out.empty();
-}
-
-static bool extractJsonNumberField(const std::string &json, const char *key, int &out) {
-  std::string temp;
-  if (!extractJsonStringField(json, key, temp)) return false;
-  out = atoi(temp.c_str());
-  return true;
-}
-
-static bool extractJsonNumberFieldU32(const std::string &json, const char *key, uint32_t &out) {
-  std::string temp;
-  if (!extractJsonStringField(json, key, temp)) return false;
-  long val = atol(temp.c_str());
-  if (val < 0) return false;
-  out = (uint32_t)val;
-  return true;
-}
-
-static bool extractJsonNumberFieldU64(const std::string &json, const char *key, uint64_t &out) {
-  std::string temp;
-  if (!extractJsonStringField(json, key, temp)) return false;
-  unsigned long long val = strtoull(temp.c_str(), nullptr, 10);
-  out = (uint64_t)val;
-  return true;
-}
-
-static bool extractJsonBoolField(const std::string &json, const char *key, bool &out) {
-  std::string temp;
-  if (!extractJsonStringField(json, key, temp)) return false;
-  std::string raw = lowerCopy(trimCopy(temp));
-  if (raw == "true" || raw == "1" || raw == "yes" || raw == "on") {
-    out = true;
-    return true;
-  }
-  if (raw == "false" || raw == "0" || raw == "no" || raw == "off") {
-    out = false;
-    return true;
-  }
-  return false;
-}
-
-static bool extractJsonObjectField(const std::string &json, const char *key, std::string &out) {
-  if (!key || !key[0]) return false;
-  const std::string pattern = std::string("\"") + key + "\"";
-  size_t pos = json.find(pattern);
-  if (pos == std::string::npos) return false;
-  pos = json.find(':', pos + pattern.size());
-  if (pos == std::string::npos) return false;
-  pos++;
-  while (pos < json.size() && isspace((unsigned char)json[pos])) pos++;
-  if (pos >= json.size() || json[pos] != '{') return false;
-  size_t start = pos;
-  int depth = 0;
-  for (; pos < json.size(); pos++) {
-    if (json[pos] == '{') depth++;
-    else if (json[pos] == '}') {
-      depth--;
-      if (depth == 0) {
-        out = json.substr(start, pos - start + 1);
-        return true;
-      }
-    }
-  }
-  return false;
+  bleNotify(txChar, payload);
 }
 
 static bool extractNameFromConfig(const std::string &value, std::string &out) {
   std::string trimmed = trimCopy(value);
   if (trimmed.empty()) return false;
-  if (trimmed.front() == '{') {
-    if (extractJsonStringField(trimmed, "name", out)) return true;
-  }
 
   size_t pos = trimmed.find("name");
   if (pos != std::string::npos) {
@@ -702,6 +1303,12 @@ static std::string buildConfigJson() {
   addField("sensor", deviceConfig.sensor);
   addNumU32("frequency", deviceConfig.frequencyMs);
   addBool("store_flash", deviceConfig.storeFlash);
+  addBool("deep_sleep", deviceConfig.deepSleep);
+  addField("log_format", deviceConfig.logFormat);
+  addNumU32("log_budget_kb", deviceConfig.logBudgetKb);
+  addNumU32("ms5611_osr", deviceConfig.ms5611Osr);
+  addNumU32("ms5611_hz", deviceConfig.ms5611Hz);
+  addBool("vario", deviceConfig.vario);
 
   if (deviceConfig.i2cSda >= 0 || deviceConfig.i2cScl >= 0) {
     if (!first) out += ",";
@@ -719,6 +1326,12 @@ static std::string buildConfigJson() {
       out += String(deviceConfig.i2cScl).c_str();
       innerFirst = false;
     }
+    if (i2cBusReady) {
+      if (!innerFirst) out += ",";
+      out += "\"hz\":";
+      out += String((unsigned long)i2cClockHz).c_str();
+      innerFirst = false;
+    }
     out += "}";
     first = false;
   }
@@ -727,6 +1340,8 @@ static std::string buildConfigJson() {
     if (!first) out += ",";
     out += "\"onewire\":{\"pin\":";
     out += String(deviceConfig.onewirePin).c_str();
+    out += ",\"resolution\":";
+    out += String(deviceConfig.onewireBits).c_str();
     out += "}";
     first = false;
   }
@@ -766,6 +1381,11 @@ static std::string buildConfigJson() {
     first = false;
   }
 
+  std::string powerJson;
+  buildPowerJson(powerJson);
+  if (!first) out += ",";
+  out += powerJson;
+
   out += "}}";
   return out;
 }
@@ -775,8 +1395,7 @@ static void sendConfigPayload() {
   const std::string payload = buildConfigJson();
   Serial.print("[BLE] TX: ");
   Serial.println(payload.c_str());
-  txChar->setValue(payload);
-  txChar->notify();
+  bleNotify(txChar, payload);
 }
 
 static void sendFlashStatus() {
@@ -795,8 +1414,7 @@ static void sendFlashStatus() {
     Serial.print("[FLASH] Status bytes=");
     Serial.println((unsigned int)payload.size());
   }
-  txChar->setValue(payload);
-  txChar->notify();
+  bleNotify(txChar, payload);
 }
 
 static void sendCsvPayload(const std::string &csv) {
@@ -812,8 +1430,7 @@ static void sendCsvPayload(const std::string &csv) {
     Serial.print(" data=");
     Serial.println((unsigned int)csv.size());
   }
-  txChar->setValue(payload);
-  txChar->notify();
+  bleNotify(txChar, payload);
 }
 
 static void sendProfilesForSensor(const std::string &sensor) {
@@ -856,44 +1473,87 @@ static void sendProfilesForSensor(const std::string &sensor) {
   payload += "}}";
   Serial.print("[BLE] TX: ");
   Serial.println(payload.c_str());
-  txChar->setValue(payload);
-  txChar->notify();
+  bleNotify(txChar, payload);
 }
 
 static bool ensureLogFile() {
-  if (!ensureLittleFS()) return false;
-  const bool ok = csvLogger.begin(true);
+  if (!ensureLogRing()) return false;
+  const uint8_t version = logFormatVersion();
+  if (version != 0 && binLogger.version() != version
+      && !binLogger.setBlocks(version == BinaryLogger::kBlockVersion)) {
+    return false;
+  }
+  const bool ok = version != 0 ? binLogger.begin() : csvLogger.begin(true);
   if (DEBUG_VERBOSE && ok) {
     Serial.print("[FLASH] Log ready at ");
-    Serial.println(LOG_PATH);
+    Serial.println(logRing.headPath());
   }
   return ok;
 }
 
+// Closes the head segment and starts a new one; a segment only ever holds
+// one format so readers can sniff it from the first bytes.
+static void rotateLogSegment() {
+  csvLogger.end();
+  binLogger.end();
+  logRing.advance();
+  logIndexCountdown = 0;
+  trimLogRing();
+  saveLogRing();
+  if (DEBUG_VERBOSE) {
+    Serial.print("[FLASH] New segment ");
+    Serial.println(logRing.headPath());
+  }
+}
+
+static void flushLogs() {
+  csvLogger.flush();
+  binLogger.flush();
+}
+
 static void flashClear() {
-  if (!ensureLittleFS()) return;
-  if (LittleFS.exists(LOG_PATH)) {
-    LittleFS.remove(LOG_PATH);
-    if (DEBUG_VERBOSE) {
-      Serial.print("[FLASH] Log file cleared (");
-      Serial.print(LOG_PATH);
-      Serial.println(")");
-    }
-  } else {
-    if (DEBUG_VERBOSE) {
-      Serial.print("[FLASH] Log file not found (");
-      Serial.print(LOG_PATH);
-      Serial.println(")");
-    }
+  if (!ensureLogRing()) return;
+  csvLogger.end();
+  binLogger.end();
+  const uint32_t segments = logRing.segmentCount();
+  logRing.clear();
+  logIndexCountdown = 0;
+  saveLogRing();
+  if (DEBUG_VERBOSE) {
+    Serial.print("[FLASH] Log cleared (");
+    Serial.print((unsigned long)segments);
+    Serial.println(" segments)");
   }
 }
 
+// Bytes per logged row and per acquisition tick, measured from what was
+// actually appended; the fixed guesses only apply until the first tick.
 static size_t estimateLineBytes() {
+  if (logRowBytesAvg > 0) return logRowBytesAvg;
+  if (logFormatVersion() == BinaryLogger::kBlockVersion) return 8;
+  if (logFormatVersion() != 0) return 24;
   const std::string sensor = normalizeSensor(deviceConfig.sensor);
   if (sensor == "i2c") return 120;
   return 96;
 }
 
+static size_t estimateTickBytes() {
+  if (logTickBytesAvg > 0) return logTickBytesAvg;
+  return estimateLineBytes();
+}
+
+static void noteLoggedBytes(size_t bytes) {
+  if (bytes == 0) return;
+  logTickBytes += bytes;
+  logRowBytesAvg = logRowBytesAvg ? (logRowBytesAvg * 7 + bytes + 4) / 8 : bytes;
+}
+
+static void finishLogTick() {
+  if (logTickBytes == 0) return;
+  logTickBytesAvg = logTickBytesAvg ? (logTickBytesAvg * 7 + logTickBytes + 4) / 8 : logTickBytes;
+  logTickBytes = 0;
+}
+
 static void applyTimeSync(uint64_t epochMs) {
   epochOffsetMs = (int64_t)epochMs - (int64_t)millis();
   timeSynced = true;
@@ -920,12 +1580,25 @@ static uint64_t currentEpochMs() {
   return (uint64_t)now;
 }
 
-static uint64_t currentLocalMs() {
-  int64_t local = (int64_t)currentEpochMs() - (int64_t)tzOffsetMin * 60000LL;
+static uint64_t epochToLocalMs(uint64_t epochMs) {
+  int64_t local = (int64_t)epochMs - (int64_t)tzOffsetMin * 60000LL;
   if (local < 0) return 0;
   return (uint64_t)local;
 }
 
+static uint64_t currentLocalMs() {
+  return epochToLocalMs(currentEpochMs());
+}
+
+// from_ms/to_ms arrive as epoch ms; log rows are stamped in local time.
+static void exportRange(const ConfigUpdate &update, uint64_t &fromMs, uint64_t &toMs) {
+  fromMs = 0;
+  toMs = UINT64_MAX;
+  if (!update.hasRange) return;
+  if (update.fromMs > 0) fromMs = epochToLocalMs(update.fromMs);
+  if (update.toMs != UINT64_MAX) toMs = epochToLocalMs(update.toMs);
+}
+
 static void formatTimestamp(uint64_t epochMs, char *out, size_t outLen) {
   if (!out || outLen == 0) return;
   time_t seconds = (time_t)(epochMs / 1000ULL);
@@ -937,6 +1610,32 @@ static void formatTimestamp(uint64_t epochMs, char *out, size_t outLen) {
            tmInfo.tm_hour, tmInfo.tm_min, tmInfo.tm_sec);
 }
 
+static int64_t daysFromCivil(int year, unsigned month, unsigned day) {
+  year -= month <= 2;
+  const int era = (year >= 0 ? year : year - 399) / 400;
+  const unsigned yoe = (unsigned)(year - era * 400);
+  const unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return (int64_t)era * 146097 + (int64_t)doe - 719468;
+}
+
+// Inverse of formatTimestamp for the leading column of a CSV row.
+static bool parseCsvTimestamp(const char *text, uint64_t &outMs) {
+  int day = 0;
+  int month = 0;
+  int year = 0;
+  int hour = 0;
+  int minute = 0;
+  int second = 0;
+  if (sscanf(text, "%d/%d/%d %d:%d:%d", &day, &month, &year, &hour, &minute, &second) != 6) return false;
+  if (month < 1 || month > 12 || day < 1 || day > 31) return false;
+  const int64_t days = daysFromCivil(2000 + year, (unsigned)month, (unsigned)day);
+  const int64_t seconds = days * 86400 + hour * 3600 + minute * 60 + second;
+  if (seconds < 0) return false;
+  outMs = (uint64_t)seconds * 1000ULL;
+  return true;
+}
+
 static void formatCsvFloat(char *out, size_t outLen, float value, uint8_t decimals = 3) {
   if (!out || outLen == 0) return;
   if (!isfinite(value)) {
@@ -957,7 +1656,40 @@ static std::string sanitizeCsvToken(const char *token) {
   return out;
 }
 
+static void formatCsvRow(
+    uint64_t localMs,
+    const float *values,
+    const char *sensor,
+    const char *address,
+    char *line,
+    size_t lineLen) {
+  char tsBuf[24];
+  char valueBufs[LOG_FIELD_COUNT][20];
+  formatTimestamp(localMs, tsBuf, sizeof(tsBuf));
+  for (uint8_t i = 0; i < LOG_FIELD_COUNT; i++) {
+    formatCsvFloat(valueBufs[i], sizeof(valueBufs[i]), values[i]);
+  }
+  const std::string sensorSafe = sanitizeCsvToken(sensor);
+  const std::string addrSafe = sanitizeCsvToken(address);
+  snprintf(
+      line, lineLen, "%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s",
+      tsBuf, valueBufs[0], valueBufs[1], valueBufs[2], valueBufs[3], valueBufs[4],
+      valueBufs[5], valueBufs[6], valueBufs[7], valueBufs[8],
+      sensorSafe.c_str(), addrSafe.c_str());
+}
+
+static void formatBinaryRow(const BinaryLogRecord &record, char *line, size_t lineLen) {
+  float values[LOG_FIELD_COUNT];
+  for (uint8_t i = 0; i < LOG_FIELD_COUNT; i++) {
+    values[i] = (record.mask & (1U << i)) ? record.values[i] : NAN;
+  }
+  char addr[24];
+  formatHexAddress(record.addr, record.addrLen, addr, sizeof(addr));
+  formatCsvRow(record.timestampMs, values, logSensorName(record.sensorId), addr, line, lineLen);
+}
+
 static void flashLogRow(
+    uint64_t localMs,
     const char *sensor,
     const char *address,
     float temperature,
@@ -971,60 +1703,65 @@ static void flashLogRow(
     float generic) {
   if (!deviceConfig.storeFlash) return;
   if (csvExportInProgress) return;
+  if (!ensureLogRing()) return;
+  const uint8_t version = logFormatVersion();
+  const bool binary = version != 0;
+  if (logRing.headBytes() > 0 && (logRing.headFull() || logRingHeadVersion != version)) {
+    rotateLogSegment();
+  }
   if (!ensureLogFile()) return;
 
-  char tsBuf[24];
-  char tempBuf[20];
-  char humBuf[20];
-  char pressBuf[20];
-  char iaqBuf[20];
-  char iaAccBuf[20];
-  char vocBuf[20];
-  char co2Buf[20];
-  char gasBuf[20];
-  char genericBuf[20];
-  formatTimestamp(currentLocalMs(), tsBuf, sizeof(tsBuf));
-  formatCsvFloat(tempBuf, sizeof(tempBuf), temperature);
-  formatCsvFloat(humBuf, sizeof(humBuf), humidity);
-  formatCsvFloat(pressBuf, sizeof(pressBuf), pressure);
-  formatCsvFloat(iaqBuf, sizeof(iaqBuf), iaq);
-  formatCsvFloat(iaAccBuf, sizeof(iaAccBuf), iaqAccuracy);
-  formatCsvFloat(vocBuf, sizeof(vocBuf), voc);
-  formatCsvFloat(co2Buf, sizeof(co2Buf), eqco2);
-  formatCsvFloat(gasBuf, sizeof(gasBuf), gasKOhm);
-  formatCsvFloat(genericBuf, sizeof(genericBuf), generic);
-
-  const std::string sensorSafe = sanitizeCsvToken(sensor);
-  const std::string addrSafe = sanitizeCsvToken(address);
-  char line[320];
-  snprintf(
-      line, sizeof(line), "%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s",
-      tsBuf, tempBuf, humBuf, pressBuf, iaqBuf, iaAccBuf, vocBuf, co2Buf, gasBuf, genericBuf,
-      sensorSafe.c_str(), addrSafe.c_str());
-  csvLogger.appendLine(line);
+  const float values[LOG_FIELD_COUNT] = {
+    temperature, humidity, pressure, iaq, iaqAccuracy, voc, eqco2, gasKOhm, generic
+  };
+  // Every LOG_INDEX_EVERY rows, the row's offset goes into the segment's
+  // time index; binary rows there start with an anchor or a new block so
+  // readers can seek.
+  const bool indexRow = logIndexCountdown == 0;
+  if (indexRow && binary) binLogger.anchorNext();
+  const size_t offset = binary ? binLogger.position() : csvLogger.size();
+  size_t written = 0;
+  if (binary) {
+    BinaryLogRecord record;
+    record.timestampMs = localMs;
+    record.sensorId = logSensorId(sensor);
+    record.addrLen = parseHexAddress(address, record.addr, BinaryLogRecord::kMaxAddr);
+    for (uint8_t i = 0; i < LOG_FIELD_COUNT; i++) {
+      if (!isfinite(values[i])) continue;
+      record.mask |= (uint16_t)(1U << i);
+      record.values[i] = values[i];
+    }
+    written = binLogger.append(record);
+  } else {
+    char line[320];
+    formatCsvRow(localMs, values, sensor, address, line, sizeof(line));
+    if (csvLogger.appendLine(line)) written = strlen(line) + 1;
+  }
+  if (written > 0) {
+    logRing.noteAppended(written);
+    logRingHeadVersion = version;
+    noteLoggedBytes(written);
+    if (indexRow) {
+      logRing.appendIndex(localMs, (uint32_t)offset);
+      logIndexCountdown = LOG_INDEX_EVERY - 1;
+    } else {
+      logIndexCountdown--;
+    }
+  } else if (logRing.dropOldest()) {
+    // Most likely a full filesystem: make room for the next tick.
+    saveLogRing();
+  }
 
   if (DEBUG_VERBOSE) {
+    char tsBuf[24];
+    formatTimestamp(localMs, tsBuf, sizeof(tsBuf));
     Serial.print("[FLASH] Log row ts=");
     Serial.print(tsBuf);
     Serial.print(" sensor=");
-    Serial.print(sensorSafe.c_str());
+    Serial.print(sensor ? sensor : "");
     Serial.print(" addr=");
-    Serial.println(addrSafe.c_str());
-  }
-}
-
-static std::string readFlashCsv() {
-  if (!ensureLittleFS()) return std::string(LOG_HEADER) + "\n";
-  if (!LittleFS.exists(LOG_PATH)) return std::string(LOG_HEADER) + "\n";
-  File file = LittleFS.open(LOG_PATH, "r");
-  if (!file) return std::string(LOG_HEADER) + "\n";
-  std::string out;
-  out.reserve(file.size() + 16);
-  while (file.available()) {
-    out.push_back((char)file.read());
+    Serial.println(address ? address : "");
   }
-  file.close();
-  return out;
 }
 
 static size_t csvChunkBytes() {
@@ -1069,49 +1806,196 @@ static void sendCsvChunk(uint32_t exportId, uint32_t seq, uint32_t totalBytes, b
     Serial.print(" payload=");
     Serial.println((unsigned int)payload.size());
   }
-  txChar->setValue(payload);
-  txChar->notify();
+  bleNotify(txChar, payload);
 }
 
-static void sendCsvFromFlash() {
-  LOGVLN("[CSV] Export requested");
-  if (csvStreamActive) return;
-  csvExportInProgress = true;
-  csvExportStartedAt = millis();
-  csvStreamId = ++csvExportId;
-  csvStreamSeq = 0;
-  csvStreamLastSent = 0;
-  csvStreamLastAck = 0;
-  csvStreamAllSent = false;
-  csvAwaitAck = false;
-  csvStreamLastActivityMs = millis();
+// Export line source: walks the ring from tail to head and yields the CSV
+// header once, then every row of each segment rendered to CSV whatever its
+// on-flash format.
+static void logCursorCloseSegment(LogCursor &cursor) {
+  if (cursor.file) cursor.file.close();
+  cursor.bin.close();
+  cursor.segmentOpen = false;
+}
 
-  if (!ensureLogFile()) {
-    sendFlashAck("flash_export", "error", "Flash indisponible");
-    endCsvStream();
-    return;
-  }
-  File sizeFile = LittleFS.open(LOG_PATH, "r");
-  size_t totalBytes = 0;
-  if (sizeFile) {
-    totalBytes = sizeFile.size();
-    sizeFile.close();
+static bool logCursorOpenSegment(LogCursor &cursor, uint32_t seq) {
+  char path[32];
+  logRing.segmentPath(seq, path, sizeof(path));
+  if (!LittleFS.exists(path)) return false;
+  cursor.binary = logSegmentVersion(seq) != 0;
+  uint32_t offset = 0;
+  const bool seek = cursor.fromMs > 0 && logRing.seekIndex(seq, cursor.fromMs, offset);
+  if (cursor.binary) {
+    if (!cursor.bin.open(LittleFS, path)) return false;
+    if (seek) cursor.bin.seek(offset);
+  } else {
+    cursor.file = LittleFS.open(path, "r");
+    if (!cursor.file) return false;
+    // Every CSV segment starts with its own header; only the first is exported.
+    String first = cursor.file.readStringUntil('\n');
+    if (!first.startsWith("date,")) cursor.file.seek(0);
+    if (seek && offset > cursor.file.position()) cursor.file.seek(offset);
   }
+  cursor.segmentOpen = true;
+  return true;
+}
+
+static bool logCursorWants(const LogCursor &cursor, uint64_t rowMs) {
+  return rowMs <= cursor.toMs && rowMs + 999 >= cursor.fromMs;
+}
+
+static bool logCursorOpen(LogCursor &cursor, uint64_t fromMs = 0, uint64_t toMs = UINT64_MAX) {
+  logCursorCloseSegment(cursor);
+  cursor.headerSent = false;
+  cursor.rows = 0;
+  cursor.fromMs = fromMs;
+  cursor.toMs = toMs;
+  if (!ensureLogRing()) return false;
+  cursor.seq = logRing.tail();
+  if (fromMs == 0) return true;
+  // Start from the newest segment that begins at or before the range.
+  for (uint32_t seq = logRing.tail(); seq <= logRing.head(); seq++) {
+    uint64_t firstMs = 0;
+    if (!logRing.firstIndexed(seq, firstMs)) continue;
+    if (firstMs > fromMs) break;
+    cursor.seq = seq;
+  }
+  return true;
+}
+
+static void logCursorClose(LogCursor &cursor) {
+  logCursorCloseSegment(cursor);
+}
+
+static LogCursorMark logCursorTell(const LogCursor &cursor) {
+  LogCursorMark mark;
+  mark.seq = cursor.seq;
+  mark.headerSent = cursor.headerSent;
+  mark.rows = cursor.rows;
+  if (cursor.segmentOpen) {
+    mark.offset = cursor.binary ? cursor.bin.position() : (uint32_t)cursor.file.position();
+    mark.lastTs = cursor.binary ? cursor.bin.lastTimestamp() : 0;
+  }
+  return mark;
+}
+
+static void logCursorSeek(LogCursor &cursor, const LogCursorMark &mark) {
+  logCursorCloseSegment(cursor);
+  cursor.seq = mark.seq;
+  cursor.headerSent = mark.headerSent;
+  cursor.rows = mark.rows;
+  if (mark.offset == 0 || !logCursorOpenSegment(cursor, mark.seq)) return;
+  if (cursor.binary) {
+    cursor.bin.seek(mark.offset, mark.lastTs);
+  } else {
+    cursor.file.seek(mark.offset);
+  }
+}
+
+static bool logCursorHasMore(LogCursor &cursor) {
+  if (!cursor.headerSent) return true;
+  while (true) {
+    if (cursor.segmentOpen) {
+      if (cursor.binary ? cursor.bin.available() : cursor.file.available() > 0) return true;
+      logCursorCloseSegment(cursor);
+      cursor.seq++;
+    }
+    if (cursor.seq > logRing.head()) return false;
+    // Written segments index their first row (logIndexCountdown restarts
+    // with each segment), so nothing in front of this entry is skipped.
+    uint64_t firstMs = 0;
+    if (logRing.firstIndexed(cursor.seq, firstMs) && firstMs > cursor.toMs) {
+      cursor.seq = logRing.head() + 1;
+      return false;
+    }
+    if (!logCursorOpenSegment(cursor, cursor.seq)) cursor.seq++;
+  }
+}
+
+static bool logCursorNextLine(LogCursor &cursor, std::string &line) {
+  if (!cursor.headerSent) {
+    cursor.lineMark = logCursorTell(cursor);
+    cursor.headerSent = true;
+    line = LOG_HEADER;
+    return true;
+  }
+  while (logCursorHasMore(cursor)) {
+    const LogCursorMark mark = logCursorTell(cursor);
+    if (cursor.binary) {
+      BinaryLogRecord record;
+      if (!cursor.bin.next(record)) {
+        cursor.bin.close();
+        continue;
+      }
+      if (!logCursorWants(cursor, record.timestampMs)) continue;
+      char row[320];
+      formatBinaryRow(record, row, sizeof(row));
+      line = row;
+      cursor.lineMark = mark;
+      cursor.rows++;
+      return true;
+    }
+    String raw = cursor.file.readStringUntil('\n');
+    raw.trim();
+    if (raw.length() == 0) continue;
+    uint64_t rowMs = 0;
+    if (parseCsvTimestamp(raw.c_str(), rowMs) && !logCursorWants(cursor, rowMs)) continue;
+    line = std::string(raw.c_str());
+    cursor.lineMark = mark;
+    cursor.rows++;
+    return true;
+  }
+  return false;
+}
+
+static void sendCsvFromFlash(uint64_t fromMs, uint64_t toMs, uint32_t window, bool binaryFraming, bool compress,
+                             const LogCursorMark *start) {
+  LOGVLN("[CSV] Export requested");
+  if (DEBUG_VERBOSE && (fromMs > 0 || toMs != UINT64_MAX)) {
+    Serial.print("[CSV] Range from=");
+    Serial.print((unsigned long long)fromMs);
+    Serial.print(" to=");
+    Serial.println((unsigned long long)toMs);
+  }
+  if (csvStreamActive) return;
+  csvExportInProgress = true;
+  csvExportStartedAt = millis();
+  csvStreamId = ++csvExportId;
+  csvStreamSeq = 0;
+  csvStreamAcked = 0;
+  csvRetransmitMask = 0;
+  csvStreamWindow = window == 0 ? CSV_WINDOW_DEFAULT : (uint8_t)(window > CSV_WINDOW_MAX ? CSV_WINDOW_MAX : window);
+  csvStreamBinary = binaryFraming && exportChar != nullptr;
+  // Compressed blocks are binary; without the heap for the encoder the
+  // stream simply goes out uncompressed (frames say which).
+  csvStreamLz = compress && csvStreamBinary && csvLz.begin();
+  csvStreamAllSent = false;
+  csvStreamLastActivityMs = millis();
+  for (CsvBlockSlot &slot : csvBlockMap) slot.seq = UINT32_MAX;
+
+  if (!ensureLogFile()) {
+    sendFlashAck("flash_export", "error", "Flash indisponible");
+    endCsvStream();
+    return;
+  }
+  flushLogs();
   const uint16_t mtu = bleMtu ? bleMtu : NimBLEDevice::getMTU();
   const size_t maxPayload = mtu > 3 ? (size_t)(mtu - 3) : 20;
-  if (totalBytes > 0 && totalBytes <= 900) {
-    File inlineFile = LittleFS.open(LOG_PATH, "r");
-    if (inlineFile) {
+  if (!start && !csvStreamBinary && logRing.bytes() <= 900) {
+    LogCursor inlineCursor;
+    if (logCursorOpen(inlineCursor, fromMs, toMs)) {
       std::string csv;
-      csv.reserve(totalBytes + 8);
-      while (inlineFile.available()) {
-        csv.push_back((char)inlineFile.read());
+      std::string line;
+      while (csv.size() <= 900 && logCursorNextLine(inlineCursor, line)) {
+        csv += line;
+        csv += "\n";
       }
-      inlineFile.close();
+      const bool complete = !logCursorHasMore(inlineCursor);
+      logCursorClose(inlineCursor);
       std::string payload = "{\"csv\":\"";
       payload += escapeJson(csv);
       payload += "\"}";
-      if (payload.size() <= maxPayload) {
+      if (complete && payload.size() <= maxPayload) {
         if (DEBUG_VERBOSE) {
           Serial.print("[CSV] Inline send bytes=");
           Serial.println((unsigned int)payload.size());
@@ -1123,63 +2007,68 @@ static void sendCsvFromFlash() {
     }
   }
 
-  csvStreamFile = LittleFS.open(LOG_PATH, "r");
-  if (!csvStreamFile) {
+  if (!logCursorOpen(csvStreamCursor, fromMs, toMs)) {
     sendFlashAck("flash_export", "error", "Lecture flash impossible");
     endCsvStream();
     return;
   }
+  if (start) logCursorSeek(csvStreamCursor, *start);
   if (DEBUG_VERBOSE) {
     Serial.print("[CSV] Stream start id=");
-    Serial.println((unsigned long)csvStreamId);
+    Serial.print((unsigned long)csvStreamId);
+    Serial.print(" window=");
+    Serial.print((unsigned int)csvStreamWindow);
+    Serial.print(" framing=");
+    Serial.println(csvStreamLz ? "binary+lz" : (csvStreamBinary ? "binary" : "json"));
   }
+  // Blocks go out from loop() through pumpCsvStream().
   csvStreamActive = true;
-  sendNextCsvBlock();
 }
 
-static void sendNextCsvBlock() {
-  if (!csvStreamActive || csvAwaitAck || !txChar) return;
-  if (!csvStreamFile) {
-    endCsvStream();
-    return;
-  }
-  if (!csvStreamFile.available() && !csvHasPendingLine) {
-    endCsvStream();
-    return;
+static std::string csvBlockPayload(uint32_t seq, const std::string &data, bool last) {
+  std::string payload = "{\"csv_block\":{\"id\":";
+  payload += std::to_string(csvStreamId);
+  payload += ",\"seq\":";
+  payload += std::to_string(seq);
+  if (seq == 0) {
+    payload += ",\"window\":";
+    payload += std::to_string(csvStreamWindow);
   }
+  payload += ",\"last\":";
+  payload += last ? "true" : "false";
+  payload += ",\"data\":\"";
+  payload += escapeJson(data);
+  payload += "\"}}";
+  return payload;
+}
+
+// Packs as many lines as fit in one notification, starting with the line
+// left over by the previous block. startMark is where the block begins.
+static void buildCsvBlock(uint32_t seq, std::string &block, bool &last, LogCursorMark &startMark) {
   const uint16_t mtu = bleMtu ? bleMtu : NimBLEDevice::getMTU();
   const size_t maxPayload = mtu > 3 ? (size_t)(mtu - 3) : 20;
-  std::string block;
-  bool last = false;
-  while (csvStreamFile.available() || csvHasPendingLine) {
+  block.clear();
+  last = false;
+  startMark = csvHasPendingLine ? csvPendingMark : logCursorTell(csvStreamCursor);
+  while (logCursorHasMore(csvStreamCursor) || csvHasPendingLine) {
     std::string line;
+    LogCursorMark lineMark;
     if (csvHasPendingLine) {
       line = csvPendingLine;
+      lineMark = csvPendingMark;
       csvPendingLine.clear();
       csvHasPendingLine = false;
+    } else if (!logCursorNextLine(csvStreamCursor, line)) {
+      last = true;
+      break;
     } else {
-      String raw = csvStreamFile.readStringUntil('\n');
-      raw.trim();
-      if (raw.length() == 0) {
-        if (!csvStreamFile.available()) last = true;
-        if (last && block.empty()) break;
-        if (last) break;
-        continue;
-      }
-      line = std::string(raw.c_str());
+      lineMark = csvStreamCursor.lineMark;
     }
+    if (block.empty()) startMark = lineMark;
 
     std::string candidate = block.empty() ? line : block + "\n" + line;
-    const bool candidateLast = !csvStreamFile.available() && !csvHasPendingLine;
-    std::string payload = "{\"csv_block\":{\"id\":";
-    payload += std::to_string(csvStreamId);
-    payload += ",\"seq\":";
-    payload += std::to_string(csvStreamSeq);
-    payload += ",\"last\":";
-    payload += candidateLast ? "true" : "false";
-    payload += ",\"data\":\"";
-    payload += escapeJson(candidate);
-    payload += "\"}}";
+    const bool candidateLast = !logCursorHasMore(csvStreamCursor) && !csvHasPendingLine;
+    const std::string payload = csvBlockPayload(seq, candidate, candidateLast);
 
     if (payload.size() <= maxPayload) {
       block = candidate;
@@ -1193,59 +2082,269 @@ static void sendNextCsvBlock() {
       last = candidateLast;
     } else {
       csvPendingLine = line;
+      csvPendingMark = lineMark;
       csvHasPendingLine = true;
       last = false;
     }
     break;
   }
+}
 
-  if (block.empty()) {
-    endCsvStream();
-    return;
-  }
-
-  std::string payload = "{\"csv_block\":{\"id\":";
-  payload += std::to_string(csvStreamId);
-  payload += ",\"seq\":";
-  payload += std::to_string(csvStreamSeq);
-  payload += ",\"last\":";
-  payload += last ? "true" : "false";
-  payload += ",\"data\":\"";
-  payload += escapeJson(block);
-  payload += "\"}}";
+static bool notifyCsvBlock(uint32_t seq, const std::string &block, bool last) {
+  const std::string payload = csvBlockPayload(seq, block, last);
   Serial.print("[BLE] TX CSV block=");
-  Serial.print(csvStreamSeq);
+  Serial.print(seq);
   Serial.print(" bytes=");
   Serial.println(payload.size());
-  txChar->setValue(payload);
-  txChar->notify();
-  csvStreamLastActivityMs = millis();
-  csvStreamLastSent = csvStreamSeq;
-  csvStreamSeq++;
-  if (last) {
-    csvStreamAllSent = true;
+  return bleNotify(txChar, payload);
+}
+
+// Fills out with raw CSV bytes, continuing inside the pending line if the
+// previous block cut it. csvPendingMark.skip counts the bytes already sent.
+static void buildExportBlock(uint8_t *out, size_t cap, size_t &len, bool &last, LogCursorMark &startMark) {
+  len = 0;
+  startMark = csvHasPendingLine ? csvPendingMark : logCursorTell(csvStreamCursor);
+  while (len < cap) {
+    if (!csvHasPendingLine) {
+      std::string line;
+      if (!logCursorNextLine(csvStreamCursor, line)) break;
+      csvPendingLine = line + "\n";
+      csvPendingMark = csvStreamCursor.lineMark;
+      csvPendingMark.skip = 0;
+      csvHasPendingLine = true;
+      if (len == 0) startMark = csvPendingMark;
+    }
+    const size_t remaining = csvPendingLine.size() - csvPendingMark.skip;
+    const size_t n = remaining < cap - len ? remaining : cap - len;
+    memcpy(out + len, csvPendingLine.data() + csvPendingMark.skip, n);
+    len += n;
+    csvPendingMark.skip += n;
+    if (csvPendingMark.skip >= csvPendingLine.size()) {
+      csvHasPendingLine = false;
+      csvPendingLine.clear();
+    }
   }
-  if (csvStreamAllSent || (csvStreamLastSent - csvStreamLastAck + 1) >= CSV_ACK_WINDOW) {
-    csvAwaitAck = true;
+  last = !csvHasPendingLine && !logCursorHasMore(csvStreamCursor);
+}
+
+static void csvStreamSeek(const LogCursorMark &mark);
+
+// Stages raw CSV, compresses as much of it as fits in cap, then moves the
+// stream to the first byte the encoder did not take.
+static void buildLzExportBlock(uint8_t *out, size_t cap, size_t &len, bool &last, LogCursorMark &startMark) {
+  static uint8_t stage[EXPORT_LZ_STAGE_BYTES];
+  size_t staged = 0;
+  buildExportBlock(stage, sizeof(stage), staged, last, startMark);
+  size_t consumed = 0;
+  len = csvLz.compress(stage, staged, out, cap, consumed);
+  if (consumed == staged) return;
+  csvStreamSeek(startMark);
+  buildExportBlock(stage, consumed, staged, last, startMark);
+}
+
+static bool notifyExportBlock(uint32_t seq, bool &last, bool &empty, LogCursorMark &startMark) {
+  const uint16_t mtu = bleMtu ? bleMtu : NimBLEDevice::getMTU();
+  size_t maxPayload = mtu > 3 ? (size_t)(mtu - 3) : 20;
+  if (maxPayload > EXPORT_BLOCK_MAX) maxPayload = EXPORT_BLOCK_MAX;
+  uint8_t frame[EXPORT_BLOCK_MAX];
+  size_t len = 0;
+  if (csvStreamLz) {
+    buildLzExportBlock(frame + EXPORT_HEADER_BYTES, maxPayload - EXPORT_HEADER_BYTES, len, last, startMark);
   } else {
-    // Send next block immediately if window allows.
-    sendNextCsvBlock();
+    buildExportBlock(frame + EXPORT_HEADER_BYTES, maxPayload - EXPORT_HEADER_BYTES, len, last, startMark);
+  }
+  empty = len == 0 && !last;
+  if (empty) return false;
+  frame[0] = (uint8_t)csvStreamId;
+  frame[1] = (last ? EXPORT_FLAG_LAST : 0) | (csvStreamLz ? EXPORT_FLAG_LZ : 0);
+  frame[2] = (uint8_t)len;
+  frame[3] = (uint8_t)(len >> 8);
+  for (uint8_t i = 0; i < 4; i++) frame[4 + i] = (uint8_t)(seq >> (8 * i));
+  if (DEBUG_VERBOSE) {
+    Serial.print("[BLE] TX export block=");
+    Serial.print(seq);
+    Serial.print(" bytes=");
+    Serial.println((unsigned int)(len + EXPORT_HEADER_BYTES));
   }
+  return bleNotify(exportChar, frame, len + EXPORT_HEADER_BYTES);
 }
 
-static void endCsvStream() {
-  if (csvStreamFile) {
-    csvStreamFile.close();
+// Builds block seq at the current stream position and notifies it; empty
+// is set when there was nothing left to put in it.
+static bool emitCsvBlock(uint32_t seq, bool &last, bool &empty, LogCursorMark &startMark) {
+  if (csvStreamBinary) return notifyExportBlock(seq, last, empty, startMark);
+  std::string block;
+  buildCsvBlock(seq, block, last, startMark);
+  empty = block.empty() && !last;
+  if (empty) return false;
+  return notifyCsvBlock(seq, block, last);
+}
+
+// Moves the stream to a mark, re-reading a partly streamed line if needed.
+static void csvStreamSeek(const LogCursorMark &mark) {
+  csvHasPendingLine = false;
+  csvPendingLine.clear();
+  logCursorSeek(csvStreamCursor, mark);
+  if (mark.skip == 0) return;
+  std::string line;
+  if (!logCursorNextLine(csvStreamCursor, line)) return;
+  csvPendingLine = line + "\n";
+  csvPendingMark = csvStreamCursor.lineMark;
+  csvPendingMark.skip = mark.skip;
+  csvHasPendingLine = true;
+}
+
+static bool sendNewCsvBlock() {
+  const uint32_t seq = csvStreamSeq;
+  bool last = false;
+  bool empty = false;
+  LogCursorMark startMark;
+  const bool ok = emitCsvBlock(seq, last, empty, startMark);
+  if (empty) {
+    csvStreamAllSent = true;
+    return false;
+  }
+  if (!ok) {
+    // Host stack queue full: rewind so the same block is built next time.
+    csvStreamSeek(startMark);
+    return false;
+  }
+  CsvBlockSlot &slot = csvBlockMap[seq % CSV_WINDOW_MAX];
+  slot.seq = seq;
+  slot.mark = startMark;
+  slot.sentMs = millis();
+  csvStreamSeq++;
+  if (last) csvStreamAllSent = true;
+  return true;
+}
+
+// Rebuilds one in-flight block from its mark, then puts the cursor back.
+static bool resendCsvBlock(uint32_t seq) {
+  CsvBlockSlot &slot = csvBlockMap[seq % CSV_WINDOW_MAX];
+  if (slot.seq != seq || seq < csvStreamAcked || seq >= csvStreamSeq) return false;
+  const LogCursorMark resume = csvHasPendingLine ? csvPendingMark : logCursorTell(csvStreamCursor);
+  csvStreamSeek(slot.mark);
+  bool last = false;
+  bool empty = false;
+  LogCursorMark startMark;
+  const bool ok = emitCsvBlock(seq, last, empty, startMark);
+  csvStreamSeek(resume);
+  slot.sentMs = millis();
+  if (DEBUG_VERBOSE) {
+    Serial.print("[CSV] Resend seq=");
+    Serial.println((unsigned long)seq);
+  }
+  return ok;
+}
+
+// Binary frames only carry the low byte of the stream id.
+static bool csvStreamIdMatches(uint32_t id) {
+  if (csvStreamBinary) return (id & 0xFF) == (csvStreamId & 0xFF);
+  return id == csvStreamId;
+}
+
+static void pumpCsvStream() {
+  if (!csvStreamActive || csvStreamSuspended) return;
+  if (!txChar || (csvStreamBinary && !exportChar)) return;
+  const uint32_t acked = csvStreamAcked;
+  if (csvStreamAllSent && acked >= csvStreamSeq) {
+    if (csvSyncActive) {
+      csvSyncTarget.rows += csvStreamCursor.rows;
+      saveLogSyncPoint(csvSyncClient, csvSyncTarget);
+      Serial.print("[CSV] Sync point saved rows=");
+      Serial.println((unsigned long)csvSyncTarget.rows);
+    }
+    endCsvStream();
+    return;
   }
+  const uint16_t nacks = csvRetransmitMask;
+  csvRetransmitMask = 0;
+  for (uint32_t seq = acked; seq < csvStreamSeq; seq++) {
+    if (nacks & (1U << (seq % CSV_WINDOW_MAX))) resendCsvBlock(seq);
+  }
+  if (acked < csvStreamSeq) {
+    const CsvBlockSlot &oldest = csvBlockMap[acked % CSV_WINDOW_MAX];
+    if (millis() - oldest.sentMs >= CSV_RETRANSMIT_MS) resendCsvBlock(acked);
+  }
+  while (!csvStreamAllSent && csvStreamSeq - acked < csvStreamWindow) {
+    if (!sendNewCsvBlock()) break;
+  }
+  if (csvStreamAllSent && csvStreamSeq == 0) endCsvStream();
+}
+
+// Picks a suspended (or live) stream back up at block offset, the first one
+// the client is missing. Only blocks still in the window can be rebuilt.
+static bool resumeCsvStream(uint32_t id, uint32_t offset, uint32_t window) {
+  if (!csvStreamActive || !csvStreamIdMatches(id)) return false;
+  if (offset < csvStreamAcked || offset > csvStreamSeq) return false;
+  if (offset < csvStreamSeq) {
+    const CsvBlockSlot &slot = csvBlockMap[offset % CSV_WINDOW_MAX];
+    if (slot.seq != offset) return false;
+    csvStreamSeek(slot.mark);
+    for (uint32_t seq = offset; seq < csvStreamSeq; seq++) {
+      csvBlockMap[seq % CSV_WINDOW_MAX].seq = UINT32_MAX;
+    }
+    csvStreamSeq = offset;
+    csvStreamAllSent = false;
+  }
+  csvStreamAcked = offset;
+  csvRetransmitMask = 0;
+  if (window > 0) csvStreamWindow = (uint8_t)(window > CSV_WINDOW_MAX ? CSV_WINDOW_MAX : window);
+  if (csvStreamSuspended) {
+    // Rows logged meanwhile are appended behind the cursor.
+    flushLogs();
+    csvExportInProgress = true;
+    csvExportStartedAt = millis();
+  }
+  csvStreamSuspended = false;
+  csvStreamLastActivityMs = millis();
+  Serial.print("[CSV] Resume id=");
+  Serial.print((unsigned long)csvStreamId);
+  Serial.print(" seq=");
+  Serial.println((unsigned long)offset);
+  return true;
+}
+
+// Sampling and logging go on while the client is away: the stream only
+// keeps cursor marks, which resumeCsvStream() seeks back to.
+static void suspendCsvStream() {
+  csvStreamSuspended = true;
+  csvStreamSuspendedAt = millis();
+  csvRetransmitMask = 0;
+  csvExportInProgress = false;
+  Serial.print("[CSV] Stream suspended id=");
+  Serial.print((unsigned long)csvStreamId);
+  Serial.print(" acked=");
+  Serial.println((unsigned long)csvStreamAcked);
+}
+
+// Runs from loop() with PIPELINE_LOCK_LOGS held.
+static void handleCsvLinkLost() {
+  csvLinkLost = false;
+  if (csvStreamActive) {
+    if (!csvStreamSuspended) suspendCsvStream();
+    return;
+  }
+  csvExportInProgress = false;
+  csvExportStartedAt = 0;
+}
+
+static void endCsvStream() {
+  logCursorClose(csvStreamCursor);
   csvStreamActive = false;
-  csvAwaitAck = false;
   csvExportInProgress = false;
   csvExportStartedAt = 0;
   csvHasPendingLine = false;
   csvPendingLine.clear();
-  csvStreamLastAck = 0;
+  csvStreamAcked = 0;
+  csvRetransmitMask = 0;
   csvStreamAllSent = false;
   csvStreamLastActivityMs = 0;
+  csvStreamLz = false;
+  csvLz.end();
+  csvStreamSuspended = false;
+  csvSyncActive = false;
+  csvSyncClient.clear();
 }
 
 static void dumpCsvToSerial() {
@@ -1258,22 +2357,20 @@ static void dumpCsvToSerial() {
     csvExportInProgress = false;
     return;
   }
-  File file = LittleFS.open(LOG_PATH, "r");
-  if (!file) {
+  flushLogs();
+  LogCursor cursor;
+  if (!logCursorOpen(cursor)) {
     Serial.println("CSV_ERROR");
     serialDumpInProgress = false;
     csvExportInProgress = false;
     return;
   }
   Serial.println("CSV_BEGIN");
-  Serial.print("CSV_SIZE:");
-  Serial.println((unsigned long)file.size());
-  char buf[128];
-  while (file.available()) {
-    size_t n = file.readBytes(buf, sizeof(buf));
-    if (n > 0) Serial.write((uint8_t *)buf, n);
+  std::string line;
+  while (logCursorNextLine(cursor, line)) {
+    Serial.println(line.c_str());
   }
-  file.close();
+  logCursorClose(cursor);
   Serial.println();
   Serial.println("CSV_END");
   serialDumpInProgress = false;
@@ -1289,6 +2386,12 @@ static void handleSerialCommands() {
       if (cmd.length() > 0) {
         if (cmd == "CSV_DUMP") {
           dumpCsvToSerial();
+        } else if (cmd == "I2C_SCAN") {
+          beginI2cBus();
+          const uint32_t hz = i2cClockHz;
+          setI2cClock(I2C_SAFE_HZ);
+          i2cScan();
+          setI2cClock(hz);
         }
       }
       cmd = "";
@@ -1300,13 +2403,14 @@ static void handleSerialCommands() {
   }
 }
 
-static void applyI2cConfig() {
+static bool beginI2cBus() {
   int sda = deviceConfig.i2cSda >= 0 ? deviceConfig.i2cSda : I2C_SDA;
   int scl = deviceConfig.i2cScl >= 0 ? deviceConfig.i2cScl : I2C_SCL;
   if (!i2cBusReady || sda != activeI2cSda || scl != activeI2cScl) {
     Wire.begin(sda, scl);
-    Wire.setClock(100000);
+    Wire.setClock(I2C_SAFE_HZ);
     Wire.setTimeOut(20);
+    i2cClockHz = I2C_SAFE_HZ;
     i2cBusReady = true;
     activeI2cSda = sda;
     activeI2cScl = scl;
@@ -1314,13 +2418,23 @@ static void applyI2cConfig() {
     Serial.print(sda);
     Serial.print(" SCL=");
     Serial.println(scl);
+    return true;
   }
+  return false;
+}
+
+static void applyI2cConfig() {
+  // Drivers found on other pins would pass the ACK check by address alone.
+  if (beginI2cBus()) clearSensors();
   i2cScanPending = true;
-  lastScanMs = millis();
+  loopScheduler.scheduleIn(RESCAN_INTERVAL_MS, rescanJob);
   Serial.println("[I2C] Deferred scan");
 }
 
 static void clearOneWire() {
+  oneWireConverting = false;
+  oneWireReady = false;
+  oneWireRomCount = 0;
   if (ds18b20) {
     delete ds18b20;
     ds18b20 = nullptr;
@@ -1331,12 +2445,50 @@ static void clearOneWire() {
   }
 }
 
+// getTempCByIndex() runs a full search for every read; the ROMs are
+// searched once here and probes are then addressed directly.
+static void enumerateOneWire() {
+  oneWireRomCount = 0;
+  DeviceAddress rom;
+  oneWire->reset_search();
+  while (oneWireRomCount < ONEWIRE_MAX_PROBES && oneWire->search(rom)) {
+    if (OneWire::crc8(rom, 7) != rom[7] || !ds18b20->validFamily(rom)) continue;
+    memcpy(oneWireRoms[oneWireRomCount++], rom, sizeof(DeviceAddress));
+  }
+  Serial.print("[1W] Sondes trouvees: ");
+  Serial.println(oneWireRomCount);
+}
+
 static void initOneWire() {
   clearOneWire();
   if (deviceConfig.onewirePin < 0) return;
   oneWire = new OneWire(deviceConfig.onewirePin);
   ds18b20 = new DallasTemperature(oneWire);
   ds18b20->begin();
+  ds18b20->setWaitForConversion(false);
+  enumerateOneWire();
+  applyOneWireResolution();
+  // A tick waiting on the conversion clearOneWire() dropped gets a new one
+  // rather than a blocking read.
+  if (oneWireSamplePending) {
+    startOneWireConversion();
+    oneWireRestart = true;
+  }
+}
+
+// Probes only rewrite their configuration register (and EEPROM) when the
+// resolution actually changes.
+static void applyOneWireResolution() {
+  if (!ds18b20) return;
+  for (uint8_t i = 0; i < oneWireRomCount; i++) {
+    ds18b20->setResolution(oneWireRoms[i], deviceConfig.onewireBits, true);
+  }
+  // A conversion started at the old resolution may take longer.
+  oneWireReady = false;
+  if (oneWireConverting) {
+    oneWireReadyAtMs = millis() + ds18b20->millisToWaitForConversion(DS18B20_MAX_BITS);
+    oneWireRestart = true;
+  }
 }
 
 static void clearDigitalSensor() {
@@ -1345,6 +2497,16 @@ static void clearDigitalSensor() {
     dht = nullptr;
   }
   digitalSensorType = DIGITAL_SENSOR_NONE;
+  dhtFromCache = false;
+  dhtReadFailures = 0;
+}
+
+static void rememberDht(uint8_t dhtType) {
+  SensorCache entry;
+  entry.kind = SENSOR_CACHE_DHT;
+  entry.pinA = (int8_t)deviceConfig.digitalPin;
+  entry.dhtType = dhtType;
+  storeSensorCache(entry);
 }
 
 static bool tryInitDht(uint8_t dhtType) {
@@ -1361,12 +2523,32 @@ static bool tryInitDht(uint8_t dhtType) {
     Serial.print(deviceConfig.digitalPin);
     Serial.print(" type=");
     Serial.println(dhtType == DHT11 ? "DHT11" : "DHT22");
+    rememberDht(dhtType);
     return true;
   }
   delete candidate;
   return false;
 }
 
+// Skips the probe reads: the first reads may still fail while a DHT22
+// powers up, which readDigitalSensor() tolerates.
+static bool initDhtFromCache() {
+  if (sensorCache.kind != SENSOR_CACHE_DHT || sensorCache.pinA != deviceConfig.digitalPin
+      || deviceConfig.digitalPin < 0) {
+    return false;
+  }
+  clearDigitalSensor();
+  pinMode(deviceConfig.digitalPin, INPUT_PULLUP);
+  dht = new DHT(deviceConfig.digitalPin, sensorCache.dhtType);
+  dht->begin();
+  digitalSensorType = (sensorCache.dhtType == DHT11) ? DIGITAL_SENSOR_DHT11 : DIGITAL_SENSOR_DHT22;
+  dhtFromCache = true;
+  dhtReadFailures = 0;
+  Serial.print("[DIGITAL] DHT restaure depuis le cache type=");
+  Serial.println(sensorCache.dhtType == DHT11 ? "DHT11" : "DHT22");
+  return true;
+}
+
 static void detectDigitalSensor() {
   clearDigitalSensor();
   if (deviceConfig.digitalPin < 0) return;
@@ -1387,8 +2569,17 @@ static bool readDigitalSensor(float &v1, float &v2, bool &paired, const char *&s
       v2 = h;
       paired = true;
       sensorName = (digitalSensorType == DIGITAL_SENSOR_DHT11) ? "dht11" : "dht22";
+      dhtFromCache = false;
+      dhtReadFailures = 0;
       return true;
     }
+    // A DHT pin read as a plain input would log meaningless 0/1 rows.
+    if (dhtFromCache && ++dhtReadFailures >= DHT_CACHE_MAX_FAILURES) {
+      Serial.println("[DIGITAL] DHT du cache muet, nouvelle detection");
+      storeSensorCache(SensorCache());
+      detectDigitalSensor();
+    }
+    return false;
   }
   if (deviceConfig.digitalPin < 0) return false;
   v1 = (float)(digitalRead(deviceConfig.digitalPin) ? 1 : 0);
@@ -1398,6 +2589,209 @@ static bool readDigitalSensor(float &v1, float &v2, bool &paired, const char *&s
   return true;
 }
 
+// Sampling pipeline. acquireAndPublishSample() only reads the sensors and
+// fills two rings; the publish stage turns them into notifications and the
+// storage stage into log rows. With USE_TASK_PIPELINE each stage is a task
+// and a periodic esp_timer wakes acquisition, so a slow flash write or
+// notify never shifts the sampling instants: a full ring drops the new
+// entry, and timer ticks missed while a read is still running coalesce.
+// Without it, loop() runs the three stages back to back.
+static const size_t METRIC_RING_LEN = 32;
+static const size_t LOG_SAMPLE_RING_LEN = 32;
+static SpscQueue<MetricSample, METRIC_RING_LEN> metricRing;
+static SpscQueue<LogSample, LOG_SAMPLE_RING_LEN> logSampleRing;
+static uint32_t metricRingDropped = 0;
+static uint32_t logSampleRingDropped = 0;
+
+static void publishMetric(const char *sensor, const char *addr, const char *key1, float v1, const char *key2, float v2) {
+  MetricSample sample;
+  sample.sensor = sensor ? sensor : "";
+  snprintf(sample.addr, sizeof(sample.addr), "%s", addr ? addr : "");
+  sample.key1 = key1;
+  sample.v1 = v1;
+  sample.key2 = key2;
+  sample.v2 = v2;
+  if (!metricRing.push(std::move(sample), 1)) metricRingDropped++;
+}
+
+static void storeLogRow(
+    const char *sensor,
+    const char *address,
+    float temperature,
+    float humidity,
+    float pressure,
+    float iaq,
+    float iaqAccuracy,
+    float voc,
+    float eqco2,
+    float gasKOhm,
+    float generic) {
+  if (!deviceConfig.storeFlash || csvExportInProgress) return;
+  LogSample row;
+  row.localMs = currentLocalMs();
+  row.sensor = sensor ? sensor : "";
+  snprintf(row.addr, sizeof(row.addr), "%s", address ? address : "");
+  const float values[LOG_FIELD_COUNT] = {
+    temperature, humidity, pressure, iaq, iaqAccuracy, voc, eqco2, gasKOhm, generic
+  };
+  memcpy(row.values, values, sizeof(values));
+  if (!logSampleRing.push(std::move(row), 1)) logSampleRingDropped++;
+}
+
+// Rows leave the last slot to the end-of-tick marker, so a full ring drops
+// rows but never merges two ticks. A marker that does not fit comes right
+// after another one: that tick had no rows left to close.
+static void endSampleTick() {
+  if (!metricRing.push(MetricSample())) metricRingDropped++;
+  if (!logSampleRing.push(LogSample())) logSampleRingDropped++;
+}
+
+static void runPublishStage() {
+  MetricSample sample;
+  while (metricRing.pop(sample)) {
+    if (!sample.sensor) {
+      flushMetricBatch();
+      continue;
+    }
+    queueMetricPayload(sample.sensor, sample.addr, sample.key1, sample.v1, sample.key2, sample.v2);
+  }
+}
+
+static void runStorageStage() {
+  LogSample row;
+  while (logSampleRing.pop(row)) {
+    if (!row.sensor) {
+      finishLogTick();
+      continue;
+    }
+    const float *v = row.values;
+    flashLogRow(row.localMs, row.sensor, row.addr, v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8]);
+  }
+}
+
+#if USE_TASK_PIPELINE
+static TaskHandle_t acquisitionTaskHandle = nullptr;
+static TaskHandle_t publishTaskHandle = nullptr;
+static TaskHandle_t storageTaskHandle = nullptr;
+static esp_timer_handle_t sampleTimer = nullptr;
+static uint32_t sampleTimerStartMs = 0;
+
+static void wakeAcquisition() {
+  if (acquisitionTaskHandle) xTaskNotifyGive(acquisitionTaskHandle);
+}
+
+static void onSampleTimer(void *arg) {
+  (void)arg;
+  wakeAcquisition();
+}
+
+static void acquisitionTask(void *arg) {
+  (void)arg;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (csvExportInProgress || (connectedCount == 0 && !deviceConfig.storeFlash)) continue;
+    const int64_t startUs = esp_timer_get_time();
+    pipelineLock(PIPELINE_LOCK_SENSORS);
+    // MS5611 and DS18B20 ticks come back through ms5611Job() and
+    // oneWireJob() once converted.
+    const bool deferred = startMs5611ForSample() || startOneWireForSample();
+    if (!deferred) acquireAndPublishSample();
+    pipelineUnlock(PIPELINE_LOCK_SENSORS);
+    powerEstimator.addBusy((uint32_t)(esp_timer_get_time() - startUs));
+    if (deferred) continue;
+    xTaskNotifyGive(publishTaskHandle);
+    xTaskNotifyGive(storageTaskHandle);
+  }
+}
+
+static void publishTask(void *arg) {
+  (void)arg;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    const int64_t startUs = esp_timer_get_time();
+    pipelineLock(PIPELINE_LOCK_BLE);
+    runPublishStage();
+    pipelineUnlock(PIPELINE_LOCK_BLE);
+    powerEstimator.addBusy((uint32_t)(esp_timer_get_time() - startUs));
+  }
+}
+
+static void storageTask(void *arg) {
+  (void)arg;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    const int64_t startUs = esp_timer_get_time();
+    pipelineLock(PIPELINE_LOCK_LOGS);
+    runStorageStage();
+    pipelineUnlock(PIPELINE_LOCK_LOGS);
+    powerEstimator.addBusy((uint32_t)(esp_timer_get_time() - startUs));
+  }
+}
+
+static void restartSampleTimer() {
+  if (!sampleTimer) return;
+  esp_timer_stop(sampleTimer);
+  esp_timer_start_periodic(sampleTimer, (uint64_t)sensorIntervalMs * 1000ULL);
+  sampleTimerStartMs = millis();
+}
+
+static void startSamplePipeline() {
+  for (uint8_t i = 0; i < PIPELINE_LOCK_COUNT; i++) {
+    pipelineMutex[i] = xSemaphoreCreateRecursiveMutex();
+  }
+  // Acquisition preempts publishing, which preempts flash writes.
+  xTaskCreate(storageTask, "storage", 6144, nullptr, 2, &storageTaskHandle);
+  xTaskCreate(publishTask, "publish", 4096, nullptr, 3, &publishTaskHandle);
+  xTaskCreate(acquisitionTask, "acquire", 6144, nullptr, 4, &acquisitionTaskHandle);
+  esp_timer_create_args_t args = {};
+  args.callback = onSampleTimer;
+  args.name = "sample";
+  if (esp_timer_create(&args, &sampleTimer) != ESP_OK) {
+    Serial.println("[SENSOR] Timer d'acquisition indisponible");
+    sampleTimer = nullptr;
+    return;
+  }
+  restartSampleTimer();
+}
+
+// Restarts the cadence from now, e.g. after a frequency change.
+static void requestImmediateSample() {
+  restartSampleTimer();
+  if (acquisitionTaskHandle) xTaskNotifyGive(acquisitionTaskHandle);
+}
+#endif
+
+// First sampling instant at or after atMs.
+static uint32_t nextSampleAtMs(uint32_t atMs) {
+#if USE_TASK_PIPELINE
+  if (!sampleTimer) return atMs;
+  const uint32_t gridMs = sampleTimerStartMs;
+#else
+  const uint32_t gridMs = sampleDeadline;
+#endif
+  const int32_t aheadMs = (int32_t)(atMs - gridMs);
+  if (aheadMs <= 0) return gridMs;
+  const uint32_t ticks = ((uint32_t)aheadMs + sensorIntervalMs - 1) / sensorIntervalMs;
+  return gridMs + ticks * sensorIntervalMs;
+}
+
+// Light sleep with nobody connected: housekeeping rides on the sample
+// wakeups instead of waking the chip on its own.
+static bool housekeepingQuiet() {
+  return lightSleepReady && connectedCount == 0;
+}
+static bool housekeepingStretched = false;
+
+static void scheduleHousekeeping(DeadlineScheduler::Job job, uint32_t periodMs) {
+  const uint32_t dueMs = millis() + periodMs;
+  if (housekeepingQuiet()) {
+    housekeepingStretched = true;
+    loopScheduler.scheduleAt(nextSampleAtMs(dueMs), job);
+  } else {
+    loopScheduler.scheduleAt(dueMs, job);
+  }
+}
+
 static void acquireAndPublishSample() {
   const std::string sensor = normalizeSensor(deviceConfig.sensor);
   if (sensor == "i2c") {
@@ -1409,51 +2803,51 @@ static void acquireAndPublishSample() {
       snprintf(addr, sizeof(addr), "0x%02X", bmeAddr);
       if (connectedCount > 0) {
         if (isfinite(bme.tempC) && isfinite(bme.pressHpa)) {
-          sendMetricPayload("bme680", addr, "temperature", bme.tempC, "pressure", bme.pressHpa);
+          publishMetric("bme680", addr, "temperature", bme.tempC, "pressure", bme.pressHpa);
         }
         if (isfinite(bme.humPct)) {
-          sendMetricPayload("bme680", addr, "humidity", bme.humPct, nullptr, 0.0f);
+          publishMetric("bme680", addr, "humidity", bme.humPct, nullptr, 0.0f);
         }
         if (isfinite(bme.iaq)) {
           if (isfinite(bme.iaqAccuracy)) {
-            sendMetricPayload("bme680", addr, "iaq", bme.iaq, "iaq_accuracy", bme.iaqAccuracy);
+            publishMetric("bme680", addr, "iaq", bme.iaq, "iaq_accuracy", bme.iaqAccuracy);
           } else {
-            sendMetricPayload("bme680", addr, "iaq", bme.iaq, nullptr, 0.0f);
+            publishMetric("bme680", addr, "iaq", bme.iaq, nullptr, 0.0f);
           }
         }
         if (isfinite(bme.co2eq)) {
-          sendMetricPayload("bme680", addr, "co2eq", bme.co2eq, nullptr, 0.0f);
+          publishMetric("bme680", addr, "co2eq", bme.co2eq, nullptr, 0.0f);
         }
         if (isfinite(bme.breathVoc)) {
-          sendMetricPayload("bme680", addr, "breath_voc", bme.breathVoc, nullptr, 0.0f);
+          publishMetric("bme680", addr, "breath_voc", bme.breathVoc, nullptr, 0.0f);
         }
       }
-      flashLogRow("bme680", addr, bme.tempC, bme.humPct, bme.pressHpa, bme.iaq, bme.iaqAccuracy,
+      storeLogRow("bme680", addr, bme.tempC, bme.humPct, bme.pressHpa, bme.iaq, bme.iaqAccuracy,
                   bme.breathVoc, bme.co2eq, bme.gasKOhm, NAN);
     }
     if (bmp280 && readBmp280(tempC, pressHpa)) {
       char addr[8];
       snprintf(addr, sizeof(addr), "0x%02X", bmpAddr);
       if (connectedCount > 0) {
-        sendMetricPayload("bmp280", addr, "temperature", tempC, "pressure", pressHpa);
+        publishMetric("bmp280", addr, "temperature", tempC, "pressure", pressHpa);
       }
-      flashLogRow("bmp280", addr, tempC, NAN, pressHpa, NAN, NAN, NAN, NAN, NAN, NAN);
+      storeLogRow("bmp280", addr, tempC, NAN, pressHpa, NAN, NAN, NAN, NAN, NAN, NAN);
     }
     if (ms5611 && readMs5611(tempC, pressHpa)) {
       char addr[8];
       snprintf(addr, sizeof(addr), "0x%02X", msAddr);
       if (connectedCount > 0) {
-        sendMetricPayload("gy63", addr, "temperature", tempC, "pressure", pressHpa);
+        publishMetric("gy63", addr, "temperature", tempC, "pressure", pressHpa);
       }
-      flashLogRow("gy63", addr, tempC, NAN, pressHpa, NAN, NAN, NAN, NAN, NAN, NAN);
+      storeLogRow("gy63", addr, tempC, NAN, pressHpa, NAN, NAN, NAN, NAN, NAN, NAN);
     }
   } else if (sensor == "analog" && deviceConfig.analogPin >= 0) {
     int raw = analogRead(deviceConfig.analogPin);
     float value = (float)raw;
     if (connectedCount > 0) {
-      sendMetricPayload("analog", "", "generic", value, nullptr, 0.0f);
+      publishMetric("analog", "", "generic", value, nullptr, 0.0f);
     }
-    flashLogRow("analog", "", NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, value);
+    storeLogRow("analog", "", NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, value);
   } else if (sensor == "digital" && deviceConfig.digitalPin >= 0) {
     float v1 = NAN;
     float v2 = NAN;
@@ -1462,32 +2856,41 @@ static void acquireAndPublishSample() {
     if (readDigitalSensor(v1, v2, paired, sensorName)) {
       if (connectedCount > 0) {
         if (paired) {
-          sendMetricPayload(sensorName, "", "temperature", v1, "humidity", v2);
+          publishMetric(sensorName, "", "temperature", v1, "humidity", v2);
         } else {
-          sendMetricPayload(sensorName, "", "generic", v1, nullptr, 0.0f);
+          publishMetric(sensorName, "", "generic", v1, nullptr, 0.0f);
         }
       }
       if (paired) {
-        flashLogRow(sensorName, "", v1, v2, NAN, NAN, NAN, NAN, NAN, NAN, NAN);
+        storeLogRow(sensorName, "", v1, v2, NAN, NAN, NAN, NAN, NAN, NAN, NAN);
       } else {
-        flashLogRow(sensorName, "", NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, v1);
+        storeLogRow(sensorName, "", NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, v1);
       }
     }
   } else if (sensor == "onewire" && deviceConfig.onewirePin >= 0) {
-    float value = 0.0f;
-    if (readOneWire(value)) {
+    OneWireProbe probes[ONEWIRE_MAX_PROBES];
+    const uint8_t count = readOneWire(probes);
+    for (uint8_t i = 0; i < count; i++) {
       if (connectedCount > 0) {
-        sendMetricPayload("ds18b20", "", "temperature", value, nullptr, 0.0f);
+        publishMetric("ds18b20", probes[i].addr, "temperature", probes[i].tempC, nullptr, 0.0f);
       }
-      flashLogRow("ds18b20", "", value, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN);
+      storeLogRow("ds18b20", probes[i].addr, probes[i].tempC, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN);
     }
   } else if (sensor == "random") {
     float value = (float)(random(0, 1000)) / 10.0f;
     if (connectedCount > 0) {
-      sendMetricPayload("random", "", "generic", value, nullptr, 0.0f);
+      publishMetric("random", "", "generic", value, nullptr, 0.0f);
     }
-    flashLogRow("random", "", NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, value);
+    storeLogRow("random", "", NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, value);
+  }
+  endSampleTick();
+#if BOOT_PROFILE
+  static bool firstSampleDone = false;
+  if (!firstSampleDone) {
+    firstSampleDone = true;
+    bootPhase("first_sample", 0);
   }
+#endif
 }
 
 static void applySensorMode() {
@@ -1511,19 +2914,91 @@ static void applySensorMode() {
   }
 }
 
-static void updateRecordingLed() {
-  if (!neoPixel) return;
-  if (deviceConfig.storeFlash) {
-    neoPixel->setPixelColor(0, neoPixel->Color(255, 0, 0));
+// Boot-time variant of applySensorMode(): reuses the cached probe result
+// when it still matches the configuration and probes synchronously
+// otherwise, so the first tick already has its drivers.
+static void initSensorsAtBoot() {
+  const uint32_t startUs = micros();
+  const std::string sensor = normalizeSensor(deviceConfig.sensor);
+  if (sensor == "i2c") {
+    clearOneWire();
+    clearDigitalSensor();
+    beginI2cBus();
+    if (!initI2cFromCache()) scanSensors();
+    i2cScanPending = false;
+  } else if (sensor == "digital") {
+    clearSensors();
+    clearOneWire();
+    if (!initDhtFromCache()) detectDigitalSensor();
   } else {
-    neoPixel->setPixelColor(0, 0);
+    applySensorMode();
   }
-  neoPixel->show();
+  sensorInitPending = false;
+  bootPhase("sensors", startUs);
 }
 
-static void applyUserIo() {
-  if (deviceConfig.buttonPin >= 0) {
+static void runSensorInit() {
+  pipelineLock(PIPELINE_LOCK_SENSORS);
+  initSensorsAtBoot();
+  pipelineUnlock(PIPELINE_LOCK_SENSORS);
+#if USE_TASK_PIPELINE
+  requestImmediateSample();
+#else
+  immediateSamplePending = true;
+  wakeLoop();
+#endif
+}
+
+#if USE_TASK_PIPELINE
+static void sensorInitTask(void *arg) {
+  (void)arg;
+  runSensorInit();
+  vTaskDelete(nullptr);
+}
+#endif
+
+// Sensor bring-up overlaps bleInit(): the task shares loopTask's priority,
+// so either one runs while the other waits on the bus or the controller.
+// Acquisition blocks on the sensors lock until the drivers exist.
+static void startSensorInit() {
+#if USE_TASK_PIPELINE
+  if (xTaskCreate(sensorInitTask, "sensor_init", 8192, nullptr, 1, nullptr) == pdPASS) return;
+#endif
+  runSensorInit();
+}
+
+static void updateRecordingLed() {
+  if (!neoPixel) return;
+  if (deviceConfig.storeFlash) {
+    neoPixel->setPixelColor(0, neoPixel->Color(255, 0, 0));
+  } else {
+    neoPixel->setPixelColor(0, 0);
+  }
+  neoPixel->show();
+}
+
+static void applyUserIo() {
+  // Edges only wake loop(); debouncing stays in handleButtonInput().
+  static int buttonIrqPin = -1;
+  if (buttonIrqPin >= 0 && buttonIrqPin != deviceConfig.buttonPin) {
+#if !VARIO_DISABLE_SLEEP
+    buttonWakePin = -1;
+    gpio_wakeup_disable((gpio_num_t)buttonIrqPin);
+#endif
+    detachInterrupt(digitalPinToInterrupt(buttonIrqPin));
+    buttonIrqPin = -1;
+  }
+  if (deviceConfig.buttonPin >= 0) {
     pinMode(deviceConfig.buttonPin, INPUT_PULLUP);
+    if (buttonIrqPin < 0) {
+#if VARIO_DISABLE_SLEEP
+      attachInterrupt(digitalPinToInterrupt(deviceConfig.buttonPin), wakeLoopFromIsr, CHANGE);
+#else
+      attachInterrupt(digitalPinToInterrupt(deviceConfig.buttonPin), onButtonWake, ONLOW);
+      buttonWakePin = deviceConfig.buttonPin;
+#endif
+      buttonIrqPin = deviceConfig.buttonPin;
+    }
     buttonLastRead = digitalRead(deviceConfig.buttonPin);
     buttonStableState = buttonLastRead;
     buttonLastChangeMs = millis();
@@ -1561,8 +3036,10 @@ static void handleButtonInput() {
   }
   if ((now - buttonLastChangeMs) > BUTTON_DEBOUNCE_MS && reading != buttonStableState) {
     buttonStableState = reading;
+    holdDeepSleep();
     if (buttonStableState == LOW) {
       deviceConfig.storeFlash = !deviceConfig.storeFlash;
+      if (!deviceConfig.storeFlash) flushLogs();
       saveConfig();
       updateRecordingLed();
       if (connectedCount > 0) {
@@ -1602,6 +3079,13 @@ static bool applyConfigUpdate(const ConfigUpdate &update) {
     changed = true;
     modeTouched = true;
   }
+  if (update.hasOneWireBits) {
+    if (deviceConfig.onewireBits != update.onewireBits) {
+      deviceConfig.onewireBits = (uint8_t)update.onewireBits;
+      applyOneWireResolution();
+    }
+    changed = true;
+  }
   if (update.hasAnalog) {
     deviceConfig.analogPin = update.analogPin;
     changed = true;
@@ -1631,11 +3115,49 @@ static bool applyConfigUpdate(const ConfigUpdate &update) {
     sensorIntervalMs = nextFreq;
     changed = true;
   }
+  if (update.hasLogFormat) {
+    const std::string nextFormat = normalizeLogFormat(update.logFormat);
+    if (nextFormat != deviceConfig.logFormat) {
+      csvLogger.end();
+      binLogger.end();
+      deviceConfig.logFormat = nextFormat;
+    }
+    changed = true;
+  }
+  if (update.hasLogBudget) {
+    deviceConfig.logBudgetKb = update.logBudgetKb;
+    if (logRingReady) {
+      logRing.setBudget(logBudgetBytes());
+      if (!csvExportInProgress && trimLogRing()) saveLogRing();
+    }
+    changed = true;
+  }
   if (update.hasStoreFlash) {
     deviceConfig.storeFlash = update.storeFlash;
+    if (!deviceConfig.storeFlash) flushLogs();
     changed = true;
     updateRecordingLed();
   }
+  if (update.hasDeepSleep) {
+    deviceConfig.deepSleep = update.deepSleep;
+    changed = true;
+  }
+  if (update.hasMs5611Osr || update.hasMs5611Hz) {
+    if (update.hasMs5611Osr) deviceConfig.ms5611Osr = update.ms5611Osr;
+    if (update.hasMs5611Hz) {
+      deviceConfig.ms5611Hz = update.ms5611Hz > MS5611_MAX_HZ ? MS5611_MAX_HZ : update.ms5611Hz;
+    }
+    applyMs5611Config();
+    changed = true;
+  }
+  if (update.hasVario) {
+    if (deviceConfig.vario != update.vario) {
+      deviceConfig.vario = update.vario;
+      applyMs5611Config();
+      applyBmp280Sampling();
+    }
+    changed = true;
+  }
 
   if (modeTouched) {
     applySensorMode();
@@ -1657,208 +3179,311 @@ static bool applyConfigUpdate(const ConfigUpdate &update) {
   return changed;
 }
 
-static ConfigUpdate parseConfigUpdate(const std::string &value) {
-  ConfigUpdate update;
-  const std::string trimmed = trimCopy(value);
-  if (trimmed.empty()) return update;
+// Config writes are parsed in one pass by JsonScanner: each member is looked
+// up in CONFIG_KEYS and stored in its field. Several keys can feed one field;
+// the lowest rank wins whatever the order in the payload, and members of a
+// "config" object rank below top-level ones.
+enum ConfigField : uint8_t {
+  CF_NAME,
+  CF_SENSOR,
+  CF_FREQUENCY,
+  CF_STORE_FLASH,
+  CF_DEEP_SLEEP,
+  CF_LOG_FORMAT,
+  CF_LOG_BUDGET,
+  CF_MS5611_OSR,
+  CF_MS5611_HZ,
+  CF_VARIO,
+  CF_ACTION,
+  CF_FORMAT,
+  CF_FROM_MS,
+  CF_TO_MS,
+  CF_WINDOW,
+  CF_FRAMING,
+  CF_CLIENT,
+  CF_RESUME_ID,
+  CF_RESUME_OFFSET,
+  CF_EPOCH_MS,
+  CF_TZ_OFFSET,
+  CF_ACK_ID,
+  CF_ACK_SEQ,
+  CF_SDA,
+  CF_SCL,
+  CF_ONEWIRE,
+  CF_ONEWIRE_BITS,
+  CF_ANALOG,
+  CF_DIGITAL,
+  CF_BUTTON,
+  CF_NEOPIXEL,
+  CF_COUNT
+};
 
-  if (!trimmed.empty() && trimmed.front() == '{') {
-    std::string configObj;
-    const bool hasConfigObj = extractJsonObjectField(trimmed, "config", configObj);
+struct ConfigKey {
+  const char *parent;  // nullptr: top level or inside "config"
+  const char *key;
+  uint8_t field;
+  uint8_t rank;
+};
 
-    std::string action;
-    if (extractJsonStringField(trimmed, "action", action)) {
-      update.hasAction = true;
-      update.action = lowerCopy(action);
-      extractJsonStringField(trimmed, "format", update.format);
-    }
+static const uint8_t CONFIG_RANK_NESTED = 16;
+static const uint8_t CONFIG_RANK_UNSET = 0xFF;
+
+static const ConfigKey CONFIG_KEYS[] = {
+  {nullptr, "name", CF_NAME, 0},
+  {nullptr, "sensor", CF_SENSOR, 0},
+  {nullptr, "type", CF_SENSOR, 1},
+  {nullptr, "frequency", CF_FREQUENCY, 0},
+  {nullptr, "freq", CF_FREQUENCY, 1},
+  {nullptr, "interval", CF_FREQUENCY, 2},
+  {nullptr, "period", CF_FREQUENCY, 3},
+  {nullptr, "store_flash", CF_STORE_FLASH, 0},
+  {nullptr, "storeFlash", CF_STORE_FLASH, 1},
+  {nullptr, "save", CF_STORE_FLASH, 2},
+  {nullptr, "flash", CF_STORE_FLASH, 3},
+  {nullptr, "deep_sleep", CF_DEEP_SLEEP, 0},
+  {nullptr, "deepSleep", CF_DEEP_SLEEP, 1},
+  {nullptr, "log_format", CF_LOG_FORMAT, 0},
+  {nullptr, "logFormat", CF_LOG_FORMAT, 1},
+  {nullptr, "log_budget_kb", CF_LOG_BUDGET, 0},
+  {nullptr, "logBudgetKb", CF_LOG_BUDGET, 1},
+  {nullptr, "ms5611_osr", CF_MS5611_OSR, 0},
+  {nullptr, "ms5611Osr", CF_MS5611_OSR, 1},
+  {nullptr, "ms5611_hz", CF_MS5611_HZ, 0},
+  {nullptr, "ms5611Hz", CF_MS5611_HZ, 1},
+  {nullptr, "vario", CF_VARIO, 0},
+  {nullptr, "action", CF_ACTION, 0},
+  {nullptr, "format", CF_FORMAT, 0},
+  {nullptr, "from_ms", CF_FROM_MS, 0},
+  {nullptr, "to_ms", CF_TO_MS, 0},
+  {nullptr, "window", CF_WINDOW, 0},
+  {nullptr, "framing", CF_FRAMING, 0},
+  {nullptr, "client", CF_CLIENT, 0},
+  {nullptr, "resume_id", CF_RESUME_ID, 0},
+  {nullptr, "offset", CF_RESUME_OFFSET, 0},
+  {nullptr, "epoch_ms", CF_EPOCH_MS, 0},
+  {nullptr, "epoch", CF_EPOCH_MS, 1},
+  {nullptr, "time_ms", CF_EPOCH_MS, 2},
+  {nullptr, "timestamp", CF_EPOCH_MS, 3},
+  {nullptr, "tz_offset_min", CF_TZ_OFFSET, 0},
+  {nullptr, "tzOffsetMin", CF_TZ_OFFSET, 1},
+  {nullptr, "tz", CF_TZ_OFFSET, 2},
+  {nullptr, "id", CF_ACK_ID, 0},
+  {nullptr, "export_id", CF_ACK_ID, 1},
+  {nullptr, "exportId", CF_ACK_ID, 2},
+  {nullptr, "seq", CF_ACK_SEQ, 0},
+  {nullptr, "sda", CF_SDA, 1},
+  {nullptr, "scl", CF_SCL, 1},
+  {nullptr, "onewire", CF_ONEWIRE, 1},
+  {nullptr, "one_wire", CF_ONEWIRE, 2},
+  {nullptr, "analog", CF_ANALOG, 1},
+  {nullptr, "digital", CF_DIGITAL, 1},
+  {nullptr, "button", CF_BUTTON, 1},
+  {nullptr, "button_pin", CF_BUTTON, 2},
+  {nullptr, "neopixel", CF_NEOPIXEL, 1},
+  {nullptr, "neopixel_pin", CF_NEOPIXEL, 2},
+  {nullptr, "neo", CF_NEOPIXEL, 3},
+  {"i2c", "sda", CF_SDA, 0},
+  {"i2c", "scl", CF_SCL, 0},
+  {"onewire", "pin", CF_ONEWIRE, 0},
+  {"one_wire", "pin", CF_ONEWIRE, 1},
+  {"onewire", "resolution", CF_ONEWIRE_BITS, 0},
+  {"onewire", "bits", CF_ONEWIRE_BITS, 1},
+  {"one_wire", "resolution", CF_ONEWIRE_BITS, 2},
+  {"analog", "pin", CF_ANALOG, 0},
+  {"digital", "pin", CF_DIGITAL, 0},
+  {"button", "pin", CF_BUTTON, 0},
+  {"neopixel", "pin", CF_NEOPIXEL, 0},
+  {"neo", "pin", CF_NEOPIXEL, 1},
+};
 
-    uint64_t epochMs = 0;
-    if (extractJsonNumberFieldU64(trimmed, "epoch_ms", epochMs)
-        || extractJsonNumberFieldU64(trimmed, "epoch", epochMs)
-        || extractJsonNumberFieldU64(trimmed, "time_ms", epochMs)
-        || extractJsonNumberFieldU64(trimmed, "timestamp", epochMs)) {
-      update.hasEpochMs = true;
-      update.epochMs = epochMs;
-    }
+struct ConfigParseState {
+  ConfigUpdate *update;
+  uint8_t rank[CF_COUNT];
+};
 
-    int tzMin = 0;
-    if (extractJsonNumberField(trimmed, "tz_offset_min", tzMin)
-        || extractJsonNumberField(trimmed, "tzOffsetMin", tzMin)
-        || extractJsonNumberField(trimmed, "tz", tzMin)) {
-      update.hasTzOffset = true;
-      update.tzOffsetMin = tzMin;
-    }
-
-    if (update.hasAction && update.action == "csv_ack") {
-      uint32_t ackId = 0;
-      uint32_t ackSeq = 0;
-      bool got = false;
-      if (extractJsonNumberFieldU32(trimmed, "id", ackId)
-          || extractJsonNumberFieldU32(trimmed, "export_id", ackId)
-          || extractJsonNumberFieldU32(trimmed, "exportId", ackId)) {
-        update.csvAckId = ackId;
-        got = true;
-      }
-      if (extractJsonNumberFieldU32(trimmed, "seq", ackSeq)) {
-        update.csvAckSeq = ackSeq;
-        got = true;
-      }
-      update.hasCsvAck = got;
-    }
+static void assignLower(std::string &out, const JsonSpan &text) {
+  out.assign(text.ptr, text.len);
+  for (char &c : out) c = (char)tolower((unsigned char)c);
+}
 
-    if (extractJsonStringField(trimmed, "name", update.name)
-        || (hasConfigObj && extractJsonStringField(configObj, "name", update.name))) {
+static bool applyConfigField(ConfigUpdate &update, uint8_t field, const JsonToken &value) {
+  // Empty strings count as absent, like a missing key.
+  if (!value.isScalar() || value.text.empty()) return false;
+  switch (field) {
+    case CF_NAME:
+      update.name.assign(value.text.ptr, value.text.len);
       update.hasName = true;
-    }
-
-    std::string sensor;
-    if (extractJsonStringField(trimmed, "sensor", sensor)
-        || extractJsonStringField(trimmed, "type", sensor)
-        || (hasConfigObj && extractJsonStringField(configObj, "sensor", sensor))
-        || (hasConfigObj && extractJsonStringField(configObj, "type", sensor))) {
+      return true;
+    case CF_SENSOR:
+      update.sensor.assign(value.text.ptr, value.text.len);
       update.hasSensor = true;
-      update.sensor = sensor;
-    }
-
-    uint32_t freq = 0;
-    if (extractJsonNumberFieldU32(trimmed, "frequency", freq)
-        || extractJsonNumberFieldU32(trimmed, "freq", freq)
-        || extractJsonNumberFieldU32(trimmed, "interval", freq)
-        || extractJsonNumberFieldU32(trimmed, "period", freq)
-        || (hasConfigObj && extractJsonNumberFieldU32(configObj, "frequency", freq))
-        || (hasConfigObj && extractJsonNumberFieldU32(configObj, "freq", freq))
-        || (hasConfigObj && extractJsonNumberFieldU32(configObj, "interval", freq))
-        || (hasConfigObj && extractJsonNumberFieldU32(configObj, "period", freq))) {
+      return true;
+    case CF_FREQUENCY:
+      if (!value.toU32(update.frequencyMs)) return false;
       update.hasFrequency = true;
-      update.frequencyMs = freq;
-    }
-
-    bool storeFlash = false;
-    if (extractJsonBoolField(trimmed, "store_flash", storeFlash)
-        || extractJsonBoolField(trimmed, "storeFlash", storeFlash)
-        || extractJsonBoolField(trimmed, "save", storeFlash)
-        || extractJsonBoolField(trimmed, "flash", storeFlash)
-        || (hasConfigObj && extractJsonBoolField(configObj, "store_flash", storeFlash))
-        || (hasConfigObj && extractJsonBoolField(configObj, "storeFlash", storeFlash))
-        || (hasConfigObj && extractJsonBoolField(configObj, "save", storeFlash))
-        || (hasConfigObj && extractJsonBoolField(configObj, "flash", storeFlash))) {
+      return true;
+    case CF_STORE_FLASH:
+      if (!value.toBool(update.storeFlash)) return false;
       update.hasStoreFlash = true;
-      update.storeFlash = storeFlash;
-    }
-
-    std::string i2cObj;
-    if (extractJsonObjectField(trimmed, "i2c", i2cObj)) {
-      int sda = -1;
-      int scl = -1;
-      bool has = false;
-      if (extractJsonNumberField(i2cObj, "sda", sda)) {
-        update.i2cSda = sda;
-        has = true;
-      }
-      if (extractJsonNumberField(i2cObj, "scl", scl)) {
-        update.i2cScl = scl;
-        has = true;
-      }
-      if (has) update.hasI2c = true;
-    } else {
-      int sda = -1;
-      int scl = -1;
-      bool has = false;
-      if (extractJsonNumberField(trimmed, "sda", sda)) {
-        update.i2cSda = sda;
-        has = true;
-      }
-      if (extractJsonNumberField(trimmed, "scl", scl)) {
-        update.i2cScl = scl;
-        has = true;
-      }
-      if (has) update.hasI2c = true;
-    }
-
-    std::string oneObj;
-    if (extractJsonObjectField(trimmed, "onewire", oneObj) || extractJsonObjectField(trimmed, "one_wire", oneObj)) {
-      int pin = -1;
-      if (extractJsonNumberField(oneObj, "pin", pin)) {
-        update.hasOneWire = true;
-        update.onewirePin = pin;
-      }
-    } else {
-      int pin = -1;
-      if (extractJsonNumberField(trimmed, "onewire", pin) || extractJsonNumberField(trimmed, "one_wire", pin)) {
-        update.hasOneWire = true;
-        update.onewirePin = pin;
-      }
+      return true;
+    case CF_DEEP_SLEEP:
+      if (!value.toBool(update.deepSleep)) return false;
+      update.hasDeepSleep = true;
+      return true;
+    case CF_LOG_FORMAT:
+      update.logFormat.assign(value.text.ptr, value.text.len);
+      update.hasLogFormat = true;
+      return true;
+    case CF_LOG_BUDGET:
+      if (!value.toU32(update.logBudgetKb)) return false;
+      update.hasLogBudget = true;
+      return true;
+    case CF_MS5611_OSR: {
+      Ms5611Async::Osr osr;
+      if (!value.toU32(update.ms5611Osr) || !Ms5611Async::osrFromSamples(update.ms5611Osr, osr)) return false;
+      update.hasMs5611Osr = true;
+      return true;
     }
-
-    std::string analogObj;
-    if (extractJsonObjectField(trimmed, "analog", analogObj)) {
-      int pin = -1;
-      if (extractJsonNumberField(analogObj, "pin", pin)) {
-        update.hasAnalog = true;
-        update.analogPin = pin;
-      }
-    } else {
-      int pin = -1;
-      if (extractJsonNumberField(trimmed, "analog", pin)) {
-        update.hasAnalog = true;
-        update.analogPin = pin;
-      }
+    case CF_MS5611_HZ:
+      if (!value.toU32(update.ms5611Hz)) return false;
+      update.hasMs5611Hz = true;
+      return true;
+    case CF_VARIO:
+      if (!value.toBool(update.vario)) return false;
+      update.hasVario = true;
+      return true;
+    case CF_ACTION:
+      assignLower(update.action, value.text);
+      update.hasAction = true;
+      return true;
+    case CF_FORMAT:
+      assignLower(update.format, value.text);
+      return true;
+    case CF_FROM_MS:
+      if (!value.toU64(update.fromMs)) return false;
+      update.hasRange = true;
+      return true;
+    case CF_TO_MS:
+      if (!value.toU64(update.toMs)) return false;
+      update.hasRange = true;
+      return true;
+    case CF_WINDOW:
+      return value.toU32(update.window);
+    case CF_FRAMING:
+      assignLower(update.framing, value.text);
+      return true;
+    case CF_CLIENT:
+      update.client.assign(value.text.ptr, value.text.len);
+      return true;
+    case CF_RESUME_ID:
+      if (!value.toU32(update.resumeId)) return false;
+      update.hasResume = true;
+      return true;
+    case CF_RESUME_OFFSET:
+      return value.toU32(update.resumeOffset);
+    case CF_EPOCH_MS:
+      if (!value.toU64(update.epochMs)) return false;
+      update.hasEpochMs = true;
+      return true;
+    case CF_TZ_OFFSET: {
+      int tz = 0;
+      if (!value.toInt(tz)) return false;
+      update.tzOffsetMin = tz;
+      update.hasTzOffset = true;
+      return true;
     }
+    case CF_ACK_ID:
+      if (!value.toU32(update.csvAckId)) return false;
+      update.hasCsvAck = true;
+      return true;
+    case CF_ACK_SEQ:
+      if (!value.toU32(update.csvAckSeq)) return false;
+      update.hasCsvAck = true;
+      return true;
+    case CF_SDA:
+      if (!value.toInt(update.i2cSda)) return false;
+      update.hasI2c = true;
+      return true;
+    case CF_SCL:
+      if (!value.toInt(update.i2cScl)) return false;
+      update.hasI2c = true;
+      return true;
+    case CF_ONEWIRE:
+      if (!value.toInt(update.onewirePin)) return false;
+      update.hasOneWire = true;
+      return true;
+    case CF_ONEWIRE_BITS:
+      if (!value.toU32(update.onewireBits)) return false;
+      if (update.onewireBits < DS18B20_MIN_BITS || update.onewireBits > DS18B20_MAX_BITS) return false;
+      update.hasOneWireBits = true;
+      return true;
+    case CF_ANALOG:
+      if (!value.toInt(update.analogPin)) return false;
+      update.hasAnalog = true;
+      return true;
+    case CF_DIGITAL:
+      if (!value.toInt(update.digitalPin)) return false;
+      update.hasDigital = true;
+      return true;
+    case CF_BUTTON:
+      if (!value.toInt(update.buttonPin)) return false;
+      update.hasButton = true;
+      return true;
+    case CF_NEOPIXEL:
+      if (!value.toInt(update.neopixelPin)) return false;
+      update.hasNeoPixel = true;
+      return true;
+    default:
+      return false;
+  }
+}
 
-    std::string digitalObj;
-    if (extractJsonObjectField(trimmed, "digital", digitalObj)) {
-      int pin = -1;
-      if (extractJsonNumberField(digitalObj, "pin", pin)) {
-        update.hasDigital = true;
-        update.digitalPin = pin;
-      }
-    } else {
-      int pin = -1;
-      if (extractJsonNumberField(trimmed, "digital", pin)) {
-        update.hasDigital = true;
-        update.digitalPin = pin;
+static void onConfigMember(void *ctx, const JsonSpan &parent, const JsonSpan &key, const JsonToken &value) {
+  ConfigParseState &state = *static_cast<ConfigParseState *>(ctx);
+  const bool nested = parent.equals("config");
+  if (!parent.empty() && !nested) {
+    for (const ConfigKey &entry : CONFIG_KEYS) {
+      if (entry.parent && parent.equals(entry.parent) && key.equals(entry.key)) {
+        if (entry.rank < state.rank[entry.field]
+            && applyConfigField(*state.update, entry.field, value)) {
+          state.rank[entry.field] = entry.rank;
+        }
+        return;
       }
     }
-
-    std::string buttonObj;
-    if (extractJsonObjectField(trimmed, "button", buttonObj)) {
-      int pin = -1;
-      if (extractJsonNumberField(buttonObj, "pin", pin)) {
-        update.hasButton = true;
-        update.buttonPin = pin;
-      }
-    } else {
-      int pin = -1;
-      if (extractJsonNumberField(trimmed, "button", pin)
-          || extractJsonNumberField(trimmed, "button_pin", pin)) {
-        update.hasButton = true;
-        update.buttonPin = pin;
-      }
+    return;
+  }
+  for (const ConfigKey &entry : CONFIG_KEYS) {
+    if (entry.parent || !key.equals(entry.key)) continue;
+    const uint8_t rank = nested ? (uint8_t)(entry.rank + CONFIG_RANK_NESTED) : entry.rank;
+    if (rank < state.rank[entry.field] && applyConfigField(*state.update, entry.field, value)) {
+      state.rank[entry.field] = rank;
     }
+    return;
+  }
+}
 
-    std::string neoObj;
-    if (extractJsonObjectField(trimmed, "neopixel", neoObj) || extractJsonObjectField(trimmed, "neo", neoObj)) {
-      int pin = -1;
-      if (extractJsonNumberField(neoObj, "pin", pin)) {
-        update.hasNeoPixel = true;
-        update.neopixelPin = pin;
-      }
-    } else {
-      int pin = -1;
-      if (extractJsonNumberField(trimmed, "neopixel", pin)
-          || extractJsonNumberField(trimmed, "neopixel_pin", pin)
-          || extractJsonNumberField(trimmed, "neo", pin)) {
-        update.hasNeoPixel = true;
-        update.neopixelPin = pin;
-      }
+static ConfigUpdate parseConfigUpdate(const std::string &value) {
+  ConfigUpdate update;
+  size_t start = 0;
+  size_t end = value.size();
+  while (start < end && isspace((unsigned char)value[start])) start++;
+  while (end > start && isspace((unsigned char)value[end - 1])) end--;
+  if (start == end) return update;
+
+  if (value[start] == '{') {
+    ConfigParseState state;
+    state.update = &update;
+    memset(state.rank, CONFIG_RANK_UNSET, sizeof(state.rank));
+    JsonScanner scanner(value.data() + start, end - start);
+    if (!scanner.scan(onConfigMember, &state)) {
+      Serial.println("[BLE] Config JSON invalide (champs lus avant l'erreur conserves)");
     }
-
     return update;
   }
 
   std::string name;
-  if (extractNameFromConfig(trimmed, name)) {
+  if (extractNameFromConfig(value, name)) {
     update.hasName = true;
     update.name = name;
   }
@@ -1904,7 +3529,9 @@ static bool i2cReadByte(uint8_t addr, uint8_t reg, uint8_t &value) {
   return true;
 }
 
-static void i2cScan() {
+// Diagnostic only (I2C_SCAN on serial, i2c_scan over BLE): 117 probes.
+// Returns the addresses found, e.g. "0X76, 0X77".
+static std::string i2cScan() {
   Serial.println("[I2C] Scan...");
   int found = 0;
   String foundList;
@@ -1930,6 +3557,92 @@ static void i2cScan() {
     Serial.print("): ");
     Serial.println(foundList);
   }
+  return std::string(foundList.c_str());
+}
+
+// What tuneI2cClock() reads back: the chip ID register, or the first PROM
+// word on the MS5611, which has no ID and wants a stop before reading.
+struct I2cIdCheck {
+  uint8_t addr;
+  uint8_t cmd;
+  bool stop;
+  uint8_t len;
+  uint8_t id[2];
+};
+
+static bool i2cReadId(const I2cIdCheck &check, uint8_t *out) {
+  Wire.beginTransmission(check.addr);
+  Wire.write(check.cmd);
+  if (Wire.endTransmission(check.stop) != 0) return false;
+  if (Wire.requestFrom((int)check.addr, (int)check.len) != check.len) return false;
+  for (uint8_t i = 0; i < check.len; i++) {
+    if (!Wire.available()) return false;
+    out[i] = Wire.read();
+  }
+  return true;
+}
+
+static bool i2cIdsMatch(const I2cIdCheck *checks, uint8_t count) {
+  for (uint8_t round = 0; round < I2C_ID_ROUNDS; round++) {
+    for (uint8_t i = 0; i < count; i++) {
+      uint8_t id[2] = {0, 0};
+      if (!i2cReadId(checks[i], id) || memcmp(id, checks[i].id, checks[i].len) != 0) return false;
+    }
+  }
+  return true;
+}
+
+static void setI2cClock(uint32_t hz) {
+  if (hz == i2cClockHz) return;
+  Wire.setClock(hz);
+  i2cClockHz = hz;
+}
+
+// Runs after the drivers were created at I2C_SAFE_HZ. A NACK, timeout or
+// ID mismatch at a rate steps down to the next one. preferStored starts
+// from the rate negotiated last time for this topology, so a warm boot
+// costs one confirmation instead of a failed attempt.
+static void tuneI2cClock(bool preferStored) {
+  setI2cClock(I2C_SAFE_HZ);
+  I2cIdCheck checks[3];
+  uint8_t count = 0;
+  if (ms5611) checks[count++] = {msAddr, MS5611_CMD_PROM_C1, true, 2, {0, 0}};
+  if (bme680) checks[count++] = {bmeAddr, REG_CHIP_ID, false, 1, {0, 0}};
+  if (bmp280) checks[count++] = {bmpAddr, REG_CHIP_ID, false, 1, {0, 0}};
+  for (uint8_t i = 0; i < count; i++) {
+    if (!i2cReadId(checks[i], checks[i].id)) return;
+  }
+  if (count == 0) return;
+
+  uint32_t hz = ms5611 ? I2C_FAST_HZ : I2C_MAX_HZ;
+  if (preferStored && i2cStoredHz >= I2C_SAFE_HZ && i2cStoredHz < hz) hz = i2cStoredHz;
+  while (hz > I2C_SAFE_HZ) {
+    setI2cClock(hz);
+    if (i2cIdsMatch(checks, count)) break;
+    Serial.print("[I2C] Echec a ");
+    Serial.print((unsigned long)hz / 1000);
+    Serial.println(" kHz");
+    hz = hz > I2C_FAST_HZ ? I2C_FAST_HZ : I2C_SAFE_HZ;
+  }
+  setI2cClock(hz > I2C_SAFE_HZ ? hz : I2C_SAFE_HZ);
+  Serial.print("[I2C] Horloge bus ");
+  Serial.print((unsigned long)i2cClockHz / 1000);
+  Serial.println(" kHz");
+  if (i2cClockHz != i2cStoredHz) {
+    i2cStoredHz = i2cClockHz;
+    ensurePrefs();
+    if (prefsReady) prefs.putUInt("i2c_hz", i2cStoredHz);
+  }
+}
+
+// One ACK per active driver tells a known-good topology from unplugged
+// wiring, without re-creating the drivers (BSEC keeps its state).
+static bool i2cSensorsAnswer() {
+  if (!bmp280 && !bme680 && !ms5611) return false;
+  if (ms5611 && !i2cPresent(msAddr)) return false;
+  if (bme680 && !i2cPresent(bmeAddr)) return false;
+  if (bmp280 && !i2cPresent(bmpAddr)) return false;
+  return true;
 }
 
 static void clearSensors() {
@@ -1951,17 +3664,69 @@ static void clearSensors() {
   lastBsecTimestampNs = 0;
   bme680Latest = Bme680Reading();
   bme680LatestValid = false;
+  ms5611Fresh = false;
+  ms5611SampleReady = false;
+  vario.reset();
+}
+
+// Vario mode needs a pressure stream even when ms5611_hz is left at 0.
+static uint32_t ms5611RateHz() {
+  if (deviceConfig.ms5611Hz > 0) return deviceConfig.ms5611Hz;
+  return deviceConfig.vario ? VARIO_MS5611_HZ : 0;
+}
+
+// Datasheet resolution of one MS5611 sample, as altitude.
+static uint16_t ms5611SigmaCm(Ms5611Async::Osr osr) {
+  switch (osr) {
+    case Ms5611Async::OSR_256: return 55;
+    case Ms5611Async::OSR_512: return 35;
+    case Ms5611Async::OSR_1024: return 23;
+    case Ms5611Async::OSR_2048: return 15;
+    default: return 10;
+  }
+}
+
+// Restarts the filter for the current pressure source; the MS5611 wins
+// when both chips are on the bus.
+static void configureVario() {
+  vario.reset();
+  if (ms5611) {
+    vario.setNoise(ms5611SigmaCm(ms5611->oversampling()), VARIO_ACCEL_CMS2);
+  } else if (bmp280) {
+    vario.setNoise(VARIO_BMP280_SIGMA_CM, VARIO_ACCEL_CMS2);
+  }
+  if (deviceConfig.vario) {
+    varioRestart = true;
+    wakeLoop();
+  }
+}
+
+// Continuous mode reads temperature about five times per second and
+// spends the other cycles on pressure.
+static void applyMs5611Config() {
+  if (!ms5611) return;
+  Ms5611Async::Osr osr = Ms5611Async::OSR_4096;
+  Ms5611Async::osrFromSamples(deviceConfig.ms5611Osr, osr);
+  ms5611->setOversampling(osr);
+  const uint32_t hz = ms5611RateHz();
+  ms5611->setTemperatureEvery(hz >= 10 ? (uint8_t)(hz / 5) : 1);
+  ms5611NextStartUs = micros();
+  ms5611Restart = true;
+  configureVario();
+  wakeLoop();
 }
 
 static bool tryMs5611(uint8_t addr) {
   if (!i2cPresent(addr) || ms5611) return false;
   delay(1);
-  ms5611 = new MS5611(addr);
-  if (ms5611->begin()) {
+  ms5611 = new Ms5611Async(Wire);
+  if (ms5611->begin(addr)) {
     msAddr = addr;
     Serial.print("[I2C] MS5611 (GY63) detecte a 0x");
     if (addr < 16) Serial.print("0");
     Serial.println(addr, HEX);
+    if (!ms5611->promCrcOk()) Serial.println("[I2C] MS5611 CRC PROM invalide (clone ?)");
+    applyMs5611Config();
     return true;
   }
   delete ms5611;
@@ -1978,6 +3743,27 @@ static bool tryBmp280(uint8_t addr) {
     Serial.print("[I2C] BMP280 detecte a 0x");
     if (addr < 16) Serial.print("0");
     Serial.println(addr, HEX);
+    applyBmp280Sampling();
+    return true;
+  }
+  delete bmp280;
+  bmp280 = nullptr;
+  return false;
+}
+
+// Vario mode trades the heavy IIR filter and the 500 ms standby for about
+// 40 conversions per second; the Kalman filter does the smoothing.
+static void applyBmp280Sampling() {
+  if (!bmp280) return;
+  if (deviceConfig.vario) {
+    bmp280->setSampling(
+      Adafruit_BMP280::MODE_NORMAL,
+      Adafruit_BMP280::SAMPLING_X1,
+      Adafruit_BMP280::SAMPLING_X8,
+      Adafruit_BMP280::FILTER_X4,
+      Adafruit_BMP280::STANDBY_MS_1
+    );
+  } else {
     bmp280->setSampling(
       Adafruit_BMP280::MODE_NORMAL,
       Adafruit_BMP280::SAMPLING_X2,
@@ -1985,11 +3771,8 @@ static bool tryBmp280(uint8_t addr) {
       Adafruit_BMP280::FILTER_X16,
       Adafruit_BMP280::STANDBY_MS_500
     );
-    return true;
   }
-  delete bmp280;
-  bmp280 = nullptr;
-  return false;
+  configureVario();
 }
 
 static bool tryBme680(uint8_t addr) {
@@ -2055,10 +3838,12 @@ static bool tryBme680(uint8_t addr) {
   return false;
 }
 
+// Targeted probe: every supported chip answers on 0x76 or 0x77, so only
+// those two addresses are tried instead of scanning the whole bus.
 static void scanSensors() {
   Serial.println("[I2C] scanSensors start");
   clearSensors();
-  i2cScan();
+  setI2cClock(I2C_SAFE_HZ);
 
   // Try MS5611 first on both possible addresses (0x77, sometimes 0x76)
   tryMs5611(I2C_ADDR_MS5611_A);
@@ -2077,12 +3862,45 @@ static void scanSensors() {
   delay(1);
   tryBmp280(I2C_ADDR_BMP280_B);
 
+  SensorCache entry;
   if (!bmp280 && !bme680 && !ms5611) {
     Serial.println("[I2C] Aucun capteur reconnu");
+  } else {
+    entry.kind = SENSOR_CACHE_I2C;
+    entry.pinA = (int8_t)activeI2cSda;
+    entry.pinB = (int8_t)activeI2cScl;
+    entry.msAddr = msAddr;
+    entry.bmeAddr = bmeAddr;
+    entry.bmpAddr = bmpAddr;
   }
+  storeSensorCache(entry);
+  tuneI2cClock(false);
   Serial.println("[I2C] scanSensors done");
 }
 
+// Probes only the cached addresses. A cached sensor that no longer answers
+// means the wiring changed: the caller falls back to a full scan.
+static bool initI2cFromCache() {
+  if (sensorCache.kind != SENSOR_CACHE_I2C || sensorCache.pinA != activeI2cSda
+      || sensorCache.pinB != activeI2cScl) {
+    return false;
+  }
+  clearSensors();
+  setI2cClock(I2C_SAFE_HZ);
+  bool ok = true;
+  if (sensorCache.msAddr) ok = tryMs5611(sensorCache.msAddr) && ok;
+  if (sensorCache.bmeAddr) ok = tryBme680(sensorCache.bmeAddr) && ok;
+  if (sensorCache.bmpAddr) ok = tryBmp280(sensorCache.bmpAddr) && ok;
+  if (!ok || (!bmp280 && !bme680 && !ms5611)) {
+    Serial.println("[I2C] Cache capteurs obsolete, scan complet");
+    clearSensors();
+    return false;
+  }
+  Serial.println("[I2C] Capteurs restaures depuis le cache");
+  tuneI2cClock(true);
+  return true;
+}
+
 static bool readBmp280(float &tempC, float &pressHpa) {
   if (!bmp280) return false;
   tempC = bmp280->readTemperature();
@@ -2090,11 +3908,27 @@ static bool readBmp280(float &tempC, float &pressHpa) {
   return isfinite(tempC) && isfinite(pressHpa);
 }
 
+// Waits out a whole cycle in delay(). Only the deep-sleep wake, which has
+// no loop() to run ms5611Job(), takes this path.
+static bool runMs5611Cycle() {
+  if (!ms5611->busy() && !ms5611->start(micros())) return false;
+  for (;;) {
+    const int32_t waitUs = (int32_t)(ms5611->dueUs() - micros());
+    if (waitUs > 0) delay(((uint32_t)waitUs + 999) / 1000);
+    if (ms5611->poll(micros())) return true;
+    if (!ms5611->busy()) return false;
+  }
+}
+
+// Continuous mode hands out the latest cycle. Otherwise a cycle finished by
+// ms5611Job() is used once; without a loop one is run now.
 static bool readMs5611(float &tempC, float &pressHpa) {
   if (!ms5611) return false;
-  ms5611->read();
-  tempC = ms5611->getTemperature();
-  pressHpa = ms5611->getPressure();
+  const bool ready = ms5611Fresh || (ms5611RateHz() > 0 && ms5611->valid());
+  if (!ready && (loopTaskHandle || !runMs5611Cycle())) return false;
+  ms5611Fresh = false;
+  tempC = ms5611->temperatureC();
+  pressHpa = ms5611->pressureHpa();
   return isfinite(tempC) && isfinite(pressHpa);
 }
 
@@ -2149,15 +3983,61 @@ static bool readBme680(Bme680Reading &reading) {
   return isfinite(reading.tempC) || isfinite(reading.humPct) || isfinite(reading.pressHpa) || isfinite(reading.iaq);
 }
 
-static bool readOneWire(float &tempC) {
-  if (!ds18b20) return false;
+// DS18S20 probes have no resolution setting and always take 750 ms.
+static uint8_t oneWireConversionBits() {
+  for (uint8_t i = 0; i < oneWireRomCount; i++) {
+    if (oneWireRoms[i][0] == DS18S20MODEL) return DS18B20_MAX_BITS;
+  }
+  return deviceConfig.onewireBits;
+}
+
+static void startOneWireConversion() {
+  // A bus that was empty at init is searched again, so probes plugged in
+  // later are picked up.
+  if (oneWireRomCount == 0) {
+    enumerateOneWire();
+    applyOneWireResolution();
+  }
   ds18b20->requestTemperatures();
-  float value = ds18b20->getTempCByIndex(0);
-  if (value == DEVICE_DISCONNECTED_C || !isfinite(value)) return false;
-  tempC = value;
+  oneWireConverting = true;
+  oneWireReady = false;
+  oneWireReadyAtMs = millis() + ds18b20->millisToWaitForConversion(oneWireConversionBits());
+}
+
+// Starts the conversion a tick needs and hands the tick to oneWireJob().
+// False when a finished conversion is waiting: the tick reads it now.
+static bool startOneWireForSample() {
+  if (!ds18b20 || oneWireReady || normalizeSensor(deviceConfig.sensor) != "onewire") return false;
+  if (!oneWireConverting) startOneWireConversion();
+  oneWireSamplePending = true;
+  oneWireRestart = true;
+  wakeLoop();
   return true;
 }
 
+// Ticks normally arrive with a finished conversion (startOneWireForSample);
+// the deep-sleep wake has no loop and waits it out in delay(). Probes whose
+// scratchpad fails its CRC are left out. Returns the number filled.
+static uint8_t readOneWire(OneWireProbe *probes) {
+  if (!ds18b20) return 0;
+  if (!oneWireReady) {
+    if (!oneWireConverting) startOneWireConversion();
+    const int32_t waitMs = (int32_t)(oneWireReadyAtMs - millis());
+    if (waitMs > 0) delay((uint32_t)waitMs);
+  }
+  oneWireConverting = false;
+  oneWireReady = false;
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < oneWireRomCount; i++) {
+    const float value = ds18b20->getTempC(oneWireRoms[i]);
+    if (value == DEVICE_DISCONNECTED_C || !isfinite(value)) continue;
+    formatHexAddress(oneWireRoms[i], sizeof(DeviceAddress), probes[count].addr, sizeof(probes[count].addr));
+    probes[count].tempC = value;
+    count++;
+  }
+  return count;
+}
+
 static const char *compactMetricKey(const char *key) {
   if (!key || !key[0]) return "";
   if (strcmp(key, "generic") == 0) return "g";
@@ -2172,39 +4052,12 @@ static const char *compactMetricKey(const char *key) {
   return key;
 }
 
+#if !USE_COMPACT_METRICS
+// Verbose schema, one notification per call; compact metrics are batched
+// by queueMetricPayload() instead.
 static void sendMetricPayload(const char *sensor, const char *addr, const char *key1, float v1, const char *key2, float v2) {
   if (!txChar) return;
   char payload[220];
-#if USE_COMPACT_METRICS
-  const char *k1 = compactMetricKey(key1);
-  const char *k2 = compactMetricKey(key2);
-  char tsBuf[24] = {0};
-  const bool haveTs = timeSynced;
-  if (haveTs) {
-    formatTimestamp(currentLocalMs(), tsBuf, sizeof(tsBuf));
-  }
-  if (key2) {
-    if (haveTs) {
-      snprintf(payload, sizeof(payload),
-               "{\"s\":\"%s\",\"m\":{\"%s\":%.3f,\"%s\":%.3f},\"ts\":\"%s\"}",
-               sensor ? sensor : "", k1, v1, k2, v2, tsBuf);
-    } else {
-      snprintf(payload, sizeof(payload),
-               "{\"s\":\"%s\",\"m\":{\"%s\":%.3f,\"%s\":%.3f}}",
-               sensor ? sensor : "", k1, v1, k2, v2);
-    }
-  } else {
-    if (haveTs) {
-      snprintf(payload, sizeof(payload),
-               "{\"s\":\"%s\",\"m\":{\"%s\":%.3f},\"ts\":\"%s\"}",
-               sensor ? sensor : "", k1, v1, tsBuf);
-    } else {
-      snprintf(payload, sizeof(payload),
-               "{\"s\":\"%s\",\"m\":{\"%s\":%.3f}}",
-               sensor ? sensor : "", k1, v1);
-    }
-  }
-#else
   if (key2) {
     snprintf(payload, sizeof(payload),
              "{\"sensor\":\"%s\",\"addr\":\"%s\",\"name\":\"%s\",\"metrics\":{\"%s\":%.2f,\"%s\":%.2f}}",
@@ -2214,121 +4067,464 @@ static void sendMetricPayload(const char *sensor, const char *addr, const char *
              "{\"sensor\":\"%s\",\"addr\":\"%s\",\"name\":\"%s\",\"metrics\":{\"%s\":%.2f}}",
              sensor, addr ? addr : "", bleName, key1, v1);
   }
-#endif
   Serial.print("[BLE] TX: ");
   Serial.println(payload);
-  txChar->setValue(payload);
-  txChar->notify();
+  bleNotify(txChar, payload);
 }
+#endif
 
-class RxCallbacks : public NimBLECharacteristicCallbacks {
-  void onWrite(NimBLECharacteristic *pCharacteristic, NimBLEConnInfo &connInfo) override {
-    (void)connInfo;
-    std::string value = pCharacteristic->getValue();
-    if (value.empty()) return;
-    Serial.print("[BLE] RX: ");
-    Serial.println(value.c_str());
-    ConfigUpdate update = parseConfigUpdate(value);
+static size_t metricBatchLimit() {
+  const uint16_t mtu = bleMtu ? bleMtu : NimBLEDevice::getMTU();
+  return mtu > 3 ? (size_t)(mtu - 3) : 20;
+}
 
-    if (update.hasAction) {
-      if (update.action == "time_sync") {
-        if (update.hasTzOffset) {
-          applyTzOffset(update.tzOffsetMin);
-        }
-        if (update.hasEpochMs) {
-          applyTimeSync(update.epochMs);
-          sendFlashAck("time_sync", "ok", "Heure synchronisee");
-        } else {
-          sendFlashAck("time_sync", "error", "Timestamp manquant");
-        }
-        return;
-      }
-      if (update.action == "config_get") {
-        sendConfigPayload();
-        return;
-      }
-      if (update.action == "flash_clear") {
-        flashClear();
-        sendFlashAck("flash_clear", "ok", "Flash videe");
-        sendFlashStatus();
-        return;
-      }
-      if (update.action == "flash_export") {
-        if (csvExportInProgress) {
-          sendFlashAck("flash_export", "error", "Export en cours");
-          return;
-        }
-        sendFlashAck("flash_export", "ok", "Export CSV");
-        sendFlashStatus();
-        sendCsvFromFlash();
-        return;
-      }
-      if (update.action == "flash_stream") {
-        if (csvExportInProgress) {
-          sendFlashAck("flash_stream", "error", "Export en cours");
-          return;
-        }
-        sendFlashAck("flash_stream", "ok", "Stream CSV");
-        sendFlashStatus();
-        sendCsvFromFlash();
-        return;
-      }
-      if (update.action == "flash_stream_stop") {
-        endCsvStream();
-        sendFlashAck("flash_stream_stop", "ok", "Stream stop");
-        return;
-      }
-      if (update.action == "csv_ack") {
-        if (update.hasCsvAck && csvStreamActive && csvAwaitAck
-            && update.csvAckId == csvStreamId
-            && update.csvAckSeq == csvStreamLastSent) {
-          if (update.csvAckSeq >= csvStreamLastAck) {
-            csvStreamLastAck = update.csvAckSeq;
-          }
-          csvStreamLastActivityMs = millis();
-          if (csvStreamAllSent && csvStreamLastAck >= csvStreamLastSent) {
-            endCsvStream();
-          } else {
-            csvAwaitAck = false;
-            sendNextCsvBlock();
-          }
-        }
-        return;
-      }
-      if (update.action == "flash_status") {
-        sendFlashStatus();
-        sendConfigPayload();
+// Binary live metrics, negotiated with {"action":"metric_format","format":"binary"}.
+// Frame (little endian):
+//   u8 version (0x81, never a JSON start byte)
+//   u32 local seconds since 2024-01-01 00:00:00, 0 when the clock is not synced
+//   items: u8 sensor id, u8 value count, then per value u8 key id and a
+//          scaled int16/int32 (width and scale fixed by the key id)
+// Keys map through compactMetricKey(); a sensor or key without an id falls
+// back to JSON. Non-finite values are sent as the type's minimum.
+static const uint8_t METRIC_FRAME_VERSION = 0x81;
+static const size_t METRIC_FRAME_HEADER_BYTES = 5;
+static const uint32_t METRIC_EPOCH_BASE_S = 1704067200UL;
+
+struct BinaryMetricKey {
+  const char *key;
+  uint8_t id;
+  uint16_t scale;
+  bool wide;
+};
+
+static const BinaryMetricKey BINARY_METRIC_KEYS[] = {
+  {"t", 1, 100, false},
+  {"p", 2, 100, true},
+  {"h", 3, 100, false},
+  {"g", 4, 1000, true},
+  {"iaq", 5, 10, false},
+  {"ia", 6, 1, false},
+  {"co2eq", 7, 10, true},
+  {"breath_voc", 8, 1000, true},
+};
+
+static const char *const BINARY_METRIC_SENSORS[] = {
+  "bme680", "bmp280", "gy63", "analog", "dht11", "dht22", "digital", "ds18b20", "random",
+};
+
+static bool metricBinary = false;
+static std::string metricBinFrame;
+static size_t metricBinItemPos = 0;
+static uint8_t metricBinSensor = 0;
+
+static const BinaryMetricKey *binaryMetricKey(const char *key) {
+  const char *compact = compactMetricKey(key);
+  for (const BinaryMetricKey &entry : BINARY_METRIC_KEYS) {
+    if (strcmp(entry.key, compact) == 0) return &entry;
+  }
+  return nullptr;
+}
+
+static uint8_t binaryMetricSensor(const char *sensor) {
+  if (!sensor) return 0;
+  for (size_t i = 0; i < sizeof(BINARY_METRIC_SENSORS) / sizeof(BINARY_METRIC_SENSORS[0]); i++) {
+    if (strcmp(BINARY_METRIC_SENSORS[i], sensor) == 0) return (uint8_t)(i + 1);
+  }
+  return 0;
+}
+
+static void sendBinaryMetricFrame() {
+  if (metricBinFrame.size() > METRIC_FRAME_HEADER_BYTES && txChar) {
+    bleNotify(txChar, (const uint8_t *)metricBinFrame.data(), metricBinFrame.size());
+  }
+  metricBinFrame.clear();
+  metricBinSensor = 0;
+}
+
+static void appendBinaryMetricValue(const BinaryMetricKey &entry, float value) {
+  const int32_t lo = entry.wide ? INT32_MIN : INT16_MIN;
+  const int32_t hi = entry.wide ? INT32_MAX : INT16_MAX;
+  int32_t scaled = lo;
+  if (isfinite(value)) {
+    const double v = (double)value * entry.scale;
+    scaled = v <= (double)(lo + 1) ? lo + 1 : (v >= (double)hi ? hi : (int32_t)lround(v));
+  }
+  metricBinFrame.push_back((char)entry.id);
+  const uint32_t raw = (uint32_t)scaled;
+  const size_t width = entry.wide ? 4 : 2;
+  for (size_t i = 0; i < width; i++) metricBinFrame.push_back((char)((raw >> (8 * i)) & 0xFF));
+  metricBinFrame[metricBinItemPos]++;
+}
+
+static bool queueBinaryMetrics(const char *sensor, const char *key1, float v1, const char *key2, float v2) {
+  const uint8_t sensorId = binaryMetricSensor(sensor);
+  const BinaryMetricKey *k1 = binaryMetricKey(key1);
+  const BinaryMetricKey *k2 = key2 ? binaryMetricKey(key2) : nullptr;
+  if (sensorId == 0 || !k1 || (key2 && !k2)) return false;
+
+  const bool sameItem = !metricBinFrame.empty() && metricBinSensor == sensorId
+                        && (uint8_t)metricBinFrame[metricBinItemPos] < 254;
+  size_t needed = (sameItem ? 0 : 2) + (k1->wide ? 5 : 3);
+  if (k2) needed += k2->wide ? 5 : 3;
+  if (!metricBinFrame.empty() && metricBinFrame.size() + needed > metricBatchLimit()) {
+    sendBinaryMetricFrame();
+  }
+  if (metricBinFrame.empty()) {
+    uint32_t stamp = 0;
+    if (timeSynced) {
+      const uint64_t localS = currentLocalMs() / 1000ULL;
+      if (localS > METRIC_EPOCH_BASE_S) stamp = (uint32_t)(localS - METRIC_EPOCH_BASE_S);
+    }
+    metricBinFrame.push_back((char)METRIC_FRAME_VERSION);
+    for (size_t i = 0; i < 4; i++) metricBinFrame.push_back((char)((stamp >> (8 * i)) & 0xFF));
+  }
+  if (metricBinSensor != sensorId || (uint8_t)metricBinFrame[metricBinItemPos] >= 254) {
+    metricBinFrame.push_back((char)sensorId);
+    metricBinItemPos = metricBinFrame.size();
+    metricBinFrame.push_back(0);
+    metricBinSensor = sensorId;
+  }
+  appendBinaryMetricValue(*k1, v1);
+  if (k2) appendBinaryMetricValue(*k2, v2);
+  return true;
+}
+
+// Compact metrics of one acquisition tick: consecutive values of the same
+// sensor merge into one {"s","m"} item and items are packed into
+// {"b":[...],"ts":...} notifications that fit the MTU. A lone item goes out
+// in the plain single-sensor form. 1-Wire probes share a sensor name, so
+// their items add the ROM as "a" and never merge across probes.
+#if USE_COMPACT_METRICS
+static std::string metricBatchItems;
+static uint8_t metricBatchCount = 0;
+static std::string metricItemSensor;
+static std::string metricItemAddr;
+static std::string metricItemBody;
+
+static void metricBatchTimestamp(std::string &out) {
+  if (!timeSynced) return;
+  char tsBuf[24] = {0};
+  formatTimestamp(currentLocalMs(), tsBuf, sizeof(tsBuf));
+  out += ",\"ts\":\"";
+  out += tsBuf;
+  out += "\"";
+}
+
+static void sendMetricBatch() {
+  if (metricBatchCount == 0) return;
+  std::string payload;
+  if (metricBatchCount == 1) {
+    payload = metricBatchItems;
+    payload.pop_back();
+  } else {
+    payload = "{\"b\":[";
+    payload += metricBatchItems;
+    payload += "]";
+  }
+  metricBatchTimestamp(payload);
+  payload += "}";
+  metricBatchItems.clear();
+  metricBatchCount = 0;
+  if (!txChar) return;
+  Serial.print("[BLE] TX: ");
+  Serial.println(payload.c_str());
+  bleNotify(txChar, payload);
+}
+
+static void closeMetricItem() {
+  if (metricItemBody.empty()) return;
+  std::string item = "{\"s\":\"";
+  item += metricItemSensor;
+  if (!metricItemAddr.empty()) {
+    item += "\",\"a\":\"";
+    item += metricItemAddr;
+  }
+  item += "\",\"m\":{";
+  item += metricItemBody;
+  item += "}}";
+  metricItemBody.clear();
+  // Room for the batch wrapper and the timestamp.
+  const size_t overhead = 8 + (timeSynced ? 26 : 0);
+  if (metricBatchCount > 0
+      && metricBatchItems.size() + 1 + item.size() + overhead > metricBatchLimit()) {
+    sendMetricBatch();
+  }
+  if (metricBatchCount > 0) metricBatchItems += ",";
+  metricBatchItems += item;
+  metricBatchCount++;
+}
+
+static void appendMetricValue(const char *key, float value) {
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%s\"%s\":%.3f", metricItemBody.empty() ? "" : ",", compactMetricKey(key), value);
+  metricItemBody += buf;
+}
+
+#endif
+
+// Binary items carry no address: 1-Wire probes, told apart by their ROM,
+// go out as JSON.
+static void queueMetricPayload(const char *sensor, const char *addr, const char *key1, float v1, const char *key2, float v2) {
+  const bool rom = isOneWireRom(addr);
+  if (metricBinary && !rom && queueBinaryMetrics(sensor, key1, v1, key2, v2)) return;
+#if USE_COMPACT_METRICS
+  const char *name = sensor ? sensor : "";
+  const char *address = rom ? addr : "";
+  if (!metricItemBody.empty() && (metricItemSensor != name || metricItemAddr != address)) closeMetricItem();
+  metricItemSensor = name;
+  metricItemAddr = address;
+  appendMetricValue(key1, v1);
+  if (key2) appendMetricValue(key2, v2);
+#else
+  sendMetricPayload(sensor, addr, key1, v1, key2, v2);
+#endif
+}
+
+static void flushMetricBatch() {
+  sendBinaryMetricFrame();
+#if USE_COMPACT_METRICS
+  closeMetricItem();
+  sendMetricBatch();
+#endif
+}
+
+// Writes are parsed in the NimBLE host task and queued; everything that
+// touches flash, NVS, sensors or the export stream runs here, from loop().
+static const size_t BLE_COMMAND_QUEUE_LEN = 8;
+static SpscQueue<ConfigUpdate, BLE_COMMAND_QUEUE_LEN> bleCommands;
+
+// Writes dropped because bleCommands was full; their error ack is sent
+// from loop() too, never from the host task.
+struct RejectedCommand {
+  bool hasAction = false;
+  std::string action;
+};
+static SpscQueue<RejectedCommand, 4> bleRejected;
+
+static void runConfigCommand(ConfigUpdate &update) {
+  if (update.hasAction) {
+    if (update.action == "time_sync") {
+      if (update.hasTzOffset) {
+        applyTzOffset(update.tzOffsetMin);
+      }
+      if (update.hasEpochMs) {
+        applyTimeSync(update.epochMs);
+        sendFlashAck("time_sync", "ok", "Heure synchronisee");
+      } else {
+        sendFlashAck("time_sync", "error", "Timestamp manquant");
+      }
+      return;
+    }
+    if (update.action == "config_get") {
+      sendConfigPayload();
+      return;
+    }
+    if (update.action == "i2c_scan") {
+      if (normalizeSensor(deviceConfig.sensor) != "i2c") {
+        sendFlashAck("i2c_scan", "error", "Mode I2C inactif");
         return;
       }
+      beginI2cBus();
+      const uint32_t hz = i2cClockHz;
+      setI2cClock(I2C_SAFE_HZ);
+      const std::string found = i2cScan();
+      setI2cClock(hz);
+      sendFlashAck("i2c_scan", "ok", found.empty() ? "Aucun peripherique" : found.c_str());
+      return;
     }
-
-    if (update.hasEpochMs) {
-      applyTimeSync(update.epochMs);
+    if (update.action == "metric_format") {
+      if (update.format == "binary") {
+        metricBinary = true;
+        sendFlashAck("metric_format", "ok", "Format binaire v1");
+      } else if (update.format.empty() || update.format == "json") {
+        metricBinary = false;
+        sendFlashAck("metric_format", "ok", "Format JSON");
+      } else {
+        sendFlashAck("metric_format", "error", "Format inconnu");
+      }
+      return;
+    }
+    if (update.action == "flash_clear") {
+      flashClear();
+      sendFlashAck("flash_clear", "ok", "Flash videe");
+      sendFlashStatus();
+      return;
     }
-    if (update.hasTzOffset) {
-      applyTzOffset(update.tzOffsetMin);
+    if (update.action == "flash_export") {
+      if (update.hasResume && resumeCsvStream(update.resumeId, update.resumeOffset, update.window)) {
+        sendFlashAck("flash_export", "ok", "Reprise export");
+        return;
+      }
+      // A stream nobody resumed is dropped in favour of the new request.
+      if (csvStreamSuspended) endCsvStream();
+      if (csvExportInProgress) {
+        sendFlashAck("flash_export", "error", "Export en cours");
+        return;
+      }
+      sendFlashAck("flash_export", "ok", "Export CSV");
+      sendFlashStatus();
+      uint64_t fromMs = 0;
+      uint64_t toMs = UINT64_MAX;
+      exportRange(update, fromMs, toMs);
+      sendCsvFromFlash(fromMs, toMs, update.window, update.framing == "binary", update.format == "lz");
+      return;
     }
-
-    bool nameHandled = false;
-    if (update.hasName) {
-      std::string applied;
-      if (applyBleNameUpdate(update.name, applied)) {
-        deviceConfig.name = applied;
-        sendNameAck("ok", applied, "");
+    if (update.action == "flash_stream") {
+      if (update.hasResume && resumeCsvStream(update.resumeId, update.resumeOffset, update.window)) {
+        sendFlashAck("flash_stream", "ok", "Reprise export");
+        return;
+      }
+      // A stream nobody resumed is dropped in favour of the new request.
+      if (csvStreamSuspended) endCsvStream();
+      if (csvExportInProgress) {
+        sendFlashAck("flash_stream", "error", "Export en cours");
+        return;
+      }
+      sendFlashAck("flash_stream", "ok", "Stream CSV");
+      sendFlashStatus();
+      uint64_t fromMs = 0;
+      uint64_t toMs = UINT64_MAX;
+      exportRange(update, fromMs, toMs);
+      sendCsvFromFlash(fromMs, toMs, update.window, update.framing == "binary", update.format == "lz");
+      return;
+    }
+    if (update.action == "flash_export_new") {
+      if (update.hasResume && resumeCsvStream(update.resumeId, update.resumeOffset, update.window)) {
+        sendFlashAck("flash_export_new", "ok", "Reprise export");
+        return;
+      }
+      if (csvStreamSuspended) endCsvStream();
+      if (csvExportInProgress) {
+        sendFlashAck("flash_export_new", "error", "Export en cours");
+        return;
+      }
+      if (!ensureLogRing()) {
+        sendFlashAck("flash_export_new", "error", "Flash indisponible");
+        return;
+      }
+      const std::string client = update.client.empty() ? "default" : update.client;
+      LogSyncPoint last;
+      const bool known = loadLogSyncPoint(client, last);
+      // Rows older than the sync point may have been evicted meanwhile:
+      // the client then gets everything still on flash.
+      LogCursorMark start;
+      if (known && last.seq >= logRing.tail() && last.seq <= logRing.head()) {
+        start.seq = last.seq;
+        start.offset = last.offset;
       } else {
-        sendNameAck("error", "", "Nom invalide");
+        start.seq = logRing.tail();
       }
-      update.hasName = false;
-      nameHandled = true;
+      sendFlashAck("flash_export_new", "ok", "Export nouveautes");
+      sendCsvFromFlash(0, UINT64_MAX, update.window, update.framing == "binary", update.format == "lz", &start);
+      if (!csvStreamActive) return;
+      // Logging is paused while exporting, so the head's current end is
+      // where this export stops; the next row after it starts seekable.
+      binLogger.anchorNext();
+      csvSyncActive = true;
+      csvSyncClient = client;
+      csvSyncTarget.seq = logRing.head();
+      csvSyncTarget.offset = logSegmentEnd(logRing.head());
+      csvSyncTarget.rows = known ? last.rows : 0;
+      return;
     }
-
-    if (applyConfigUpdate(update)) {
-      sendConfigAck("ok", "Config mise a jour");
+    if (update.action == "flash_stream_stop") {
+      endCsvStream();
+      sendFlashAck("flash_stream_stop", "ok", "Stream stop");
+      return;
+    }
+    if (update.action == "csv_ack") {
+      // Cumulative: every block up to and including seq arrived.
+      if (update.hasCsvAck && csvStreamActive
+          && csvStreamIdMatches(update.csvAckId)
+          && update.csvAckSeq < csvStreamSeq) {
+        if (update.csvAckSeq + 1 > csvStreamAcked) {
+          csvStreamAcked = update.csvAckSeq + 1;
+        }
+        csvStreamLastActivityMs = millis();
+      }
+      return;
+    }
+    if (update.action == "csv_nack") {
+      if (update.hasCsvAck && csvStreamActive
+          && csvStreamIdMatches(update.csvAckId)
+          && update.csvAckSeq >= csvStreamAcked
+          && update.csvAckSeq < csvStreamSeq) {
+        csvRetransmitMask |= (uint16_t)(1U << (update.csvAckSeq % CSV_WINDOW_MAX));
+        csvStreamLastActivityMs = millis();
+      }
       return;
     }
+    if (update.action == "flash_status") {
+      sendFlashStatus();
+      sendConfigPayload();
+      return;
+    }
+  }
 
-    if (nameHandled) return;
-    sendConfigAck("error", "Config ignoree");
+  if (update.hasEpochMs) {
+    applyTimeSync(update.epochMs);
+  }
+  if (update.hasTzOffset) {
+    applyTzOffset(update.tzOffsetMin);
+  }
+
+  bool nameHandled = false;
+  if (update.hasName) {
+    std::string applied;
+    if (applyBleNameUpdate(update.name, applied)) {
+      deviceConfig.name = applied;
+      sendNameAck("ok", applied, "");
+    } else {
+      sendNameAck("error", "", "Nom invalide");
+    }
+    update.hasName = false;
+    nameHandled = true;
+  }
+
+  if (applyConfigUpdate(update)) {
+    sendConfigAck("ok", "Config mise a jour");
+    return;
+  }
+
+  if (nameHandled) return;
+  sendConfigAck("error", "Config ignoree");
+}
+
+static bool processBleCommands() {
+  ConfigUpdate update;
+  bool ran = false;
+  while (bleCommands.pop(update)) {
+    runConfigCommand(update);
+    ran = true;
+  }
+  RejectedCommand rejected;
+  while (bleRejected.pop(rejected)) {
+    if (rejected.hasAction) {
+      sendFlashAck(rejected.action.c_str(), "error", "Commande ignoree (file pleine)");
+    } else {
+      sendConfigAck("error", "Commande ignoree (file pleine)");
+    }
+  }
+  return ran;
+}
+
+class RxCallbacks : public NimBLECharacteristicCallbacks {
+  void onWrite(NimBLECharacteristic *pCharacteristic, NimBLEConnInfo &connInfo) override {
+    (void)connInfo;
+    std::string value = pCharacteristic->getValue();
+    if (value.empty()) return;
+    Serial.print("[BLE] RX: ");
+    Serial.println(value.c_str());
+    ConfigUpdate update = parseConfigUpdate(value);
+    if (bleCommands.push(std::move(update))) {
+      wakeLoop();
+      return;
+    }
+    Serial.println("[BLE] File de commandes pleine, ecriture ignoree");
+    RejectedCommand rejected;
+    rejected.hasAction = update.hasAction;
+    rejected.action = std::move(update.action);
+    if (bleRejected.push(std::move(rejected))) wakeLoop();
   }
 
   void onRead(NimBLECharacteristic *pCharacteristic, NimBLEConnInfo &connInfo) override {
@@ -2355,14 +4551,16 @@ class TxCallbacks : public NimBLECharacteristicCallbacks {
 
 class ServerCallbacks : public NimBLEServerCallbacks {
   void onConnect(NimBLEServer *pServer, NimBLEConnInfo &connInfo) override {
-    (void)pServer;
     connectedCount = bleServer ? bleServer->getConnectedCount() : 1;
+    holdDeepSleep();
     Serial.println("[BLE] Connected");
     bleMtu = connInfo.getMTU();
     Serial.print("[BLE] MTU=");
     Serial.println(bleMtu);
     Serial.print("[BLE] Connected count=");
     Serial.println(connectedCount);
+    // Climb notifications run at up to 20 Hz: ask for a 15-30 ms interval.
+    if (deviceConfig.vario) pServer->updateConnParams(connInfo.getConnHandle(), 12, 24, 0, 400);
     // Keep advertising to allow multiple centrals to connect
     NimBLEDevice::startAdvertising();
     // Some centrals don't receive notifications until subscribe event;
@@ -2376,6 +4574,7 @@ class ServerCallbacks : public NimBLEServerCallbacks {
     Serial.print("[BLE] Disconnected, reason=");
     Serial.println(reason);
     connectedCount = bleServer ? bleServer->getConnectedCount() : 0;
+    holdDeepSleep();
     bleMtu = 23;
     Serial.print("[BLE] Connected count=");
     Serial.println(connectedCount);
@@ -2384,11 +4583,12 @@ class ServerCallbacks : public NimBLEServerCallbacks {
     Serial.println(restarted ? "OK" : "FAIL");
 
     if (connectedCount == 0) {
-      csvExportInProgress = false;
-      csvExportStartedAt = 0;
-      endCsvStream();
-      bleResetPending = true;
+      // The next client negotiates its own metric format.
+      metricBinary = false;
+      csvLinkLost = true;
       bleResetAt = millis() + 200;
+      bleResetPending = true;
+      wakeLoop();
       Serial.println("[BLE] Reset scheduled");
     }
   }
@@ -2439,6 +4639,10 @@ static void bleInit() {
       UUID_CONFIG, NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_NR);
   txChar = service->createCharacteristic(
       UUID_DATA, NIMBLE_PROPERTY::NOTIFY);
+  exportChar = service->createCharacteristic(
+      UUID_EXPORT, NIMBLE_PROPERTY::NOTIFY);
+  varioChar = service->createCharacteristic(
+      UUID_VARIO, NIMBLE_PROPERTY::NOTIFY);
 
   rxChar->setCallbacks(new RxCallbacks());
   txChar->setCallbacks(new TxCallbacks());
@@ -2479,23 +4683,259 @@ static void bleReset() {
   NimBLEDevice::deinit(true);
   delay(50);
   txChar = nullptr;
+  exportChar = nullptr;
+  varioChar = nullptr;
   bleServer = nullptr;
   connectedCount = 0;
   bleInit();
 }
 
+#if !VARIO_DISABLE_SLEEP
+// The RTC timer keeps counting through deep sleep; millis() restarts.
+static uint64_t rtcClockMs() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return (uint64_t)tv.tv_sec * 1000ULL + (uint64_t)(tv.tv_usec / 1000);
+}
+
+static void setRtcClockMs(uint64_t ms) {
+  struct timeval tv;
+  tv.tv_sec = (time_t)(ms / 1000ULL);
+  tv.tv_usec = (suseconds_t)((ms % 1000ULL) * 1000ULL);
+  settimeofday(&tv, nullptr);
+}
+
+static void saveRtcWakeState() {
+  rtcWake.magic = RTC_WAKE_MAGIC;
+  rtcWake.frequencyMs = sensorIntervalMs;
+  rtcWake.logBudgetKb = deviceConfig.logBudgetKb;
+  rtcWake.tzOffsetMin = tzOffsetMin;
+  rtcWake.i2cSda = (int8_t)deviceConfig.i2cSda;
+  rtcWake.i2cScl = (int8_t)deviceConfig.i2cScl;
+  rtcWake.onewirePin = (int8_t)deviceConfig.onewirePin;
+  rtcWake.onewireBits = deviceConfig.onewireBits;
+  rtcWake.analogPin = (int8_t)deviceConfig.analogPin;
+  rtcWake.digitalPin = (int8_t)deviceConfig.digitalPin;
+  rtcWake.buttonPin = (int8_t)deviceConfig.buttonPin;
+  rtcWake.ms5611Osr = (uint16_t)deviceConfig.ms5611Osr;
+  rtcWake.timeSynced = timeSynced;
+  snprintf(rtcWake.sensor, sizeof(rtcWake.sensor), "%s", deviceConfig.sensor.c_str());
+  snprintf(rtcWake.logFormat, sizeof(rtcWake.logFormat), "%s", deviceConfig.logFormat.c_str());
+  rtcWake.sensorCache = sensorCache;
+}
+
+static void restoreRtcWakeState() {
+  deviceConfig.sensor = rtcWake.sensor;
+  deviceConfig.logFormat = rtcWake.logFormat;
+  deviceConfig.logBudgetKb = rtcWake.logBudgetKb;
+  deviceConfig.frequencyMs = rtcWake.frequencyMs;
+  deviceConfig.i2cSda = rtcWake.i2cSda;
+  deviceConfig.i2cScl = rtcWake.i2cScl;
+  deviceConfig.onewirePin = rtcWake.onewirePin;
+  deviceConfig.onewireBits = rtcWake.onewireBits;
+  deviceConfig.analogPin = rtcWake.analogPin;
+  deviceConfig.digitalPin = rtcWake.digitalPin;
+  deviceConfig.buttonPin = rtcWake.buttonPin;
+  deviceConfig.ms5611Osr = rtcWake.ms5611Osr;
+  deviceConfig.storeFlash = true;
+  deviceConfig.deepSleep = true;
+  sensorIntervalMs = rtcWake.frequencyMs ? rtcWake.frequencyMs : 1000;
+  tzOffsetMin = rtcWake.tzOffsetMin;
+  sensorCache = rtcWake.sensorCache;
+}
+
+static void replayRtcRow(void *ctx, const BinaryLogRecord &record, bool tickEnd) {
+  (void)ctx;
+  char addr[2 * BinaryLogRecord::kMaxAddr + 1];
+  formatHexAddress(record.addr, record.addrLen, addr, sizeof(addr));
+  float v[LOG_FIELD_COUNT];
+  for (uint8_t i = 0; i < LOG_FIELD_COUNT; i++) {
+    v[i] = (record.mask & (1U << i)) ? record.values[i] : NAN;
+  }
+  flashLogRow(record.timestampMs, logSensorName(record.sensorId), addr,
+              v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8]);
+  if (tickEnd) finishLogTick();
+}
+
+// Every buffered row goes out in one buffered append.
+static void flushRtcLog() {
+  const uint16_t rows = rtcLog.rows();
+  if (rows == 0) return;
+  rtcLog.forEach(replayRtcRow, nullptr);
+  flushLogs();
+  rtcLog.clear();
+  Serial.print("[SLEEP] RTC rows flushed=");
+  Serial.println((unsigned int)rows);
+}
+
+static void logRecordFromSample(const LogSample &row, BinaryLogRecord &record) {
+  record = BinaryLogRecord();
+  record.timestampMs = row.localMs;
+  record.sensorId = logSensorId(row.sensor);
+  record.addrLen = parseHexAddress(row.addr, record.addr, BinaryLogRecord::kMaxAddr);
+  for (uint8_t i = 0; i < LOG_FIELD_COUNT; i++) {
+    if (!isfinite(row.values[i])) continue;
+    record.mask |= (uint16_t)(1U << i);
+    record.values[i] = row.values[i];
+  }
+}
+
+// Moves the tick acquireAndPublishSample() just queued into RTC memory.
+// Flushes first when it does not fit, and again when the next tick of the
+// same size would not, so a full buffer never waits a whole cycle.
+static void bufferTickInRtc() {
+  BinaryLogRecord records[RTC_TICK_MAX_ROWS];
+  uint8_t count = 0;
+  size_t bytes = 0;
+  LogSample row;
+  while (logSampleRing.pop(row)) {
+    if (!row.sensor || count >= RTC_TICK_MAX_ROWS) continue;
+    logRecordFromSample(row, records[count]);
+    bytes += RtcLog::packedSize(records[count]);
+    count++;
+  }
+  if (count == 0) return;
+  if (bytes > rtcLog.room()) flushRtcLog();
+  for (uint8_t i = 0; i < count; i++) {
+    const bool tickEnd = i + 1 == count;
+    if (!rtcLog.append(records[i], tickEnd)) {
+      flushRtcLog();
+      rtcLog.append(records[i], tickEnd);
+    }
+  }
+  if (bytes > rtcLog.room()) flushRtcLog();
+}
+
+static void armDeepSleepWakeups(uint64_t sleepUs) {
+  esp_sleep_enable_timer_wakeup(sleepUs);
+  const int pin = deviceConfig.buttonPin;
+  if (pin < 0) return;
+  gpio_pullup_en((gpio_num_t)pin);
+#if SOC_GPIO_SUPPORT_DEEPSLEEP_WAKEUP
+  const esp_err_t err = esp_deep_sleep_enable_gpio_wakeup(1ULL << pin, ESP_GPIO_WAKEUP_GPIO_LOW);
+#elif SOC_PM_SUPPORT_EXT1_WAKEUP
+  const esp_err_t err = esp_sleep_enable_ext1_wakeup(1ULL << pin, ESP_EXT1_WAKEUP_ANY_LOW);
+#else
+  const esp_err_t err = ESP_ERR_NOT_SUPPORTED;
+#endif
+  if (err != ESP_OK) {
+    Serial.print("[SLEEP] Button cannot wake from deep sleep, pin=");
+    Serial.println(pin);
+  }
+}
+
+static void deepSleepUntil(uint64_t nextMs) {
+  const uint64_t nowMs = rtcClockMs();
+  const uint64_t sleepMs = nextMs > nowMs ? nextMs - nowMs : 1;
+  rtcWake.nextWakeMs = nextMs;
+  rtcWake.lastAwakeMs = millis();
+  armDeepSleepWakeups(sleepMs * 1000ULL);
+  Serial.flush();
+  esp_deep_sleep_start();
+}
+
+// Timer wake inside the cycle. Button and power-on wakes return false and
+// take the full boot, which flushes the RTC rows.
+static bool runDeepSleepWake() {
+  if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER || rtcWake.magic != RTC_WAKE_MAGIC) return false;
+  Serial.begin(115200);
+  restoreRtcWakeState();
+  // Rows keep the clock of the awake phase: epoch when synced, uptime
+  // since the cycle started otherwise.
+  epochOffsetMs = (int64_t)rtcClockMs() - (int64_t)millis();
+  timeSynced = true;
+  csvLogger.setBuffered(LOG_BUFFER_BYTES, LOG_FLUSH_MS);
+  binLogger.setBuffered(LOG_BUFFER_BYTES, LOG_FLUSH_MS);
+  rtcLog.attach();
+
+  initSensorsAtBoot();
+  acquireAndPublishSample();
+  bufferTickInRtc();
+  rtcWake.cycles++;
+
+  uint64_t nextMs = rtcWake.nextWakeMs + sensorIntervalMs;
+  const uint64_t nowMs = rtcClockMs();
+  if (nextMs <= nowMs) nextMs = nowMs + sensorIntervalMs;
+  deepSleepUntil(nextMs);
+  return true;
+}
+
+// Full boot after a cycle: restore the clock and land the buffered rows.
+static void resumeFromDeepSleep() {
+  rtcLog.attach();
+  if (rtcWake.magic == RTC_WAKE_MAGIC) {
+    if (rtcWake.timeSynced) {
+      applyTimeSync(rtcClockMs());
+      applyTzOffset(rtcWake.tzOffsetMin);
+    }
+    Serial.print("[SLEEP] Cycle ended after wakes=");
+    Serial.print((unsigned long)rtcWake.cycles);
+    Serial.print(" last_awake_ms=");
+    Serial.println((unsigned long)rtcWake.lastAwakeMs);
+    rtcWake.magic = 0;
+  }
+  flushRtcLog();
+}
+
+// BSEC needs the chip awake between its own sample slots, so BME680 nodes
+// stay on light sleep, as does vario mode with its continuous stream.
+static bool deepSleepAllowed() {
+  return deviceConfig.deepSleep && deviceConfig.storeFlash && connectedCount == 0
+    && !csvExportInProgress && !csvStreamActive && !csvStreamSuspended
+    && !serialDumpInProgress && !sensorInitPending && !bme680 && !deviceConfig.vario;
+}
+
+static void enterDeepSleepCycle() {
+  pipelineLock(PIPELINE_LOCK_SENSORS);
+  pipelineLock(PIPELINE_LOCK_LOGS);
+  runStorageStage();
+  flushLogs();
+  const uint64_t nowMs = currentEpochMs();
+  setRtcClockMs(nowMs);
+  saveRtcWakeState();
+  rtcWake.cycles = 0;
+  rtcLog.clear();
+  Serial.print("[SLEEP] Deep sleep cycle, interval ms=");
+  Serial.println((unsigned long)sensorIntervalMs);
+  deepSleepUntil(nowMs + sensorIntervalMs);
+}
+
+static void deepSleepJob() {
+  if (deepSleepAllowed() && (int32_t)(millis() - deepSleepHoldUntil) >= 0) {
+    enterDeepSleepCycle();
+  }
+  scheduleHousekeeping(deepSleepJob, 1000);
+}
+#endif
+
 void setup() {
+#if !VARIO_DISABLE_SLEEP
+  if (runDeepSleepWake()) return;
+#endif
+  uint32_t phaseUs = micros();
   Serial.begin(115200);
-  delay(200);
-#if defined(ARDUINO_USB_CDC_ON_BOOT) && ARDUINO_USB_CDC_ON_BOOT
+#if SERIAL_WAIT_MS > 0 && defined(ARDUINO_USB_CDC_ON_BOOT) && ARDUINO_USB_CDC_ON_BOOT
   unsigned long start = millis();
-  while (!Serial && (millis() - start) < 2000) {
+  while (!Serial && (millis() - start) < SERIAL_WAIT_MS) {
     delay(10);
   }
 #endif
+  bootPhase("serial", phaseUs);
   printBootInfo();
+  phaseUs = micros();
+  csvLogger.setBuffered(LOG_BUFFER_BYTES, LOG_FLUSH_MS);
+  binLogger.setBuffered(LOG_BUFFER_BYTES, LOG_FLUSH_MS);
   ensureLittleFS();
+  bootPhase("littlefs", phaseUs);
+  phaseUs = micros();
   loadConfig();
+  bootPhase("nvs", phaseUs);
+  phaseUs = micros();
+  ensureLogRing();
+#if !VARIO_DISABLE_SLEEP
+  resumeFromDeepSleep();
+#endif
+  bootPhase("log_ring", phaseUs);
   // Migrate legacy stored pins on ESP32-C3 (older builds used 11/12).
   if (deviceConfig.i2cSda == 11 && deviceConfig.i2cScl == 12
       && (I2C_SDA != 11 || I2C_SCL != 12)) {
@@ -2521,41 +4961,144 @@ void setup() {
   Serial.print(" SCL=");
   Serial.println(deviceConfig.i2cScl);
   applyI2cConfig();
-  sensorInitPending = true;
-  sensorInitAt = millis() + 3000;
-  Serial.println("[SENSOR] Init deferred");
   applyUserIo();
+  // The pipeline creates the sensors lock the init task takes.
+#if USE_TASK_PIPELINE
+  startSamplePipeline();
+#endif
+  startSensorInit();
+  phaseUs = micros();
   bleInit();
+  bootPhase("ble", phaseUs);
+  setupPowerManagement();
+  startLoopScheduler();
+  bootPhase("setup", 0);
 }
 
-void loop() {
-  handleSerialCommands();
-  handleButtonInput();
-  if (bleResetPending && (int32_t)(millis() - bleResetAt) >= 0) {
-    bleResetPending = false;
-    bleReset();
+// The loop only sets the wait; the idle task enters light sleep when every
+// task is blocked, with the BLE controller in modem sleep. esp_timer
+// deadlines, GPIO levels and the radio wake it up.
+static void setupPowerManagement() {
+  powerEstimator.begin((uint64_t)esp_timer_get_time());
+#if !VARIO_DISABLE_SLEEP
+#if ESP_IDF_VERSION_MAJOR >= 5
+  esp_pm_config_t pm = {};
+#else
+  esp_pm_config_esp32c3_t pm = {};
+#endif
+  pm.max_freq_mhz = (int)getCpuFrequencyMhz();
+  pm.min_freq_mhz = (int)getXtalFrequencyMhz();
+  pm.light_sleep_enable = true;
+  const esp_err_t err = esp_pm_configure(&pm);
+  if (err != ESP_OK) {
+    Serial.print("[PM] Light sleep unavailable err=");
+    Serial.println((int)err);
+    return;
+  }
+  if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "busy", &noSleepLock) != ESP_OK) {
+    noSleepLock = nullptr;
   }
+  esp_sleep_enable_gpio_wakeup();
+  lightSleepReady = true;
+  Serial.println("[PM] Light sleep enabled");
+#endif
+}
 
-  const uint32_t now = millis();
-  if (sensorInitPending && (int32_t)(now - sensorInitAt) >= 0) {
-    sensorInitPending = false;
-    Serial.println("[SENSOR] Init start");
-    applySensorMode();
-    Serial.println("[SENSOR] Init done");
+// Exports and serial dumps stream back to back; sleeping between chunks
+// would only stretch them.
+static bool lightSleepBlocked() {
+  return (csvStreamActive && !csvStreamSuspended) || csvExportInProgress || serialDumpInProgress;
+}
+
+static void updateSleepLock() {
+#if !VARIO_DISABLE_SLEEP
+  if (!noSleepLock) return;
+  const bool blocked = lightSleepBlocked();
+  if (blocked == noSleepHeld) return;
+  if (blocked) {
+    esp_pm_lock_acquire(noSleepLock);
+  } else {
+    esp_pm_lock_release(noSleepLock);
   }
+  noSleepHeld = blocked;
+#endif
+}
+
+static bool loopCanSleep() {
+#if VARIO_DISABLE_SLEEP
+  return false;
+#else
+  return lightSleepReady && !noSleepHeld;
+#endif
+}
+
+static void buildPowerJson(std::string &out) {
+  const uint64_t nowUs = (uint64_t)esp_timer_get_time();
+  const uint32_t sleepPermille = powerEstimator.sleepPermille(nowUs);
+  char buf[128];
+  snprintf(buf, sizeof(buf),
+           "\"power\":{\"sleep\":\"%s\",\"avg_ua\":%lu,\"sleep_pct\":%lu.%lu,\"window_s\":%lu}",
+           lightSleepReady ? "light" : "off",
+           (unsigned long)powerEstimator.averageUa(nowUs),
+           (unsigned long)(sleepPermille / 10),
+           (unsigned long)(sleepPermille % 10),
+           (unsigned long)(powerEstimator.elapsedUs(nowUs) / 1000000ULL));
+  out.assign(buf);
+}
 
-  if (!serialDumpInProgress && now - lastBeat >= HEARTBEAT_MS) {
-    lastBeat = now;
+static void heartbeatJob() {
+  if (!serialDumpInProgress && !housekeepingQuiet()) {
     Serial.print("[ALIVE] ms=");
-    Serial.println(now);
+    Serial.println(millis());
   }
+  scheduleHousekeeping(heartbeatJob, HEARTBEAT_MS);
+}
+
+static void rescanJob() {
+  pipelineLock(PIPELINE_LOCK_SENSORS);
+  if (deviceConfig.sensor == "i2c" && (i2cScanPending || (!bmp280 && !bme680 && !ms5611))) {
+    if (!i2cSensorsAnswer()) scanSensors();
+    i2cScanPending = false;
+  }
+  pipelineUnlock(PIPELINE_LOCK_SENSORS);
+  scheduleHousekeeping(rescanJob, RESCAN_INTERVAL_MS);
+}
+
+static void bleResetJob() {
+  bleResetPending = false;
+  pipelineLock(PIPELINE_LOCK_BLE);
+  bleReset();
+  pipelineUnlock(PIPELINE_LOCK_BLE);
+}
 
-  if (csvStreamActive && csvStreamLastActivityMs && (now - csvStreamLastActivityMs) > 5000) {
+static void logPollJob() {
+  pipelineLock(PIPELINE_LOCK_LOGS);
+  csvLogger.poll();
+  binLogger.poll();
+  pipelineUnlock(PIPELINE_LOCK_LOGS);
+  scheduleHousekeeping(logPollJob, LOG_POLL_MS);
+}
+
+// Pumps an active export and enforces its timeouts; stays scheduled only
+// while an export exists.
+static void csvStreamJob() {
+  const uint32_t now = millis();
+  pipelineLock(PIPELINE_LOCK_LOGS);
+  pumpCsvStream();
+
+  if (csvStreamActive && !csvStreamSuspended
+      && csvStreamLastActivityMs && (now - csvStreamLastActivityMs) > 5000) {
     Serial.println("[CSV] Stream timeout, closing.");
     endCsvStream();
   }
 
-  if (csvExportInProgress && connectedCount == 0 && csvExportStartedAt) {
+  if (csvStreamSuspended && (now - csvStreamSuspendedAt) > CSV_RESUME_GRACE_MS) {
+    Serial.println("[CSV] Resume window expired, closing.");
+    endCsvStream();
+  }
+  pipelineUnlock(PIPELINE_LOCK_LOGS);
+
+  if (csvExportInProgress && !csvStreamActive && connectedCount == 0 && csvExportStartedAt) {
     if (now - csvExportStartedAt > 5000) {
       csvExportInProgress = false;
       csvExportStartedAt = 0;
@@ -2563,26 +5106,293 @@ void loop() {
     }
   }
 
-  if (now - lastScanMs >= RESCAN_INTERVAL_MS) {
-    lastScanMs = now;
-    if (deviceConfig.sensor == "i2c" && (i2cScanPending || (!bmp280 && !bme680 && !ms5611))) {
-      scanSensors();
-      i2cScanPending = false;
+  if (csvStreamSuspended) {
+    loopScheduler.scheduleAt(csvStreamSuspendedAt + CSV_RESUME_GRACE_MS + 1, csvStreamJob);
+  } else if (csvStreamActive) {
+    loopScheduler.scheduleIn(CSV_PUMP_INTERVAL_MS, csvStreamJob);
+  } else if (csvExportInProgress) {
+    loopScheduler.scheduleIn(1000, csvStreamJob);
+  }
+}
+
+// The tick waits for a fresh MS5611 cycle, which ms5611Job() collects on
+// later scheduler ticks, instead of blocking loop() or the acquisition
+// task for the conversions. Continuous mode only waits until its first
+// cycle after a (re)detection has finished. Called with
+// PIPELINE_LOCK_SENSORS held.
+static bool startMs5611ForSample() {
+  if (!ms5611 || normalizeSensor(deviceConfig.sensor) != "i2c") return false;
+  if (ms5611SampleReady) {
+    ms5611SampleReady = false;
+    return false;
+  }
+  if (ms5611RateHz() > 0 && ms5611->valid()) return false;
+  if (!ms5611->busy() && !ms5611->start(micros())) return false;
+  ms5611SamplePending = true;
+#if USE_TASK_PIPELINE
+  // The scheduler belongs to loop(); it picks the flag up.
+  ms5611Restart = true;
+  wakeLoop();
+#else
+  if (!loopScheduler.pending(ms5611Job)) {
+    loopScheduler.scheduleIn(Ms5611Async::conversionUs(ms5611->oversampling()) / 1000 + 1, ms5611Job);
+  }
+#endif
+  return true;
+}
+
+#if !USE_TASK_PIPELINE
+// Deadlines stay on the frequencyMs grid; a late tick moves the grid
+// instead of firing catch-up samples.
+static void runSampleStages() {
+  acquireAndPublishSample();
+  runPublishStage();
+  runStorageStage();
+}
+
+static void sampleJob() {
+  if (!csvExportInProgress && (connectedCount > 0 || deviceConfig.storeFlash)) {
+    if (!startMs5611ForSample() && !startOneWireForSample()) runSampleStages();
+  }
+  sampleDeadline += sensorIntervalMs;
+  const uint32_t now = millis();
+  if ((int32_t)(now - sampleDeadline) >= 0) sampleDeadline = now + sensorIntervalMs;
+  loopScheduler.scheduleAt(sampleDeadline, sampleJob);
+}
+#endif
+
+struct VarioReading {
+  bool fed = false;
+  bool ready = false;
+  int32_t altitudeCm = 0;
+  int32_t climbCmS = 0;
+};
+
+// Called with PIPELINE_LOCK_SENSORS held.
+static void varioFeed(float pressHpa, uint32_t nowUs, VarioReading &out) {
+  const uint32_t startUs = micros();
+  vario.update(VarioFilter::paQ8FromHpa(pressHpa), nowUs);
+  varioFilterUs += micros() - startUs;
+  varioLogUpdates++;
+  out.fed = true;
+  out.ready = vario.ready();
+  out.altitudeCm = vario.altitudeCm();
+  out.climbCmS = vario.climbCmS();
+}
+
+// UUID_VARIO payload, little endian: u8 version, u8 seq, i32 altitude cm,
+// i16 climb cm/s. Sent as soon as the filter ran, at most every
+// VARIO_NOTIFY_MIN_MS.
+static void varioPublish(const VarioReading &reading) {
+  if (!reading.fed || !reading.ready) return;
+  const uint32_t now = millis();
+  if ((uint32_t)(now - varioLogAt) >= VARIO_LOG_MS) {
+    if (!serialDumpInProgress) {
+      Serial.print("[VARIO] alt_cm=");
+      Serial.print((long)reading.altitudeCm);
+      Serial.print(" climb_cms=");
+      Serial.print((long)reading.climbCmS);
+      Serial.print(" updates=");
+      Serial.print((unsigned long)varioLogUpdates);
+      Serial.print(" filter_us_avg=");
+      Serial.println(varioLogUpdates ? (float)varioFilterUs / varioLogUpdates : 0.0f, 1);
+    }
+    varioLogAt = now;
+    varioLogUpdates = 0;
+    varioFilterUs = 0;
+  }
+  if (!varioChar || connectedCount == 0) return;
+  if ((uint32_t)(now - varioLastNotifyMs) < VARIO_NOTIFY_MIN_MS) return;
+  varioLastNotifyMs = now;
+  int32_t climb = reading.climbCmS;
+  if (climb > INT16_MAX) climb = INT16_MAX;
+  if (climb < INT16_MIN) climb = INT16_MIN;
+  const uint32_t alt = (uint32_t)reading.altitudeCm;
+  const uint16_t climbLe = (uint16_t)(int16_t)climb;
+  const uint8_t frame[8] = {
+    0x01, varioSeq++,
+    (uint8_t)alt, (uint8_t)(alt >> 8), (uint8_t)(alt >> 16), (uint8_t)(alt >> 24),
+    (uint8_t)climbLe, (uint8_t)(climbLe >> 8)
+  };
+  bleNotify(varioChar, frame, sizeof(frame));
+}
+
+// BMP280 vario source: the chip converts on its own (applyBmp280Sampling)
+// and this job reads the latest result. The MS5611 path feeds the filter
+// from ms5611Job() instead.
+static void varioJob() {
+  pipelineLock(PIPELINE_LOCK_SENSORS);
+  const bool active = deviceConfig.vario && bmp280 && !ms5611;
+  VarioReading reading;
+  if (active) {
+    const float pressHpa = bmp280->readPressure() / 100.0f;
+    if (isfinite(pressHpa)) varioFeed(pressHpa, micros(), reading);
+  }
+  pipelineUnlock(PIPELINE_LOCK_SENSORS);
+  if (!active) return;
+  varioPublish(reading);
+  loopScheduler.scheduleIn(1000 / VARIO_BMP280_HZ, varioJob);
+}
+
+// Collects finished conversions and, with ms5611_hz > 0 or in vario mode,
+// starts a cycle every period. Reschedules itself while a cycle runs or
+// the mode is on.
+static void ms5611Job() {
+  pipelineLock(PIPELINE_LOCK_SENSORS);
+  const uint32_t nowUs = micros();
+  const uint32_t rateHz = ms5611RateHz();
+  bool reschedule = false;
+  uint32_t nextUs = 0;
+  VarioReading reading;
+  if (ms5611) {
+    if (ms5611->busy() && ms5611->poll(nowUs)) {
+      ms5611Fresh = true;
+      if (deviceConfig.vario) varioFeed(ms5611->pressureHpa(), nowUs, reading);
+    }
+    if (!ms5611->busy() && rateHz > 0 && (int32_t)(nowUs - ms5611NextStartUs) >= 0) {
+      const uint32_t periodUs = 1000000UL / rateHz;
+      ms5611NextStartUs += periodUs;
+      if ((int32_t)(nowUs - ms5611NextStartUs) >= 0) ms5611NextStartUs = nowUs + periodUs;
+      ms5611->start(nowUs);
     }
+    if (ms5611->busy()) {
+      nextUs = ms5611->dueUs();
+      reschedule = true;
+    } else if (rateHz > 0) {
+      nextUs = ms5611NextStartUs;
+      reschedule = true;
+    }
+  }
+  // In continuous mode the next cycle may already be running.
+  const bool sampleNow = ms5611SamplePending && (ms5611Fresh || !(ms5611 && ms5611->busy()));
+  if (sampleNow) {
+    ms5611SamplePending = false;
+#if USE_TASK_PIPELINE
+    ms5611SampleReady = true;
+#endif
+  }
+  pipelineUnlock(PIPELINE_LOCK_SENSORS);
+  varioPublish(reading);
+  if (sampleNow) {
+#if USE_TASK_PIPELINE
+    wakeAcquisition();
+#else
+    runSampleStages();
+#endif
+  }
+  if (reschedule) {
+    const int32_t waitUs = (int32_t)(nextUs - micros());
+    loopScheduler.scheduleIn(waitUs > 0 ? ((uint32_t)waitUs + 999) / 1000 : 0, ms5611Job);
   }
+}
 
-  if (immediateSamplePending
-      && !csvExportInProgress
-      && (connectedCount > 0 || deviceConfig.storeFlash)) {
+// Marks the conversion finished and runs the tick that waits on it.
+static void oneWireJob() {
+  pipelineLock(PIPELINE_LOCK_SENSORS);
+  if (oneWireConverting && (int32_t)(millis() - oneWireReadyAtMs) < 0) {
+    // Pushed back by a resolution change.
+    const uint32_t readyAtMs = oneWireReadyAtMs;
+    pipelineUnlock(PIPELINE_LOCK_SENSORS);
+    loopScheduler.scheduleAt(readyAtMs, oneWireJob);
+    return;
+  }
+  if (ds18b20 && oneWireConverting) {
+    oneWireConverting = false;
+    oneWireReady = true;
+  }
+  const bool sampleNow = oneWireSamplePending;
+  oneWireSamplePending = false;
+  pipelineUnlock(PIPELINE_LOCK_SENSORS);
+  if (!sampleNow) return;
+#if USE_TASK_PIPELINE
+  wakeAcquisition();
+#else
+  runSampleStages();
+#endif
+}
+
+// Turns the flags other tasks raise into deadlines.
+static void scheduleLoopEvents(bool commandsRan) {
+  const uint32_t now = millis();
+  if (ms5611Restart) {
+    ms5611Restart = false;
+    loopScheduler.scheduleAt(now, ms5611Job);
+  }
+  if (varioRestart) {
+    varioRestart = false;
+    loopScheduler.scheduleAt(now, varioJob);
+  }
+  if (oneWireRestart) {
+    oneWireRestart = false;
+    loopScheduler.scheduleAt(oneWireReadyAtMs, oneWireJob);
+  }
+  if (bleResetPending) loopScheduler.scheduleAt(bleResetAt, bleResetJob);
+  if (housekeepingStretched && !housekeepingQuiet()) {
+    // A client connected: back to the regular periods.
+    housekeepingStretched = false;
+    loopScheduler.scheduleAt(now, heartbeatJob);
+    loopScheduler.scheduleAt(now, logPollJob);
+  }
+  if (rescanRequested) {
+    rescanRequested = false;
+    loopScheduler.scheduleAt(now, rescanJob);
+  }
+  if ((csvStreamActive || csvExportInProgress)
+      && (commandsRan || !loopScheduler.pending(csvStreamJob))) {
+    loopScheduler.scheduleAt(now, csvStreamJob);
+  }
+#if !USE_TASK_PIPELINE
+  if (immediateSamplePending) {
     immediateSamplePending = false;
-    acquireAndPublishSample();
+    sampleDeadline = now;
+    loopScheduler.scheduleAt(now, sampleJob);
   }
+#endif
+}
+
+static void startLoopScheduler() {
+  loopTaskHandle = xTaskGetCurrentTaskHandle();
+  const uint32_t now = millis();
+  loopScheduler.scheduleAt(now, heartbeatJob);
+  loopScheduler.scheduleAt(now + LOG_POLL_MS, logPollJob);
+  if (!loopScheduler.pending(rescanJob)) loopScheduler.scheduleAt(now + RESCAN_INTERVAL_MS, rescanJob);
+#if !VARIO_DISABLE_SLEEP
+  holdDeepSleep();
+  loopScheduler.scheduleAt(now + 1000, deepSleepJob);
+#endif
+#if !USE_TASK_PIPELINE
+  sampleDeadline = now;
+  loopScheduler.scheduleAt(now, sampleJob);
+#endif
+}
 
-  if (!csvExportInProgress
-      && (connectedCount > 0 || deviceConfig.storeFlash)
-      && (now - lastSensorMs) >= sensorIntervalMs) {
-    lastSensorMs = now;
-    acquireAndPublishSample();
+void loop() {
+  // Commands and the button can reconfigure sensors and touch the logs.
+  pipelineLock(PIPELINE_LOCK_SENSORS);
+  pipelineLock(PIPELINE_LOCK_LOGS);
+  if (csvLinkLost) handleCsvLinkLost();
+  const bool commandsRan = processBleCommands();
+  if (commandsRan) holdDeepSleep();
+  handleSerialCommands();
+  handleButtonInput();
+  pipelineUnlock(PIPELINE_LOCK_LOGS);
+  pipelineUnlock(PIPELINE_LOCK_SENSORS);
+
+  scheduleLoopEvents(commandsRan);
+  uint32_t waitMs = loopScheduler.runDue(millis());
+  // Serial input has no wakeup of its own; a bouncing button needs the
+  // end of its debounce window.
+  if (!lightSleepReady && waitMs > LOOP_IDLE_MAX_MS) waitMs = LOOP_IDLE_MAX_MS;
+  if (deviceConfig.buttonPin >= 0 && buttonLastRead != buttonStableState && waitMs > BUTTON_DEBOUNCE_MS + 1) {
+    waitMs = BUTTON_DEBOUNCE_MS + 1;
   }
-  delay(10);
+  if (waitMs == 0) return;
+
+  updateSleepLock();
+#if !VARIO_DISABLE_SLEEP
+  armButtonWake();
+#endif
+  const int64_t waitStartUs = esp_timer_get_time();
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+  powerEstimator.addWait((uint64_t)(esp_timer_get_time() - waitStartUs), loopCanSleep());
 }
@@ -0,0 +1,30 @@
+#pragma once
+
+// BMP280 driver over the simulated bus: begin() succeeds when a device at
+// the address reports chip id 0x58, readings come from host::bmp280*.
+
+#include <Wire.h>
+
+namespace host {
+inline float bmp280TempC = 21.5f;
+inline float bmp280PressurePa = 101325.0f;
+}  // namespace host
+
+class Adafruit_BMP280 {
+ public:
+  enum sensor_mode { MODE_SLEEP = 0x00, MODE_FORCED = 0x01, MODE_NORMAL = 0x03 };
+  enum sensor_sampling { SAMPLING_NONE, SAMPLING_X1, SAMPLING_X2, SAMPLING_X4, SAMPLING_X8, SAMPLING_X16 };
+  enum sensor_filter { FILTER_OFF, FILTER_X2, FILTER_X4, FILTER_X8, FILTER_X16 };
+  enum standby_duration { STANDBY_MS_1, STANDBY_MS_63, STANDBY_MS_125, STANDBY_MS_250, STANDBY_MS_500 };
+
+  bool begin(uint8_t addr = 0x77, uint8_t chipId = 0x58) {
+    Wire.beginTransmission(addr);
+    Wire.write(0xD0);
+    if (Wire.endTransmission() != 0 || Wire.requestFrom(addr, (size_t)1) != 1) return false;
+    return Wire.read() == chipId;
+  }
+  void setSampling(sensor_mode = MODE_NORMAL, sensor_sampling = SAMPLING_X16, sensor_sampling = SAMPLING_X16,
+                   sensor_filter = FILTER_OFF, standby_duration = STANDBY_MS_1) {}
+  float readTemperature() { return host::bmp280TempC; }
+  float readPressure() { return host::bmp280PressurePa; }
+};
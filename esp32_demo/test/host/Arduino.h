@@ -0,0 +1,307 @@
+#pragma once
+
+// Minimal Arduino core for the native test env. Time is simulated: millis()
+// and micros() read host::nowUs, and delay() advances it, so the suites are
+// deterministic and a "60 s" scenario runs instantly.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <string>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define INPUT_PULLDOWN 0x09
+#define CHANGE 0x03
+#define FALLING 0x02
+#define ONLOW 0x04
+#define HEX 16
+#define DEC 10
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define digitalPinToInterrupt(p) (p)
+
+typedef uint8_t byte;
+
+namespace host {
+inline uint64_t nowUs = 0;
+inline uint64_t delayedUs = 0;
+// Wall clock at nowUs == 0; settimeofday() moves it, deep sleep keeps it.
+inline uint64_t rtcBaseUs = 0;
+inline int pinLevel[64];
+inline void (*pinIsr[64])() = {};
+inline int pinIsrMode[64];
+inline void advanceUs(uint64_t us) { nowUs += us; }
+inline void advanceMs(uint64_t ms) { nowUs += ms * 1000ULL; }
+
+inline int getTimeOfDay(struct timeval *tv, void *) {
+  const uint64_t us = rtcBaseUs + nowUs;
+  tv->tv_sec = (time_t)(us / 1000000ULL);
+  tv->tv_usec = (suseconds_t)(us % 1000000ULL);
+  return 0;
+}
+inline int setTimeOfDay(const struct timeval *tv, const void *) {
+  rtcBaseUs = (uint64_t)tv->tv_sec * 1000000ULL + (uint64_t)tv->tv_usec - nowUs;
+  return 0;
+}
+}  // namespace host
+
+// Never touch the host's clock.
+#define gettimeofday(tv, tz) host::getTimeOfDay(tv, tz)
+#define settimeofday(tv, tz) host::setTimeOfDay(tv, tz)
+
+inline unsigned long millis() { return (unsigned long)(host::nowUs / 1000ULL); }
+inline unsigned long micros() { return (unsigned long)host::nowUs; }
+inline void delay(unsigned long ms) {
+  host::delayedUs += ms * 1000ULL;
+  host::advanceMs(ms);
+}
+inline void delayMicroseconds(unsigned int us) {
+  host::delayedUs += us;
+  host::advanceUs(us);
+}
+inline void yield() {}
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t pin) { return pin < 64 ? host::pinLevel[pin] : LOW; }
+inline void digitalWrite(uint8_t pin, uint8_t level) {
+  if (pin < 64) host::pinLevel[pin] = level;
+}
+inline int analogRead(uint8_t) { return 0; }
+inline void attachInterrupt(uint8_t pin, void (*isr)(void), int mode) {
+  if (pin >= 64) return;
+  host::pinIsr[pin] = isr;
+  host::pinIsrMode[pin] = mode;
+}
+inline void detachInterrupt(uint8_t pin) {
+  if (pin < 64) host::pinIsr[pin] = nullptr;
+}
+
+namespace host {
+// An external signal on an input pin; fires the pin's interrupt if armed.
+inline void drivePin(uint8_t pin, int level) {
+  if (pin >= 64) return;
+  const int before = pinLevel[pin];
+  pinLevel[pin] = level;
+  if (!pinIsr[pin]) return;
+  const int mode = pinIsrMode[pin];
+  if ((mode == CHANGE && before != level) || (mode == FALLING && before == HIGH && level == LOW)
+      || (mode == ONLOW && level == LOW)) {
+    pinIsr[pin]();
+  }
+}
+}  // namespace host
+inline void randomSeed(unsigned long seed) { srand((unsigned)seed); }
+inline long random(long howBig) { return howBig > 0 ? rand() % howBig : 0; }
+inline long random(long howSmall, long howBig) {
+  return howBig > howSmall ? howSmall + random(howBig - howSmall) : howSmall;
+}
+inline uint32_t getCpuFrequencyMhz() { return 160; }
+inline uint32_t getXtalFrequencyMhz() { return 40; }
+
+class EspClass {
+ public:
+  uint32_t getFreeHeap() { return 200 * 1024; }
+  void restart() {}
+};
+inline EspClass ESP;
+
+class String {
+ public:
+  String() {}
+  String(const char *text) : s_(text ? text : "") {}
+  String(const std::string &text) : s_(text) {}
+  String(char c) : s_(1, c) {}
+  String(int value, unsigned char base = DEC) { format(base == HEX ? "%x" : "%d", value); }
+  String(unsigned value, unsigned char base = DEC) { format(base == HEX ? "%x" : "%u", value); }
+  String(long value) { format("%ld", value); }
+  String(unsigned long value) { format("%lu", value); }
+  String(float value, unsigned char decimals = 2) { format("%.*f", decimals, (double)value); }
+  String(double value, unsigned char decimals = 2) { format("%.*f", decimals, value); }
+
+  const char *c_str() const { return s_.c_str(); }
+  unsigned length() const { return (unsigned)s_.size(); }
+  bool isEmpty() const { return s_.empty(); }
+  char operator[](unsigned i) const { return i < s_.size() ? s_[i] : 0; }
+  char charAt(unsigned i) const { return (*this)[i]; }
+  bool reserve(unsigned size) {
+    s_.reserve(size);
+    return true;
+  }
+  void trim() {
+    const size_t first = s_.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+      s_.clear();
+      return;
+    }
+    s_ = s_.substr(first, s_.find_last_not_of(" \t\r\n") - first + 1);
+  }
+  void toUpperCase() {
+    for (char &c : s_) c = (char)toupper((unsigned char)c);
+  }
+  void toLowerCase() {
+    for (char &c : s_) c = (char)tolower((unsigned char)c);
+  }
+  void replace(const String &from, const String &to) {
+    if (from.s_.empty()) return;
+    for (size_t at = s_.find(from.s_); at != std::string::npos; at = s_.find(from.s_, at + to.s_.size())) {
+      s_.replace(at, from.s_.size(), to.s_);
+    }
+  }
+  bool startsWith(const String &prefix) const { return s_.rfind(prefix.s_, 0) == 0; }
+  bool endsWith(const String &suffix) const {
+    return s_.size() >= suffix.s_.size() && s_.compare(s_.size() - suffix.s_.size(), suffix.s_.size(), suffix.s_) == 0;
+  }
+  int indexOf(char c, unsigned from = 0) const {
+    const size_t at = s_.find(c, from);
+    return at == std::string::npos ? -1 : (int)at;
+  }
+  int indexOf(const String &text, unsigned from = 0) const {
+    const size_t at = s_.find(text.s_, from);
+    return at == std::string::npos ? -1 : (int)at;
+  }
+  String substring(unsigned from) const { return from < s_.size() ? String(s_.substr(from)) : String(); }
+  String substring(unsigned from, unsigned to) const {
+    if (from >= s_.size() || to <= from) return String();
+    return String(s_.substr(from, to - from));
+  }
+  long toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(s_.c_str(), nullptr); }
+
+  String &operator+=(const String &other) {
+    s_ += other.s_;
+    return *this;
+  }
+  String &operator+=(const char *text) {
+    s_ += text ? text : "";
+    return *this;
+  }
+  String &operator+=(char c) {
+    s_ += c;
+    return *this;
+  }
+  bool operator==(const String &other) const { return s_ == other.s_; }
+  bool operator==(const char *text) const { return s_ == (text ? text : ""); }
+  bool operator!=(const String &other) const { return s_ != other.s_; }
+  bool operator!=(const char *text) const { return !(*this == text); }
+  friend String operator+(String lhs, const String &rhs) { return lhs += rhs; }
+  friend String operator+(String lhs, const char *rhs) { return lhs += rhs; }
+  friend String operator+(String lhs, char rhs) { return lhs += rhs; }
+
+ private:
+  std::string s_;
+
+  template <typename... Args>
+  void format(const char *fmt, Args... args) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), fmt, args...);
+    s_ = buf;
+  }
+};
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *data, size_t len) {
+    size_t n = 0;
+    while (len--) n += write(*data++);
+    return n;
+  }
+  size_t write(const char *text) { return text ? write((const uint8_t *)text, strlen(text)) : 0; }
+  size_t write(const char *data, size_t len) { return write((const uint8_t *)data, len); }
+  virtual void flush() {}
+
+  size_t print(const char *text) { return write(text); }
+  size_t print(const String &text) { return write(text.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+  size_t print(unsigned value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+  size_t print(long value) { return print(String(value)); }
+  size_t print(unsigned long value) { return print(String(value)); }
+  size_t print(long long value) { return print(String(std::to_string(value))); }
+  size_t print(unsigned long long value) { return print(String(std::to_string(value))); }
+  size_t print(double value, int decimals = 2) { return print(String(value, (unsigned char)decimals)); }
+  template <typename T>
+  size_t println(const T &value) {
+    return print(value) + print('\n');
+  }
+  template <typename T>
+  size_t println(const T &value, int format) {
+    return print(value, format) + print('\n');
+  }
+  size_t println() { return print('\n'); }
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+#include <stdarg.h>
+
+inline size_t Print::printf(const char *fmt, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, fmt);
+  const int len = vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  if (len <= 0) return 0;
+  return write((const uint8_t *)buf, (size_t)len < sizeof(buf) ? (size_t)len : sizeof(buf) - 1);
+}
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  void setTimeout(unsigned long) {}
+  size_t readBytes(uint8_t *out, size_t len) {
+    size_t n = 0;
+    int c;
+    while (n < len && (c = read()) >= 0) out[n++] = (uint8_t)c;
+    return n;
+  }
+  size_t readBytes(char *out, size_t len) { return readBytes((uint8_t *)out, len); }
+  size_t readBytesUntil(char terminator, char *out, size_t len) {
+    size_t n = 0;
+    int c;
+    while (n < len && (c = read()) >= 0 && c != terminator) out[n++] = (char)c;
+    return n;
+  }
+  String readStringUntil(char terminator) {
+    std::string out;
+    int c;
+    while ((c = read()) >= 0 && c != terminator) out += (char)c;
+    return String(out);
+  }
+};
+
+// Serial output is kept so a suite can assert on what the firmware printed.
+class HostSerial : public Stream {
+ public:
+  std::string output;
+  std::string input;
+
+  void begin(unsigned long) {}
+  void end() {}
+  explicit operator bool() const { return true; }
+  using Print::write;
+  size_t write(uint8_t c) override {
+    output += (char)c;
+    return 1;
+  }
+  int available() override { return (int)input.size(); }
+  int read() override {
+    if (input.empty()) return -1;
+    const int c = (uint8_t)input[0];
+    input.erase(0, 1);
+    return c;
+  }
+  int peek() override { return input.empty() ? -1 : (uint8_t)input[0]; }
+};
+
+inline HostSerial Serial;
@@ -0,0 +1,74 @@
+#pragma once
+
+// DallasTemperature over the OneWire model. A probe reads 20 + rom[1] / 10
+// degrees unless host::dallasTempC has an entry for its ROM. Conversions
+// take the datasheet time for host::dallasBits; a read before that returns
+// the 85 degC power-on value and counts in host::dallasEarlyReads.
+
+#include <OneWire.h>
+
+#include <map>
+
+#define DEVICE_DISCONNECTED_C -127
+#define DS18S20MODEL 0x10
+#define DS18B20MODEL 0x28
+#define DS1822MODEL 0x22
+#define DS1825MODEL 0x3B
+
+typedef uint8_t DeviceAddress[8];
+
+namespace host {
+inline std::map<uint64_t, float> dallasTempC;
+inline uint32_t dallasConversions = 0;
+inline uint8_t dallasBits = 12;
+inline uint64_t dallasReadyAtUs = 0;
+inline uint64_t dallasLastReadUs = 0;
+inline uint32_t dallasEarlyReads = 0;
+}  // namespace host
+
+class DallasTemperature {
+ public:
+  explicit DallasTemperature(OneWire *bus) : bus_(bus) {}
+  void begin() {}
+  bool validFamily(const uint8_t *rom) {
+    return rom[0] == DS18S20MODEL || rom[0] == DS18B20MODEL || rom[0] == DS1822MODEL || rom[0] == DS1825MODEL;
+  }
+  bool setResolution(const uint8_t *, uint8_t bits, bool = false) {
+    host::dallasBits = bits;
+    return true;
+  }
+  void setWaitForConversion(bool wait) { wait_ = wait; }
+  void requestTemperatures() {
+    host::dallasConversions++;
+    host::dallasReadyAtUs = host::nowUs + millisToWaitForConversion(host::dallasBits) * 1000ULL;
+    if (wait_) delay(millisToWaitForConversion(host::dallasBits));
+  }
+  float getTempC(const uint8_t *rom) {
+    host::dallasLastReadUs = host::nowUs;
+    if (host::nowUs < host::dallasReadyAtUs) {
+      host::dallasEarlyReads++;
+      return 85.0f;
+    }
+    uint64_t key = 0;
+    for (uint8_t i = 0; i < 8; i++) key = (key << 8) | rom[i];
+    auto it = host::dallasTempC.find(key);
+    if (it != host::dallasTempC.end()) return it->second;
+    return 20.0f + rom[1] / 10.0f;
+  }
+  static uint16_t millisToWaitForConversion(uint8_t bits) {
+    switch (bits) {
+      case 9:
+        return 94;
+      case 10:
+        return 188;
+      case 11:
+        return 375;
+      default:
+        return 750;
+    }
+  }
+
+ private:
+  OneWire *bus_;
+  bool wait_ = true;
+};
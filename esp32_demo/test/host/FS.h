@@ -0,0 +1,138 @@
+#pragma once
+
+// In-memory fs::FS for the native test env. Every call that would reach
+// LittleFS on the device is counted in fs::stats, which is what the logger
+// benchmarks report per row.
+
+#include <Arduino.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct Stats {
+  uint32_t opens = 0;
+  uint32_t exists = 0;
+  uint32_t writes = 0;
+  uint32_t flushes = 0;
+  uint32_t removes = 0;
+  uint32_t renames = 0;
+  uint32_t calls() const { return opens + exists + writes + flushes + removes + renames; }
+};
+
+inline Stats stats;
+
+struct Blob {
+  std::vector<uint8_t> data;
+};
+
+class File : public Stream {
+ public:
+  File() {}
+  File(std::shared_ptr<Blob> blob, const std::string &path, bool append)
+      : blob_(blob), path_(path), append_(append) {}
+
+  explicit operator bool() const { return (bool)blob_; }
+
+  using Print::write;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *data, size_t len) override {
+    if (!blob_) return 0;
+    stats.writes++;
+    std::vector<uint8_t> &d = blob_->data;
+    if (append_) pos_ = d.size();
+    if (d.size() < pos_ + len) d.resize(pos_ + len);
+    memcpy(d.data() + pos_, data, len);
+    pos_ += len;
+    return len;
+  }
+  size_t read(uint8_t *out, size_t len) {
+    const size_t left = (size_t)available();
+    if (len > left) len = left;
+    if (len) memcpy(out, blob_->data.data() + pos_, len);
+    pos_ += len;
+    return len;
+  }
+  int read() override { return available() ? blob_->data[pos_++] : -1; }
+  int peek() override { return available() ? blob_->data[pos_] : -1; }
+  int available() override { return blob_ ? (int)(blob_->data.size() - pos_) : 0; }
+  void flush() override {
+    if (blob_) stats.flushes++;
+  }
+  bool seek(uint32_t pos, SeekMode mode = SeekSet) {
+    if (!blob_) return false;
+    size_t target = pos;
+    if (mode == SeekCur) target = pos_ + pos;
+    if (mode == SeekEnd) target = blob_->data.size() - pos;
+    if (target > blob_->data.size()) return false;
+    pos_ = target;
+    return true;
+  }
+  size_t position() const { return pos_; }
+  size_t size() const { return blob_ ? blob_->data.size() : 0; }
+  const char *name() const { return path_.c_str(); }
+  void close() { blob_.reset(); }
+
+ private:
+  std::shared_ptr<Blob> blob_;
+  std::string path_;
+  bool append_ = false;
+  size_t pos_ = 0;
+};
+
+class FS {
+ public:
+  std::map<std::string, std::shared_ptr<Blob>> files;
+
+  File open(const char *path, const char *mode = "r", bool create = false) {
+    stats.opens++;
+    const std::string key(path);
+    auto it = files.find(key);
+    if (mode[0] == 'r') {
+      if (it == files.end()) return File();
+      return File(it->second, key, false);
+    }
+    if (mode[0] == 'w' || it == files.end()) files[key] = std::make_shared<Blob>();
+    (void)create;
+    return File(files[key], key, mode[0] == 'a');
+  }
+  File open(const String &path, const char *mode = "r", bool create = false) {
+    return open(path.c_str(), mode, create);
+  }
+  bool exists(const char *path) {
+    stats.exists++;
+    return files.count(path) > 0;
+  }
+  bool exists(const String &path) { return exists(path.c_str()); }
+  bool remove(const char *path) {
+    stats.removes++;
+    return files.erase(path) > 0;
+  }
+  bool remove(const String &path) { return remove(path.c_str()); }
+  bool rename(const char *from, const char *to) {
+    stats.renames++;
+    auto it = files.find(from);
+    if (it == files.end()) return false;
+    std::shared_ptr<Blob> blob = it->second;
+    files.erase(it);
+    files[to] = blob;
+    return true;
+  }
+  bool rename(const String &from, const String &to) { return rename(from.c_str(), to.c_str()); }
+  bool mkdir(const char *) { return true; }
+  bool mkdir(const String &) { return true; }
+
+  std::string contents(const char *path) const {
+    auto it = files.find(path);
+    if (it == files.end()) return std::string();
+    return std::string(it->second->data.begin(), it->second->data.end());
+  }
+};
+
+}  // namespace fs
+
+using fs::File;
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <FS.h>
+
+class LittleFSFS : public fs::FS {
+ public:
+  size_t capacity = 1024 * 1024;
+
+  bool begin(bool formatOnFail = false, const char * = "/littlefs", uint8_t = 10, const char * = "spiffs") {
+    (void)formatOnFail;
+    return true;
+  }
+  void end() {}
+  bool format() {
+    files.clear();
+    return true;
+  }
+  size_t totalBytes() const { return capacity; }
+  size_t usedBytes() const {
+    size_t used = 0;
+    for (const auto &entry : files) used += entry.second->data.size();
+    return used;
+  }
+};
+
+inline LittleFSFS LittleFS;
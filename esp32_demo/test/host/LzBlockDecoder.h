@@ -0,0 +1,30 @@
+#pragma once
+
+// Reference LZSS decoder for the suites, the C++ twin of lzDecompress() in
+// app.js. Returns false on a truncated match or a distance before the start.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+inline bool lzBlockDecode(const uint8_t *in, size_t len, std::string &out) {
+  out.clear();
+  size_t i = 0;
+  while (i < len) {
+    const uint8_t flags = in[i++];
+    for (uint8_t bit = 0; bit < 8 && i < len; bit++) {
+      if (!(flags & (1U << bit))) {
+        out += (char)in[i++];
+        continue;
+      }
+      if (i + 1 >= len) return false;
+      const size_t distance = (in[i] | ((size_t)(in[i + 1] >> 5) << 8)) + 1;
+      const size_t length = (in[i + 1] & 0x1F) + 3;
+      i += 2;
+      if (distance > out.size()) return false;
+      for (size_t k = 0; k < length; k++) out += out[out.size() - distance];
+    }
+  }
+  return true;
+}
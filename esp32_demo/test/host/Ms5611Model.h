@@ -0,0 +1,105 @@
+#pragma once
+
+// MS5611 on the simulated bus, timed against host::nowUs. The PROM and ADC
+// values default to the datasheet example (20.07 degC, 1000.09 mbar).
+// Like the chip, an ADC read before the conversion ended returns 0, a
+// conversion command during one is ignored, and a result is read once.
+
+#include <Wire.h>
+
+class Ms5611Model : public I2cDevice {
+ public:
+  uint16_t prom[8] = {0, 40127, 36924, 23317, 23282, 33464, 28312, 0};
+  uint32_t d1 = 9085466;
+  uint32_t d2 = 8569150;
+  // Counters for the suites.
+  uint32_t conversions = 0;
+  uint32_t pressureResults = 0;
+  uint8_t lastConversion = 0;
+  uint32_t earlyReads = 0;
+  uint32_t ignoredCommands = 0;
+
+  Ms5611Model() { setCrc(); }
+
+  // AN520: the 4-bit CRC lives in the low nibble of the last word.
+  void setCrc(bool valid = true) {
+    prom[7] &= 0xFFF0;
+    const uint16_t crc = crc4(prom);
+    prom[7] |= valid ? crc : (uint16_t)((crc + 1) & 0x0F);
+  }
+
+  // Datasheet maximum conversion time for the OSR bits of a command.
+  static uint32_t conversionUs(uint8_t osrBits) {
+    static const uint32_t kUs[] = {600, 1170, 2280, 4540, 9040};
+    return kUs[(osrBits / 2) > 4 ? 4 : osrBits / 2];
+  }
+
+  bool converting() const { return pending_ != 0 && host::nowUs < readyAtUs_; }
+
+  void write(const uint8_t *data, size_t len) override {
+    if (len == 0) return;
+    const uint8_t cmd = data[0];
+    if (cmd != 0x00 && converting()) {
+      ignoredCommands++;
+      return;
+    }
+    if (cmd == 0x1E) {
+      pending_ = 0;
+      result_ = 0;
+      read_ = Read::None;
+    } else if ((cmd & 0xF0) == 0x40 || (cmd & 0xF0) == 0x50) {
+      pending_ = cmd;
+      lastConversion = cmd;
+      result_ = 0;
+      readyAtUs_ = host::nowUs + conversionUs(cmd & 0x0F);
+      conversions++;
+    } else if (cmd == 0x00) {
+      read_ = Read::Adc;
+    } else if ((cmd & 0xF0) == 0xA0) {
+      read_ = Read::Prom;
+      promIndex_ = (uint8_t)((cmd & 0x0F) / 2);
+    }
+  }
+
+  size_t read(uint8_t *out, size_t len) override {
+    if (read_ == Read::Prom) {
+      const uint16_t word = prom[promIndex_ & 7];
+      for (size_t i = 0; i < len; i++) out[i] = i == 0 ? (uint8_t)(word >> 8) : i == 1 ? (uint8_t)word : 0;
+      return len;
+    }
+    uint32_t value = 0;
+    if (read_ == Read::Adc) {
+      if (pending_ && host::nowUs >= readyAtUs_) {
+        result_ = (pending_ & 0xF0) == 0x40 ? d1 : d2;
+        if ((pending_ & 0xF0) == 0x40) pressureResults++;
+        pending_ = 0;
+      } else if (pending_) {
+        earlyReads++;
+      }
+      value = result_;
+      result_ = 0;
+    }
+    for (size_t i = 0; i < len; i++) out[i] = i < 3 ? (uint8_t)(value >> (8 * (2 - i))) : 0;
+    return len;
+  }
+
+ private:
+  enum class Read : uint8_t { None, Adc, Prom };
+  uint8_t pending_ = 0;
+  uint64_t readyAtUs_ = 0;
+  uint32_t result_ = 0;
+  Read read_ = Read::None;
+  uint8_t promIndex_ = 0;
+
+  static uint16_t crc4(const uint16_t *words) {
+    uint16_t rem = 0;
+    for (uint8_t i = 0; i < 16; i++) {
+      const uint16_t word = i >= 14 ? (uint16_t)(words[7] & 0xFF00) : words[i >> 1];
+      rem ^= (i & 1) ? (word & 0x00FF) : (word >> 8);
+      for (uint8_t bit = 0; bit < 8; bit++) {
+        rem = (rem & 0x8000) ? (uint16_t)((rem << 1) ^ 0x3000) : (uint16_t)(rem << 1);
+      }
+    }
+    return (uint16_t)((rem >> 12) & 0x000F);
+  }
+};
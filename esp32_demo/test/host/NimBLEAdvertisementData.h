@@ -0,0 +1,12 @@
+#pragma once
+
+#include <Arduino.h>
+
+class NimBLEAdvertisementData {
+ public:
+  bool setFlags(uint8_t) { return true; }
+  bool addServiceUUID(const char *) { return true; }
+  bool setPreferredParams(uint16_t, uint16_t) { return true; }
+  bool setName(const std::string &, bool = true) { return true; }
+  bool addTxPower() { return true; }
+};
@@ -0,0 +1,168 @@
+#pragma once
+
+// NimBLE server surface for the native test env. A suite plays the central
+// through the host::ble* helpers: connect, write a characteristic, read
+// back what the firmware notified.
+
+#include <Arduino.h>
+#include <NimBLEAdvertisementData.h>
+
+#include <map>
+#include <vector>
+
+#define ESP_PWR_LVL_P9 9
+
+namespace NIMBLE_PROPERTY {
+enum { READ = 0x02, WRITE_NR = 0x04, WRITE = 0x08, NOTIFY = 0x10, INDICATE = 0x20 };
+}
+
+class NimBLEAddress {
+ public:
+  std::string toString() const { return "a4:cf:12:00:be:ef"; }
+};
+
+class NimBLEConnInfo {
+ public:
+  uint16_t mtu = 23;
+  uint16_t getMTU() const { return mtu; }
+  uint16_t getConnHandle() const { return 1; }
+  NimBLEAddress getAddress() const { return NimBLEAddress(); }
+};
+
+class NimBLECharacteristic;
+
+class NimBLECharacteristicCallbacks {
+ public:
+  virtual ~NimBLECharacteristicCallbacks() {}
+  virtual void onWrite(NimBLECharacteristic *, NimBLEConnInfo &) {}
+  virtual void onRead(NimBLECharacteristic *, NimBLEConnInfo &) {}
+  virtual void onSubscribe(NimBLECharacteristic *, NimBLEConnInfo &, uint16_t) {}
+};
+
+namespace host {
+// Every notifyFailEvery-th notify() fails, as when the controller runs out
+// of buffers. 0 disables it.
+inline uint32_t notifyFailEvery = 0;
+inline uint32_t notifyCalls = 0;
+}  // namespace host
+
+class NimBLECharacteristic {
+ public:
+  std::string uuid;
+  std::string value;
+  // Payloads the central received, oldest first.
+  std::vector<std::string> notified;
+  NimBLECharacteristicCallbacks *callbacks = nullptr;
+
+  std::string getValue() const { return value; }
+  void setValue(const uint8_t *data, size_t len) { value.assign((const char *)data, len); }
+  void setValue(const std::string &text) { value = text; }
+  void setValue(const char *text) { value = text ? text : ""; }
+  void setCallbacks(NimBLECharacteristicCallbacks *cb) { callbacks = cb; }
+  bool notify(bool = true) {
+    host::notifyCalls++;
+    if (host::notifyFailEvery && host::notifyCalls % host::notifyFailEvery == 0) return false;
+    notified.push_back(value);
+    return true;
+  }
+};
+
+class NimBLEService {
+ public:
+  NimBLECharacteristic *createCharacteristic(const char *uuid, uint32_t, uint16_t = 512);
+  bool start() { return true; }
+};
+
+class NimBLEServer;
+
+class NimBLEServerCallbacks {
+ public:
+  virtual ~NimBLEServerCallbacks() {}
+  virtual void onConnect(NimBLEServer *, NimBLEConnInfo &) {}
+  virtual void onDisconnect(NimBLEServer *, NimBLEConnInfo &, int) {}
+  virtual void onMTUChange(uint16_t, NimBLEConnInfo &) {}
+};
+
+namespace host {
+inline NimBLEServer *bleServer = nullptr;
+inline NimBLEServerCallbacks *bleServerCallbacks = nullptr;
+inline std::map<std::string, NimBLECharacteristic *> bleCharacteristics;
+inline uint8_t bleConnected = 0;
+inline uint16_t bleMtu = 185;
+}  // namespace host
+
+inline NimBLECharacteristic *NimBLEService::createCharacteristic(const char *uuid, uint32_t, uint16_t) {
+  NimBLECharacteristic *chr = new NimBLECharacteristic();
+  chr->uuid = uuid;
+  host::bleCharacteristics[uuid] = chr;
+  return chr;
+}
+
+class NimBLEServer {
+ public:
+  void setCallbacks(NimBLEServerCallbacks *cb) { host::bleServerCallbacks = cb; }
+  NimBLEService *createService(const char *) { return new NimBLEService(); }
+  uint8_t getConnectedCount() const { return host::bleConnected; }
+  bool updateConnParams(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t) const { return true; }
+};
+
+class NimBLEAdvertising {
+ public:
+  void setMinInterval(uint16_t) {}
+  void setMaxInterval(uint16_t) {}
+  bool setAdvertisementData(const NimBLEAdvertisementData &) { return true; }
+  bool setScanResponseData(const NimBLEAdvertisementData &) { return true; }
+  void enableScanResponse(bool) {}
+  bool start() { return true; }
+};
+
+class NimBLEDevice {
+ public:
+  static bool init(const std::string &) { return true; }
+  static bool deinit(bool = false) { return true; }
+  static bool setMTU(uint16_t) { return true; }
+  static uint16_t getMTU() { return host::bleMtu; }
+  static bool setPower(int) { return true; }
+  static NimBLEAddress getAddress() { return NimBLEAddress(); }
+  static bool setDeviceName(const std::string &) { return true; }
+  static NimBLEServer *createServer() { return host::bleServer = new NimBLEServer(); }
+  static NimBLEAdvertising *getAdvertising() {
+    static NimBLEAdvertising advertising;
+    return &advertising;
+  }
+  static bool startAdvertising() { return true; }
+  static bool stopAdvertising() { return true; }
+};
+
+namespace host {
+inline NimBLECharacteristic *bleCharacteristic(const char *uuid) {
+  auto it = bleCharacteristics.find(uuid);
+  return it == bleCharacteristics.end() ? nullptr : it->second;
+}
+inline void bleConnect(uint16_t mtu) {
+  bleConnected++;
+  bleMtu = mtu;
+  NimBLEConnInfo info;
+  info.mtu = mtu;
+  if (bleServerCallbacks) bleServerCallbacks->onConnect(bleServer, info);
+}
+inline void bleDisconnect(int reason = 0x13) {
+  if (bleConnected) bleConnected--;
+  NimBLEConnInfo info;
+  if (bleServerCallbacks) bleServerCallbacks->onDisconnect(bleServer, info, reason);
+}
+inline void bleSubscribe(const char *uuid) {
+  NimBLECharacteristic *chr = bleCharacteristic(uuid);
+  NimBLEConnInfo info;
+  info.mtu = bleMtu;
+  if (chr && chr->callbacks) chr->callbacks->onSubscribe(chr, info, 1);
+}
+inline void bleWrite(const char *uuid, const std::string &value) {
+  NimBLECharacteristic *chr = bleCharacteristic(uuid);
+  if (!chr) return;
+  chr->setValue(value);
+  NimBLEConnInfo info;
+  info.mtu = bleMtu;
+  if (chr->callbacks) chr->callbacks->onWrite(chr, info);
+}
+}  // namespace host
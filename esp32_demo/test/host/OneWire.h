@@ -0,0 +1,46 @@
+#pragma once
+
+// 1-Wire bus model: host::oneWireRoms lists the ROMs a search returns,
+// in order, CRC byte included.
+
+#include <Arduino.h>
+
+#include <array>
+#include <vector>
+
+namespace host {
+inline std::vector<std::array<uint8_t, 8>> oneWireRoms;
+inline uint32_t oneWireSearches = 0;
+}  // namespace host
+
+class OneWire {
+ public:
+  explicit OneWire(uint8_t pin) : pin_(pin) {}
+  uint8_t reset() { return host::oneWireRoms.empty() ? 0 : 1; }
+  void reset_search() {
+    next_ = 0;
+    host::oneWireSearches++;
+  }
+  bool search(uint8_t *rom, bool = true) {
+    if (next_ >= host::oneWireRoms.size()) return false;
+    memcpy(rom, host::oneWireRoms[next_++].data(), 8);
+    return true;
+  }
+  static uint8_t crc8(const uint8_t *addr, uint8_t len) {
+    uint8_t crc = 0;
+    while (len--) {
+      uint8_t byte = *addr++;
+      for (uint8_t i = 8; i; i--) {
+        const uint8_t mix = (crc ^ byte) & 0x01;
+        crc >>= 1;
+        if (mix) crc ^= 0x8C;
+        byte >>= 1;
+      }
+    }
+    return crc;
+  }
+
+ private:
+  uint8_t pin_;
+  size_t next_ = 0;
+};
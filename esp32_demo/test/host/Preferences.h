@@ -0,0 +1,77 @@
+#pragma once
+
+// NVS in RAM. host::nvs outlives Preferences objects, so it survives a
+// simulated reboot the way flash would.
+
+#include <Arduino.h>
+
+#include <map>
+
+namespace host {
+inline std::map<std::string, std::string> nvs;
+}  // namespace host
+
+class Preferences {
+ public:
+  bool begin(const char *name, bool readOnly = false) {
+    (void)readOnly;
+    ns_ = name;
+    return true;
+  }
+  void end() {}
+  bool isKey(const char *key) { return host::nvs.count(path(key)) > 0; }
+  bool remove(const char *key) { return host::nvs.erase(path(key)) > 0; }
+  bool clear() {
+    for (auto it = host::nvs.begin(); it != host::nvs.end();) {
+      it = it->first.rfind(ns_ + "/", 0) == 0 ? host::nvs.erase(it) : std::next(it);
+    }
+    return true;
+  }
+
+  size_t putBytes(const char *key, const void *data, size_t len) {
+    host::nvs[path(key)].assign((const char *)data, len);
+    return len;
+  }
+  size_t getBytesLength(const char *key) {
+    auto it = host::nvs.find(path(key));
+    return it == host::nvs.end() ? 0 : it->second.size();
+  }
+  size_t getBytes(const char *key, void *out, size_t len) {
+    auto it = host::nvs.find(path(key));
+    if (it == host::nvs.end() || it->second.size() > len) return 0;
+    memcpy(out, it->second.data(), it->second.size());
+    return it->second.size();
+  }
+
+  size_t putString(const char *key, const char *value) { return putBytes(key, value, strlen(value)); }
+  size_t putString(const char *key, const String &value) { return putString(key, value.c_str()); }
+  String getString(const char *key, const String &fallback = String()) {
+    auto it = host::nvs.find(path(key));
+    return it == host::nvs.end() ? fallback : String(it->second);
+  }
+
+  size_t putBool(const char *key, bool value) { return putValue(key, (uint8_t)value); }
+  bool getBool(const char *key, bool fallback = false) { return getValue(key, (uint8_t)fallback) != 0; }
+  size_t putUChar(const char *key, uint8_t value) { return putValue(key, value); }
+  uint8_t getUChar(const char *key, uint8_t fallback = 0) { return getValue(key, fallback); }
+  size_t putInt(const char *key, int32_t value) { return putValue(key, value); }
+  int32_t getInt(const char *key, int32_t fallback = 0) { return getValue(key, fallback); }
+  size_t putUInt(const char *key, uint32_t value) { return putValue(key, value); }
+  uint32_t getUInt(const char *key, uint32_t fallback = 0) { return getValue(key, fallback); }
+  size_t putULong64(const char *key, uint64_t value) { return putValue(key, value); }
+  uint64_t getULong64(const char *key, uint64_t fallback = 0) { return getValue(key, fallback); }
+
+ private:
+  std::string ns_;
+
+  std::string path(const char *key) const { return ns_ + "/" + key; }
+  template <typename T>
+  size_t putValue(const char *key, T value) {
+    return putBytes(key, &value, sizeof(value));
+  }
+  template <typename T>
+  T getValue(const char *key, T fallback) {
+    T value;
+    return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : fallback;
+  }
+};
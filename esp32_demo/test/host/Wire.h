@@ -0,0 +1,111 @@
+#pragma once
+
+// TwoWire over a map of simulated devices. An address with no device, or
+// whose device cannot follow the current clock, does not ACK.
+
+#include <Arduino.h>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+class I2cDevice {
+ public:
+  virtual ~I2cDevice() {}
+  // Highest SCL rate the device (and its wiring) still answers at.
+  uint32_t maxHz = 1000000;
+  virtual void write(const uint8_t *data, size_t len) = 0;
+  virtual size_t read(uint8_t *out, size_t len) = 0;
+};
+
+// Byte-addressed register file: a write sets the register pointer and
+// stores any following bytes, a read streams from the pointer.
+class I2cRegisterDevice : public I2cDevice {
+ public:
+  uint8_t regs[256] = {};
+  uint8_t pointer = 0;
+  void write(const uint8_t *data, size_t len) override {
+    if (len == 0) return;
+    pointer = data[0];
+    for (size_t i = 1; i < len; i++) regs[(uint8_t)(pointer + i - 1)] = data[i];
+  }
+  size_t read(uint8_t *out, size_t len) override {
+    for (size_t i = 0; i < len; i++) out[i] = regs[(uint8_t)(pointer + i)];
+    return len;
+  }
+};
+
+namespace host {
+inline std::map<uint8_t, I2cDevice *> i2cDevices;
+// Every address put on the bus, in order.
+inline std::vector<uint8_t> i2cAddressed;
+}  // namespace host
+
+class TwoWire : public Stream {
+ public:
+  bool begin(int sda = -1, int scl = -1, uint32_t hz = 0) {
+    (void)sda;
+    (void)scl;
+    if (hz) hz_ = hz;
+    return true;
+  }
+  bool end() { return true; }
+  bool setClock(uint32_t hz) {
+    hz_ = hz;
+    return true;
+  }
+  uint32_t getClock() const { return hz_; }
+  void setTimeOut(uint16_t) {}
+
+  void beginTransmission(uint8_t address) {
+    address_ = address;
+    tx_.clear();
+  }
+  uint8_t endTransmission(bool stop = true) {
+    (void)stop;
+    I2cDevice *device = answering(address_);
+    if (!device) return 2;
+    device->write(tx_.data(), tx_.size());
+    return 0;
+  }
+  uint8_t requestFrom(uint8_t address, size_t len, bool stop = true) {
+    (void)stop;
+    rx_.clear();
+    I2cDevice *device = answering(address);
+    if (!device) return 0;
+    std::vector<uint8_t> data(len);
+    const size_t got = device->read(data.data(), len);
+    rx_.insert(rx_.end(), data.begin(), data.begin() + got);
+    return (uint8_t)got;
+  }
+  uint8_t requestFrom(int address, int len) { return requestFrom((uint8_t)address, (size_t)len); }
+
+  using Print::write;
+  size_t write(uint8_t c) override {
+    tx_.push_back(c);
+    return 1;
+  }
+  int available() override { return (int)rx_.size(); }
+  int read() override {
+    if (rx_.empty()) return -1;
+    const int c = rx_.front();
+    rx_.pop_front();
+    return c;
+  }
+  int peek() override { return rx_.empty() ? -1 : rx_.front(); }
+
+ private:
+  uint32_t hz_ = 100000;
+  uint8_t address_ = 0;
+  std::vector<uint8_t> tx_;
+  std::deque<uint8_t> rx_;
+
+  I2cDevice *answering(uint8_t address) {
+    host::i2cAddressed.push_back(address);
+    auto it = host::i2cDevices.find(address);
+    if (it == host::i2cDevices.end() || hz_ > it->second->maxHz) return nullptr;
+    return it->second;
+  }
+};
+
+inline TwoWire Wire;
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "esp_timer.h"
+
+typedef int gpio_num_t;
+typedef enum { GPIO_INTR_LOW_LEVEL = 4, GPIO_INTR_HIGH_LEVEL = 5 } gpio_int_type_t;
+
+inline esp_err_t gpio_wakeup_enable(gpio_num_t, gpio_int_type_t) { return ESP_OK; }
+inline esp_err_t gpio_wakeup_disable(gpio_num_t) { return ESP_OK; }
+inline esp_err_t gpio_intr_enable(gpio_num_t) { return ESP_OK; }
+inline esp_err_t gpio_intr_disable(gpio_num_t) { return ESP_OK; }
+inline esp_err_t gpio_pullup_en(gpio_num_t) { return ESP_OK; }
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "esp_timer.h"
+
+#ifndef ESP_IDF_VERSION_MAJOR
+#define ESP_IDF_VERSION_MAJOR 5
+#endif
+
+typedef struct {
+  int max_freq_mhz;
+  int min_freq_mhz;
+  bool light_sleep_enable;
+} esp_pm_config_t;
+typedef esp_pm_config_t esp_pm_config_esp32c3_t;
+typedef void *esp_pm_lock_handle_t;
+typedef enum { ESP_PM_CPU_FREQ_MAX, ESP_PM_APB_FREQ_MAX, ESP_PM_NO_LIGHT_SLEEP } esp_pm_lock_type_t;
+
+namespace host {
+inline bool lightSleepEnabled = false;
+inline int noSleepLocks = 0;
+// What esp_pm_configure() returns; anything but ESP_OK leaves PM as it was,
+// like an sdkconfig without CONFIG_PM_ENABLE.
+inline esp_err_t pmConfigureResult = ESP_OK;
+}  // namespace host
+
+inline esp_err_t esp_pm_configure(const void *config) {
+  if (host::pmConfigureResult != ESP_OK) return host::pmConfigureResult;
+  host::lightSleepEnabled = ((const esp_pm_config_t *)config)->light_sleep_enable;
+  return ESP_OK;
+}
+inline esp_err_t esp_pm_lock_create(esp_pm_lock_type_t, int, const char *, esp_pm_lock_handle_t *handle) {
+  *handle = (esp_pm_lock_handle_t)1;
+  return ESP_OK;
+}
+inline esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t) {
+  host::noSleepLocks++;
+  return ESP_OK;
+}
+inline esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t) {
+  host::noSleepLocks--;
+  return ESP_OK;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "esp_timer.h"
+
+typedef enum {
+  ESP_SLEEP_WAKEUP_UNDEFINED,
+  ESP_SLEEP_WAKEUP_TIMER = 4,
+  ESP_SLEEP_WAKEUP_GPIO = 7,
+} esp_sleep_wakeup_cause_t;
+typedef enum { ESP_GPIO_WAKEUP_GPIO_LOW, ESP_GPIO_WAKEUP_GPIO_HIGH } esp_deepsleep_gpio_wake_up_mode_t;
+
+namespace host {
+// esp_deep_sleep_start() throws this so a suite can catch the reset and
+// boot the firmware again, as the chip would after the timer fires.
+struct DeepSleep {
+  uint64_t wakeAfterUs;
+};
+inline esp_sleep_wakeup_cause_t wakeupCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+inline uint64_t sleepTimerUs = 0;
+}  // namespace host
+
+inline esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() { return host::wakeupCause; }
+inline esp_err_t esp_sleep_enable_timer_wakeup(uint64_t us) {
+  host::sleepTimerUs = us;
+  return ESP_OK;
+}
+inline esp_err_t esp_sleep_enable_gpio_wakeup() { return ESP_OK; }
+inline esp_err_t esp_deep_sleep_enable_gpio_wakeup(uint64_t, esp_deepsleep_gpio_wake_up_mode_t) { return ESP_OK; }
+[[noreturn]] inline void esp_deep_sleep_start() { throw host::DeepSleep{host::sleepTimerUs}; }
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+inline int esp_reset_reason() { return 1; }
+inline uint32_t esp_random() { return (uint32_t)rand(); }
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <vector>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NOT_SUPPORTED 0x106
+
+typedef void (*esp_timer_cb_t)(void *arg);
+typedef enum { ESP_TIMER_TASK } esp_timer_dispatch_t;
+typedef struct {
+  esp_timer_cb_t callback;
+  void *arg;
+  esp_timer_dispatch_t dispatch_method;
+  const char *name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+// Periodic timers only; they fire while the loop task waits
+// (ulTaskNotifyTake in freertos/task.h).
+struct esp_timer {
+  esp_timer_cb_t callback = nullptr;
+  void *arg = nullptr;
+  uint64_t periodUs = 0;  // 0: stopped
+  uint64_t nextUs = 0;
+};
+typedef struct esp_timer *esp_timer_handle_t;
+
+namespace host {
+inline std::vector<esp_timer *> espTimers;
+}  // namespace host
+
+inline int64_t esp_timer_get_time() { return (int64_t)host::nowUs; }
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out) {
+  esp_timer *timer = new esp_timer;
+  timer->callback = args->callback;
+  timer->arg = args->arg;
+  host::espTimers.push_back(timer);
+  *out = timer;
+  return ESP_OK;
+}
+inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs) {
+  if (!timer || !periodUs) return ESP_FAIL;
+  timer->periodUs = periodUs;
+  timer->nextUs = host::nowUs + periodUs;
+  return ESP_OK;
+}
+inline esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  if (!timer || !timer->periodUs) return ESP_FAIL;
+  timer->periodUs = 0;
+  return ESP_OK;
+}
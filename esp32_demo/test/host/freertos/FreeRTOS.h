@@ -0,0 +1,23 @@
+#pragma once
+
+// FreeRTOS surface for the native test env. Most firmware suites build with
+// USE_TASK_PIPELINE=0 and only use the loop task's notification wait;
+// test_fw_pipeline starts the pipeline tasks, which task.h runs one at a
+// time in priority order.
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef void *TaskHandle_t;
+typedef void *SemaphoreHandle_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xffffffffu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portYIELD_FROM_ISR(woken) (void)(woken)
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+// Recursive mutexes with ownership: a task that finds one held blocks until
+// the holder gives it back, which then switches to the waiter if it has the
+// higher priority.
+inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return new host::Mutex; }
+inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t handle, TickType_t) {
+  host::Mutex *m = (host::Mutex *)handle;
+  host::Task *self = host::currentTask;
+  if (m->depth && m->owner != self) {
+    // The loop task only runs while every task is blocked; one blocked on
+    // a mutex it holds would never give it back.
+    if (!self) {
+      fprintf(stderr, "host: loop task blocked on a mutex held by a blocked task\n");
+      abort();
+    }
+    self->waitingOn = m;
+    self->state = host::Task::WAIT_MUTEX;
+    host::blockCurrent();
+    self->waitingOn = nullptr;
+  }
+  m->owner = self;
+  m->depth++;
+  return pdTRUE;
+}
+inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t handle) {
+  host::Mutex *m = (host::Mutex *)handle;
+  if (!m->depth || m->owner != host::currentTask) return pdFALSE;
+  if (--m->depth == 0) {
+    m->owner = nullptr;
+    host::runReadyTasks(host::currentPriority());
+  }
+  return pdTRUE;
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+
+namespace host {
+// Notifications given to the loop task and not yet taken.
+inline uint32_t loopNotifications = 0;
+// Time spent blocked in ulTaskNotifyTake().
+inline uint64_t blockedUs = 0;
+// Called once when a wait reaches waitEventAtUs, like an interrupt or the
+// BLE host task would be; it may notify the loop to end the wait early.
+inline void (*waitEvent)() = nullptr;
+inline uint64_t waitEventAtUs = 0;
+
+// Tasks from xTaskCreate() run on their own threads, one at a time: a
+// single baton stands for the CPU. A notify or a released mutex switches
+// to a higher-priority task at once and the caller resumes when it blocks
+// again, like a preemptive single-core scheduler. Lower-priority tasks run
+// while the loop task waits, which is also when esp_timer callbacks fire.
+static const UBaseType_t LOOP_TASK_PRIORITY = 1;
+
+struct Mutex {
+  struct Task *owner = nullptr;  // nullptr with depth > 0: the loop task
+  uint32_t depth = 0;
+};
+
+struct Task {
+  enum State { READY, RUNNING, WAIT_NOTIFY, WAIT_MUTEX, DELETED };
+  TaskFunction_t fn = nullptr;
+  void *arg = nullptr;
+  const char *name = "";
+  UBaseType_t priority = 0;
+  State state = READY;
+  uint32_t notifications = 0;
+  Mutex *waitingOn = nullptr;
+  Task *resumeTo = nullptr;
+};
+
+inline std::vector<Task *> tasks;
+inline Task *currentTask = nullptr;  // nullptr: the loop task
+inline Task *baton = nullptr;
+
+// Never destroyed: task threads stay blocked on them at exit.
+inline std::mutex &batonMutex() {
+  static std::mutex *m = new std::mutex;
+  return *m;
+}
+inline std::condition_variable &batonCv() {
+  static std::condition_variable *cv = new std::condition_variable;
+  return *cv;
+}
+
+inline Task *findTask(void *handle) {
+  for (Task *t : tasks) {
+    if (t == handle) return t;
+  }
+  return nullptr;
+}
+
+inline UBaseType_t currentPriority() { return currentTask ? currentTask->priority : LOOP_TASK_PRIORITY; }
+
+inline bool taskReady(const Task *t) {
+  switch (t->state) {
+    case Task::READY: return true;
+    case Task::WAIT_NOTIFY: return t->notifications > 0;
+    case Task::WAIT_MUTEX: return t->waitingOn->depth == 0;
+    default: return false;
+  }
+}
+
+// Runs t until it blocks again.
+inline void switchTo(Task *t) {
+  std::unique_lock<std::mutex> lock(batonMutex());
+  Task *self = currentTask;
+  t->resumeTo = self;
+  t->state = Task::RUNNING;
+  currentTask = t;
+  baton = t;
+  batonCv().notify_all();
+  batonCv().wait(lock, [&] { return baton == self; });
+  currentTask = self;
+}
+
+// Called on a task's own thread once it has set its wait state.
+inline void blockCurrent() {
+  Task *self = currentTask;
+  std::unique_lock<std::mutex> lock(batonMutex());
+  baton = self->resumeTo;
+  batonCv().notify_all();
+  batonCv().wait(lock, [&] { return baton == self; });
+}
+
+// Runs every ready task above minPriority, highest first.
+inline void runReadyTasks(UBaseType_t minPriority) {
+  for (;;) {
+    Task *best = nullptr;
+    for (Task *t : tasks) {
+      if (t->priority > minPriority && taskReady(t) && (!best || t->priority > best->priority)) best = t;
+    }
+    if (!best) return;
+    switchTo(best);
+  }
+}
+
+inline void taskThread(Task *t) {
+  {
+    std::unique_lock<std::mutex> lock(batonMutex());
+    batonCv().wait(lock, [&] { return baton == t; });
+  }
+  t->fn(t->arg);
+  t->state = Task::DELETED;
+  blockCurrent();
+}
+
+inline esp_timer *nextEspTimer() {
+  esp_timer *next = nullptr;
+  for (esp_timer *timer : espTimers) {
+    if (timer->periodUs && (!next || timer->nextUs < next->nextUs)) next = timer;
+  }
+  return next;
+}
+}  // namespace host
+
+inline BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t, void *arg, UBaseType_t priority,
+                              TaskHandle_t *handle) {
+  host::Task *t = new host::Task;
+  t->fn = fn;
+  t->arg = arg;
+  t->name = name;
+  t->priority = priority;
+  host::tasks.push_back(t);
+  if (handle) *handle = t;
+  std::thread(host::taskThread, t).detach();
+  host::runReadyTasks(host::currentPriority());
+  return pdPASS;
+}
+inline void vTaskDelete(TaskHandle_t handle) {
+  host::Task *t = handle ? host::findTask(handle) : host::currentTask;
+  if (!t) return;
+  t->state = host::Task::DELETED;
+  if (t == host::currentTask) {
+    for (;;) host::blockCurrent();
+  }
+}
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return host::currentTask ? (TaskHandle_t)host::currentTask : (TaskHandle_t)1;
+}
+inline void vTaskDelay(TickType_t ticks) { delay(ticks); }
+inline BaseType_t xTaskNotifyGive(TaskHandle_t handle) {
+  host::Task *t = host::findTask(handle);
+  if (!t) {
+    host::loopNotifications++;
+    return pdPASS;
+  }
+  t->notifications++;
+  host::runReadyTasks(host::currentPriority());
+  return pdPASS;
+}
+inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) {
+  xTaskNotifyGive(task);
+  if (woken) *woken = pdTRUE;
+}
+// Tasks wait for a notification for as long as it takes. The loop task's
+// wait runs the simulated clock: host::waitEvent and esp_timer callbacks
+// fire at their times, and a notification ends the wait early.
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+  if (host::currentTask) {
+    host::Task *self = host::currentTask;
+    if (!self->notifications) {
+      self->state = host::Task::WAIT_NOTIFY;
+      host::blockCurrent();
+    }
+    const uint32_t count = self->notifications;
+    self->notifications = clearOnExit ? 0 : count - 1;
+    return count;
+  }
+  const uint64_t endUs = ticks == portMAX_DELAY ? UINT64_MAX : host::nowUs + ticks * 1000ULL;
+  host::runReadyTasks(0);
+  while (!host::loopNotifications) {
+    uint64_t atUs = endUs;
+    esp_timer *timer = nullptr;
+    if (host::waitEvent) {
+      const uint64_t eventUs = host::waitEventAtUs > host::nowUs ? host::waitEventAtUs : host::nowUs;
+      if (eventUs < atUs) atUs = eventUs;
+    }
+    esp_timer *next = host::nextEspTimer();
+    if (next) {
+      const uint64_t timerUs = next->nextUs > host::nowUs ? next->nextUs : host::nowUs;
+      if (timerUs < atUs) {
+        atUs = timerUs;
+        timer = next;
+      }
+    }
+    if (atUs == UINT64_MAX) break;
+    host::blockedUs += atUs - host::nowUs;
+    host::nowUs = atUs;
+    if (timer) {
+      while (timer->nextUs <= host::nowUs) timer->nextUs += timer->periodUs;
+      timer->callback(timer->arg);
+    } else if (host::waitEvent && atUs < endUs) {
+      void (*event)() = host::waitEvent;
+      host::waitEvent = nullptr;
+      event();
+    } else {
+      break;
+    }
+    host::runReadyTasks(0);
+  }
+  if (host::loopNotifications) {
+    const uint32_t count = host::loopNotifications;
+    host::loopNotifications = clearOnExit ? 0 : count - 1;
+    return count;
+  }
+  return 0;
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// ESP32-C3 wakes from deep sleep on a GPIO level.
+#define SOC_GPIO_SUPPORT_DEEPSLEEP_WAKEUP 1
@@ -0,0 +1,67 @@
+#include <BufferedFile.h>
+#include <unity.h>
+
+#include <string>
+
+static fs::FS *storage;
+
+void setUp(void) {
+  storage = new fs::FS();
+  fs::stats = fs::Stats();
+  host::nowUs = 0;
+}
+
+void tearDown(void) { delete storage; }
+
+static bool put(BufferedFile &out, const std::string &data) {
+  return out.write((const uint8_t *)data.data(), data.size());
+}
+
+static void test_unbuffered_writes_go_straight_through(void) {
+  BufferedFile out;
+  TEST_ASSERT_TRUE(out.open(*storage, "/f"));
+  TEST_ASSERT_FALSE(out.buffered());
+  TEST_ASSERT_TRUE(put(out, "abc"));
+  TEST_ASSERT_EQUAL_STRING("abc", storage->contents("/f").c_str());
+  TEST_ASSERT_EQUAL(3, out.size());
+}
+
+static void test_buffered_batches_and_writes_oversize_through(void) {
+  BufferedFile out;
+  TEST_ASSERT_TRUE(out.setBuffer(8, 1000));
+  TEST_ASSERT_TRUE(out.open(*storage, "/f"));
+  TEST_ASSERT_TRUE(put(out, "12345"));
+  TEST_ASSERT_EQUAL_STRING("", storage->contents("/f").c_str());
+  TEST_ASSERT_EQUAL(5, out.size());
+  // Pending bytes go out first, then the write that is larger than the buffer.
+  TEST_ASSERT_TRUE(put(out, "abcdefghij"));
+  TEST_ASSERT_EQUAL_STRING("12345abcdefghij", storage->contents("/f").c_str());
+  TEST_ASSERT_TRUE(put(out, "xy"));
+  out.close();
+  TEST_ASSERT_EQUAL_STRING("12345abcdefghijxy", storage->contents("/f").c_str());
+  TEST_ASSERT_FALSE(out.isOpen());
+}
+
+static void test_poll_flushes_the_oldest_byte_at_max_age(void) {
+  BufferedFile out;
+  out.setBuffer(64, 1000);
+  out.open(*storage, "/f");
+  put(out, "a");
+  host::advanceMs(600);
+  put(out, "b");
+  host::advanceMs(399);
+  TEST_ASSERT_TRUE(out.poll());
+  TEST_ASSERT_EQUAL_STRING("", storage->contents("/f").c_str());
+  host::advanceMs(1);
+  TEST_ASSERT_TRUE(out.poll());
+  TEST_ASSERT_EQUAL_STRING("ab", storage->contents("/f").c_str());
+  TEST_ASSERT_EQUAL(1, fs::stats.flushes);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_unbuffered_writes_go_straight_through);
+  RUN_TEST(test_buffered_batches_and_writes_oversize_through);
+  RUN_TEST(test_poll_flushes_the_oldest_byte_at_max_age);
+  return UNITY_END();
+}
@@ -0,0 +1,129 @@
+#include <CsvLogger.h>
+#include <unity.h>
+
+static const char *HEADER =
+    "date,temperature,humidity,pressure,iaq,accuracy,voc,eqco2,gas_kohm,generic,sensor,address";
+static const char *ROW = "14/11/23 10:00:00,21.480,,1013.250,,,,,,,bmp280,0x76";
+
+static fs::FS *storage;
+
+void setUp(void) {
+  storage = new fs::FS();
+  fs::stats = fs::Stats();
+  host::nowUs = 0;
+}
+
+void tearDown(void) { delete storage; }
+
+static std::string expectedFile(size_t rows) {
+  std::string out = std::string(HEADER) + "\n";
+  for (size_t i = 0; i < rows; i++) out += std::string(ROW) + "\n";
+  return out;
+}
+
+static void test_unbuffered_writes_header_and_rows(void) {
+  CsvLogger log(*storage, "/log.csv", HEADER);
+  TEST_ASSERT_TRUE(log.appendLine(ROW));
+  TEST_ASSERT_TRUE(log.appendLine(ROW));
+  TEST_ASSERT_EQUAL_STRING(expectedFile(2).c_str(), storage->contents("/log.csv").c_str());
+}
+
+static void test_buffered_checks_header_once_and_keeps_one_handle(void) {
+  CsvLogger log(*storage, "/log.csv", HEADER);
+  TEST_ASSERT_TRUE(log.setBuffered(1024, 15000));
+  TEST_ASSERT_TRUE(log.begin());
+  const uint32_t opensAfterBegin = fs::stats.opens;
+  for (int i = 0; i < 10; i++) TEST_ASSERT_TRUE(log.appendLine(ROW));
+  TEST_ASSERT_EQUAL(opensAfterBegin, fs::stats.opens);
+  TEST_ASSERT_EQUAL_STRING(expectedFile(0).c_str(), storage->contents("/log.csv").c_str());
+  TEST_ASSERT_EQUAL(expectedFile(10).size(), log.size());
+  TEST_ASSERT_TRUE(log.flush());
+  TEST_ASSERT_EQUAL_STRING(expectedFile(10).c_str(), storage->contents("/log.csv").c_str());
+}
+
+static void test_buffered_flushes_when_full(void) {
+  CsvLogger log(*storage, "/log.csv", HEADER);
+  const size_t rowBytes = strlen(ROW) + 1;
+  log.setBuffered(rowBytes * 4, 60000);
+  for (int i = 0; i < 5; i++) log.appendLine(ROW);
+  // The fifth row did not fit: the first four were written, one is pending.
+  TEST_ASSERT_EQUAL_STRING(expectedFile(4).c_str(), storage->contents("/log.csv").c_str());
+  log.end();
+  TEST_ASSERT_EQUAL_STRING(expectedFile(5).c_str(), storage->contents("/log.csv").c_str());
+}
+
+static void test_buffered_flushes_by_age(void) {
+  CsvLogger log(*storage, "/log.csv", HEADER);
+  log.setBuffered(1024, 15000);
+  log.appendLine(ROW);
+  host::advanceMs(14999);
+  TEST_ASSERT_TRUE(log.poll());
+  TEST_ASSERT_EQUAL_STRING(expectedFile(0).c_str(), storage->contents("/log.csv").c_str());
+  host::advanceMs(1);
+  TEST_ASSERT_TRUE(log.poll());
+  TEST_ASSERT_EQUAL_STRING(expectedFile(1).c_str(), storage->contents("/log.csv").c_str());
+}
+
+static void test_row_larger_than_buffer_goes_straight_to_file(void) {
+  CsvLogger log(*storage, "/log.csv", HEADER);
+  log.setBuffered(16, 15000);
+  TEST_ASSERT_TRUE(log.appendLine(ROW));
+  log.end();
+  TEST_ASSERT_EQUAL_STRING(expectedFile(1).c_str(), storage->contents("/log.csv").c_str());
+}
+
+static void test_headerless_file_is_repaired_once(void) {
+  {
+    File f = storage->open("/log.csv", "w");
+    f.print(ROW);
+    f.print('\n');
+  }
+  CsvLogger log(*storage, "/log.csv", HEADER);
+  log.setBuffered(1024, 15000);
+  log.appendLine(ROW);
+  log.end();
+  TEST_ASSERT_EQUAL_STRING(expectedFile(2).c_str(), storage->contents("/log.csv").c_str());
+}
+
+// Three I2C sensors logging at 1 Hz for ten minutes, as on the fleet.
+static uint32_t callsForTenMinutes(bool buffered, uint32_t &opens) {
+  fs::FS fs;
+  CsvLogger log(fs, "/log.csv", HEADER);
+  if (buffered) log.setBuffered(1024, 15000);
+  fs::stats = fs::Stats();
+  host::nowUs = 0;
+  for (int second = 0; second < 600; second++) {
+    for (int sensor = 0; sensor < 3; sensor++) log.appendLine(ROW);
+    if (buffered) log.poll();
+    host::advanceMs(1000);
+  }
+  log.end();
+  TEST_ASSERT_EQUAL_STRING(expectedFile(1800).c_str(), fs.contents("/log.csv").c_str());
+  opens = fs::stats.opens;
+  return fs::stats.calls();
+}
+
+static void test_benchmark_filesystem_calls_per_row(void) {
+  uint32_t directOpens = 0;
+  uint32_t bufferedOpens = 0;
+  const uint32_t direct = callsForTenMinutes(false, directOpens);
+  const uint32_t buffered = callsForTenMinutes(true, bufferedOpens);
+  char line[160];
+  snprintf(line, sizeof(line), "fs calls/row: direct %.2f (opens %.2f), buffered %.3f (opens %.4f)",
+           direct / 1800.0, directOpens / 1800.0, buffered / 1800.0, bufferedOpens / 1800.0);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL(2, bufferedOpens);
+  TEST_ASSERT_LESS_THAN(direct / 20, buffered);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_unbuffered_writes_header_and_rows);
+  RUN_TEST(test_buffered_checks_header_once_and_keeps_one_handle);
+  RUN_TEST(test_buffered_flushes_when_full);
+  RUN_TEST(test_buffered_flushes_by_age);
+  RUN_TEST(test_row_larger_than_buffer_goes_straight_to_file);
+  RUN_TEST(test_headerless_file_is_repaired_once);
+  RUN_TEST(test_benchmark_filesystem_calls_per_row);
+  return UNITY_END();
+}
@@ -0,0 +1,152 @@
+#include <DeadlineScheduler.h>
+#include <unity.h>
+
+#include <random>
+#include <vector>
+
+static DeadlineScheduler *scheduler;
+static std::vector<int> ran;
+
+void setUp(void) {
+  scheduler = new DeadlineScheduler();
+  ran.clear();
+  host::nowUs = 0;
+}
+
+void tearDown(void) { delete scheduler; }
+
+// Jobs are plain function pointers, so the tests use a fixed family.
+template <int N>
+static void job() {
+  ran.push_back(N);
+}
+
+static void selfRescheduling() {
+  ran.push_back(100);
+  scheduler->scheduleAt(millis(), selfRescheduling);
+}
+
+static DeadlineScheduler::Job jobs[DeadlineScheduler::kMaxJobs + 1] = {
+    job<0>, job<1>, job<2>,  job<3>,  job<4>,  job<5>,  job<6>,  job<7>,  job<8>,
+    job<9>, job<10>, job<11>, job<12>, job<13>, job<14>, job<15>, job<16>,
+};
+
+static void test_runs_due_jobs_earliest_first(void) {
+  scheduler->scheduleAt(30, job<3>);
+  scheduler->scheduleAt(10, job<1>);
+  scheduler->scheduleAt(20, job<2>);
+  scheduler->scheduleAt(50, job<5>);
+  TEST_ASSERT_EQUAL(10, scheduler->msUntilNext(0));
+  host::advanceMs(30);
+  TEST_ASSERT_EQUAL(20, scheduler->runDue(30));
+  TEST_ASSERT_EQUAL(3, ran.size());
+  TEST_ASSERT_EQUAL(1, ran[0]);
+  TEST_ASSERT_EQUAL(2, ran[1]);
+  TEST_ASSERT_EQUAL(3, ran[2]);
+  TEST_ASSERT_TRUE(scheduler->pending(job<5>));
+}
+
+static void test_scheduling_again_moves_the_deadline(void) {
+  scheduler->scheduleAt(10, job<1>);
+  scheduler->scheduleAt(40, job<1>);
+  scheduler->runDue(20);
+  TEST_ASSERT_EQUAL(0, ran.size());
+  scheduler->runDue(40);
+  TEST_ASSERT_EQUAL(1, ran.size());
+  TEST_ASSERT_FALSE(scheduler->pending(job<1>));
+}
+
+static void test_cancel_and_idle(void) {
+  TEST_ASSERT_EQUAL(DeadlineScheduler::kIdle, scheduler->msUntilNext(0));
+  scheduler->scheduleAt(10, job<1>);
+  scheduler->cancel(job<1>);
+  scheduler->cancel(job<2>);
+  TEST_ASSERT_EQUAL(DeadlineScheduler::kIdle, scheduler->runDue(100));
+  TEST_ASSERT_EQUAL(0, ran.size());
+  TEST_ASSERT_FALSE(scheduler->scheduleAt(10, nullptr));
+}
+
+static void test_capacity_is_fixed(void) {
+  for (uint8_t i = 0; i < DeadlineScheduler::kMaxJobs; i++) TEST_ASSERT_TRUE(scheduler->scheduleAt(100 + i, jobs[i]));
+  TEST_ASSERT_FALSE(scheduler->scheduleAt(5, jobs[DeadlineScheduler::kMaxJobs]));
+  // A pending job can still be moved when the heap is full.
+  TEST_ASSERT_TRUE(scheduler->scheduleAt(5, jobs[7]));
+  TEST_ASSERT_EQUAL(5, scheduler->msUntilNext(0));
+}
+
+static void test_deadlines_survive_millis_wrap(void) {
+  const uint32_t now = UINT32_MAX - 5;
+  scheduler->scheduleAt(now + 20, job<2>);
+  scheduler->scheduleAt(now + 3, job<1>);
+  TEST_ASSERT_EQUAL(3, scheduler->msUntilNext(now));
+  scheduler->runDue(now + 10);
+  TEST_ASSERT_EQUAL(1, ran.size());
+  TEST_ASSERT_EQUAL(1, ran[0]);
+  TEST_ASSERT_EQUAL(10, scheduler->msUntilNext(now + 10));
+  // Overdue deadlines report zero, not a huge wait.
+  TEST_ASSERT_EQUAL(0, scheduler->msUntilNext(now + 100));
+}
+
+static void test_a_job_rescheduling_itself_now_does_not_starve_the_caller(void) {
+  scheduler->scheduleAt(0, selfRescheduling);
+  TEST_ASSERT_EQUAL(0, scheduler->runDue(0));
+  TEST_ASSERT_EQUAL(1, ran.size());
+  scheduler->runDue(0);
+  TEST_ASSERT_EQUAL(2, ran.size());
+}
+
+// Random schedule/cancel/run sequences against a plain list.
+static void test_matches_a_reference_model(void) {
+  std::mt19937 rng(5);
+  std::vector<std::pair<uint32_t, int>> model(DeadlineScheduler::kMaxJobs, std::make_pair(0u, -1));
+  uint32_t now = UINT32_MAX - 50000;
+  for (int step = 0; step < 100000; step++) {
+    const int id = rng() % DeadlineScheduler::kMaxJobs;
+    switch (rng() % 4) {
+      case 0:
+      case 1: {
+        const uint32_t at = now + rng() % 500;
+        TEST_ASSERT_TRUE(scheduler->scheduleAt(at, jobs[id]));
+        model[id] = std::make_pair(at, id);
+        break;
+      }
+      case 2:
+        scheduler->cancel(jobs[id]);
+        model[id].second = -1;
+        break;
+      default: {
+        now += rng() % 200;
+        host::nowUs = (uint64_t)now * 1000ULL;
+        std::vector<std::pair<uint32_t, int>> due;
+        for (auto &entry : model) {
+          if (entry.second >= 0 && (int32_t)(entry.first - now) <= 0) {
+            due.push_back(entry);
+            entry.second = -1;
+          }
+        }
+        ran.clear();
+        scheduler->runDue(now);
+        TEST_ASSERT_EQUAL(due.size(), ran.size());
+        for (size_t i = 1; i < ran.size(); i++) {
+          TEST_ASSERT_TRUE((int32_t)(model[ran[i - 1]].first - model[ran[i]].first) <= 0);
+        }
+        break;
+      }
+    }
+    for (int j = 0; j < DeadlineScheduler::kMaxJobs; j++) {
+      TEST_ASSERT_EQUAL(model[j].second >= 0, scheduler->pending(jobs[j]));
+    }
+  }
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_runs_due_jobs_earliest_first);
+  RUN_TEST(test_scheduling_again_moves_the_deadline);
+  RUN_TEST(test_cancel_and_idle);
+  RUN_TEST(test_capacity_is_fixed);
+  RUN_TEST(test_deadlines_survive_millis_wrap);
+  RUN_TEST(test_a_job_rescheduling_itself_now_does_not_starve_the_caller);
+  RUN_TEST(test_matches_a_reference_model);
+  return UNITY_END();
+}
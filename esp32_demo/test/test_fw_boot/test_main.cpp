@@ -0,0 +1,253 @@
+// Sensor bring-up at boot: a cold boot probes and stores what it found in
+// NVS, a warm boot goes straight to the cached sensor. The host clock only
+// moves in delay() here, so the times below are the fixed waits of each
+// path; USB CDC and radio start-up are not modelled.
+
+#include "../../src/main.cpp"
+
+#include <unity.h>
+
+static const int DHT_PIN = 5;
+
+static I2cRegisterDevice bmp;
+
+static void command(const std::string &json) {
+  host::bleWrite(UUID_CONFIG, json);
+  processBleCommands();
+}
+
+// A reset keeps NVS; the drivers and the cache copy in RAM go.
+static void reboot() {
+  clearSensors();
+  clearDigitalSensor();
+  sensorCache = SensorCache();
+  const DeviceConfig keep = deviceConfig;
+  loadConfig();
+  deviceConfig = keep;
+  host::i2cAddressed.clear();
+  Serial.output.clear();
+}
+
+// Fixed waits spent bringing the sensors up, in ms.
+static uint32_t timedInit() {
+  const uint64_t before = host::delayedUs;
+  initSensorsAtBoot();
+  return (uint32_t)((host::delayedUs - before) / 1000);
+}
+
+// Full setup() after a reset, then loop() until the first sampling tick;
+// returns the ms from reset to the start of that tick.
+static uint32_t bootToFirstSample() {
+  reboot();
+  deviceConfig = DeviceConfig();
+  prefsReady = false;
+  littlefsReady = false;
+  logRingReady = false;
+  const uint32_t resetMs = millis();
+  setup();
+  for (int i = 0; i < 100; i++) {
+    const uint32_t deadline = sampleDeadline;
+    const uint32_t startedAt = millis();
+    loop();
+    if (sampleDeadline != deadline) return startedAt - resetMs;
+  }
+  TEST_FAIL_MESSAGE("no sample after boot");
+  return 0;
+}
+
+static bool onlyAddressed(uint8_t addr) {
+  if (host::i2cAddressed.empty()) return false;
+  for (uint8_t a : host::i2cAddressed) {
+    if (a != addr) return false;
+  }
+  return true;
+}
+
+static bool printed(const char *text) {
+  return Serial.output.find(text) != std::string::npos;
+}
+
+static size_t cachedBlobBytes() {
+  ensurePrefs();
+  return prefs.getBytesLength("sensor_cache");
+}
+
+void setUp(void) {
+  static bool booted = false;
+  if (!booted) {
+    setup();
+    booted = true;
+  }
+  bmp.regs[0xD0] = 0x58;
+  host::i2cDevices.clear();
+  host::dhtPins.clear();
+  storeSensorCache(SensorCache());
+  reboot();
+}
+
+void tearDown(void) {}
+
+static void test_i2c_warm_boot_probes_the_cached_address_only(void) {
+  host::i2cDevices[0x76] = &bmp;
+  command("{\"sensor\":\"i2c\"}");
+  reboot();
+  initSensorsAtBoot();
+  TEST_ASSERT_NOT_NULL(bmp280);
+  TEST_ASSERT_EQUAL(SENSOR_CACHE_I2C, sensorCache.kind);
+  TEST_ASSERT_EQUAL(0x76, sensorCache.bmpAddr);
+  TEST_ASSERT_EQUAL(sizeof(SensorCache), cachedBlobBytes());
+
+  reboot();
+  TEST_ASSERT_EQUAL(0x76, sensorCache.bmpAddr);
+  initSensorsAtBoot();
+  TEST_ASSERT_NOT_NULL(bmp280);
+  TEST_ASSERT_TRUE(printed("[I2C] Capteurs restaures depuis le cache"));
+  TEST_ASSERT_FALSE(printed("scanSensors start"));
+  TEST_ASSERT_TRUE(onlyAddressed(0x76));
+}
+
+// The sensor moved to the other address: the cached probe fails and the
+// full probe finds it and rewrites the cache.
+static void test_stale_i2c_cache_falls_back_to_a_scan(void) {
+  host::i2cDevices[0x76] = &bmp;
+  command("{\"sensor\":\"i2c\"}");
+  initSensorsAtBoot();
+  host::i2cDevices.clear();
+  host::i2cDevices[0x77] = &bmp;
+  reboot();
+  initSensorsAtBoot();
+  TEST_ASSERT_TRUE(printed("[I2C] Cache capteurs obsolete, scan complet"));
+  TEST_ASSERT_TRUE(printed("scanSensors start"));
+  TEST_ASSERT_NOT_NULL(bmp280);
+  TEST_ASSERT_EQUAL(0x77, sensorCache.bmpAddr);
+  reboot();
+  TEST_ASSERT_EQUAL(0x77, sensorCache.bmpAddr);
+}
+
+static void test_moved_i2c_pins_ignore_the_cache(void) {
+  host::i2cDevices[0x76] = &bmp;
+  command("{\"sensor\":\"i2c\"}");
+  initSensorsAtBoot();
+  const int8_t cachedSda = sensorCache.pinA;
+  const int sda = deviceConfig.i2cSda == 4 ? 5 : 4;
+  command("{\"i2c\":{\"sda\":" + std::to_string(sda) + "}}");
+  reboot();
+  initSensorsAtBoot();
+  TEST_ASSERT_TRUE(printed("scanSensors start"));
+  TEST_ASSERT_FALSE(printed("depuis le cache"));
+  TEST_ASSERT_NOT_EQUAL(cachedSda, sensorCache.pinA);
+  TEST_ASSERT_EQUAL(sda, sensorCache.pinA);
+}
+
+// DHT22 detection waits 1.2 s per candidate type; the cached type does not
+// wait at all.
+static void test_dht_warm_boot_skips_detection(void) {
+  host::dhtPins.insert(DHT_PIN);
+  command("{\"sensor\":\"digital\",\"digital\":{\"pin\":" + std::to_string(DHT_PIN) + "}}");
+  // Switching modes already ran a detection; start from an empty cache.
+  storeSensorCache(SensorCache());
+  reboot();
+  const uint32_t coldMs = timedInit();
+  TEST_ASSERT_EQUAL(DIGITAL_SENSOR_DHT22, digitalSensorType);
+  TEST_ASSERT_EQUAL(SENSOR_CACHE_DHT, sensorCache.kind);
+  TEST_ASSERT_EQUAL(DHT22, sensorCache.dhtType);
+
+  reboot();
+  const uint32_t readsBefore = host::dhtReads;
+  const uint32_t warmMs = timedInit();
+  TEST_ASSERT_TRUE(dhtFromCache);
+  TEST_ASSERT_EQUAL(DIGITAL_SENSOR_DHT22, digitalSensorType);
+  TEST_ASSERT_EQUAL(readsBefore, host::dhtReads);
+
+  // Nothing on the pin: both types are tried and nothing is cached.
+  host::dhtPins.clear();
+  storeSensorCache(SensorCache());
+  reboot();
+  const uint32_t missingMs = timedInit();
+  TEST_ASSERT_EQUAL(DIGITAL_SENSOR_NONE, digitalSensorType);
+  TEST_ASSERT_EQUAL(0, cachedBlobBytes());
+
+  char line[128];
+  snprintf(line, sizeof(line), "DHT bring-up waits: cold %lu ms, warm %lu ms, no sensor %lu ms",
+           (unsigned long)coldMs, (unsigned long)warmMs, (unsigned long)missingMs);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL(1200, coldMs);
+  TEST_ASSERT_EQUAL(0, warmMs);
+  TEST_ASSERT_EQUAL(2400, missingMs);
+}
+
+// The request's budget: a warm boot samples within 500 ms of reset.
+static void test_first_sample_after_a_warm_boot(void) {
+  host::dhtPins.insert(DHT_PIN);
+  command("{\"sensor\":\"digital\",\"digital\":{\"pin\":" + std::to_string(DHT_PIN) + "}}");
+  storeSensorCache(SensorCache());
+  const uint32_t coldMs = bootToFirstSample();
+  TEST_ASSERT_EQUAL(SENSOR_CACHE_DHT, sensorCache.kind);
+  const uint32_t warmMs = bootToFirstSample();
+  TEST_ASSERT_TRUE(printed("[DIGITAL] DHT restaure depuis le cache"));
+  char line[128];
+  snprintf(line, sizeof(line), "reset to first DHT sample: cold %lu ms, warm %lu ms", (unsigned long)coldMs,
+           (unsigned long)warmMs);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_GREATER_OR_EQUAL(1200, coldMs);
+  TEST_ASSERT_LESS_THAN(500, warmMs);
+}
+
+// A cached DHT that stopped answering is detected again after
+// DHT_CACHE_MAX_FAILURES reads rather than logging the raw pin.
+static void test_silent_cached_dht_is_probed_again(void) {
+  host::dhtPins.insert(DHT_PIN);
+  command("{\"sensor\":\"digital\",\"digital\":{\"pin\":" + std::to_string(DHT_PIN) + "}}");
+  initSensorsAtBoot();
+  reboot();
+  initSensorsAtBoot();
+  TEST_ASSERT_TRUE(dhtFromCache);
+
+  host::dhtPins.clear();
+  float v1 = 0;
+  float v2 = 0;
+  bool paired = false;
+  const char *name = nullptr;
+  for (uint8_t i = 1; i < DHT_CACHE_MAX_FAILURES; i++) {
+    TEST_ASSERT_FALSE(readDigitalSensor(v1, v2, paired, name));
+    TEST_ASSERT_NOT_NULL(dht);
+  }
+  TEST_ASSERT_FALSE(readDigitalSensor(v1, v2, paired, name));
+  TEST_ASSERT_TRUE(printed("[DIGITAL] DHT du cache muet, nouvelle detection"));
+  TEST_ASSERT_NULL(dht);
+  TEST_ASSERT_EQUAL(SENSOR_CACHE_NONE, sensorCache.kind);
+  TEST_ASSERT_EQUAL(0, cachedBlobBytes());
+}
+
+// One good read clears the cached flag, so later failures are plain
+// skipped ticks.
+static void test_good_read_confirms_the_cached_dht(void) {
+  host::dhtPins.insert(DHT_PIN);
+  command("{\"sensor\":\"digital\",\"digital\":{\"pin\":" + std::to_string(DHT_PIN) + "}}");
+  initSensorsAtBoot();
+  reboot();
+  initSensorsAtBoot();
+  float v1 = 0;
+  float v2 = 0;
+  bool paired = false;
+  const char *name = nullptr;
+  TEST_ASSERT_TRUE(readDigitalSensor(v1, v2, paired, name));
+  TEST_ASSERT_EQUAL_STRING("dht22", name);
+  TEST_ASSERT_FALSE(dhtFromCache);
+  host::dhtPins.clear();
+  for (uint8_t i = 0; i < 2 * DHT_CACHE_MAX_FAILURES; i++) readDigitalSensor(v1, v2, paired, name);
+  TEST_ASSERT_NOT_NULL(dht);
+  TEST_ASSERT_EQUAL(SENSOR_CACHE_DHT, sensorCache.kind);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_i2c_warm_boot_probes_the_cached_address_only);
+  RUN_TEST(test_stale_i2c_cache_falls_back_to_a_scan);
+  RUN_TEST(test_moved_i2c_pins_ignore_the_cache);
+  RUN_TEST(test_dht_warm_boot_skips_detection);
+  RUN_TEST(test_first_sample_after_a_warm_boot);
+  RUN_TEST(test_silent_cached_dht_is_probed_again);
+  RUN_TEST(test_good_read_confirms_the_cached_dht);
+  return UNITY_END();
+}
@@ -0,0 +1,18 @@
+// Counts heap allocations for the parser benchmark. Kept out of
+// test_main.cpp so the replacements are not inlined into the firmware.
+
+#include <cstdlib>
+#include <new>
+
+size_t allocations = 0;
+
+void *operator new(size_t n) {
+  allocations++;
+  void *p = malloc(n ? n : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+void operator delete(void *p, size_t) noexcept { free(p); }
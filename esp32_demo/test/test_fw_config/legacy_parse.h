@@ -0,0 +1,330 @@
+// parseConfigUpdate() as it was before JsonScan: one find() per key over the
+// whole payload. Kept as the reference for the differential test and the
+// benchmark in test_main.cpp.
+
+#pragma once
+
+static bool old_extractJsonStringField(const std::string &json, const char *key, std::string &out) {
+  if (!key || !key[0]) return false;
+  const std::string pattern = std::string("\"") + key + "\"";
+  size_t pos = json.find(pattern);
+  if (pos == std::string::npos) return false;
+  pos = json.find(':', pos + pattern.size());
+  if (pos == std::string::npos) return false;
+  pos++;
+  while (pos < json.size() && isspace((unsigned char)json[pos])) pos++;
+  if (pos >= json.size()) return false;
+  const char quote = json[pos];
+  if (quote == '"' || quote == '\'') {
+    pos++;
+    size_t end = json.find(quote, pos);
+    if (end == std::string::npos) return false;
+    out = json.substr(pos, end - pos);
+    return !out.empty();
+  }
+  size_t end = pos;
+  while (end < json.size() && json[end] != ',' && json[end] != '}' && !isspace((unsigned char)json[end])) end++;
+  out = json.substr(pos, end - pos);
+  return !out.empty();
+}
+
+static bool old_extractJsonNumberField(const std::string &json, const char *key, int &out) {
+  std::string temp;
+  if (!old_extractJsonStringField(json, key, temp)) return false;
+  out = atoi(temp.c_str());
+  return true;
+}
+
+static bool old_extractJsonNumberFieldU32(const std::string &json, const char *key, uint32_t &out) {
+  std::string temp;
+  if (!old_extractJsonStringField(json, key, temp)) return false;
+  long val = atol(temp.c_str());
+  if (val < 0) return false;
+  out = (uint32_t)val;
+  return true;
+}
+
+static bool old_extractJsonNumberFieldU64(const std::string &json, const char *key, uint64_t &out) {
+  std::string temp;
+  if (!old_extractJsonStringField(json, key, temp)) return false;
+  unsigned long long val = strtoull(temp.c_str(), nullptr, 10);
+  out = (uint64_t)val;
+  return true;
+}
+
+static bool old_extractJsonBoolField(const std::string &json, const char *key, bool &out) {
+  std::string temp;
+  if (!old_extractJsonStringField(json, key, temp)) return false;
+  std::string raw = lowerCopy(trimCopy(temp));
+  if (raw == "true" || raw == "1" || raw == "yes" || raw == "on") {
+    out = true;
+    return true;
+  }
+  if (raw == "false" || raw == "0" || raw == "no" || raw == "off") {
+    out = false;
+    return true;
+  }
+  return false;
+}
+
+static bool old_extractJsonObjectField(const std::string &json, const char *key, std::string &out) {
+  if (!key || !key[0]) return false;
+  const std::string pattern = std::string("\"") + key + "\"";
+  size_t pos = json.find(pattern);
+  if (pos == std::string::npos) return false;
+  pos = json.find(':', pos + pattern.size());
+  if (pos == std::string::npos) return false;
+  pos++;
+  while (pos < json.size() && isspace((unsigned char)json[pos])) pos++;
+  if (pos >= json.size() || json[pos] != '{') return false;
+  size_t start = pos;
+  int depth = 0;
+  for (; pos < json.size(); pos++) {
+    if (json[pos] == '{') depth++;
+    else if (json[pos] == '}') {
+      depth--;
+      if (depth == 0) {
+        out = json.substr(start, pos - start + 1);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+static ConfigUpdate old_parseConfigUpdate(const std::string &value) {
+  ConfigUpdate update;
+  const std::string trimmed = trimCopy(value);
+  if (trimmed.empty()) return update;
+
+  if (!trimmed.empty() && trimmed.front() == '{') {
+    std::string configObj;
+    const bool hasConfigObj = old_extractJsonObjectField(trimmed, "config", configObj);
+
+    std::string action;
+    if (old_extractJsonStringField(trimmed, "action", action)) {
+      update.hasAction = true;
+      update.action = lowerCopy(action);
+      old_extractJsonStringField(trimmed, "format", update.format);
+      update.format = lowerCopy(update.format);
+      if (old_extractJsonNumberFieldU64(trimmed, "from_ms", update.fromMs)) update.hasRange = true;
+      if (old_extractJsonNumberFieldU64(trimmed, "to_ms", update.toMs)) update.hasRange = true;
+      old_extractJsonNumberFieldU32(trimmed, "window", update.window);
+      old_extractJsonStringField(trimmed, "framing", update.framing);
+      update.framing = lowerCopy(update.framing);
+      old_extractJsonStringField(trimmed, "client", update.client);
+      if (old_extractJsonNumberFieldU32(trimmed, "resume_id", update.resumeId)) {
+        update.hasResume = true;
+        old_extractJsonNumberFieldU32(trimmed, "offset", update.resumeOffset);
+      }
+    }
+
+    uint64_t epochMs = 0;
+    if (old_extractJsonNumberFieldU64(trimmed, "epoch_ms", epochMs)
+        || old_extractJsonNumberFieldU64(trimmed, "epoch", epochMs)
+        || old_extractJsonNumberFieldU64(trimmed, "time_ms", epochMs)
+        || old_extractJsonNumberFieldU64(trimmed, "timestamp", epochMs)) {
+      update.hasEpochMs = true;
+      update.epochMs = epochMs;
+    }
+
+    int tzMin = 0;
+    if (old_extractJsonNumberField(trimmed, "tz_offset_min", tzMin)
+        || old_extractJsonNumberField(trimmed, "tzOffsetMin", tzMin)
+        || old_extractJsonNumberField(trimmed, "tz", tzMin)) {
+      update.hasTzOffset = true;
+      update.tzOffsetMin = tzMin;
+    }
+
+    if (update.hasAction && (update.action == "csv_ack" || update.action == "csv_nack")) {
+      uint32_t ackId = 0;
+      uint32_t ackSeq = 0;
+      bool got = false;
+      if (old_extractJsonNumberFieldU32(trimmed, "id", ackId)
+          || old_extractJsonNumberFieldU32(trimmed, "export_id", ackId)
+          || old_extractJsonNumberFieldU32(trimmed, "exportId", ackId)) {
+        update.csvAckId = ackId;
+        got = true;
+      }
+      if (old_extractJsonNumberFieldU32(trimmed, "seq", ackSeq)) {
+        update.csvAckSeq = ackSeq;
+        got = true;
+      }
+      update.hasCsvAck = got;
+    }
+
+    if (old_extractJsonStringField(trimmed, "name", update.name)
+        || (hasConfigObj && old_extractJsonStringField(configObj, "name", update.name))) {
+      update.hasName = true;
+    }
+
+    std::string sensor;
+    if (old_extractJsonStringField(trimmed, "sensor", sensor)
+        || old_extractJsonStringField(trimmed, "type", sensor)
+        || (hasConfigObj && old_extractJsonStringField(configObj, "sensor", sensor))
+        || (hasConfigObj && old_extractJsonStringField(configObj, "type", sensor))) {
+      update.hasSensor = true;
+      update.sensor = sensor;
+    }
+
+    uint32_t freq = 0;
+    if (old_extractJsonNumberFieldU32(trimmed, "frequency", freq)
+        || old_extractJsonNumberFieldU32(trimmed, "freq", freq)
+        || old_extractJsonNumberFieldU32(trimmed, "interval", freq)
+        || old_extractJsonNumberFieldU32(trimmed, "period", freq)
+        || (hasConfigObj && old_extractJsonNumberFieldU32(configObj, "frequency", freq))
+        || (hasConfigObj && old_extractJsonNumberFieldU32(configObj, "freq", freq))
+        || (hasConfigObj && old_extractJsonNumberFieldU32(configObj, "interval", freq))
+        || (hasConfigObj && old_extractJsonNumberFieldU32(configObj, "period", freq))) {
+      update.hasFrequency = true;
+      update.frequencyMs = freq;
+    }
+
+    bool storeFlash = false;
+    if (old_extractJsonBoolField(trimmed, "store_flash", storeFlash)
+        || old_extractJsonBoolField(trimmed, "storeFlash", storeFlash)
+        || old_extractJsonBoolField(trimmed, "save", storeFlash)
+        || old_extractJsonBoolField(trimmed, "flash", storeFlash)
+        || (hasConfigObj && old_extractJsonBoolField(configObj, "store_flash", storeFlash))
+        || (hasConfigObj && old_extractJsonBoolField(configObj, "storeFlash", storeFlash))
+        || (hasConfigObj && old_extractJsonBoolField(configObj, "save", storeFlash))
+        || (hasConfigObj && old_extractJsonBoolField(configObj, "flash", storeFlash))) {
+      update.hasStoreFlash = true;
+      update.storeFlash = storeFlash;
+    }
+
+    std::string logFormat;
+    if (old_extractJsonStringField(trimmed, "log_format", logFormat)
+        || old_extractJsonStringField(trimmed, "logFormat", logFormat)
+        || (hasConfigObj && old_extractJsonStringField(configObj, "log_format", logFormat))
+        || (hasConfigObj && old_extractJsonStringField(configObj, "logFormat", logFormat))) {
+      update.hasLogFormat = true;
+      update.logFormat = logFormat;
+    }
+
+    uint32_t logBudgetKb = 0;
+    if (old_extractJsonNumberFieldU32(trimmed, "log_budget_kb", logBudgetKb)
+        || old_extractJsonNumberFieldU32(trimmed, "logBudgetKb", logBudgetKb)
+        || (hasConfigObj && old_extractJsonNumberFieldU32(configObj, "log_budget_kb", logBudgetKb))
+        || (hasConfigObj && old_extractJsonNumberFieldU32(configObj, "logBudgetKb", logBudgetKb))) {
+      update.hasLogBudget = true;
+      update.logBudgetKb = logBudgetKb;
+    }
+
+    std::string i2cObj;
+    if (old_extractJsonObjectField(trimmed, "i2c", i2cObj)) {
+      int sda = -1;
+      int scl = -1;
+      bool has = false;
+      if (old_extractJsonNumberField(i2cObj, "sda", sda)) {
+        update.i2cSda = sda;
+        has = true;
+      }
+      if (old_extractJsonNumberField(i2cObj, "scl", scl)) {
+        update.i2cScl = scl;
+        has = true;
+      }
+      if (has) update.hasI2c = true;
+    } else {
+      int sda = -1;
+      int scl = -1;
+      bool has = false;
+      if (old_extractJsonNumberField(trimmed, "sda", sda)) {
+        update.i2cSda = sda;
+        has = true;
+      }
+      if (old_extractJsonNumberField(trimmed, "scl", scl)) {
+        update.i2cScl = scl;
+        has = true;
+      }
+      if (has) update.hasI2c = true;
+    }
+
+    std::string oneObj;
+    if (old_extractJsonObjectField(trimmed, "onewire", oneObj) || old_extractJsonObjectField(trimmed, "one_wire", oneObj)) {
+      int pin = -1;
+      if (old_extractJsonNumberField(oneObj, "pin", pin)) {
+        update.hasOneWire = true;
+        update.onewirePin = pin;
+      }
+    } else {
+      int pin = -1;
+      if (old_extractJsonNumberField(trimmed, "onewire", pin) || old_extractJsonNumberField(trimmed, "one_wire", pin)) {
+        update.hasOneWire = true;
+        update.onewirePin = pin;
+      }
+    }
+
+    std::string analogObj;
+    if (old_extractJsonObjectField(trimmed, "analog", analogObj)) {
+      int pin = -1;
+      if (old_extractJsonNumberField(analogObj, "pin", pin)) {
+        update.hasAnalog = true;
+        update.analogPin = pin;
+      }
+    } else {
+      int pin = -1;
+      if (old_extractJsonNumberField(trimmed, "analog", pin)) {
+        update.hasAnalog = true;
+        update.analogPin = pin;
+      }
+    }
+
+    std::string digitalObj;
+    if (old_extractJsonObjectField(trimmed, "digital", digitalObj)) {
+      int pin = -1;
+      if (old_extractJsonNumberField(digitalObj, "pin", pin)) {
+        update.hasDigital = true;
+        update.digitalPin = pin;
+      }
+    } else {
+      int pin = -1;
+      if (old_extractJsonNumberField(trimmed, "digital", pin)) {
+        update.hasDigital = true;
+        update.digitalPin = pin;
+      }
+    }
+
+    std::string buttonObj;
+    if (old_extractJsonObjectField(trimmed, "button", buttonObj)) {
+      int pin = -1;
+      if (old_extractJsonNumberField(buttonObj, "pin", pin)) {
+        update.hasButton = true;
+        update.buttonPin = pin;
+      }
+    } else {
+      int pin = -1;
+      if (old_extractJsonNumberField(trimmed, "button", pin)
+          || old_extractJsonNumberField(trimmed, "button_pin", pin)) {
+        update.hasButton = true;
+        update.buttonPin = pin;
+      }
+    }
+
+    std::string neoObj;
+    if (old_extractJsonObjectField(trimmed, "neopixel", neoObj) || old_extractJsonObjectField(trimmed, "neo", neoObj)) {
+      int pin = -1;
+      if (old_extractJsonNumberField(neoObj, "pin", pin)) {
+        update.hasNeoPixel = true;
+        update.neopixelPin = pin;
+      }
+    } else {
+      int pin = -1;
+      if (old_extractJsonNumberField(trimmed, "neopixel", pin)
+          || old_extractJsonNumberField(trimmed, "neopixel_pin", pin)
+          || old_extractJsonNumberField(trimmed, "neo", pin)) {
+        update.hasNeoPixel = true;
+        update.neopixelPin = pin;
+      }
+    }
+
+    return update;
+  }
+
+  std::string name;
+  if (extractNameFromConfig(trimmed, name)) {
+    update.hasName = true;
+    update.name = name;
+  }
+
+  return update;
+}
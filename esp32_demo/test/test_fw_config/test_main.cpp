@@ -0,0 +1,174 @@
+// Config writes through parseConfigUpdate(), compared with the parser it
+// replaced (legacy_parse.h) on the app's writes and on generated ones.
+
+#include "../../src/main.cpp"
+#include "legacy_parse.h"
+
+#include <unity.h>
+
+#include <chrono>
+#include <random>
+
+// alloc_count.cpp
+extern size_t allocations;
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// The fields both parsers know about; action fields only count with an action.
+static std::string dump(const ConfigUpdate &u) {
+  char b[1024];
+  snprintf(b, sizeof(b),
+           "name=%d:%s sensor=%d:%s i2c=%d:%d,%d ow=%d:%d an=%d:%d dg=%d:%d bt=%d:%d np=%d:%d fq=%d:%lu sf=%d:%d "
+           "lf=%d:%s lb=%d:%lu ep=%d:%llu tz=%d:%d",
+           u.hasName, u.name.c_str(), u.hasSensor, u.sensor.c_str(), u.hasI2c, u.i2cSda, u.i2cScl, u.hasOneWire,
+           u.onewirePin, u.hasAnalog, u.analogPin, u.hasDigital, u.digitalPin, u.hasButton, u.buttonPin,
+           u.hasNeoPixel, u.neopixelPin, u.hasFrequency, (unsigned long)u.frequencyMs, u.hasStoreFlash,
+           u.storeFlash, u.hasLogFormat, u.logFormat.c_str(), u.hasLogBudget, (unsigned long)u.logBudgetKb,
+           u.hasEpochMs, (unsigned long long)u.epochMs, u.hasTzOffset, u.tzOffsetMin);
+  std::string s = b;
+  if (!u.hasAction) return s;
+  snprintf(b, sizeof(b), " act=%s fmt=%s rg=%d:%llu,%llu win=%lu fr=%s cl=%s rs=%d:%lu,%lu", u.action.c_str(),
+           u.format.c_str(), u.hasRange, (unsigned long long)u.fromMs, (unsigned long long)u.toMs,
+           (unsigned long)u.window, u.framing.c_str(), u.client.c_str(), u.hasResume,
+           u.hasResume ? (unsigned long)u.resumeId : 0UL, u.hasResume ? (unsigned long)u.resumeOffset : 0UL);
+  s += b;
+  if (u.action == "csv_ack" || u.action == "csv_nack") {
+    snprintf(b, sizeof(b), " ack=%d:%lu,%lu", u.hasCsvAck, (unsigned long)u.csvAckId, (unsigned long)u.csvAckSeq);
+    s += b;
+  }
+  return s;
+}
+
+static const char *APP_WRITES[] = {
+    "{\"name\":\"Phenix 2\",\"sensor\":\"i2c\",\"i2c\":{\"sda\":21,\"scl\":22},\"frequency\":2000,"
+    "\"store_flash\":true,\"log_format\":\"tsz\",\"log_budget_kb\":512}",
+    "{\"action\":\"time_sync\",\"epoch_ms\":1750000000000,\"tz_offset_min\":-120}",
+    "{\"action\":\"csv_ack\",\"id\":7,\"seq\":42}",
+    "{\"action\":\"flash_export\",\"window\":8,\"framing\":\"Binary\",\"format\":\"LZ\",\"from_ms\":1,\"to_ms\":99}",
+    "{\"action\":\"flash_export_new\",\"client\":\"tablet-1\",\"window\":8}",
+    "{\"action\":\"flash_stream\",\"resume_id\":3,\"offset\":17}",
+    "{\"config\":{\"name\":\"x\",\"freq\":500,\"save\":\"on\",\"logFormat\":\"bin\"}}",
+    "{\"sensor\":\"onewire\",\"onewire\":{\"pin\":4}}",
+    "{\"sensor\":\"analog\",\"analog\":{\"pin\":34},\"button\":{\"pin\":0},\"neopixel\":{\"pin\":48}}",
+    "{\"sensor\":\"digital\",\"digital\":5,\"button_pin\":9,\"neo\":8}",
+    "{\"store_flash\":false}",
+    "{\"type\":\"random\",\"period\":100,\"flash\":1}",
+    "{\"action\":\"config_get\"}",
+    "  Phenix Nord  ",
+    "name=Mon capteur;",
+};
+
+static void test_app_writes_parse_as_before(void) {
+  for (const char *write : APP_WRITES) {
+    TEST_ASSERT_EQUAL_STRING(dump(old_parseConfigUpdate(write)).c_str(), dump(parseConfigUpdate(write)).c_str());
+  }
+}
+
+static void test_single_quoted_keys_are_now_accepted(void) {
+  const char *write = "{ 'name' : 'quoted' , \"interval\" : \"1500\" }";
+  TEST_ASSERT_FALSE(old_parseConfigUpdate(write).hasName);
+  const ConfigUpdate u = parseConfigUpdate(write);
+  TEST_ASSERT_TRUE(u.hasName);
+  TEST_ASSERT_EQUAL_STRING("quoted", u.name.c_str());
+  TEST_ASSERT_EQUAL(1500, u.frequencyMs);
+}
+
+// Later aliases never override earlier-ranked ones, whatever the order.
+static void test_alias_precedence_does_not_depend_on_order(void) {
+  const ConfigUpdate a = parseConfigUpdate("{\"epoch\":5,\"epoch_ms\":7,\"config\":{\"freq\":1},\"frequency\":2}");
+  const ConfigUpdate b = parseConfigUpdate("{\"frequency\":2,\"config\":{\"freq\":1},\"epoch_ms\":7,\"epoch\":5}");
+  TEST_ASSERT_EQUAL_STRING(dump(a).c_str(), dump(b).c_str());
+  TEST_ASSERT_TRUE(a.epochMs == 7);
+  TEST_ASSERT_EQUAL(2, a.frequencyMs);
+  TEST_ASSERT_EQUAL_STRING(dump(old_parseConfigUpdate("{\"epoch\":5,\"epoch_ms\":7}")).c_str(),
+                           dump(parseConfigUpdate("{\"epoch\":5,\"epoch_ms\":7}")).c_str());
+}
+
+static void test_generated_writes_parse_as_before(void) {
+  const char *strings[] = {"name", "sensor", "type", "log_format", "logFormat", "action", "format", "framing", "client"};
+  const char *numbers[] = {"frequency", "freq", "interval", "period", "log_budget_kb", "logBudgetKb",
+                           "from_ms", "to_ms", "window", "resume_id", "offset", "epoch_ms",
+                           "epoch", "time_ms", "timestamp", "tz_offset_min", "tz", "id",
+                           "seq", "analog", "digital", "button", "neo"};
+  const char *bools[] = {"store_flash", "storeFlash", "save"};
+  const int nStrings = sizeof(strings) / sizeof(strings[0]);
+  const int nNumbers = sizeof(numbers) / sizeof(numbers[0]);
+  const int nKeys = nStrings + nNumbers + sizeof(bools) / sizeof(bools[0]);
+  std::mt19937 rng(1);
+  for (int run = 0; run < 20000; run++) {
+    std::string j = "{";
+    bool used[64] = {};
+    const int n = 1 + rng() % 6;
+    for (int k = 0; k < n; k++) {
+      const int pick = rng() % nKeys;
+      if (used[pick]) continue;
+      used[pick] = true;
+      if (j.size() > 1) j += ",";
+      if (pick < nStrings) {
+        j += std::string("\"") + strings[pick] + "\":\"v" + std::to_string(rng() % 50) + "\"";
+      } else if (pick < nStrings + nNumbers) {
+        j += std::string("\"") + numbers[pick - nStrings] + "\":" + std::to_string(rng() % 100000);
+      } else {
+        j += std::string("\"") + bools[pick - nStrings - nNumbers] + "\":" + ((rng() & 1) ? "true" : "false");
+      }
+    }
+    j += "}";
+    const std::string want = dump(old_parseConfigUpdate(j));
+    const std::string got = dump(parseConfigUpdate(j));
+    if (want != got) TEST_FAIL_MESSAGE(j.c_str());
+  }
+}
+
+static void test_mutated_writes_do_not_crash(void) {
+  std::mt19937 rng(2);
+  const size_t seeds = sizeof(APP_WRITES) / sizeof(APP_WRITES[0]);
+  for (int run = 0; run < 50000; run++) {
+    std::string j = APP_WRITES[rng() % seeds];
+    const int edits = 1 + rng() % 8;
+    for (int k = 0; k < edits && !j.empty(); k++) {
+      const size_t pos = rng() % j.size();
+      switch (rng() % 4) {
+        case 0: j[pos] = "{}[]\"':,\\ a1-"[rng() % 14]; break;
+        case 1: j.erase(pos, 1 + rng() % 4); break;
+        case 2: j.insert(pos, 1, (char)(rng() % 256)); break;
+        default: j.resize(pos); break;
+      }
+    }
+    parseConfigUpdate(j);
+  }
+}
+
+static void test_benchmark_against_the_legacy_parser(void) {
+  const std::string write = APP_WRITES[0];
+  const int runs = 20000;
+  double us[2];
+  double allocs[2];
+  for (int pass = 0; pass < 2; pass++) {
+    const size_t before = allocations;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) {
+      ConfigUpdate u = pass ? parseConfigUpdate(write) : old_parseConfigUpdate(write);
+      TEST_ASSERT_TRUE(u.hasLogBudget);
+    }
+    us[pass] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+    allocs[pass] = (double)(allocations - before) / runs;
+  }
+  char line[128];
+  snprintf(line, sizeof(line), "full config write: legacy %.2f us, %.1f allocs; scanner %.2f us, %.1f allocs", us[0],
+           allocs[0], us[1], allocs[1]);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_LESS_THAN(allocs[0] / 4, allocs[1]);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_app_writes_parse_as_before);
+  RUN_TEST(test_single_quoted_keys_are_now_accepted);
+  RUN_TEST(test_alias_precedence_does_not_depend_on_order);
+  RUN_TEST(test_generated_writes_parse_as_before);
+  RUN_TEST(test_mutated_writes_do_not_crash);
+  RUN_TEST(test_benchmark_against_the_legacy_parser);
+  return UNITY_END();
+}
@@ -0,0 +1,430 @@
+// Flash export over BLE, driven through the config characteristic exactly as
+// the web app does it. The central below acks, nacks and drops blocks; the
+// loopback model at the end measures throughput for a latency and an MTU.
+
+#include "../../src/main.cpp"
+
+#include <LzBlockDecoder.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <random>
+
+static const uint64_t EPOCH_MS = 1700000000000ULL;
+
+static void command(const std::string &json) {
+  host::bleWrite(UUID_CONFIG, json);
+  processBleCommands();
+}
+
+static void logRows(int count, const char *format) {
+  command(std::string("{\"log_format\":\"") + format + "\"}");
+  for (int i = 0; i < count; i++) {
+    host::advanceMs(1000);
+    const bool probe = i % 3 == 0;
+    flashLogRow(currentLocalMs(), probe ? "ds18b20" : "bmp280", probe ? "28FF4A1D93160302" : "0x76",
+                20.0f + (i % 500) * 0.01f, NAN, 1013.25f - (i % 50) * 0.1f, NAN, NAN, NAN, NAN, NAN, NAN);
+  }
+  flushLogs();
+}
+
+static std::string reference(uint64_t fromMs = 0, uint64_t toMs = UINT64_MAX) {
+  LogCursor cursor;
+  logCursorOpen(cursor, fromMs, toMs);
+  std::string out;
+  std::string line;
+  while (logCursorNextLine(cursor, line)) {
+    if (!out.empty()) out += "\n";
+    out += line;
+  }
+  logCursorClose(cursor);
+  return out;
+}
+
+static std::string unescapeJson(const std::string &in) {
+  std::string out;
+  for (size_t i = 0; i < in.size(); i++) {
+    if (in[i] != '\\' || i + 1 == in.size()) {
+      out += in[i];
+      continue;
+    }
+    const char c = in[++i];
+    out += c == 'n' ? '\n' : c == 'r' ? '\r' : c == 't' ? '\t' : c;
+  }
+  return out;
+}
+
+static uint32_t jsonU32(const std::string &payload, const char *key) {
+  const size_t at = payload.find(std::string("\"") + key + "\":");
+  return at == std::string::npos ? 0 : (uint32_t)strtoul(payload.c_str() + at + strlen(key) + 3, nullptr, 10);
+}
+
+struct Block {
+  uint32_t id = 0;
+  uint32_t seq = 0;
+  bool last = false;
+  std::string data;
+};
+
+// Decodes JSON csv_block notifications (txChar) and binary frames
+// (exportChar), expanding LZ payloads like the web app does.
+static bool decodeBlock(const std::string &payload, bool binary, Block &out) {
+  if (binary) {
+    if (payload.size() < EXPORT_HEADER_BYTES) return false;
+    const uint8_t *h = (const uint8_t *)payload.data();
+    const size_t len = h[2] | (h[3] << 8);
+    TEST_ASSERT_EQUAL(len + EXPORT_HEADER_BYTES, payload.size());
+    out.id = h[0];
+    out.last = h[1] & EXPORT_FLAG_LAST;
+    out.seq = h[4] | (h[5] << 8) | (h[6] << 16) | ((uint32_t)h[7] << 24);
+    out.data = payload.substr(EXPORT_HEADER_BYTES);
+    if (h[1] & EXPORT_FLAG_LZ) {
+      std::string raw;
+      TEST_ASSERT_TRUE(lzBlockDecode(h + EXPORT_HEADER_BYTES, len, raw));
+      out.data = raw;
+    }
+    return true;
+  }
+  if (payload.find("{\"csv_block\":") != 0) return false;
+  out.id = jsonU32(payload, "id");
+  out.seq = jsonU32(payload, "seq");
+  out.last = payload.find("\"last\":true") != std::string::npos;
+  const size_t from = payload.find("\"data\":\"") + 8;
+  out.data = unescapeJson(payload.substr(from, payload.rfind("\"}}") - from));
+  return true;
+}
+
+// The receiving side of the web app: buffers out-of-order blocks, nacks
+// gaps and acks cumulatively.
+struct Central {
+  bool binary = false;
+  uint32_t id = 0;
+  uint32_t next = 0;
+  int64_t lastSeq = -1;
+  std::map<uint32_t, std::string> blocks;
+
+  bool done() const { return lastSeq >= 0 && next == (uint32_t)lastSeq + 1; }
+  std::string ack() const {
+    return "{\"action\":\"csv_ack\",\"id\":" + std::to_string(id) + ",\"seq\":" + std::to_string(next - 1) + "}";
+  }
+  std::string nack(uint32_t seq) const {
+    return "{\"action\":\"csv_nack\",\"id\":" + std::to_string(id) + ",\"seq\":" + std::to_string(seq) + "}";
+  }
+  // Returns the nacks to send for the gap this block reveals.
+  std::vector<std::string> receive(const Block &block) {
+    std::vector<std::string> nacks;
+    id = block.id;
+    blocks[block.seq] = block.data;
+    if (block.last) lastSeq = block.seq;
+    for (uint32_t seq = next; seq < block.seq; seq++) {
+      if (!blocks.count(seq)) nacks.push_back(nack(seq));
+    }
+    while (blocks.count(next)) next++;
+    return nacks;
+  }
+  std::string joined() const {
+    std::string out;
+    for (const auto &entry : blocks) {
+      if (entry.first && !binary) out += "\n";
+      out += entry.second;
+    }
+    return out;
+  }
+};
+
+static NimBLECharacteristic *streamChar(bool binary) {
+  return host::bleCharacteristic(binary ? UUID_EXPORT : UUID_DATA);
+}
+
+// Runs one export to completion over a link that drops blocks and acks at
+// dropRate; every failEvery-th notify() fails in the controller.
+static std::string runLossy(const std::string &request, double dropRate, uint32_t failEvery, unsigned seed,
+                            uint32_t *notifications = nullptr) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> coin(0, 1);
+  Central central;
+  central.binary = request.find("\"binary\"") != std::string::npos;
+  NimBLECharacteristic *chr = streamChar(central.binary);
+  size_t seen = chr->notified.size();
+  uint32_t sent = 0;
+  host::notifyFailEvery = failEvery;
+  command(request);
+  for (int step = 0; step < 100000 && csvStreamActive; step++) {
+    pumpCsvStream();
+    for (; seen < chr->notified.size(); seen++) {
+      Block block;
+      if (!decodeBlock(chr->notified[seen], central.binary, block)) continue;
+      sent++;
+      if (coin(rng) < dropRate) continue;
+      for (const std::string &nack : central.receive(block)) command(nack);
+      if (central.next > 0 && coin(rng) >= dropRate) command(central.ack());
+    }
+    host::advanceMs(50);
+  }
+  host::notifyFailEvery = 0;
+  TEST_ASSERT_FALSE(csvStreamActive);
+  TEST_ASSERT_TRUE(central.done());
+  if (notifications) *notifications = sent;
+  return central.joined();
+}
+
+static bool booted = false;
+static std::string fullLog;
+
+void setUp(void) {
+  if (booted) return;
+  setup();
+  host::bleConnect(185);
+  host::bleSubscribe(UUID_DATA);
+  command("{\"epoch_ms\":" + std::to_string(EPOCH_MS) + ",\"store_flash\":true}");
+  logRows(1500, "csv");
+  logRows(1500, "bin");
+  logRows(500, "csv");
+  fullLog = reference();
+  booted = true;
+}
+
+void tearDown(void) {}
+
+static void test_reference_covers_every_row(void) {
+  TEST_ASSERT_EQUAL(3501, std::count(fullLog.begin(), fullLog.end(), '\n') + 1);
+  TEST_ASSERT_GREATER_THAN(1, logRing.segmentCount());
+}
+
+static void test_stop_and_wait_still_works(void) {
+  uint32_t blocks = 0;
+  TEST_ASSERT_TRUE(runLossy("{\"action\":\"flash_stream\"}", 0, 0, 1, &blocks) == fullLog);
+  TEST_ASSERT_GREATER_THAN(100, blocks);
+}
+
+static void test_window_is_capped_and_echoed(void) {
+  NimBLECharacteristic *chr = streamChar(false);
+  const size_t before = chr->notified.size();
+  command("{\"action\":\"flash_stream\",\"window\":40}");
+  pumpCsvStream();
+  Block first;
+  size_t blocks = 0;
+  for (size_t i = before; i < chr->notified.size(); i++) {
+    if (!decodeBlock(chr->notified[i], false, first)) continue;
+    if (blocks++ == 0) TEST_ASSERT_TRUE(chr->notified[i].find("\"window\":16") != std::string::npos);
+  }
+  TEST_ASSERT_EQUAL(CSV_WINDOW_MAX, blocks);
+  command("{\"action\":\"flash_stream_stop\"}");
+  TEST_ASSERT_FALSE(csvStreamActive);
+}
+
+static void test_window_survives_loss_and_failed_notifies(void) {
+  TEST_ASSERT_TRUE(runLossy("{\"action\":\"flash_stream\",\"window\":8}", 0.1, 7, 2) == fullLog);
+  TEST_ASSERT_TRUE(runLossy("{\"action\":\"flash_export\",\"window\":16}", 0.3, 0, 3) == fullLog);
+}
+
+static void test_ranged_export_under_loss(void) {
+  const uint64_t from = EPOCH_MS + 1600 * 1000ULL;
+  const uint64_t to = EPOCH_MS + 2400 * 1000ULL;
+  const std::string expected = reference(epochToLocalMs(from), epochToLocalMs(to));
+  const size_t lines = std::count(expected.begin(), expected.end(), '\n');
+  TEST_ASSERT_INT_WITHIN(5, 800, lines);
+  const std::string range = ",\"from_ms\":" + std::to_string(from) + ",\"to_ms\":" + std::to_string(to) + "}";
+  TEST_ASSERT_TRUE(runLossy("{\"action\":\"flash_stream\",\"window\":4" + range, 0.1, 0, 4) == expected);
+}
+
+static void test_binary_framing_under_loss(void) {
+  TEST_ASSERT_TRUE(runLossy("{\"action\":\"flash_stream\",\"window\":8,\"framing\":\"binary\"}", 0.2, 5, 5)
+                   == fullLog + "\n");
+}
+
+static void test_lz_framing_under_loss(void) {
+  uint32_t plain = 0;
+  uint32_t packed = 0;
+  TEST_ASSERT_TRUE(runLossy("{\"action\":\"flash_stream\",\"window\":8,\"framing\":\"binary\"}", 0, 0, 6, &plain)
+                   == fullLog + "\n");
+  TEST_ASSERT_TRUE(runLossy("{\"action\":\"flash_stream\",\"window\":8,\"framing\":\"binary\",\"format\":\"lz\"}",
+                            0.2, 5, 7) == fullLog + "\n");
+  TEST_ASSERT_TRUE(runLossy("{\"action\":\"flash_stream\",\"window\":8,\"framing\":\"binary\",\"format\":\"lz\"}",
+                            0, 0, 8, &packed) == fullLog + "\n");
+  char line[64];
+  snprintf(line, sizeof(line), "binary frames: %lu plain, %lu lz", (unsigned long)plain, (unsigned long)packed);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_LESS_THAN(plain / 2, packed);
+}
+
+// Loopback link: every notification occupies the air for its bytes plus
+// ATT/L2CAP/LL overhead at 1M PHY, then arrives latencyMs later; a write
+// from the central reaches the device latencyMs after it was sent.
+struct LinkResult {
+  double kBps;
+  uint32_t blocks;
+};
+
+static LinkResult runLoopback(const char *framing, uint16_t mtu, uint32_t latencyMs, uint32_t window) {
+  const bool binary = strcmp(framing, "json") != 0;
+  host::bleMtu = mtu;
+  bleMtu = mtu;
+  Central central;
+  central.binary = binary;
+  NimBLECharacteristic *chr = streamChar(binary);
+  size_t seen = chr->notified.size();
+  std::string request = "{\"action\":\"flash_stream\",\"window\":" + std::to_string(window);
+  if (binary) request += ",\"framing\":\"binary\"";
+  if (strcmp(framing, "lz") == 0) request += ",\"format\":\"lz\"";
+  request += "}";
+
+  typedef std::pair<uint64_t, std::string> Event;
+  auto later = [](const Event &a, const Event &b) { return a.first > b.first; };
+  std::priority_queue<Event, std::vector<Event>, decltype(later)> toCentral(later);
+  std::priority_queue<Event, std::vector<Event>, decltype(later)> toDevice(later);
+  const uint64_t latencyUs = latencyMs * 1000ULL;
+  const uint64_t startUs = host::nowUs;
+  uint64_t airFreeUs = startUs;
+  uint64_t doneUs = startUs;
+  uint32_t blocks = 0;
+  command(request);
+  while (csvStreamActive) {
+    pumpCsvStream();
+    for (; seen < chr->notified.size(); seen++) {
+      const std::string &payload = chr->notified[seen];
+      airFreeUs = std::max(airFreeUs, host::nowUs) + (payload.size() + 14) * 8 + 300;
+      toCentral.push(Event(airFreeUs + latencyUs, payload));
+    }
+    uint64_t next = UINT64_MAX;
+    if (!toCentral.empty()) next = toCentral.top().first;
+    if (!toDevice.empty()) next = std::min(next, toDevice.top().first);
+    if (next == UINT64_MAX) break;
+    host::nowUs = std::max(host::nowUs, next);
+    while (!toCentral.empty() && toCentral.top().first <= host::nowUs) {
+      Block block;
+      if (decodeBlock(toCentral.top().second, binary, block)) {
+        blocks++;
+        central.receive(block);
+        toDevice.push(Event(host::nowUs + latencyUs, central.ack()));
+        if (central.done()) doneUs = host::nowUs;
+      }
+      toCentral.pop();
+    }
+    while (!toDevice.empty() && toDevice.top().first <= host::nowUs) {
+      command(toDevice.top().second);
+      toDevice.pop();
+    }
+  }
+  TEST_ASSERT_TRUE(central.done());
+  TEST_ASSERT_TRUE(central.joined() == (binary ? fullLog + "\n" : fullLog));
+  LinkResult result;
+  result.kBps = fullLog.size() / 1024.0 / ((doneUs - startUs) / 1e6);
+  result.blocks = blocks;
+  return result;
+}
+
+static void test_loopback_throughput(void) {
+  const uint16_t mtus[] = {23, 185, 247};
+  const uint32_t latencies[] = {8, 30, 100};
+  const uint32_t windows[] = {1, 4, 16};
+  const char *framings[] = {"json", "binary", "lz"};
+  TEST_MESSAGE("framing mtu latency_ms window kB/s blocks");
+  for (const char *framing : framings) {
+    for (uint16_t mtu : mtus) {
+      for (uint32_t latency : latencies) {
+        for (uint32_t window : windows) {
+          const LinkResult r = runLoopback(framing, mtu, latency, window);
+          char line[96];
+          snprintf(line, sizeof(line), "%-6s %3u %3lu %2lu %7.1f %5lu", framing, mtu, (unsigned long)latency,
+                   (unsigned long)window, r.kBps, (unsigned long)r.blocks);
+          TEST_MESSAGE(line);
+        }
+      }
+    }
+  }
+  const double stopAndWait = runLoopback("json", 185, 30, 1).kBps;
+  const double windowed = runLoopback("json", 185, 30, 16).kBps;
+  TEST_ASSERT_GREATER_THAN(8 * stopAndWait, windowed);
+  const double binary = runLoopback("binary", 185, 30, 16).kBps;
+  TEST_ASSERT_GREATER_THAN(windowed, binary);
+  TEST_ASSERT_GREATER_THAN(binary, runLoopback("lz", 185, 30, 16).kBps);
+  host::bleMtu = 185;
+  bleMtu = 185;
+}
+
+// Runs last: it appends to the log the earlier cases compare against.
+static void test_tsz_segments_export_like_the_others(void) {
+  const size_t before = logRing.bytes();
+  logRows(600, "csv");
+  const size_t csvBytes = logRing.bytes() - before;
+  logRows(600, "tsz");
+  const size_t tszBytes = logRing.bytes() - before - csvBytes;
+  const std::string expected = reference();
+  TEST_ASSERT_EQUAL(3501 + 1200, std::count(expected.begin(), expected.end(), '\n') + 1);
+  TEST_ASSERT_TRUE(runLossy("{\"action\":\"flash_stream\",\"window\":8}", 0.1, 0, 9) == expected);
+  char line[80];
+  snprintf(line, sizeof(line), "flash bytes/row: csv %.1f, tsz %.1f", csvBytes / 600.0, tszBytes / 600.0);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_LESS_THAN(csvBytes / 4, tszBytes);
+}
+
+// Delivers what the stream sends, acks it, and pumps until stop() holds.
+template <typename Stop>
+static void receiveUntil(Central &central, size_t &seen, Stop stop) {
+  NimBLECharacteristic *chr = streamChar(false);
+  for (int step = 0; step < 100000 && csvStreamActive && !stop(); step++) {
+    pumpCsvStream();
+    for (; seen < chr->notified.size(); seen++) {
+      Block block;
+      if (!decodeBlock(chr->notified[seen], false, block)) continue;
+      central.receive(block);
+      command(central.ack());
+    }
+    host::advanceMs(50);
+  }
+}
+
+// Runs last too. A dropped client leaves the stream suspended while
+// sampling and logging go on; the resumed stream carries on from the first
+// missing block and picks up the rows logged meanwhile.
+static void test_disconnect_keeps_logging_and_resumes(void) {
+  const size_t linesBefore = std::count(fullLog.begin(), fullLog.end(), '\n');
+  Central central;
+  size_t seen = streamChar(false)->notified.size();
+  command("{\"action\":\"flash_stream\",\"window\":4}");
+  receiveUntil(central, seen, [&] { return central.next >= 10; });
+  TEST_ASSERT_FALSE(central.done());
+
+  host::bleDisconnect();
+  // onDisconnect() runs on the NimBLE host task and only raises a flag.
+  TEST_ASSERT_FALSE(csvStreamSuspended);
+  TEST_ASSERT_TRUE(csvExportInProgress);
+  loop();
+  TEST_ASSERT_TRUE(csvStreamActive);
+  TEST_ASSERT_TRUE(csvStreamSuspended);
+  TEST_ASSERT_FALSE(csvExportInProgress);
+  while (bleResetPending) loop();
+  logRows(30, "csv");
+
+  const std::string expected = reference();
+  TEST_ASSERT_GREATER_OR_EQUAL(linesBefore + 30, (size_t)std::count(expected.begin(), expected.end(), '\n'));
+  host::bleConnect(185);
+  host::bleSubscribe(UUID_DATA);
+  seen = streamChar(false)->notified.size();  // bleReset() made new characteristics
+  command("{\"action\":\"flash_stream\",\"resume_id\":" + std::to_string(central.id)
+          + ",\"offset\":" + std::to_string(central.next) + "}");
+  TEST_ASSERT_FALSE(csvStreamSuspended);
+  TEST_ASSERT_TRUE(csvExportInProgress);
+  receiveUntil(central, seen, [] { return false; });
+  TEST_ASSERT_FALSE(csvStreamActive);
+  TEST_ASSERT_TRUE(central.done());
+  TEST_ASSERT_TRUE(central.joined() == expected);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_reference_covers_every_row);
+  RUN_TEST(test_stop_and_wait_still_works);
+  RUN_TEST(test_window_is_capped_and_echoed);
+  RUN_TEST(test_window_survives_loss_and_failed_notifies);
+  RUN_TEST(test_ranged_export_under_loss);
+  RUN_TEST(test_binary_framing_under_loss);
+  RUN_TEST(test_lz_framing_under_loss);
+  RUN_TEST(test_loopback_throughput);
+  RUN_TEST(test_tsz_segments_export_like_the_others);
+  RUN_TEST(test_disconnect_keeps_logging_and_resumes);
+  return UNITY_END();
+}
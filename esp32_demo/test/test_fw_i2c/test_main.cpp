@@ -0,0 +1,268 @@
+// I2C bring-up on the simulated bus: which addresses the firmware puts on
+// the wire when it probes, rescans and scans on request, and which clock
+// it settles on. A device above its maxHz does not ACK.
+
+#include "../../src/main.cpp"
+
+#include <Ms5611Model.h>
+#include <unity.h>
+
+#include <set>
+
+static I2cRegisterDevice bmp;
+static I2cRegisterDevice bme;
+static Ms5611Model ms;
+
+// ACKs at any rate, but its reads come back corrupted above 400 kHz, like
+// long wires with weak pull-ups.
+class MarginalBmp : public I2cRegisterDevice {
+ public:
+  size_t read(uint8_t *out, size_t len) override {
+    const size_t n = I2cRegisterDevice::read(out, len);
+    if (Wire.getClock() > 400000) {
+      for (size_t i = 0; i < n; i++) out[i] ^= 0x10;
+    }
+    return n;
+  }
+};
+
+static void command(const std::string &json) {
+  host::bleWrite(UUID_CONFIG, json);
+  processBleCommands();
+}
+
+static std::set<uint8_t> addressed() {
+  return std::set<uint8_t>(host::i2cAddressed.begin(), host::i2cAddressed.end());
+}
+
+static bool printed(const char *text) {
+  return Serial.output.find(text) != std::string::npos;
+}
+
+static size_t count(const std::string &text, const char *needle) {
+  size_t n = 0;
+  for (size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1)) n++;
+  return n;
+}
+
+static uint32_t storedHz() {
+  ensurePrefs();
+  return prefs.getUInt("i2c_hz", 0);
+}
+
+// Cold probe: no cache, no stored rate.
+static void coldProbe() {
+  storeSensorCache(SensorCache());
+  i2cStoredHz = 0;
+  scanSensors();
+}
+
+static void resetBus() {
+  host::i2cAddressed.clear();
+  Serial.output.clear();
+}
+
+void setUp(void) {
+  static bool booted = false;
+  if (!booted) {
+    setup();
+    command("{\"sensor\":\"i2c\"}");
+    booted = true;
+  }
+  bmp.regs[0xD0] = 0x58;
+  bme.regs[0xD0] = 0x61;
+  bmp.maxHz = bme.maxHz = ms.maxHz = 1000000;
+  host::i2cDevices.clear();
+  clearSensors();
+  storeSensorCache(SensorCache());
+  resetBus();
+}
+
+void tearDown(void) {}
+
+static void test_probe_touches_only_the_sensor_addresses(void) {
+  host::i2cDevices[0x76] = &bmp;
+  host::i2cDevices[0x77] = &bme;
+  host::i2cDevices[0x3C] = &bmp;  // a display, say
+  scanSensors();
+  TEST_ASSERT_NOT_NULL(bmp280);
+  TEST_ASSERT_NOT_NULL(bme680);
+  TEST_ASSERT_EQUAL(0x76, bmpAddr);
+  TEST_ASSERT_EQUAL(0x77, bmeAddr);
+  TEST_ASSERT_TRUE((addressed() == std::set<uint8_t>{0x76, 0x77}));
+  char line[128];
+  snprintf(line, sizeof(line), "probe and clock check: %lu transactions on 2 addresses (full scan: 117 addresses)",
+           (unsigned long)host::i2cAddressed.size());
+  TEST_MESSAGE(line);
+}
+
+static void test_empty_bus_probes_two_addresses_per_rescan(void) {
+  rescanJob();
+  TEST_ASSERT_NULL(bmp280);
+  TEST_ASSERT_TRUE(printed("[I2C] Aucun capteur reconnu"));
+  TEST_ASSERT_TRUE((addressed() == std::set<uint8_t>{0x76, 0x77}));
+  TEST_ASSERT_FALSE(printed("[I2C] Scan..."));
+  TEST_ASSERT_LESS_OR_EQUAL(6, host::i2cAddressed.size());
+}
+
+// A known-good topology costs one ACK per driver and keeps the drivers.
+static void test_rescan_of_a_known_topology_is_ack_only(void) {
+  host::i2cDevices[0x76] = &bmp;
+  host::i2cDevices[0x77] = &bme;
+  scanSensors();
+  const Adafruit_BMP280 *bmpDriver = bmp280;
+  const Bsec2 *bmeDriver = bme680;
+  resetBus();
+  scheduleImmediateSensorPush();
+  TEST_ASSERT_TRUE(i2cScanPending);
+  rescanJob();
+  TEST_ASSERT_FALSE(i2cScanPending);
+  TEST_ASSERT_EQUAL(2, host::i2cAddressed.size());
+  TEST_ASSERT_TRUE((addressed() == std::set<uint8_t>{0x76, 0x77}));
+  TEST_ASSERT_TRUE(bmp280 == bmpDriver);
+  TEST_ASSERT_TRUE(bme680 == bmeDriver);
+  TEST_ASSERT_FALSE(printed("scanSensors start"));
+}
+
+static void test_unplugged_sensor_triggers_a_probe(void) {
+  host::i2cDevices[0x76] = &bmp;
+  host::i2cDevices[0x77] = &bme;
+  scanSensors();
+  host::i2cDevices.erase(0x77);
+  resetBus();
+  i2cScanPending = true;
+  rescanJob();
+  TEST_ASSERT_TRUE(printed("scanSensors start"));
+  TEST_ASSERT_NOT_NULL(bmp280);
+  TEST_ASSERT_NULL(bme680);
+  TEST_ASSERT_EQUAL(0, sensorCache.bmeAddr);
+  TEST_ASSERT_EQUAL(0x76, sensorCache.bmpAddr);
+}
+
+// The diagnostic scan still walks the whole range, only on request.
+static void test_full_scan_on_request(void) {
+  host::i2cDevices[0x3C] = &bmp;
+  host::i2cDevices[0x76] = &bmp;
+  command("{\"action\":\"i2c_scan\"}");
+  TEST_ASSERT_EQUAL(117, addressed().size());  // 0x03 to 0x77
+  TEST_ASSERT_TRUE(printed("\"ack\":\"i2c_scan\",\"status\":\"ok\",\"message\":\"0X3C, 0X76\""));
+  TEST_ASSERT_NULL(bmp280);
+}
+
+// Drivers bound to the old wiring would pass the address-only ACK check.
+static void test_new_pins_drop_the_drivers(void) {
+  host::i2cDevices[0x76] = &bmp;
+  scanSensors();
+  TEST_ASSERT_NOT_NULL(bmp280);
+  const int sda = deviceConfig.i2cSda == 4 ? 5 : 4;
+  command("{\"i2c\":{\"sda\":" + std::to_string(sda) + "}}");
+  TEST_ASSERT_NULL(bmp280);
+  TEST_ASSERT_TRUE(i2cScanPending);
+  rescanJob();
+  TEST_ASSERT_NOT_NULL(bmp280);
+  TEST_ASSERT_EQUAL(sda, sensorCache.pinA);
+}
+
+static void test_clock_goes_to_800k_without_an_ms5611(void) {
+  host::i2cDevices[0x76] = &bmp;
+  host::i2cDevices[0x77] = &bme;
+  coldProbe();
+  TEST_ASSERT_EQUAL(800000, Wire.getClock());
+  TEST_ASSERT_EQUAL(800000, i2cClockHz);
+  TEST_ASSERT_EQUAL(800000, storedHz());
+  TEST_ASSERT_EQUAL(0, count(Serial.output, "[I2C] Echec"));
+  TEST_ASSERT_TRUE(buildConfigJson().find("\"hz\":800000") != std::string::npos);
+}
+
+// The MS5611 is rated for 400 kHz, so that is the ceiling with one on the
+// bus, even though the model would answer faster.
+static void test_ms5611_caps_the_clock_at_400k(void) {
+  host::i2cDevices[0x76] = &bmp;
+  host::i2cDevices[0x77] = &ms;
+  coldProbe();
+  TEST_ASSERT_NOT_NULL(ms5611);
+  TEST_ASSERT_NOT_NULL(bmp280);
+  TEST_ASSERT_EQUAL(400000, i2cClockHz);
+  TEST_ASSERT_EQUAL(0, count(Serial.output, "[I2C] Echec"));
+}
+
+static void test_nack_steps_the_clock_down(void) {
+  host::i2cDevices[0x76] = &bmp;
+  bmp.maxHz = 400000;
+  coldProbe();
+  TEST_ASSERT_EQUAL(400000, i2cClockHz);
+  TEST_ASSERT_EQUAL(1, count(Serial.output, "[I2C] Echec a 800 kHz"));
+
+  bmp.maxHz = 100000;
+  resetBus();
+  coldProbe();
+  TEST_ASSERT_NOT_NULL(bmp280);
+  TEST_ASSERT_EQUAL(100000, i2cClockHz);
+  TEST_ASSERT_EQUAL(100000, storedHz());
+  TEST_ASSERT_EQUAL(1, count(Serial.output, "[I2C] Echec a 800 kHz"));
+  TEST_ASSERT_EQUAL(1, count(Serial.output, "[I2C] Echec a 400 kHz"));
+}
+
+// An ACK alone is not enough: IDs that read back wrong step down too.
+static void test_corrupted_ids_step_the_clock_down(void) {
+  MarginalBmp marginal;
+  marginal.regs[0xD0] = 0x58;
+  host::i2cDevices[0x76] = &marginal;
+  coldProbe();
+  TEST_ASSERT_NOT_NULL(bmp280);
+  TEST_ASSERT_EQUAL(400000, i2cClockHz);
+  TEST_ASSERT_EQUAL(1, count(Serial.output, "[I2C] Echec a 800 kHz"));
+  clearSensors();
+}
+
+// A warm boot from the sensor cache starts at the stored rate instead of
+// failing at the ceiling again.
+static void test_warm_boot_starts_at_the_stored_rate(void) {
+  host::i2cDevices[0x76] = &bmp;
+  bmp.maxHz = 400000;
+  coldProbe();
+  TEST_ASSERT_EQUAL(400000, storedHz());
+  clearSensors();
+  sensorCache = SensorCache();
+  i2cStoredHz = 0;
+  loadConfig();
+  resetBus();
+  TEST_ASSERT_EQUAL(400000, i2cStoredHz);
+  initSensorsAtBoot();
+  TEST_ASSERT_TRUE(printed("depuis le cache"));
+  TEST_ASSERT_EQUAL(400000, i2cClockHz);
+  TEST_ASSERT_EQUAL(0, count(Serial.output, "[I2C] Echec"));
+}
+
+// The diagnostic scan runs at 100 kHz, so it also finds devices that
+// cannot follow the negotiated rate, then puts the rate back.
+static void test_full_scan_runs_at_the_safe_rate(void) {
+  I2cRegisterDevice slow;
+  slow.maxHz = 100000;
+  host::i2cDevices[0x76] = &bmp;
+  host::i2cDevices[0x3C] = &slow;
+  coldProbe();
+  TEST_ASSERT_EQUAL(800000, i2cClockHz);
+  command("{\"action\":\"i2c_scan\"}");
+  TEST_ASSERT_TRUE(printed("\"message\":\"0X3C, 0X76\""));
+  TEST_ASSERT_EQUAL(800000, Wire.getClock());
+  TEST_ASSERT_EQUAL(800000, i2cClockHz);
+  host::i2cDevices.erase(0x3C);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_probe_touches_only_the_sensor_addresses);
+  RUN_TEST(test_empty_bus_probes_two_addresses_per_rescan);
+  RUN_TEST(test_rescan_of_a_known_topology_is_ack_only);
+  RUN_TEST(test_unplugged_sensor_triggers_a_probe);
+  RUN_TEST(test_full_scan_on_request);
+  RUN_TEST(test_new_pins_drop_the_drivers);
+  RUN_TEST(test_clock_goes_to_800k_without_an_ms5611);
+  RUN_TEST(test_ms5611_caps_the_clock_at_400k);
+  RUN_TEST(test_nack_steps_the_clock_down);
+  RUN_TEST(test_corrupted_ids_step_the_clock_down);
+  RUN_TEST(test_warm_boot_starts_at_the_stored_rate);
+  RUN_TEST(test_full_scan_runs_at_the_safe_rate);
+  return UNITY_END();
+}
@@ -0,0 +1,132 @@
+// loop() on the simulated clock: it sleeps until the scheduler's next
+// deadline, and BLE writes and button edges cut the wait short.
+
+#include "../../src/main.cpp"
+
+#include <unity.h>
+
+#include <vector>
+
+static void command(const std::string &json) {
+  host::bleWrite(UUID_CONFIG, json);
+  processBleCommands();
+}
+
+// Runs loop() until simulated time reaches endMs; returns the wakeups and
+// records the millis() of every sampling tick.
+static uint32_t runUntil(uint64_t endMs, std::vector<uint32_t> *ticks = nullptr) {
+  uint32_t wakes = 0;
+  while (millis() < endMs) {
+    const uint32_t deadline = sampleDeadline;
+    const uint32_t now = millis();
+    loop();
+    wakes++;
+    if (ticks && sampleDeadline != deadline) ticks->push_back(now);
+  }
+  return wakes;
+}
+
+// Runs loop() until done() holds; returns the millis() at which the
+// iteration that did it started, i.e. before its own wait.
+template <typename Done>
+static uint32_t loopUntil(Done done, uint32_t timeoutMs = 2000) {
+  const uint32_t endMs = millis() + timeoutMs;
+  while (millis() < endMs) {
+    const uint32_t startedAt = millis();
+    loop();
+    if (done()) return startedAt;
+  }
+  TEST_FAIL_MESSAGE("loop() never got there");
+  return 0;
+}
+
+static bool booted = false;
+
+void setUp(void) {
+  if (booted) return;
+  setup();
+  host::bleConnect(185);
+  host::bleSubscribe(UUID_DATA);
+  command("{\"sensor\":\"random\",\"frequency\":1000,\"store_flash\":false}");
+  runUntil(millis() + 2000);
+  booted = true;
+}
+
+void tearDown(void) {
+  host::waitEvent = nullptr;
+}
+
+static void test_idle_loop_sleeps_between_deadlines(void) {
+  const uint64_t startUs = host::nowUs;
+  const uint64_t blockedBefore = host::blockedUs;
+  std::vector<uint32_t> ticks;
+  const uint32_t wakes = runUntil(millis() + 60000, &ticks);
+  const double blocked = (double)(host::blockedUs - blockedBefore) / (host::nowUs - startUs);
+  char line[128];
+  snprintf(line, sizeof(line), "60 s at 1 Hz: %lu wakeups (10 ms polling: 6000), %lu samples, blocked %.1f%%",
+           (unsigned long)wakes, (unsigned long)ticks.size(), blocked * 100);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_INT_WITHIN(1, 60, ticks.size());
+  TEST_ASSERT_LESS_THAN(6000 / 5, wakes);
+  TEST_ASSERT_GREATER_THAN(0.99, blocked);
+}
+
+static void test_sampling_keeps_its_grid(void) {
+  std::vector<uint32_t> ticks;
+  runUntil(millis() + 10000, &ticks);
+  TEST_ASSERT_GREATER_THAN(8, ticks.size());
+  for (size_t i = 1; i < ticks.size(); i++) TEST_ASSERT_EQUAL(1000, ticks[i] - ticks[i - 1]);
+  // A stall longer than the interval moves the grid instead of firing
+  // catch-up samples.
+  host::advanceMs(3500);
+  const uint32_t stalledAt = millis();
+  ticks.clear();
+  runUntil(millis() + 2500, &ticks);
+  TEST_ASSERT_EQUAL(3, ticks.size());
+  TEST_ASSERT_EQUAL(stalledAt, ticks[0]);
+  TEST_ASSERT_EQUAL(1000, ticks[1] - ticks[0]);
+}
+
+static void bleWriteDuringWait() {
+  host::bleWrite(UUID_CONFIG, "{\"name\":\"Phenix loop\"}");
+}
+
+static void test_ble_write_ends_the_wait(void) {
+  runUntil(millis() + 1);
+  const uint32_t writeAt = millis() + 37;
+  host::waitEvent = bleWriteDuringWait;
+  host::waitEventAtUs = writeAt * 1000ULL;
+  const uint32_t handledAt = loopUntil([] { return deviceConfig.name == "Phenix loop"; });
+  TEST_ASSERT_EQUAL(writeAt, handledAt);
+}
+
+static const uint8_t BUTTON_PIN = 9;
+
+static void pressButton() { host::drivePin(BUTTON_PIN, LOW); }
+
+static void test_button_edge_ends_the_wait(void) {
+  host::pinLevel[BUTTON_PIN] = HIGH;
+  command("{\"button\":{\"pin\":9}}");
+  runUntil(millis() + 100);
+  const bool recording = deviceConfig.storeFlash;
+  const uint32_t pressAt = millis() + 250;
+  host::waitEvent = pressButton;
+  host::waitEventAtUs = pressAt * 1000ULL;
+  const uint32_t handledAt = loopUntil([&] { return deviceConfig.storeFlash != recording; });
+  char line[64];
+  snprintf(line, sizeof(line), "button press handled after %lu ms", (unsigned long)(handledAt - pressAt));
+  TEST_MESSAGE(line);
+  // The edge ends the wait; the debounce window is all that remains.
+  TEST_ASSERT_LESS_OR_EQUAL(BUTTON_DEBOUNCE_MS + 2, handledAt - pressAt);
+  host::drivePin(BUTTON_PIN, HIGH);
+  runUntil(millis() + 100);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_idle_loop_sleeps_between_deadlines);
+  RUN_TEST(test_sampling_keeps_its_grid);
+  RUN_TEST(test_ble_write_ends_the_wait);
+  RUN_TEST(test_button_edge_ends_the_wait);
+  return UNITY_END();
+}
@@ -0,0 +1,142 @@
+// The firmware's MS5611 path on the simulated bus: conversions are
+// collected by ms5611Job() on later scheduler ticks, so loop() never calls
+// delay() for them, and ms5611_hz keeps converting between samples.
+
+#include "../../src/main.cpp"
+
+#include <Ms5611Model.h>
+#include <unity.h>
+
+static Ms5611Model ms;
+
+static void command(const std::string &json) {
+  host::bleWrite(UUID_CONFIG, json);
+  processBleCommands();
+}
+
+static bool acked(const char *text) {
+  return Serial.output.find(text) != std::string::npos;
+}
+
+// Runs loop() for durationMs of simulated time; returns the sampling ticks.
+static uint32_t runFor(uint32_t durationMs) {
+  const uint32_t endMs = millis() + durationMs;
+  uint32_t ticks = 0;
+  while (millis() < endMs) {
+    const uint32_t deadline = sampleDeadline;
+    loop();
+    if (sampleDeadline != deadline) ticks++;
+  }
+  return ticks;
+}
+
+static size_t gy63Notifications() {
+  size_t n = 0;
+  for (const std::string &payload : host::bleCharacteristic(UUID_DATA)->notified) {
+    if (payload.find("gy63") != std::string::npos) n++;
+  }
+  return n;
+}
+
+void setUp(void) {
+  static bool booted = false;
+  if (!booted) {
+    host::i2cDevices[0x77] = &ms;
+    setup();
+    host::bleConnect(185);
+    host::bleSubscribe(UUID_DATA);
+    command("{\"sensor\":\"i2c\",\"frequency\":1000,\"store_flash\":false}");
+    runFor(2000);
+    booted = true;
+  }
+  command("{\"ms5611_hz\":0,\"ms5611_osr\":4096}");
+  runFor(1000);
+  ms.conversions = ms.pressureResults = ms.earlyReads = ms.ignoredCommands = 0;
+  Serial.output.clear();
+}
+
+void tearDown(void) {}
+
+static void test_detected_at_0x77(void) {
+  TEST_ASSERT_NOT_NULL(ms5611);
+  TEST_ASSERT_EQUAL_HEX8(0x77, ms5611->address());
+  TEST_ASSERT_TRUE(ms5611->promCrcOk());
+}
+
+static void test_one_hz_sampling_never_waits_in_loop(void) {
+  const uint64_t delayedBefore = host::delayedUs;
+  const size_t published = gy63Notifications();
+  const uint32_t ticks = runFor(10000);
+  char line[128];
+  snprintf(line, sizeof(line), "10 s at 1 Hz: %lu ticks, %lu pressure results, %lu early reads, delay() %lu us",
+           (unsigned long)ticks, (unsigned long)ms.pressureResults, (unsigned long)ms.earlyReads,
+           (unsigned long)(host::delayedUs - delayedBefore));
+  TEST_MESSAGE(line);
+  TEST_ASSERT_INT_WITHIN(1, 10, ticks);
+  TEST_ASSERT_INT_WITHIN(1, 10, ms.pressureResults);
+  TEST_ASSERT_INT_WITHIN(1, 10, gy63Notifications() - published);
+  TEST_ASSERT_TRUE(host::delayedUs == delayedBefore);
+  TEST_ASSERT_EQUAL(0, ms.earlyReads);
+  TEST_ASSERT_EQUAL(0, ms.ignoredCommands);
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, 1000.09f, ms5611->pressureHpa());
+}
+
+static void test_continuous_rate_between_samples(void) {
+  command("{\"ms5611_hz\":50}");
+  TEST_ASSERT_TRUE(acked("[BLE] ACK:"));
+  const uint64_t delayedBefore = host::delayedUs;
+  runFor(1000);
+  ms.pressureResults = 0;
+  runFor(1000);
+  char line[96];
+  snprintf(line, sizeof(line), "ms5611_hz=50: %lu pressure results in 1 s, %lu conversions",
+           (unsigned long)ms.pressureResults, (unsigned long)ms.conversions);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_INT_WITHIN(1, 50, ms.pressureResults);
+  TEST_ASSERT_TRUE(host::delayedUs == delayedBefore);
+  TEST_ASSERT_EQUAL(0, ms.earlyReads);
+  TEST_ASSERT_EQUAL(0, ms.ignoredCommands);
+}
+
+// A fresh driver has no result yet: the first sample after a rescan waits
+// for the first continuous cycle instead of running one in delay().
+static void test_continuous_rate_after_rescan(void) {
+  command("{\"ms5611_hz\":50}");
+  clearSensors();
+  storeSensorCache(SensorCache());
+  scanSensors();
+  TEST_ASSERT_NOT_NULL(ms5611);
+  TEST_ASSERT_FALSE(ms5611->valid());
+  const uint64_t delayedBefore = host::delayedUs;
+  const size_t published = gy63Notifications();
+  const uint32_t ticks = runFor(3000);
+  TEST_ASSERT_TRUE(host::delayedUs == delayedBefore);
+  TEST_ASSERT_EQUAL(ticks, gy63Notifications() - published);
+  TEST_ASSERT_EQUAL(0, ms.earlyReads);
+  TEST_ASSERT_EQUAL(0, ms.ignoredCommands);
+}
+
+static void test_oversampling_config(void) {
+  command("{\"ms5611_osr\":1024}");
+  TEST_ASSERT_EQUAL(1024, deviceConfig.ms5611Osr);
+  TEST_ASSERT_EQUAL(Ms5611Async::OSR_1024, ms5611->oversampling());
+  runFor(2000);
+  TEST_ASSERT_EQUAL_HEX8(0x40 + Ms5611Async::OSR_1024, ms.lastConversion);
+
+  // Not a datasheet OSR: the field is dropped and the config left alone.
+  Serial.output.clear();
+  command("{\"ms5611_osr\":1000}");
+  TEST_ASSERT_EQUAL(1024, deviceConfig.ms5611Osr);
+  TEST_ASSERT_EQUAL(Ms5611Async::OSR_1024, ms5611->oversampling());
+  TEST_ASSERT_TRUE(acked("\"status\":\"error\""));
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_detected_at_0x77);
+  RUN_TEST(test_one_hz_sampling_never_waits_in_loop);
+  RUN_TEST(test_continuous_rate_between_samples);
+  RUN_TEST(test_continuous_rate_after_rescan);
+  RUN_TEST(test_oversampling_config);
+  return UNITY_END();
+}
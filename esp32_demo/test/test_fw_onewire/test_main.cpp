@@ -0,0 +1,343 @@
+// DS18B20 sampling on the simulated clock: a tick starts the conversion,
+// oneWireJob() reads the probes once the datasheet time for the configured
+// resolution has passed, and loop() keeps serving BLE in between. On a
+// multi-drop bus one conversion covers every cached ROM.
+
+#include "../../src/main.cpp"
+
+#include <unity.h>
+
+#include <map>
+
+static void command(const std::string &json) {
+  host::bleWrite(UUID_CONFIG, json);
+  processBleCommands();
+}
+
+static bool printed(const char *text) {
+  return Serial.output.find(text) != std::string::npos;
+}
+
+static uint32_t runFor(uint32_t durationMs) {
+  const uint32_t endMs = millis() + durationMs;
+  uint32_t ticks = 0;
+  while (millis() < endMs) {
+    const uint32_t deadline = sampleDeadline;
+    loop();
+    if (sampleDeadline != deadline) ticks++;
+  }
+  return ticks;
+}
+
+// Runs loop() up to the next sampling tick; returns the millis() it fired.
+static uint32_t runToTick() {
+  const uint32_t deadline = sampleDeadline;
+  while (sampleDeadline == deadline) loop();
+  return deadline;
+}
+
+static size_t ds18b20Notifications() {
+  size_t n = 0;
+  for (const std::string &payload : host::bleCharacteristic(UUID_DATA)->notified) {
+    if (payload.find("ds18b20") != std::string::npos) n++;
+  }
+  return n;
+}
+
+static void addProbe(uint8_t serial, uint8_t family = DS18B20MODEL) {
+  std::array<uint8_t, 8> rom = {family, serial, 0xA2, 0x33, 0x44, 0x55, 0x66, 0};
+  rom[7] = OneWire::crc8(rom.data(), 7);
+  host::oneWireRoms.push_back(rom);
+}
+
+static std::string romText(uint8_t serial) {
+  char text[17];
+  snprintf(text, sizeof(text), "28%02XA23344556600", serial);
+  std::array<uint8_t, 8> rom = {DS18B20MODEL, serial, 0xA2, 0x33, 0x44, 0x55, 0x66, 0};
+  snprintf(text + 14, 3, "%02X", OneWire::crc8(rom.data(), 7));
+  return text;
+}
+
+// Puts count DS18B20 probes on the bus, serials 0x10.., and re-inits it.
+static void useProbes(uint8_t count) {
+  host::oneWireRoms.clear();
+  for (uint8_t i = 0; i < count; i++) addProbe((uint8_t)(0x10 + i));
+  initOneWire();
+}
+
+static size_t countIn(const std::vector<std::string> &payloads, size_t from, const std::string &needle) {
+  size_t n = 0;
+  for (size_t i = from; i < payloads.size(); i++) {
+    for (size_t at = payloads[i].find(needle); at != std::string::npos; at = payloads[i].find(needle, at + 1)) n++;
+  }
+  return n;
+}
+
+void setUp(void) {
+  static bool booted = false;
+  if (!booted) {
+    addProbe(0x15);
+    setup();
+    host::bleConnect(185);
+    host::bleSubscribe(UUID_DATA);
+    command("{\"sensor\":\"onewire\",\"onewire\":{\"pin\":4},\"frequency\":1000,\"store_flash\":false}");
+    booted = true;
+  }
+  if (host::oneWireRoms.size() != 1) {
+    host::oneWireRoms.clear();
+    addProbe(0x15);
+    initOneWire();
+  }
+  command("{\"onewire\":{\"pin\":4,\"resolution\":12}}");
+  runFor(2000);
+  host::dallasEarlyReads = 0;
+  Serial.output.clear();
+}
+
+void tearDown(void) {
+  host::waitEvent = nullptr;
+}
+
+static void test_one_hz_sampling_never_waits_in_loop(void) {
+  TEST_ASSERT_NOT_NULL(ds18b20);
+  const uint64_t delayedBefore = host::delayedUs;
+  const uint32_t conversionsBefore = host::dallasConversions;
+  const size_t published = ds18b20Notifications();
+  const uint32_t ticks = runFor(10000);
+  char line[112];
+  snprintf(line, sizeof(line), "10 s at 1 Hz, 12 bits: %lu ticks, %lu conversions, delay() %lu us",
+           (unsigned long)ticks, (unsigned long)(host::dallasConversions - conversionsBefore),
+           (unsigned long)(host::delayedUs - delayedBefore));
+  TEST_MESSAGE(line);
+  TEST_ASSERT_INT_WITHIN(1, 10, ticks);
+  TEST_ASSERT_EQUAL(ticks, host::dallasConversions - conversionsBefore);
+  TEST_ASSERT_INT_WITHIN(1, ticks, ds18b20Notifications() - published);
+  TEST_ASSERT_TRUE(host::delayedUs == delayedBefore);
+  TEST_ASSERT_EQUAL(0, host::dallasEarlyReads);
+}
+
+// The readback follows the conversion time of the configured resolution.
+static void test_readback_after_datasheet_time(void) {
+  const uint8_t bits[] = {9, 10, 11, 12};
+  for (const uint8_t b : bits) {
+    char json[64];
+    snprintf(json, sizeof(json), "{\"onewire\":{\"pin\":4,\"resolution\":%u}}", b);
+    command(json);
+    TEST_ASSERT_EQUAL(b, deviceConfig.onewireBits);
+    TEST_ASSERT_EQUAL(b, host::dallasBits);
+    runFor(2000);
+    const uint32_t tickMs = runToTick();
+    runFor(900);
+    const uint32_t latencyMs = (uint32_t)(host::dallasLastReadUs / 1000) - tickMs;
+    TEST_ASSERT_GREATER_OR_EQUAL(DallasTemperature::millisToWaitForConversion(b), latencyMs);
+    TEST_ASSERT_LESS_OR_EQUAL(DallasTemperature::millisToWaitForConversion(b) + 1U, latencyMs);
+  }
+  TEST_ASSERT_EQUAL(0, host::dallasEarlyReads);
+}
+
+static void bleWriteDuringWait() {
+  host::bleWrite(UUID_CONFIG, "{\"name\":\"Phenix 1W\"}");
+}
+
+// A 12-bit conversion leaves loop() waiting on its deadlines, so a BLE
+// write 100 ms in is handled at once rather than after the readback.
+static void test_ble_is_served_during_a_conversion(void) {
+  runToTick();
+  TEST_ASSERT_TRUE(oneWireConverting);
+  const uint32_t writeAt = millis() + 100;
+  host::waitEvent = bleWriteDuringWait;
+  host::waitEventAtUs = writeAt * 1000ULL;
+  uint32_t handledAt = 0;
+  bool convertingThen = false;
+  while (deviceConfig.name != "Phenix 1W" && millis() < writeAt + 1000) {
+    handledAt = millis();
+    convertingThen = oneWireConverting;
+    loop();
+  }
+  // The iteration that applied it started right at the write.
+  TEST_ASSERT_EQUAL(writeAt, handledAt);
+  TEST_ASSERT_TRUE(convertingThen);
+}
+
+static void test_resolution_config(void) {
+  command("{\"onewire\":{\"resolution\":9}}");
+  TEST_ASSERT_EQUAL(9, deviceConfig.onewireBits);
+  ensurePrefs();
+  TEST_ASSERT_EQUAL(9, prefs.getUChar("onewire_bits", 0));
+  TEST_ASSERT_TRUE(buildConfigJson().find("\"onewire\":{\"pin\":4,\"resolution\":9}") != std::string::npos);
+
+  const char *rejected[] = {"{\"onewire\":{\"resolution\":8}}", "{\"onewire\":{\"resolution\":13}}",
+                            "{\"onewire\":{\"resolution\":\"x\"}}"};
+  for (const char *json : rejected) {
+    Serial.output.clear();
+    command(json);
+    TEST_ASSERT_EQUAL(9, deviceConfig.onewireBits);
+    TEST_ASSERT_TRUE(printed("\"status\":\"error\""));
+  }
+  command("{\"onewire\":{\"bits\":11}}");
+  TEST_ASSERT_EQUAL(11, deviceConfig.onewireBits);
+}
+
+// A switch to more bits during a conversion pushes the readback out to the
+// longest conversion time instead of reading an unfinished one.
+static void test_resolution_change_mid_conversion(void) {
+  command("{\"onewire\":{\"pin\":4,\"resolution\":9}}");
+  runFor(2000);
+  runToTick();
+  runFor(20);
+  command("{\"onewire\":{\"resolution\":12}}");
+  host::dallasReadyAtUs = host::nowUs + 750000;  // the probe restarts at 12 bits
+  runFor(1000);
+  TEST_ASSERT_EQUAL(0, host::dallasEarlyReads);
+}
+
+// The deep-sleep wake has no loop() and waits the conversion in delay().
+static void test_read_without_loop_waits(void) {
+  command("{\"onewire\":{\"pin\":4,\"resolution\":10}}");
+  runFor(2000);
+  oneWireReady = false;
+  oneWireConverting = false;
+  const uint64_t delayedBefore = host::delayedUs;
+  OneWireProbe probes[ONEWIRE_MAX_PROBES];
+  TEST_ASSERT_EQUAL(1, readOneWire(probes));
+  TEST_ASSERT_TRUE(host::delayedUs - delayedBefore == 188000);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 22.1f, probes[0].tempC);
+  TEST_ASSERT_EQUAL(0, host::dallasEarlyReads);
+}
+
+// 8 probes, a ROM with a bad CRC and a non-thermometer family: 8 cached.
+static void test_multidrop_one_search_one_conversion(void) {
+  host::oneWireRoms.clear();
+  for (uint8_t i = 0; i < 8; i++) addProbe((uint8_t)(0x10 + i));
+  std::array<uint8_t, 8> bad = {DS18B20MODEL, 9, 9, 9, 9, 9, 9, 0};
+  host::oneWireRoms.insert(host::oneWireRoms.begin() + 3, bad);
+  addProbe(0x42, 0x01);  // DS2401 serial number
+  const uint32_t searchesBefore = host::oneWireSearches;
+  initOneWire();
+  TEST_ASSERT_EQUAL(8, oneWireRomCount);
+  TEST_ASSERT_EQUAL(searchesBefore + 1, host::oneWireSearches);
+
+  const std::vector<std::string> &sent = host::bleCharacteristic(UUID_DATA)->notified;
+  const size_t seen = sent.size();
+  const uint64_t delayedBefore = host::delayedUs;
+  const uint32_t conversionsBefore = host::dallasConversions;
+  const uint32_t ticks = runFor(5000);
+  TEST_ASSERT_EQUAL(searchesBefore + 1, host::oneWireSearches);
+  TEST_ASSERT_EQUAL(ticks, host::dallasConversions - conversionsBefore);
+  TEST_ASSERT_TRUE(host::delayedUs == delayedBefore);
+  TEST_ASSERT_EQUAL(0, host::dallasEarlyReads);
+  for (uint8_t i = 0; i < 8; i++) {
+    const std::string addr = "\"a\":\"" + romText((uint8_t)(0x10 + i)) + "\"";
+    TEST_ASSERT_INT_WITHIN(1, ticks, countIn(sent, seen, addr));
+  }
+  TEST_ASSERT_EQUAL(0, countIn(sent, seen, "\"a\":\"2809"));
+  TEST_ASSERT_EQUAL(0, countIn(sent, seen, "\"a\":\"0142"));
+  // Probe 0x13 reads 20 + 0x13 / 10 degrees.
+  TEST_ASSERT_TRUE(countIn(sent, seen, "\"a\":\"" + romText(0x13) + "\",\"m\":{\"t\":21.900}") > 0);
+}
+
+// A bus found empty at init is searched again by the next conversion.
+static void test_empty_bus_is_searched_again(void) {
+  host::oneWireRoms.clear();
+  initOneWire();
+  TEST_ASSERT_EQUAL(0, oneWireRomCount);
+  useProbes(0);
+  for (uint8_t i = 0; i < 3; i++) addProbe((uint8_t)(0x10 + i));
+  const uint32_t searchesBefore = host::oneWireSearches;
+  runToTick();
+  TEST_ASSERT_EQUAL(3, oneWireRomCount);
+  TEST_ASSERT_EQUAL(searchesBefore + 1, host::oneWireSearches);
+  runFor(3000);
+  TEST_ASSERT_EQUAL(searchesBefore + 1, host::oneWireSearches);
+}
+
+// Only ROMs travel as "a"; binary frames have no address, so ROM metrics
+// stay JSON while an I2C one goes binary.
+static void test_address_only_for_roms(void) {
+  const std::vector<std::string> &sent = host::bleCharacteristic(UUID_DATA)->notified;
+  size_t seen = sent.size();
+  queueMetricPayload("bmp280", "0x76", "temperature", 21.5f, "pressure", 1013.2f);
+  queueMetricPayload("ds18b20", romText(0x10).c_str(), "temperature", 21.6f, nullptr, 0.0f);
+  flushMetricBatch();
+  TEST_ASSERT_EQUAL(1, countIn(sent, seen, "{\"s\":\"bmp280\",\"m\":"));
+  TEST_ASSERT_EQUAL(1, countIn(sent, seen, "{\"s\":\"ds18b20\",\"a\":\"" + romText(0x10) + "\""));
+  TEST_ASSERT_EQUAL(0, countIn(sent, seen, "0x76"));
+
+  metricBinary = true;
+  seen = sent.size();
+  queueMetricPayload("bmp280", "0x76", "temperature", 21.5f, "pressure", 1013.2f);
+  queueMetricPayload("ds18b20", romText(0x11).c_str(), "temperature", 21.7f, nullptr, 0.0f);
+  flushMetricBatch();
+  metricBinary = false;
+  TEST_ASSERT_EQUAL(2, sent.size() - seen);
+  TEST_ASSERT_EQUAL(0, countIn(sent, seen, "bmp280"));
+  TEST_ASSERT_EQUAL(1, countIn(sent, seen, "\"a\":\"" + romText(0x11) + "\""));
+}
+
+// A full bus fits one tsz block: the 16 series all get a slot, so blocks
+// only start at the LOG_INDEX_EVERY anchors, never for lack of a slot.
+static void test_full_bus_fits_a_tsz_block(void) {
+  useProbes(ONEWIRE_MAX_PROBES);
+  TEST_ASSERT_EQUAL(ONEWIRE_MAX_PROBES, oneWireRomCount);
+  command("{\"store_flash\":true,\"log_format\":\"tsz\"}");
+  TEST_ASSERT_EQUAL(BinaryLogger::kBlockVersion, logFormatVersion());
+  flushLogs();
+  logRing.advance();
+  const uint32_t ticks = runFor(10000);
+  flushLogs();
+  command("{\"store_flash\":false,\"log_format\":\"csv\"}");
+
+  BinaryLogReader reader;
+  TEST_ASSERT_TRUE(reader.open(LittleFS, logRing.headPath()));
+  std::map<uint32_t, uint32_t> rowsPerBlock;
+  std::map<std::string, uint32_t> rowsPerRom;
+  BinaryLogRecord record;
+  for (;;) {
+    const uint32_t position = reader.position();
+    if (!reader.next(record)) break;
+    rowsPerBlock[position >> 8]++;
+    char addr[17];
+    formatHexAddress(record.addr, record.addrLen, addr, sizeof(addr));
+    rowsPerRom[addr]++;
+  }
+  reader.close();
+  char line[96];
+  snprintf(line, sizeof(line), "16 probes, %lu ticks: %lu rows in %lu tsz blocks of %lu", (unsigned long)ticks,
+           (unsigned long)(ticks * ONEWIRE_MAX_PROBES), (unsigned long)rowsPerBlock.size(),
+           (unsigned long)rowsPerBlock.begin()->second);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL(ONEWIRE_MAX_PROBES, rowsPerRom.size());
+  for (const auto &rom : rowsPerRom) TEST_ASSERT_EQUAL(ticks, rom.second);
+  for (const auto &block : rowsPerBlock) TEST_ASSERT_EQUAL(LOG_INDEX_EVERY, block.second);
+}
+
+// A "onewire" config change re-inits the bus and drops the conversion a
+// tick waits on; the readback starts a new one instead of waiting in delay().
+static void test_reinit_during_conversion_does_not_wait(void) {
+  runToTick();
+  TEST_ASSERT_TRUE(oneWireSamplePending);
+  runFor(100);
+  initOneWire();
+  const uint64_t delayedBefore = host::delayedUs;
+  const size_t published = ds18b20Notifications();
+  runFor(1000);
+  TEST_ASSERT_TRUE(host::delayedUs == delayedBefore);
+  TEST_ASSERT_EQUAL(0, host::dallasEarlyReads);
+  TEST_ASSERT_GREATER_THAN(published, ds18b20Notifications());
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_one_hz_sampling_never_waits_in_loop);
+  RUN_TEST(test_readback_after_datasheet_time);
+  RUN_TEST(test_ble_is_served_during_a_conversion);
+  RUN_TEST(test_resolution_config);
+  RUN_TEST(test_resolution_change_mid_conversion);
+  RUN_TEST(test_read_without_loop_waits);
+  RUN_TEST(test_reinit_during_conversion_does_not_wait);
+  RUN_TEST(test_multidrop_one_search_one_conversion);
+  RUN_TEST(test_empty_bus_is_searched_again);
+  RUN_TEST(test_address_only_for_roms);
+  RUN_TEST(test_full_bus_fits_a_tsz_block);
+  return UNITY_END();
+}
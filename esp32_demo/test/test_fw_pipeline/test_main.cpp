@@ -0,0 +1,201 @@
+// The default firmware build: acquisition, publish and storage tasks woken
+// by the periodic sample timer, on the host scheduler of freertos/task.h.
+// The other test_fw_* suites build the inline scheduler variant instead.
+
+#undef USE_TASK_PIPELINE
+#define USE_TASK_PIPELINE 1
+#include "../../src/main.cpp"
+
+#include <Ms5611Model.h>
+#include <unity.h>
+
+static Ms5611Model ms;
+
+static void command(const std::string &json) {
+  host::bleWrite(UUID_CONFIG, json);
+  processBleCommands();
+}
+
+static void runFor(uint32_t durationMs) {
+  const uint32_t endMs = millis() + durationMs;
+  while (millis() < endMs) loop();
+}
+
+static size_t notificationsOf(const char *sensor) {
+  size_t n = 0;
+  for (const std::string &payload : host::bleCharacteristic(UUID_DATA)->notified) {
+    if (payload.find(sensor) != std::string::npos) n++;
+  }
+  return n;
+}
+
+static host::Mutex *lockOf(PipelineLock lock) {
+  return (host::Mutex *)pipelineMutex[lock];
+}
+
+void setUp(void) {
+  static bool booted = false;
+  if (!booted) {
+    host::i2cDevices[0x77] = &ms;
+    setup();
+    host::bleConnect(185);
+    host::bleSubscribe(UUID_DATA);
+    booted = true;
+  }
+  command("{\"sensor\":\"random\",\"frequency\":1000,\"store_flash\":false}");
+  runFor(2000);
+  Serial.output.clear();
+}
+
+void tearDown(void) {
+  host::waitEvent = nullptr;
+}
+
+static void test_tasks_and_timer_started(void) {
+  TEST_ASSERT_EQUAL(4, host::tasks.size());  // sensor_init, storage, publish, acquire
+  TEST_ASSERT_NOT_NULL(acquisitionTaskHandle);
+  TEST_ASSERT_NOT_NULL(publishTaskHandle);
+  TEST_ASSERT_NOT_NULL(storageTaskHandle);
+  TEST_ASSERT_NOT_NULL(sampleTimer);
+  TEST_ASSERT_TRUE(sampleTimer->periodUs == 1000000ULL);
+  for (uint8_t i = 0; i < PIPELINE_LOCK_COUNT; i++) TEST_ASSERT_EQUAL(0, lockOf((PipelineLock)i)->depth);
+}
+
+// The timer wakes acquisition once a second; publish and storage follow
+// and loop() stays blocked in between.
+static void test_timer_drives_the_three_stages(void) {
+  command("{\"store_flash\":true,\"log_format\":\"csv\"}");
+  runFor(500);
+  const size_t published = notificationsOf("random");
+  const uint64_t startUs = host::nowUs;
+  const uint64_t blockedBefore = host::blockedUs;
+  runFor(10000);
+  flushLogs();
+  const double blocked = (double)(host::blockedUs - blockedBefore) / (host::nowUs - startUs);
+  char line[96];
+  snprintf(line, sizeof(line), "10 s at 1 Hz: %lu notifications, loop blocked %.1f%%",
+           (unsigned long)(notificationsOf("random") - published), blocked * 100);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_INT_WITHIN(1, 10, notificationsOf("random") - published);
+  TEST_ASSERT_GREATER_THAN(0.99, blocked);
+  TEST_ASSERT_TRUE(metricRing.empty());
+  TEST_ASSERT_TRUE(logSampleRing.empty());
+  TEST_ASSERT_EQUAL(0, metricRingDropped);
+  TEST_ASSERT_EQUAL(0, logSampleRingDropped);
+  command("{\"store_flash\":false}");
+}
+
+static void bleWriteDuringWait() {
+  host::bleWrite(UUID_CONFIG, "{\"name\":\"Phenix tasks\"}");
+  wakeLoop();
+}
+
+// A write lands while the stages are idle; loop() takes both locks for it.
+static void test_ble_write_between_ticks(void) {
+  const uint32_t writeAt = millis() + 300;
+  host::waitEvent = bleWriteDuringWait;
+  host::waitEventAtUs = writeAt * 1000ULL;
+  uint32_t handledAt = 0;
+  while (deviceConfig.name != "Phenix tasks" && millis() < writeAt + 2000) {
+    handledAt = millis();
+    loop();
+  }
+  TEST_ASSERT_EQUAL(writeAt, handledAt);
+}
+
+// A frequency change restarts the timer and samples at once.
+static void test_frequency_change_restarts_the_timer(void) {
+  const size_t published = notificationsOf("random");
+  command("{\"frequency\":250}");
+  TEST_ASSERT_TRUE(sampleTimer->periodUs == 250000ULL);
+  TEST_ASSERT_EQUAL(published + 1, notificationsOf("random"));
+  runFor(2000);
+  TEST_ASSERT_INT_WITHIN(1, 8, notificationsOf("random") - published - 1);
+  command("{\"frequency\":1000}");
+}
+
+// With the consumers stalled, rows are dropped but every tick keeps its
+// end marker: no two ticks' rows end up in one batch.
+static void test_full_ring_never_merges_ticks(void) {
+  command("{\"store_flash\":true}");
+  runFor(100);
+  const uint32_t droppedBefore = logSampleRingDropped;
+  for (uint32_t tick = 0; tick < LOG_SAMPLE_RING_LEN; tick++) {
+    storeLogRow("random", "", NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, (float)tick);
+    storeLogRow("random", "", NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, (float)tick);
+    endSampleTick();
+  }
+  TEST_ASSERT_GREATER_THAN(droppedBefore, logSampleRingDropped);
+  LogSample row;
+  size_t rowsInTick = 0;
+  size_t markers = 0;
+  while (logSampleRing.pop(row)) {
+    if (!row.sensor) {
+      markers++;
+      rowsInTick = 0;
+      continue;
+    }
+    rowsInTick++;
+    TEST_ASSERT_LESS_OR_EQUAL(2, rowsInTick);
+  }
+  // The last tick that got rows in is closed too.
+  TEST_ASSERT_EQUAL(0, rowsInTick);
+  TEST_ASSERT_EQUAL(11, markers);
+  MetricSample sample;
+  while (metricRing.pop(sample)) {
+  }
+  command("{\"store_flash\":false}");
+}
+
+static bool sensorsLockHeld = false;
+static bool convertingThen = false;
+
+static void bleWriteDuringConversion() {
+  sensorsLockHeld = lockOf(PIPELINE_LOCK_SENSORS)->depth != 0;
+  convertingThen = ms.converting();
+  host::bleWrite(UUID_CONFIG, "{\"name\":\"Phenix gy63\"}");
+  wakeLoop();
+}
+
+// An MS5611 tick starts the conversions and leaves; ms5611Job() collects
+// them and wakes acquisition again. Nothing waits in delay() under the
+// sensors lock, so loop() serves BLE while the chip converts.
+static void test_ms5611_tick_leaves_the_sensors_lock_free(void) {
+  command("{\"sensor\":\"i2c\",\"ms5611_hz\":0,\"ms5611_osr\":4096}");
+  runFor(RESCAN_INTERVAL_MS + 1000);  // the deferred bus scan
+  TEST_ASSERT_NOT_NULL(ms5611);
+  ms.earlyReads = 0;
+  const uint64_t delayedBefore = host::delayedUs;
+  const size_t published = notificationsOf("gy63");
+  runFor(10000);
+  char line[96];
+  snprintf(line, sizeof(line), "10 s at 1 Hz: %lu gy63 notifications, delay() %lu us",
+           (unsigned long)(notificationsOf("gy63") - published), (unsigned long)(host::delayedUs - delayedBefore));
+  TEST_MESSAGE(line);
+  TEST_ASSERT_INT_WITHIN(1, 10, notificationsOf("gy63") - published);
+  TEST_ASSERT_TRUE(host::delayedUs == delayedBefore);
+  TEST_ASSERT_EQUAL(0, ms.earlyReads);
+
+  const uint32_t writeAt = (uint32_t)(sampleTimer->nextUs / 1000) + 3;
+  host::waitEvent = bleWriteDuringConversion;
+  host::waitEventAtUs = writeAt * 1000ULL;
+  uint32_t handledAt = 0;
+  while (deviceConfig.name != "Phenix gy63" && millis() < writeAt + 2000) {
+    handledAt = millis();
+    loop();
+  }
+  TEST_ASSERT_TRUE(convertingThen);
+  TEST_ASSERT_FALSE(sensorsLockHeld);
+  TEST_ASSERT_EQUAL(writeAt, handledAt);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_tasks_and_timer_started);
+  RUN_TEST(test_timer_drives_the_three_stages);
+  RUN_TEST(test_ble_write_between_ticks);
+  RUN_TEST(test_frequency_change_restarts_the_timer);
+  RUN_TEST(test_full_ring_never_merges_ticks);
+  RUN_TEST(test_ms5611_tick_leaves_the_sensors_lock_free);
+  return UNITY_END();
+}
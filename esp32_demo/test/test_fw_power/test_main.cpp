@@ -0,0 +1,161 @@
+// An hour of logging on the simulated clock, charging each loop() and each
+// sample a fixed amount of awake time, against the estimate that the status
+// JSON reports.
+
+#include "../../src/main.cpp"
+
+#include <unity.h>
+
+#include <string>
+
+// Rough awake costs: a loop() pass with nothing to do, and a sample that
+// reads the sensor and appends a row to flash.
+static const uint32_t WAKE_MS = 2;
+static const uint32_t SAMPLE_MS = 30;
+
+struct PowerRun {
+  uint32_t wakes;
+  uint32_t samples;
+  uint64_t activeMs;
+  uint64_t totalMs;
+  uint32_t avgUa;
+  uint32_t sleepPermille;
+  std::string json;
+};
+
+static void command(const std::string &json) {
+  host::bleWrite(UUID_CONFIG, json);
+  processBleCommands();
+}
+
+static uint32_t jsonNumber(const std::string &json, const char *key, uint32_t *tenths = nullptr) {
+  const std::string needle = std::string("\"") + key + "\":";
+  const size_t at = json.find(needle);
+  TEST_ASSERT_TRUE_MESSAGE(at != std::string::npos, key);
+  char *end = nullptr;
+  const uint32_t value = strtoul(json.c_str() + at + needle.size(), &end, 10);
+  if (tenths) *tenths = *end == '.' ? (uint32_t)(end[1] - '0') : 0;
+  return value;
+}
+
+// Restarts the estimator window and runs loop() for durationMs.
+static PowerRun runFor(uint32_t durationMs) {
+  PowerRun run = {};
+  powerEstimator.begin((uint64_t)esp_timer_get_time());
+  const uint64_t startMs = millis();
+  const uint64_t endMs = startMs + durationMs;
+  while (millis() < endMs) {
+    const uint32_t deadline = sampleDeadline;
+    loop();
+    run.wakes++;
+    uint32_t busyMs = WAKE_MS;
+    if (sampleDeadline != deadline) {
+      run.samples++;
+      busyMs += SAMPLE_MS;
+    }
+    host::nowUs += busyMs * 1000ULL;
+    run.activeMs += busyMs;
+  }
+  run.totalMs = millis() - startMs;
+  buildPowerJson(run.json);
+  uint32_t tenths = 0;
+  run.avgUa = jsonNumber(run.json, "avg_ua");
+  run.sleepPermille = jsonNumber(run.json, "sleep_pct", &tenths) * 10 + tenths;
+  return run;
+}
+
+static uint32_t expectedUa(const PowerRun &run, bool sleep) {
+  const uint64_t waitMs = run.totalMs - run.activeMs;
+  const uint64_t waitUa = sleep ? POWER_MODEL.sleepUa : POWER_MODEL.idleUa;
+  return (uint32_t)((run.activeMs * POWER_MODEL.activeUa + waitMs * waitUa) / run.totalMs);
+}
+
+static void report(const char *label, const PowerRun &run) {
+  char line[160];
+  snprintf(line, sizeof(line), "%s: %lu wakeups, %lu samples, avg %lu uA, %lu.%lu%% asleep", label,
+           (unsigned long)run.wakes, (unsigned long)run.samples, (unsigned long)run.avgUa,
+           (unsigned long)(run.sleepPermille / 10), (unsigned long)(run.sleepPermille % 10));
+  TEST_MESSAGE(line);
+}
+
+static bool booted = false;
+
+void setUp(void) {
+  if (booted) return;
+  setup();
+  booted = true;
+}
+
+void tearDown(void) {
+  host::pmConfigureResult = ESP_OK;
+}
+
+static void checkSchedule(uint32_t intervalMs, const char *label) {
+  char json[96];
+  snprintf(json, sizeof(json), "{\"sensor\":\"random\",\"frequency\":%lu,\"store_flash\":true}",
+           (unsigned long)intervalMs);
+  command(json);
+  TEST_ASSERT_TRUE(lightSleepReady);
+  const PowerRun run = runFor(3600000);
+  report(label, run);
+  TEST_ASSERT_INT_WITHIN(1, 3600000 / intervalMs, run.samples);
+  // Nobody is connected: heartbeat, log polling and the deep-sleep check
+  // ride on the sample wakeups.
+  TEST_ASSERT_LESS_OR_EQUAL(run.samples + 5, run.wakes);
+  TEST_ASSERT_TRUE(run.json.find("\"sleep\":\"light\"") != std::string::npos);
+  TEST_ASSERT_TRUE(run.json.find("\"window_s\":3600") != std::string::npos);
+  const uint32_t expected = expectedUa(run, true);
+  TEST_ASSERT_UINT32_WITHIN(expected / 100 + 1, expected, run.avgUa);
+  const uint32_t expectedPermille = (uint32_t)((run.totalMs - run.activeMs) * 1000 / run.totalMs);
+  TEST_ASSERT_UINT32_WITHIN(1, expectedPermille, run.sleepPermille);
+}
+
+static void test_one_sample_a_minute(void) {
+  checkSchedule(60000, "1 h at 60 s");
+}
+
+static void test_one_sample_a_second(void) {
+  checkSchedule(1000, "1 h at 1 s");
+}
+
+// A client connecting brings the heartbeat back at once.
+static void test_heartbeat_returns_on_connect(void) {
+  command("{\"sensor\":\"random\",\"frequency\":60000,\"store_flash\":true}");
+  Serial.output.clear();
+  runFor(300000);
+  TEST_ASSERT_TRUE(Serial.output.find("[ALIVE]") == std::string::npos);
+  host::bleConnect(185);
+  const PowerRun run = runFor(10000);
+  TEST_ASSERT_TRUE(Serial.output.find("[ALIVE]") != std::string::npos);
+  TEST_ASSERT_GREATER_OR_EQUAL(10, run.wakes);
+  host::bleDisconnect();
+  runFor(1000);
+}
+
+// Same schedule on a build without CONFIG_PM_ENABLE: the waits are idle,
+// not asleep, and the loop wakes every LOOP_IDLE_MAX_MS.
+static void test_without_light_sleep(void) {
+  host::pmConfigureResult = ESP_ERR_NOT_SUPPORTED;
+  lightSleepReady = false;
+  Serial.output.clear();
+  setupPowerManagement();
+  TEST_ASSERT_FALSE(lightSleepReady);
+  TEST_ASSERT_TRUE(Serial.output.find("[PM] Light sleep unavailable") != std::string::npos);
+  command("{\"sensor\":\"random\",\"frequency\":60000,\"store_flash\":true}");
+  const PowerRun run = runFor(3600000);
+  report("1 h at 60 s, no sleep", run);
+  TEST_ASSERT_TRUE(run.json.find("\"sleep\":\"off\"") != std::string::npos);
+  TEST_ASSERT_EQUAL(0, run.sleepPermille);
+  const uint32_t expected = expectedUa(run, false);
+  TEST_ASSERT_UINT32_WITHIN(expected / 100 + 1, expected, run.avgUa);
+  TEST_ASSERT_GREATER_THAN(POWER_MODEL.idleUa, run.avgUa);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_one_sample_a_minute);
+  RUN_TEST(test_one_sample_a_second);
+  RUN_TEST(test_heartbeat_returns_on_connect);
+  RUN_TEST(test_without_light_sleep);
+  return UNITY_END();
+}
@@ -0,0 +1,163 @@
+// The deep-sleep logging cycle through setup(), the way the chip runs it:
+// esp_deep_sleep_start() throws, the suite drops what lives in RAM, moves
+// the RTC clock on by the sleep and boots again with the wakeup cause set.
+
+#include "../../src/main.cpp"
+
+#include <unity.h>
+
+#include <vector>
+
+static const uint64_t EPOCH_MS = 1700000000000ULL;
+static const uint32_t INTERVAL_MS = 60000;
+static const int WAKES = 300;
+
+static void command(const std::string &json) {
+  host::bleWrite(UUID_CONFIG, json);
+  processBleCommands();
+}
+
+// What a reset clears; RTC_DATA_ATTR state, NVS and flash stay.
+static void loseRam() {
+  deviceConfig = DeviceConfig();
+  timeSynced = false;
+  epochOffsetMs = 0;
+  littlefsReady = false;
+  logRingReady = false;
+  prefsReady = false;
+  sensorInitPending = true;
+}
+
+static void sleepThrough(const host::DeepSleep &sleep, esp_sleep_wakeup_cause_t cause) {
+  host::rtcBaseUs += host::nowUs + sleep.wakeAfterUs;
+  host::nowUs = 0;
+  host::wakeupCause = cause;
+  loseRam();
+}
+
+// Seconds of every logged row, read back the way exports read them;
+// segment headers are skipped.
+static std::vector<int64_t> loggedRows() {
+  LogCursor cursor;
+  logCursorOpen(cursor, 0, UINT64_MAX);
+  std::vector<int64_t> rows;
+  std::string line;
+  while (logCursorNextLine(cursor, line)) {
+    struct tm t = {};
+    if (sscanf(line.c_str(), "%d/%d/%d %d:%d:%d", &t.tm_mday, &t.tm_mon, &t.tm_year, &t.tm_hour, &t.tm_min,
+               &t.tm_sec) != 6) {
+      continue;
+    }
+    t.tm_mon -= 1;
+    t.tm_year += 100;
+    rows.push_back((int64_t)timegm(&t));
+  }
+  logCursorClose(cursor);
+  return rows;
+}
+
+static size_t count(const std::string &text, const char *needle) {
+  size_t n = 0;
+  for (size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1)) n++;
+  return n;
+}
+
+// Runs loop() until the cycle starts; fails if it does not within limitMs.
+static host::DeepSleep loopUntilDeepSleep(uint32_t limitMs) {
+  const uint32_t endMs = millis() + limitMs;
+  try {
+    while (millis() < endMs) loop();
+  } catch (const host::DeepSleep &sleep) {
+    return sleep;
+  }
+  TEST_FAIL_MESSAGE("no deep sleep");
+  return {};
+}
+
+static host::DeepSleep entered;
+static size_t rowsBefore = 0;
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_cycle_starts_after_the_idle_window(void) {
+  setup();
+  command("{\"epoch_ms\":" + std::to_string(EPOCH_MS) +
+          ",\"sensor\":\"random\",\"frequency\":60000,\"store_flash\":true,\"deep_sleep\":true}");
+  const uint32_t commandMs = millis();
+  entered = loopUntilDeepSleep(5 * 60000);
+  const uint32_t enteredAtMs = millis();
+  rowsBefore = loggedRows().size();
+  TEST_ASSERT_GREATER_OR_EQUAL(commandMs + DEEP_SLEEP_IDLE_MS, enteredAtMs);
+  TEST_ASSERT_LESS_THAN(commandMs + DEEP_SLEEP_IDLE_MS + 1100, enteredAtMs);
+  TEST_ASSERT_TRUE(Serial.output.find("[SLEEP] Deep sleep cycle, interval ms=60000") != std::string::npos);
+  TEST_ASSERT_EQUAL(RTC_WAKE_MAGIC, rtcWake.magic);
+  TEST_ASSERT_EQUAL(0, rtcLog.rows());
+  TEST_ASSERT_TRUE(entered.wakeAfterUs == INTERVAL_MS * 1000ULL);
+}
+
+// Each timer wake samples into RTC memory and sleeps to the next slot on
+// the grid without loading the config or starting BLE; flash is only
+// mounted when the buffer is about to fill.
+static void test_timer_wakes_take_the_fast_path(void) {
+  host::DeepSleep sleep = entered;
+  const uint64_t firstWakeMs = rtcClockMs() + INTERVAL_MS;
+  uint32_t mounts = 0;
+  uint32_t nvsLoads = 0;
+  Serial.output.clear();
+  for (int i = 0; i < WAKES; i++) {
+    sleepThrough(sleep, ESP_SLEEP_WAKEUP_TIMER);
+    TEST_ASSERT_TRUE(rtcClockMs() == firstWakeMs + (uint64_t)i * INTERVAL_MS);
+    try {
+      setup();
+      TEST_FAIL_MESSAGE("timer wake went back to sleep without throwing");
+    } catch (const host::DeepSleep &next) {
+      sleep = next;
+    }
+    if (prefsReady) nvsLoads++;
+    if (littlefsReady) mounts++;
+    TEST_ASSERT_TRUE(rtcClockMs() + sleep.wakeAfterUs / 1000 == firstWakeMs + (uint64_t)(i + 1) * INTERVAL_MS);
+  }
+  const size_t flushes = count(Serial.output, "[SLEEP] RTC rows flushed=");
+  char line[160];
+  snprintf(line, sizeof(line), "%d timer wakes: %lu flushes, %u rows still in RTC", WAKES, (unsigned long)flushes,
+           (unsigned)rtcLog.rows());
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL(WAKES, rtcWake.cycles);
+  TEST_ASSERT_EQUAL(flushes, mounts);
+  TEST_ASSERT_EQUAL(1, flushes);
+  TEST_ASSERT_TRUE(Serial.output.find("[SLEEP] RTC rows flushed=170") != std::string::npos);
+  TEST_ASSERT_EQUAL(WAKES - 170, rtcLog.rows());
+  // Only the flush opens NVS, for the log ring's head and tail.
+  TEST_ASSERT_EQUAL(flushes, nvsLoads);
+  TEST_ASSERT_EQUAL(0, count(Serial.output, "[BLE]"));
+  TEST_ASSERT_EQUAL(0, count(Serial.output, "[I2C] SDA="));
+  entered = sleep;
+}
+
+// A button press ends the cycle with a full boot that lands the rest.
+static void test_button_wake_flushes_and_restores_the_clock(void) {
+  sleepThrough(entered, ESP_SLEEP_WAKEUP_GPIO);
+  const uint64_t wakeMs = rtcClockMs();
+  Serial.output.clear();
+  setup();
+  TEST_ASSERT_TRUE(Serial.output.find("[BLE]") != std::string::npos);
+  TEST_ASSERT_TRUE(Serial.output.find("[SLEEP] Cycle ended after wakes=300") != std::string::npos);
+  TEST_ASSERT_EQUAL(0, rtcLog.rows());
+  TEST_ASSERT_EQUAL(0, rtcWake.magic);
+  TEST_ASSERT_TRUE(timeSynced);
+  TEST_ASSERT_UINT32_WITHIN(1000, 0, (uint32_t)(currentEpochMs() - wakeMs));
+
+  const std::vector<int64_t> rows = loggedRows();
+  TEST_ASSERT_EQUAL(rowsBefore + WAKES, rows.size());
+  for (size_t i = rowsBefore + 1; i < rows.size(); i++) TEST_ASSERT_EQUAL(INTERVAL_MS / 1000, rows[i] - rows[i - 1]);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_cycle_starts_after_the_idle_window);
+  RUN_TEST(test_timer_wakes_take_the_fast_path);
+  RUN_TEST(test_button_wake_flushes_and_restores_the_clock);
+  return UNITY_END();
+}
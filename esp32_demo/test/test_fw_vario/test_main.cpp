@@ -0,0 +1,157 @@
+// Vario mode in the firmware: the MS5611 converts at VARIO_MS5611_HZ and
+// feeds the filter from ms5611Job(), a lone BMP280 is read by varioJob(),
+// and UUID_VARIO carries altitude and climb at most every 50 ms.
+
+#include "../../src/main.cpp"
+
+#include <Ms5611Model.h>
+#include <unity.h>
+
+static Ms5611Model ms;
+static I2cRegisterDevice bmp;
+
+struct VarioFrame {
+  uint8_t seq;
+  int32_t altitudeCm;
+  int16_t climbCmS;
+  uint32_t atMs;
+};
+
+static std::vector<VarioFrame> frames;
+
+static void command(const std::string &json) {
+  host::bleWrite(UUID_CONFIG, json);
+  processBleCommands();
+}
+
+// Runs loop() for durationMs; pressureAt, when given, sets the BMP280
+// reading before every iteration. Collects the vario frames sent.
+static void runFor(uint32_t durationMs, double (*pressureAt)(uint32_t ms) = nullptr) {
+  NimBLECharacteristic *chr = host::bleCharacteristic(UUID_VARIO);
+  const uint32_t endMs = millis() + durationMs;
+  while (millis() < endMs) {
+    if (pressureAt) host::bmp280PressurePa = (float)pressureAt(millis());
+    const size_t seen = chr->notified.size();
+    loop();
+    for (size_t i = seen; i < chr->notified.size(); i++) {
+      const std::string &f = chr->notified[i];
+      TEST_ASSERT_EQUAL(8, f.size());
+      TEST_ASSERT_EQUAL(1, (uint8_t)f[0]);
+      VarioFrame frame;
+      frame.seq = (uint8_t)f[1];
+      memcpy(&frame.altitudeCm, f.data() + 2, 4);
+      memcpy(&frame.climbCmS, f.data() + 6, 2);
+      frame.atMs = millis();
+      frames.push_back(frame);
+    }
+  }
+}
+
+// 1 m/s climb from 500 m, starting at t0.
+static uint32_t climbStartMs = 0;
+static double climbingPressure(uint32_t nowMs) {
+  const double meters = 500.0 + (nowMs > climbStartMs ? (nowMs - climbStartMs) / 1000.0 : 0.0);
+  return 101325.0 * pow(1.0 - meters / 44330.77, 1.0 / 0.190263);
+}
+
+static void useSensors(I2cDevice *at76, I2cDevice *at77) {
+  host::i2cDevices.clear();
+  if (at76) host::i2cDevices[0x76] = at76;
+  if (at77) host::i2cDevices[0x77] = at77;
+  clearSensors();
+  storeSensorCache(SensorCache());
+  scanSensors();
+  configureVario();
+}
+
+void setUp(void) {
+  static bool booted = false;
+  if (!booted) {
+    bmp.regs[0xD0] = 0x58;
+    host::i2cDevices[0x77] = &ms;
+    setup();
+    host::bleConnect(185);
+    host::bleSubscribe(UUID_VARIO);
+    command("{\"sensor\":\"i2c\",\"frequency\":1000,\"store_flash\":true,\"deep_sleep\":true}");
+    booted = true;
+  }
+  command("{\"vario\":false,\"ms5611_hz\":0}");
+  runFor(500);
+  frames.clear();
+}
+
+void tearDown(void) {}
+
+static void test_ms5611_feeds_filter_at_50_hz(void) {
+  useSensors(nullptr, &ms);
+  command("{\"vario\":true}");
+  TEST_ASSERT_TRUE(deviceConfig.vario);
+  TEST_ASSERT_FALSE(deepSleepAllowed());
+  const uint64_t delayedBefore = host::delayedUs;
+  runFor(1000);
+  const uint32_t before = vario.updates();
+  frames.clear();
+  runFor(2000);
+  char line[112];
+  snprintf(line, sizeof(line), "MS5611 vario: %lu updates and %lu frames in 2 s, altitude %ld cm, climb %d cm/s",
+           (unsigned long)(vario.updates() - before), (unsigned long)frames.size(),
+           (long)frames.back().altitudeCm, frames.back().climbCmS);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_INT_WITHIN(2, 100, vario.updates() - before);
+  // One frame every third 20 ms step.
+  TEST_ASSERT_INT_WITHIN(2, 2000 / 60, frames.size());
+  for (size_t i = 1; i < frames.size(); i++) {
+    TEST_ASSERT_GREATER_OR_EQUAL(VARIO_NOTIFY_MIN_MS, frames[i].atMs - frames[i - 1].atMs);
+    TEST_ASSERT_EQUAL((uint8_t)(frames[i - 1].seq + 1), frames[i].seq);
+  }
+  // 1000.09 hPa in the standard atmosphere.
+  const double expectedCm = 4433077.0 * (1.0 - pow(100009.0 / 101325.0, 0.190263));
+  TEST_ASSERT_INT_WITHIN(5, (int)lround(expectedCm), frames.back().altitudeCm);
+  TEST_ASSERT_EQUAL(0, frames.back().climbCmS);
+  TEST_ASSERT_TRUE(host::delayedUs == delayedBefore);
+  TEST_ASSERT_EQUAL(0, ms.earlyReads);
+}
+
+static void test_vario_off_stops_updates(void) {
+  useSensors(nullptr, &ms);
+  command("{\"vario\":true}");
+  runFor(1000);
+  command("{\"vario\":false}");
+  runFor(100);
+  const uint32_t before = vario.updates();
+  frames.clear();
+  ms.conversions = 0;
+  runFor(2000);
+  TEST_ASSERT_EQUAL(before, vario.updates());
+  TEST_ASSERT_EQUAL(0, frames.size());
+  TEST_ASSERT_TRUE(deepSleepAllowed() || connectedCount > 0);
+  // Only the 1 Hz samples convert now: D2 and D1 each.
+  TEST_ASSERT_INT_WITHIN(2, 4, ms.conversions);
+}
+
+static void test_bmp280_tracks_a_climb(void) {
+  useSensors(&bmp, nullptr);
+  TEST_ASSERT_NULL(ms5611);
+  TEST_ASSERT_NOT_NULL(bmp280);
+  command("{\"vario\":true}");
+  climbStartMs = millis() + 2000;
+  runFor(2000, climbingPressure);
+  const uint32_t before = vario.updates();
+  frames.clear();
+  runFor(5000, climbingPressure);
+  char line[96];
+  snprintf(line, sizeof(line), "BMP280 vario: %lu updates in 5 s, climb %d cm/s after 5 s at 100 cm/s",
+           (unsigned long)(vario.updates() - before), frames.back().climbCmS);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_INT_WITHIN(2, 5 * VARIO_BMP280_HZ, vario.updates() - before);
+  TEST_ASSERT_INT_WITHIN(10, 100, frames.back().climbCmS);
+  TEST_ASSERT_INT_WITHIN(30, 50500, frames.back().altitudeCm);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_ms5611_feeds_filter_at_50_hz);
+  RUN_TEST(test_vario_off_stops_updates);
+  RUN_TEST(test_bmp280_tracks_a_climb);
+  return UNITY_END();
+}
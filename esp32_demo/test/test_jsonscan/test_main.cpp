@@ -0,0 +1,202 @@
+#include <JsonScan.h>
+#include <unity.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+struct Member {
+  std::string parent;
+  std::string key;
+  JsonType type;
+  std::string text;
+};
+
+static void collect(void *ctx, const JsonSpan &parent, const JsonSpan &key, const JsonToken &value) {
+  std::vector<Member> &out = *(std::vector<Member> *)ctx;
+  out.push_back(Member{std::string(parent.ptr ? parent.ptr : "", parent.len), std::string(key.ptr, key.len),
+                       value.type, std::string(value.text.ptr, value.text.len)});
+}
+
+static bool scan(const std::string &json, std::vector<Member> &out) {
+  out.clear();
+  JsonScanner scanner(json.data(), json.size());
+  return scanner.scan(collect, &out);
+}
+
+static JsonToken literal(const char *text) {
+  JsonToken token;
+  token.text.ptr = text;
+  token.text.len = strlen(text);
+  return token;
+}
+
+static void test_reports_members_in_order_with_parents(void) {
+  std::vector<Member> m;
+  TEST_ASSERT_TRUE(scan("{\"name\":\"Phenix 2\",\"i2c\":{\"sda\":21,\"scl\":22},\"pins\":[1,[2]],\"save\":true}", m));
+  TEST_ASSERT_EQUAL(6, m.size());
+  TEST_ASSERT_EQUAL_STRING("name", m[0].key.c_str());
+  TEST_ASSERT_TRUE(m[0].type == JsonType::String);
+  TEST_ASSERT_EQUAL_STRING("Phenix 2", m[0].text.c_str());
+  TEST_ASSERT_TRUE(m[1].type == JsonType::Object);
+  TEST_ASSERT_EQUAL_STRING("i2c", m[1].key.c_str());
+  TEST_ASSERT_EQUAL_STRING("i2c", m[2].parent.c_str());
+  TEST_ASSERT_EQUAL_STRING("sda", m[2].key.c_str());
+  TEST_ASSERT_EQUAL_STRING("22", m[3].text.c_str());
+  TEST_ASSERT_TRUE(m[4].type == JsonType::Array);
+  TEST_ASSERT_EQUAL_STRING("[1,[2]]", m[4].text.c_str());
+  TEST_ASSERT_EQUAL_STRING("", m[5].parent.c_str());
+  TEST_ASSERT_EQUAL_STRING("true", m[5].text.c_str());
+}
+
+static void test_accepts_hand_typed_writes(void) {
+  std::vector<Member> m;
+  TEST_ASSERT_TRUE(scan(" { 'name' : 'quoted' , freq : 500, \"esc\":\"a\\\"b\" } ", m));
+  TEST_ASSERT_EQUAL(3, m.size());
+  TEST_ASSERT_EQUAL_STRING("quoted", m[0].text.c_str());
+  TEST_ASSERT_EQUAL_STRING("freq", m[1].key.c_str());
+  TEST_ASSERT_EQUAL_STRING("500", m[1].text.c_str());
+  // Escapes are left in the span.
+  TEST_ASSERT_EQUAL_STRING("a\\\"b", m[2].text.c_str());
+}
+
+static void test_malformed_input_keeps_members_seen_before(void) {
+  std::vector<Member> m;
+  TEST_ASSERT_FALSE(scan("{\"a\":1,\"b\":2,\"c\"", m));
+  TEST_ASSERT_EQUAL(2, m.size());
+  TEST_ASSERT_FALSE(scan("{\"a\":\"open", m));
+  TEST_ASSERT_EQUAL(0, m.size());
+  TEST_ASSERT_FALSE(scan("name=Phenix", m));
+  TEST_ASSERT_FALSE(scan("", m));
+}
+
+static void test_nesting_is_bounded(void) {
+  std::vector<Member> m;
+  std::string ok = "{";
+  for (uint8_t i = 1; i < JsonScanner::kMaxDepth; i++) ok += "\"k\":{";
+  ok += std::string(JsonScanner::kMaxDepth, '}');
+  TEST_ASSERT_TRUE(scan(ok, m));
+  const std::string deep(200, '{');
+  TEST_ASSERT_FALSE(scan(deep, m));
+  const std::string arrays = "{\"a\":" + std::string(200, '[') + std::string(200, ']') + "}";
+  TEST_ASSERT_FALSE(scan(arrays, m));
+}
+
+static void test_number_conversions(void) {
+  int i = 0;
+  uint32_t u = 0;
+  uint64_t w = 0;
+  TEST_ASSERT_TRUE(literal("-120").toInt(i));
+  TEST_ASSERT_EQUAL(-120, i);
+  TEST_ASSERT_FALSE(literal("2147483648").toInt(i));
+  TEST_ASSERT_TRUE(literal(" 42ms").toU32(u));
+  TEST_ASSERT_EQUAL(42, u);
+  TEST_ASSERT_FALSE(literal("-1").toU32(u));
+  TEST_ASSERT_FALSE(literal("4294967296").toU32(u));
+  TEST_ASSERT_TRUE(literal("1750000000000").toU64(w));
+  TEST_ASSERT_TRUE(w == 1750000000000ULL);
+  TEST_ASSERT_TRUE(literal("99999999999999999999999").toU64(w));
+  TEST_ASSERT_TRUE(w == UINT64_MAX);
+  TEST_ASSERT_FALSE(literal("abc").toU32(u));
+  TEST_ASSERT_FALSE(literal("").toInt(i));
+  JsonToken object = literal("{");
+  object.type = JsonType::Object;
+  TEST_ASSERT_FALSE(object.toInt(i));
+}
+
+static void test_bool_conversions(void) {
+  const char *yes[] = {"true", "1", "YES", " on "};
+  const char *no[] = {"false", "0", "No", "off"};
+  for (const char *text : yes) {
+    bool b = false;
+    TEST_ASSERT_TRUE(literal(text).toBool(b));
+    TEST_ASSERT_TRUE(b);
+  }
+  for (const char *text : no) {
+    bool b = true;
+    TEST_ASSERT_TRUE(literal(text).toBool(b));
+    TEST_ASSERT_FALSE(b);
+  }
+  bool b = false;
+  TEST_ASSERT_FALSE(literal("truthy").toBool(b));
+  TEST_ASSERT_FALSE(literal("").toBool(b));
+}
+
+struct Bounds {
+  const char *begin;
+  const char *end;
+  uint32_t members;
+};
+
+static bool inside(const Bounds &b, const JsonSpan &s) {
+  return s.len == 0 || (s.ptr >= b.begin && s.ptr + s.len <= b.end);
+}
+
+static void checkBounds(void *ctx, const JsonSpan &parent, const JsonSpan &key, const JsonToken &value) {
+  Bounds &b = *(Bounds *)ctx;
+  TEST_ASSERT_TRUE(inside(b, parent) && inside(b, key) && inside(b, value.text));
+  int i;
+  uint32_t u;
+  uint64_t w;
+  bool f;
+  value.toInt(i);
+  value.toU32(u);
+  value.toU64(w);
+  value.toBool(f);
+  b.members++;
+}
+
+// Mutates real config writes; every span must stay inside the input, which
+// sits in an exact-size heap block so sanitizer builds also catch overreads.
+static void test_mutation_fuzz_stays_in_bounds(void) {
+  const char *seeds[] = {
+      "{\"name\":\"Phenix 2\",\"sensor\":\"i2c\",\"i2c\":{\"sda\":21,\"scl\":22},\"frequency\":2000,"
+      "\"store_flash\":true,\"log_format\":\"tsz\",\"log_budget_kb\":512}",
+      "{\"action\":\"time_sync\",\"epoch_ms\":1750000000000,\"tz_offset_min\":-120}",
+      "{\"action\":\"flash_export\",\"window\":8,\"framing\":\"binary\",\"format\":\"lz\",\"from_ms\":1,\"to_ms\":99}",
+      "{\"config\":{\"name\":\"x\",\"freq\":500,\"save\":\"on\"},\"list\":[1,{\"a\":[\"]\"]}]}",
+      "{ 'name' : 'quoted' , interval : \"1500\" }",
+  };
+  std::mt19937 rng(1);
+  uint32_t accepted = 0;
+  const int runs = 200000;
+  for (int run = 0; run < runs; run++) {
+    std::string j = seeds[rng() % 5];
+    const int edits = 1 + rng() % 8;
+    for (int k = 0; k < edits && !j.empty(); k++) {
+      const size_t pos = rng() % j.size();
+      switch (rng() % 4) {
+        case 0: j[pos] = "{}[]\"':,\\ a1-"[rng() % 14]; break;
+        case 1: j.erase(pos, 1 + rng() % 4); break;
+        case 2: j.insert(pos, 1, (char)(rng() % 256)); break;
+        default: j.resize(pos); break;
+      }
+    }
+    char *buf = (char *)malloc(j.size() ? j.size() : 1);
+    memcpy(buf, j.data(), j.size());
+    Bounds bounds{buf, buf + j.size(), 0};
+    JsonScanner scanner(buf, j.size());
+    if (scanner.scan(checkBounds, &bounds)) accepted++;
+    free(buf);
+  }
+  char line[64];
+  snprintf(line, sizeof(line), "%d mutated writes, %lu still well-formed", runs, (unsigned long)accepted);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_GREATER_THAN(0, accepted);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_reports_members_in_order_with_parents);
+  RUN_TEST(test_accepts_hand_typed_writes);
+  RUN_TEST(test_malformed_input_keeps_members_seen_before);
+  RUN_TEST(test_nesting_is_bounded);
+  RUN_TEST(test_number_conversions);
+  RUN_TEST(test_bool_conversions);
+  RUN_TEST(test_mutation_fuzz_stays_in_bounds);
+  return UNITY_END();
+}
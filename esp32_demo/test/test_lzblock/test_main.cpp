@@ -0,0 +1,152 @@
+#include <LzBlock.h>
+#include <LzBlockDecoder.h>
+#include <unity.h>
+
+#include <chrono>
+#include <random>
+
+static LzBlockEncoder *encoder;
+
+void setUp(void) {
+  encoder = new LzBlockEncoder();
+  TEST_ASSERT_TRUE(encoder->begin());
+}
+
+void tearDown(void) { delete encoder; }
+
+// Rows as the firmware logs them: three sensors, one second apart.
+static std::string csvRows(size_t bytes) {
+  std::string out;
+  std::mt19937 rng(7);
+  for (int i = 0; out.size() < bytes; i++) {
+    char line[96];
+    const int s = i / 3;
+    const float t = 21.0f + (rng() % 200) / 100.0f;
+    switch (i % 3) {
+      case 0:
+        snprintf(line, sizeof(line), "14/11/23 10:%02d:%02d,%.3f,,%.3f,,,,,,,bmp280,0x76\n", s / 60 % 60, s % 60, t,
+                 1013.0f + (rng() % 100) / 100.0f);
+        break;
+      case 1:
+        snprintf(line, sizeof(line), "14/11/23 10:%02d:%02d,%.3f,%.3f,,,,,,,,dht22,GPIO4\n", s / 60 % 60, s % 60, t,
+                 45.0f + (rng() % 100) / 10.0f);
+        break;
+      default:
+        snprintf(line, sizeof(line), "14/11/23 10:%02d:%02d,%.3f,,,,,,,,,ds18b20,28FF4A1D93160302\n", s / 60 % 60,
+                 s % 60, t);
+        break;
+    }
+    out += line;
+  }
+  out.resize(bytes);
+  return out;
+}
+
+static std::string roundTrip(const std::string &in, size_t outCap, size_t &consumed, size_t &outLen) {
+  std::string out(outCap, '\0');
+  outLen = encoder->compress((const uint8_t *)in.data(), in.size(), (uint8_t *)&out[0], outCap, consumed);
+  TEST_ASSERT_LESS_OR_EQUAL(outCap, outLen);
+  std::string decoded;
+  TEST_ASSERT_TRUE(lzBlockDecode((const uint8_t *)out.data(), outLen, decoded));
+  return decoded;
+}
+
+static void test_csv_round_trip(void) {
+  const std::string csv = csvRows(2048);
+  size_t consumed = 0;
+  size_t outLen = 0;
+  const std::string decoded = roundTrip(csv, 4096, consumed, outLen);
+  TEST_ASSERT_EQUAL(csv.size(), consumed);
+  TEST_ASSERT_TRUE(decoded == csv);
+  TEST_ASSERT_LESS_THAN(csv.size() / 2, outLen);
+}
+
+static void test_incompressible_input_costs_one_flag_byte_per_eight(void) {
+  std::string noise(800, '\0');
+  std::mt19937 rng(1);
+  for (char &c : noise) c = (char)rng();
+  size_t consumed = 0;
+  size_t outLen = 0;
+  const std::string decoded = roundTrip(noise, 2048, consumed, outLen);
+  TEST_ASSERT_TRUE(decoded == noise);
+  TEST_ASSERT_LESS_OR_EQUAL(noise.size() + noise.size() / 8 + 1, outLen);
+}
+
+static void test_runs_use_the_longest_match(void) {
+  const std::string run(340, 'a');
+  size_t consumed = 0;
+  size_t outLen = 0;
+  TEST_ASSERT_TRUE(roundTrip(run, 64, consumed, outLen) == run);
+  // One literal, then ten matches of at most 34 bytes.
+  TEST_ASSERT_EQUAL(run.size(), consumed);
+  TEST_ASSERT_EQUAL(2 + 1 + 10 * 2, outLen);
+}
+
+static void test_output_cap_stops_at_an_item_boundary(void) {
+  const std::string csv = csvRows(1024);
+  for (size_t cap = 3; cap <= 200; cap += 7) {
+    size_t consumed = 0;
+    size_t outLen = 0;
+    const std::string decoded = roundTrip(csv, cap, consumed, outLen);
+    TEST_ASSERT_GREATER_THAN(0, consumed);
+    TEST_ASSERT_TRUE(decoded == csv.substr(0, consumed));
+  }
+}
+
+static void test_input_is_clamped_to_the_window(void) {
+  const std::string csv = csvRows(3000);
+  size_t consumed = 0;
+  size_t outLen = 0;
+  const std::string decoded = roundTrip(csv, 4096, consumed, outLen);
+  TEST_ASSERT_EQUAL(LzBlockEncoder::kWindow, consumed);
+  TEST_ASSERT_TRUE(decoded == csv.substr(0, LzBlockEncoder::kWindow));
+}
+
+static void test_encoder_without_tables_emits_nothing(void) {
+  encoder->end();
+  uint8_t out[16];
+  size_t consumed = 99;
+  TEST_ASSERT_EQUAL(0, encoder->compress((const uint8_t *)"abcabcabc", 9, out, sizeof(out), consumed));
+  TEST_ASSERT_EQUAL(0, consumed);
+}
+
+// Export frames at MTU 185: 174 bytes of LZ payload per notification, fed
+// from a 1 KiB stage the way buildLzExportBlock() does.
+static void test_benchmark_ratio_and_speed(void) {
+  const std::string csv = csvRows(256 * 1024);
+  const size_t caps[] = {174, 512, 4096};
+  for (size_t cap : caps) {
+    std::string out(cap, '\0');
+    size_t pos = 0;
+    size_t packed = 0;
+    size_t frames = 0;
+    const auto start = std::chrono::steady_clock::now();
+    while (pos < csv.size()) {
+      const size_t stage = cap >= 4096 ? LzBlockEncoder::kWindow : 1024;
+      const size_t len = csv.size() - pos < stage ? csv.size() - pos : stage;
+      size_t consumed = 0;
+      packed += encoder->compress((const uint8_t *)csv.data() + pos, len, (uint8_t *)&out[0], cap, consumed);
+      pos += consumed;
+      frames++;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    char line[128];
+    snprintf(line, sizeof(line), "frame cap %4u: ratio %.2f, %u frames for %u KiB, %.1f MB/s on this host",
+             (unsigned)cap, (double)csv.size() / packed, (unsigned)frames, (unsigned)(csv.size() / 1024),
+             csv.size() / seconds / 1e6);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_GREATER_THAN(2.0, (double)csv.size() / packed);
+  }
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_csv_round_trip);
+  RUN_TEST(test_incompressible_input_costs_one_flag_byte_per_eight);
+  RUN_TEST(test_runs_use_the_longest_match);
+  RUN_TEST(test_output_cap_stops_at_an_item_boundary);
+  RUN_TEST(test_input_is_clamped_to_the_window);
+  RUN_TEST(test_encoder_without_tables_emits_nothing);
+  RUN_TEST(test_benchmark_ratio_and_speed);
+  return UNITY_END();
+}
@@ -0,0 +1,202 @@
+// Ms5611Async against Ms5611Model on the simulated bus: conversions are
+// timed on host::nowUs, so a read that comes too early shows up in
+// earlyReads instead of as a wrong value.
+
+#include <Ms5611Async.h>
+#include <Ms5611Model.h>
+#include <unity.h>
+
+static Ms5611Model chip;
+static Ms5611Async *sensorPtr = nullptr;
+#define sensor (*sensorPtr)
+
+static const uint8_t kAddr = 0x77;
+
+// Runs one cycle the way ms5611Job() does: poll only once dueUs() passed.
+static bool runCycle(uint32_t &elapsedUs) {
+  const uint64_t startUs = host::nowUs;
+  if (!sensor.start((uint32_t)host::nowUs)) return false;
+  while (sensor.busy()) {
+    host::nowUs = sensor.dueUs();
+    if (sensor.poll((uint32_t)host::nowUs)) break;
+  }
+  elapsedUs = (uint32_t)(host::nowUs - startUs);
+  return sensor.valid() && !sensor.busy();
+}
+
+// Datasheet compensation in floating point, second order included.
+static void reference(const Ms5611Model &model, double &tempC, double &pressHpa) {
+  const double dT = (double)model.d2 - model.prom[5] * 256.0;
+  double temp = 2000 + dT * model.prom[6] / 8388608.0;
+  double off = model.prom[2] * 65536.0 + model.prom[4] * dT / 128.0;
+  double sens = model.prom[1] * 32768.0 + model.prom[3] * dT / 256.0;
+  if (temp < 2000) {
+    const double t2 = dT * dT / 2147483648.0;
+    const double low = (temp - 2000) * (temp - 2000);
+    double off2 = 5 * low / 2;
+    double sens2 = 5 * low / 4;
+    if (temp < -1500) {
+      const double veryLow = (temp + 1500) * (temp + 1500);
+      off2 += 7 * veryLow;
+      sens2 += 11 * veryLow / 2;
+    }
+    temp -= t2;
+    off -= off2;
+    sens -= sens2;
+  }
+  tempC = temp / 100.0;
+  pressHpa = (model.d1 * sens / 2097152.0 - off) / 32768.0 / 100.0;
+}
+
+void setUp(void) {
+  chip = Ms5611Model();
+  host::i2cDevices.clear();
+  host::i2cDevices[kAddr] = &chip;
+  host::nowUs = 1000000;
+  delete sensorPtr;
+  sensorPtr = new Ms5611Async(Wire);
+  TEST_ASSERT_TRUE(sensor.begin(kAddr));
+}
+
+void tearDown(void) {}
+
+static void test_begin_reads_prom_and_checks_crc(void) {
+  TEST_ASSERT_TRUE(sensor.promCrcOk());
+  chip.setCrc(false);
+  TEST_ASSERT_TRUE(sensor.begin(kAddr));
+  TEST_ASSERT_FALSE(sensor.promCrcOk());
+  host::i2cDevices.clear();
+  TEST_ASSERT_FALSE(sensor.begin(kAddr));
+}
+
+static void test_blank_prom_is_not_an_ms5611(void) {
+  I2cRegisterDevice blank;
+  host::i2cDevices[kAddr] = &blank;
+  TEST_ASSERT_FALSE(sensor.begin(kAddr));
+}
+
+static void test_datasheet_example(void) {
+  uint32_t elapsedUs = 0;
+  TEST_ASSERT_TRUE(runCycle(elapsedUs));
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, 20.07f, sensor.temperatureC());
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, 1000.09f, sensor.pressureHpa());
+  TEST_ASSERT_EQUAL(0, chip.earlyReads);
+}
+
+static void test_start_and_early_poll_do_not_wait_or_touch_the_bus(void) {
+  const uint64_t before = host::nowUs;
+  const uint64_t delayedBefore = host::delayedUs;
+  TEST_ASSERT_TRUE(sensor.start((uint32_t)host::nowUs));
+  TEST_ASSERT_TRUE(sensor.busy());
+  TEST_ASSERT_TRUE(host::nowUs == before);
+  TEST_ASSERT_EQUAL(Ms5611Async::conversionUs(Ms5611Async::OSR_4096), sensor.dueUs() - (uint32_t)before);
+  host::i2cAddressed.clear();
+  host::nowUs = sensor.dueUs() - 1;
+  TEST_ASSERT_FALSE(sensor.poll((uint32_t)host::nowUs));
+  TEST_ASSERT_TRUE(host::i2cAddressed.empty());
+  TEST_ASSERT_TRUE(sensor.busy());
+  TEST_ASSERT_FALSE(sensor.start((uint32_t)host::nowUs));
+  TEST_ASSERT_TRUE(host::delayedUs == delayedBefore);
+}
+
+// Every OSR waits at least the chip's conversion time, and not much more.
+static void test_every_oversampling_completes_without_early_reads(void) {
+  const Ms5611Async::Osr all[] = {Ms5611Async::OSR_256, Ms5611Async::OSR_512, Ms5611Async::OSR_1024,
+                                  Ms5611Async::OSR_2048, Ms5611Async::OSR_4096};
+  for (const Ms5611Async::Osr osr : all) {
+    sensor.setOversampling(osr);
+    uint32_t elapsedUs = 0;
+    TEST_ASSERT_TRUE(runCycle(elapsedUs));
+    TEST_ASSERT_EQUAL(0x40 + osr, chip.lastConversion);
+    TEST_ASSERT_EQUAL(2 * Ms5611Async::conversionUs(osr), elapsedUs);
+    TEST_ASSERT_GREATER_OR_EQUAL(2 * Ms5611Model::conversionUs(osr), elapsedUs);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 1000.09f, sensor.pressureHpa());
+  }
+  TEST_ASSERT_EQUAL(0, chip.earlyReads);
+  TEST_ASSERT_EQUAL(0, chip.ignoredCommands);
+  TEST_ASSERT_EQUAL(0, sensor.failures());
+}
+
+static void test_unplugged_mid_cycle_fails_and_goes_idle(void) {
+  TEST_ASSERT_TRUE(sensor.start((uint32_t)host::nowUs));
+  host::i2cDevices.clear();
+  host::nowUs = sensor.dueUs();
+  TEST_ASSERT_FALSE(sensor.poll((uint32_t)host::nowUs));
+  TEST_ASSERT_FALSE(sensor.busy());
+  TEST_ASSERT_EQUAL(1, sensor.failures());
+  TEST_ASSERT_FALSE(sensor.start((uint32_t)host::nowUs));
+  TEST_ASSERT_EQUAL(2, sensor.failures());
+  TEST_ASSERT_FALSE(sensor.valid());
+}
+
+// A zero ADC result means the read came too early; it is not a sample.
+static void test_zero_adc_result_is_a_failure(void) {
+  chip.d1 = 0;
+  uint32_t elapsedUs = 0;
+  TEST_ASSERT_FALSE(runCycle(elapsedUs));
+  TEST_ASSERT_EQUAL(1, sensor.failures());
+  TEST_ASSERT_FALSE(sensor.busy());
+}
+
+static void test_temperature_every_n_cycles(void) {
+  sensor.setTemperatureEvery(5);
+  uint32_t elapsedUs = 0;
+  uint32_t sum = 0;
+  for (uint8_t i = 0; i < 10; i++) {
+    TEST_ASSERT_TRUE(runCycle(elapsedUs));
+    sum += elapsedUs;
+  }
+  // Two cycles out of ten convert D2 as well.
+  TEST_ASSERT_EQUAL(12, chip.conversions);
+  TEST_ASSERT_EQUAL(10, chip.pressureResults);
+  TEST_ASSERT_EQUAL(12 * Ms5611Async::conversionUs(Ms5611Async::OSR_4096), sum);
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, 20.07f, sensor.temperatureC());
+}
+
+static void test_second_order_compensation_matches_reference(void) {
+  // One degree is about 29600 counts of D2 with this PROM: the die drops
+  // to about 0 degC, then below -15 degC for the third-order terms.
+  const uint32_t d2s[] = {8569150 - 600000, 8569150 - 1100000};
+  for (const uint32_t d2 : d2s) {
+    chip.d2 = d2;
+    uint32_t elapsedUs = 0;
+    TEST_ASSERT_TRUE(runCycle(elapsedUs));
+    double tempC = 0;
+    double pressHpa = 0;
+    reference(chip, tempC, pressHpa);
+    TEST_ASSERT_TRUE(tempC < 20.0);
+    // The driver truncates at every shift like the datasheet's integer code.
+    TEST_ASSERT_FLOAT_WITHIN(0.02f, (float)tempC, sensor.temperatureC());
+    TEST_ASSERT_FLOAT_WITHIN(0.03f, (float)pressHpa, sensor.pressureHpa());
+  }
+  TEST_ASSERT_TRUE(sensor.temperatureC() < -15.0f);
+}
+
+static void test_osr_from_samples(void) {
+  Ms5611Async::Osr osr = Ms5611Async::OSR_4096;
+  const uint32_t samples[] = {256, 512, 1024, 2048, 4096};
+  for (const uint32_t n : samples) {
+    TEST_ASSERT_TRUE(Ms5611Async::osrFromSamples(n, osr));
+    TEST_ASSERT_EQUAL(n, Ms5611Async::samplesFromOsr(osr));
+  }
+  osr = Ms5611Async::OSR_1024;
+  TEST_ASSERT_FALSE(Ms5611Async::osrFromSamples(0, osr));
+  TEST_ASSERT_FALSE(Ms5611Async::osrFromSamples(1000, osr));
+  TEST_ASSERT_FALSE(Ms5611Async::osrFromSamples(8192, osr));
+  TEST_ASSERT_EQUAL(Ms5611Async::OSR_1024, osr);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_begin_reads_prom_and_checks_crc);
+  RUN_TEST(test_blank_prom_is_not_an_ms5611);
+  RUN_TEST(test_datasheet_example);
+  RUN_TEST(test_start_and_early_poll_do_not_wait_or_touch_the_bus);
+  RUN_TEST(test_every_oversampling_completes_without_early_reads);
+  RUN_TEST(test_unplugged_mid_cycle_fails_and_goes_idle);
+  RUN_TEST(test_zero_adc_result_is_a_failure);
+  RUN_TEST(test_temperature_every_n_cycles);
+  RUN_TEST(test_second_order_compensation_matches_reference);
+  RUN_TEST(test_osr_from_samples);
+  return UNITY_END();
+}
@@ -0,0 +1,83 @@
+#include <PowerEstimator.h>
+#include <unity.h>
+
+static const PowerModel MODEL = {22000, 13000, 130};
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_all_active_before_any_wait(void) {
+  PowerEstimator power(MODEL);
+  power.begin(5000000);
+  TEST_ASSERT_EQUAL(MODEL.activeUa, power.averageUa(5000000));
+  TEST_ASSERT_EQUAL(MODEL.activeUa, power.averageUa(9000000));
+  TEST_ASSERT_EQUAL(0, power.sleepPermille(9000000));
+  TEST_ASSERT_TRUE(power.elapsedUs(9000000) == 4000000);
+  TEST_ASSERT_TRUE(power.elapsedUs(1000000) == 0);
+}
+
+static void test_states_are_weighted_by_their_current(void) {
+  PowerEstimator power(MODEL);
+  power.begin(0);
+  // 100 ms active, 300 ms idle, 600 ms asleep.
+  power.addWait(300000, false);
+  power.addWait(600000, true);
+  const uint32_t expected = (100 * MODEL.activeUa + 300 * MODEL.idleUa + 600 * MODEL.sleepUa) / 1000;
+  TEST_ASSERT_EQUAL(expected, power.averageUa(1000000));
+  TEST_ASSERT_EQUAL(600, power.sleepPermille(1000000));
+}
+
+static void test_busy_time_is_taken_out_of_the_next_wait(void) {
+  PowerEstimator power(MODEL);
+  power.begin(0);
+  power.addBusy(200000);
+  power.addWait(500000, true);
+  TEST_ASSERT_EQUAL(300, power.sleepPermille(1000000));
+  // Only the next wait pays for it.
+  power.addWait(500000, true);
+  TEST_ASSERT_EQUAL(400, power.sleepPermille(2000000));
+}
+
+static void test_busy_longer_than_the_wait_counts_as_active(void) {
+  PowerEstimator power(MODEL);
+  power.begin(0);
+  power.addBusy(800000);
+  power.addWait(500000, true);
+  TEST_ASSERT_EQUAL(0, power.sleepPermille(1000000));
+  TEST_ASSERT_EQUAL(MODEL.activeUa, power.averageUa(1000000));
+}
+
+static void test_begin_restarts_the_window(void) {
+  PowerEstimator power(MODEL);
+  power.begin(0);
+  power.addBusy(1000);
+  power.addWait(900000, true);
+  power.begin(1000000);
+  power.addWait(1000000, false);
+  TEST_ASSERT_EQUAL(MODEL.idleUa, power.averageUa(2000000));
+  TEST_ASSERT_EQUAL(0, power.sleepPermille(2000000));
+}
+
+// A month of 1 s cycles: 2 ms awake, the rest asleep.
+static void test_long_windows_do_not_overflow(void) {
+  PowerEstimator power(MODEL);
+  power.begin(0);
+  const uint64_t seconds = 31ULL * 24 * 3600;
+  for (uint64_t s = 0; s < seconds; s++) power.addWait(998000, true);
+  const uint64_t endUs = seconds * 1000000ULL;
+  const uint32_t expected = (2 * MODEL.activeUa + 998 * MODEL.sleepUa) / 1000;
+  TEST_ASSERT_INT_WITHIN(1, expected, power.averageUa(endUs));
+  TEST_ASSERT_EQUAL(998, power.sleepPermille(endUs));
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_all_active_before_any_wait);
+  RUN_TEST(test_states_are_weighted_by_their_current);
+  RUN_TEST(test_busy_time_is_taken_out_of_the_next_wait);
+  RUN_TEST(test_busy_longer_than_the_wait_counts_as_active);
+  RUN_TEST(test_begin_restarts_the_window);
+  RUN_TEST(test_long_windows_do_not_overflow);
+  return UNITY_END();
+}
@@ -0,0 +1,170 @@
+#include <RtcLog.h>
+#include <unity.h>
+
+#include <vector>
+
+static RtcLogStore store;
+
+struct Row {
+  BinaryLogRecord record;
+  bool tickEnd;
+};
+
+static BinaryLogRecord makeRecord(uint64_t timestampMs, uint8_t sensorId, uint16_t mask, const char *addr = nullptr) {
+  BinaryLogRecord record;
+  record.timestampMs = timestampMs;
+  record.sensorId = sensorId;
+  record.mask = mask;
+  for (uint8_t i = 0; i < BinaryLogRecord::kMaxValues; i++) record.values[i] = (float)(timestampMs % 1000) + i * 0.25f;
+  if (addr) {
+    record.addrLen = (uint8_t)strlen(addr);
+    memcpy(record.addr, addr, record.addrLen);
+  }
+  return record;
+}
+
+static void collect(void *ctx, const BinaryLogRecord &record, bool tickEnd) {
+  ((std::vector<Row> *)ctx)->push_back({record, tickEnd});
+}
+
+static std::vector<Row> readAll(const RtcLog &log) {
+  std::vector<Row> rows;
+  log.forEach(collect, &rows);
+  return rows;
+}
+
+static void assertSameRecord(const BinaryLogRecord &expected, const BinaryLogRecord &actual) {
+  TEST_ASSERT_TRUE(expected.timestampMs == actual.timestampMs);
+  TEST_ASSERT_EQUAL(expected.sensorId, actual.sensorId);
+  TEST_ASSERT_EQUAL(expected.addrLen, actual.addrLen);
+  TEST_ASSERT_EQUAL_MEMORY(expected.addr, actual.addr, expected.addrLen);
+  TEST_ASSERT_EQUAL(expected.mask, actual.mask);
+  for (uint8_t i = 0; i < BinaryLogRecord::kMaxValues; i++) {
+    if (expected.mask & (1U << i)) TEST_ASSERT_EQUAL_MEMORY(&expected.values[i], &actual.values[i], 4);
+  }
+}
+
+void setUp(void) {
+  memset(&store, 0xA5, sizeof(store));
+}
+
+void tearDown(void) {}
+
+static void test_rows_come_back_oldest_first(void) {
+  RtcLog log(store);
+  log.attach();
+  const uint64_t base = 1700000000000ULL;
+  std::vector<Row> written = {
+      {makeRecord(base, 3, 0x0005, "\x76"), false},
+      {makeRecord(base, 5, 0x0001, "\x28\xFF\x4A\x1D\x93\x16\x03\x02"), true},
+      {makeRecord(base + 60000, 3, 0x0005, "\x76"), true},
+      {makeRecord(base + 120000, 1, 0x81FF), true},
+      {makeRecord(base + 180000, 1, 0), true},
+  };
+  size_t bytes = 0;
+  for (const Row &row : written) {
+    TEST_ASSERT_TRUE(log.append(row.record, row.tickEnd));
+    bytes += RtcLog::packedSize(row.record);
+    TEST_ASSERT_EQUAL(bytes, log.used());
+  }
+  TEST_ASSERT_EQUAL(written.size(), log.rows());
+  const std::vector<Row> read = readAll(log);
+  TEST_ASSERT_EQUAL(written.size(), read.size());
+  for (size_t i = 0; i < read.size(); i++) {
+    assertSameRecord(written[i].record, read[i].record);
+    TEST_ASSERT_EQUAL(written[i].tickEnd, read[i].tickEnd);
+  }
+}
+
+// A one-value row is 12 bytes and a T+P row from an I2C address 17: the
+// 170 and 120 rows per buffer the deep-sleep cycle was sized for.
+static void test_capacity(void) {
+  RtcLog log(store);
+  log.clear();
+  TEST_ASSERT_EQUAL(12, RtcLog::packedSize(makeRecord(0, 1, 0x0001)));
+  TEST_ASSERT_EQUAL(17, RtcLog::packedSize(makeRecord(0, 2, 0x0005, "\x76")));
+  uint16_t rows = 0;
+  while (log.append(makeRecord(rows * 60000ULL, 1, 0x0001), true)) rows++;
+  TEST_ASSERT_EQUAL(RtcLogStore::kBytes / 12, rows);
+  log.clear();
+  rows = 0;
+  while (log.append(makeRecord(rows * 60000ULL, 2, 0x0005, "\x76"), true)) rows++;
+  TEST_ASSERT_EQUAL(RtcLogStore::kBytes / 17, rows);
+}
+
+static void test_full_buffer_refuses_without_side_effects(void) {
+  RtcLog log(store);
+  log.clear();
+  while (log.room() >= 12) TEST_ASSERT_TRUE(log.append(makeRecord(log.rows(), 1, 0x0001), true));
+  const uint16_t rows = log.rows();
+  const size_t used = log.used();
+  TEST_ASSERT_FALSE(log.append(makeRecord(5000, 1, 0x0001), true));
+  TEST_ASSERT_EQUAL(rows, log.rows());
+  TEST_ASSERT_EQUAL(used, log.used());
+  TEST_ASSERT_EQUAL(rows, readAll(log).size());
+}
+
+// Deltas are u32 ms from the first row: about 49 days ahead, never behind.
+static void test_timestamps_outside_the_delta_range_are_refused(void) {
+  RtcLog log(store);
+  log.clear();
+  const uint64_t base = 1700000000000ULL;
+  TEST_ASSERT_TRUE(log.append(makeRecord(base, 1, 0x0001), true));
+  TEST_ASSERT_FALSE(log.append(makeRecord(base - 1, 1, 0x0001), true));
+  TEST_ASSERT_FALSE(log.append(makeRecord(base + UINT32_MAX + 1ULL, 1, 0x0001), true));
+  TEST_ASSERT_TRUE(log.append(makeRecord(base + UINT32_MAX, 1, 0x0001), true));
+  TEST_ASSERT_EQUAL(2, log.rows());
+  const std::vector<Row> read = readAll(log);
+  TEST_ASSERT_TRUE(read[1].record.timestampMs == base + UINT32_MAX);
+  // An empty log takes any first timestamp.
+  log.clear();
+  TEST_ASSERT_TRUE(log.append(makeRecord(5, 1, 0x0001), true));
+}
+
+// RTC memory holds garbage after power-on on some chips, and the rows of
+// the previous boot after deep sleep.
+static void test_attach_keeps_valid_rows_only(void) {
+  RtcLog log(store);
+  log.attach();
+  TEST_ASSERT_EQUAL(0, log.rows());
+  TEST_ASSERT_EQUAL(0, log.used());
+  TEST_ASSERT_TRUE(log.append(makeRecord(1000, 1, 0x0003), true));
+  TEST_ASSERT_TRUE(log.append(makeRecord(2000, 1, 0x0003), true));
+
+  RtcLog afterSleep(store);
+  afterSleep.attach();
+  TEST_ASSERT_EQUAL(2, afterSleep.rows());
+  TEST_ASSERT_EQUAL(2, readAll(afterSleep).size());
+
+  store.used = RtcLogStore::kBytes + 1;
+  afterSleep.attach();
+  TEST_ASSERT_EQUAL(0, afterSleep.rows());
+  TEST_ASSERT_EQUAL(RtcLogStore::kBytes, afterSleep.room());
+}
+
+// A row count that runs past the bytes, or a bad address length, stops the
+// walk instead of reading past used.
+static void test_damaged_store_stops_the_walk(void) {
+  RtcLog log(store);
+  log.clear();
+  for (uint32_t i = 0; i < 10; i++) TEST_ASSERT_TRUE(log.append(makeRecord(i * 1000, 1, 0x0003, "\x77"), true));
+  store.rows = 50;
+  TEST_ASSERT_EQUAL(10, readAll(log).size());
+  store.rows = 10;
+  store.used = (uint16_t)(log.used() - 3);
+  TEST_ASSERT_EQUAL(9, readAll(log).size());
+  store.used = (uint16_t)(store.used + 3);
+  store.data[5] = 200;
+  TEST_ASSERT_EQUAL(0, readAll(log).size());
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_rows_come_back_oldest_first);
+  RUN_TEST(test_capacity);
+  RUN_TEST(test_full_buffer_refuses_without_side_effects);
+  RUN_TEST(test_timestamps_outside_the_delta_range_are_refused);
+  RUN_TEST(test_attach_keeps_valid_rows_only);
+  RUN_TEST(test_damaged_store_stops_the_walk);
+  return UNITY_END();
+}
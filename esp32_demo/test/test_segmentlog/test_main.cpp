@@ -0,0 +1,155 @@
+#include <CsvLogger.h>
+#include <SegmentLog.h>
+#include <unity.h>
+
+static fs::FS *storage;
+
+void setUp(void) {
+  storage = new fs::FS();
+  fs::stats = fs::Stats();
+  host::nowUs = 0;
+}
+
+void tearDown(void) { delete storage; }
+
+static void writeSegment(SegmentLog &ring, size_t bytes) {
+  File file = storage->open(ring.headPath(), "a");
+  std::string data(bytes, 'x');
+  file.write((const uint8_t *)data.data(), data.size());
+  ring.noteAppended(bytes);
+}
+
+// The firmware's append path: roll the head when full, then evict.
+static void logRow(SegmentLog &ring, CsvLogger &csv, int row) {
+  if (ring.headBytes() > 0 && ring.headFull()) {
+    csv.end();
+    ring.advance();
+    while (ring.overBudget()) ring.dropOldest();
+  }
+  char line[48];
+  snprintf(line, sizeof(line), "14/11/23 10:00:00,%06d,,1013.250", row);
+  TEST_ASSERT_TRUE(csv.appendLine(line));
+  ring.noteAppended(strlen(line) + 1);
+}
+
+static size_t bytesOnFlash(const SegmentLog &ring) {
+  size_t total = 0;
+  for (uint32_t seq = ring.tail(); seq <= ring.head(); seq++) total += ring.segmentSize(seq);
+  return total;
+}
+
+static void test_ring_stays_within_budget_and_keeps_newest_rows(void) {
+  SegmentLog ring(*storage, "/log", 1024);
+  CsvLogger csv(*storage, ring.headPath(), "date,row,humidity,pressure");
+  TEST_ASSERT_TRUE(ring.begin(1, 1));
+  ring.setBudget(4096);
+  for (int row = 0; row < 2000; row++) {
+    logRow(ring, csv, row);
+    TEST_ASSERT_LESS_OR_EQUAL(4096 + 1024 + 64, ring.bytes());
+  }
+  csv.end();
+  TEST_ASSERT_GREATER_THAN(50, ring.tail());
+  char first[32];
+  ring.segmentPath(1, first, sizeof(first));
+  TEST_ASSERT_FALSE(storage->files.count(first) > 0);
+  TEST_ASSERT_TRUE(storage->contents(ring.headPath()).find("001999") != std::string::npos);
+  // Rolling the head resyncs the total with the CSV headers the writer added.
+  ring.advance();
+  TEST_ASSERT_EQUAL(bytesOnFlash(ring), ring.bytes());
+}
+
+static void test_drop_oldest_cost_does_not_grow_with_the_ring(void) {
+  SegmentLog ring(*storage, "/log", 100);
+  ring.begin(1, 1);
+  for (int i = 0; i < 400; i++) {
+    writeSegment(ring, 100);
+    ring.advance();
+  }
+  fs::stats = fs::Stats();
+  TEST_ASSERT_TRUE(ring.dropOldest());
+  const uint32_t largeRing = fs::stats.calls();
+  while (ring.segmentCount() > 3) ring.dropOldest();
+  fs::stats = fs::Stats();
+  TEST_ASSERT_TRUE(ring.dropOldest());
+  TEST_ASSERT_EQUAL(largeRing, fs::stats.calls());
+  TEST_ASSERT_EQUAL(0, fs::stats.renames);
+  TEST_ASSERT_EQUAL(1, fs::stats.removes);
+}
+
+static void test_begin_rebuilds_totals_and_skips_a_crash_gap(void) {
+  SegmentLog ring(*storage, "/log", 100);
+  ring.begin(1, 1);
+  for (int i = 0; i < 5; i++) {
+    writeSegment(ring, 80 + i);
+    ring.advance();
+  }
+  writeSegment(ring, 10);
+  // Power lost after removing segment 1 but before the new tail was saved.
+  char path[32];
+  ring.segmentPath(1, path, sizeof(path));
+  storage->remove(path);
+
+  SegmentLog again(*storage, "/log", 100);
+  TEST_ASSERT_TRUE(again.begin(1, ring.head()));
+  TEST_ASSERT_EQUAL(2, again.tail());
+  TEST_ASSERT_EQUAL(6, again.head());
+  TEST_ASSERT_EQUAL(81 + 82 + 83 + 84 + 10, again.bytes());
+  TEST_ASSERT_EQUAL(10, again.headBytes());
+}
+
+static void test_clear_starts_a_fresh_segment(void) {
+  SegmentLog ring(*storage, "/log", 100);
+  ring.begin(1, 1);
+  for (int i = 0; i < 3; i++) {
+    writeSegment(ring, 100);
+    ring.advance();
+  }
+  ring.appendIndex(1000, 0);
+  ring.clear();
+  TEST_ASSERT_EQUAL(0, ring.bytes());
+  TEST_ASSERT_EQUAL(5, ring.head());
+  TEST_ASSERT_EQUAL(ring.head(), ring.tail());
+  TEST_ASSERT_EQUAL(0, storage->files.size());
+  TEST_ASSERT_FALSE(ring.dropOldest());
+}
+
+static void test_seek_after_the_clock_stepped_back(void) {
+  SegmentLog ring(*storage, "/log", 1000);
+  ring.begin(1, 1);
+  ring.appendIndex(1000, 0);
+  ring.appendIndex(2000, 100);
+  ring.appendIndex(3000, 200);
+  uint32_t offset = 0;
+  TEST_ASSERT_TRUE(ring.seekIndex(1, 2800, offset));
+  TEST_ASSERT_EQUAL(100, offset);
+
+  // Reopened after a reboot, then the clock goes back 1.5 s: rows from
+  // 2800 to 3000 sit in front of the 2600 entry a search would pick.
+  SegmentLog again(*storage, "/log", 1000);
+  again.begin(1, 1);
+  again.appendIndex(1500, 300);
+  again.appendIndex(2500, 400);
+  again.appendIndex(2600, 500);
+  TEST_ASSERT_TRUE(again.seekIndex(1, 2800, offset));
+  TEST_ASSERT_EQUAL(0, offset);
+
+  // The next segment is sorted again; dropping the old one drops its marker.
+  again.advance();
+  again.appendIndex(4000, 0);
+  again.appendIndex(5000, 100);
+  TEST_ASSERT_TRUE(again.seekIndex(2, 5500, offset));
+  TEST_ASSERT_EQUAL(100, offset);
+  writeSegment(again, 10);
+  TEST_ASSERT_TRUE(again.dropOldest());
+  TEST_ASSERT_FALSE(storage->exists("/log/00000001.unsorted"));
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_ring_stays_within_budget_and_keeps_newest_rows);
+  RUN_TEST(test_drop_oldest_cost_does_not_grow_with_the_ring);
+  RUN_TEST(test_begin_rebuilds_totals_and_skips_a_crash_gap);
+  RUN_TEST(test_clear_starts_a_fresh_segment);
+  RUN_TEST(test_seek_after_the_clock_stepped_back);
+  return UNITY_END();
+}
@@ -0,0 +1,260 @@
+#include <BinaryLogger.h>
+#include <TsBlock.h>
+#include <unity.h>
+
+#include <random>
+#include <vector>
+
+static fs::FS *storage;
+
+void setUp(void) {
+  storage = new fs::FS();
+  host::nowUs = 0;
+}
+
+void tearDown(void) { delete storage; }
+
+static BinaryLogRecord makeRecord(uint64_t ts, uint8_t sensorId, uint8_t addr, float a, float b = NAN) {
+  BinaryLogRecord record;
+  record.timestampMs = ts;
+  record.sensorId = sensorId;
+  record.addrLen = 1;
+  record.addr[0] = addr;
+  record.mask = 1;
+  record.values[0] = a;
+  if (!isnan(b)) {
+    record.mask |= 1U << 2;
+    record.values[2] = b;
+  }
+  return record;
+}
+
+static void assertSameRecord(const BinaryLogRecord &want, const BinaryLogRecord &got) {
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)want.timestampMs, (uint32_t)got.timestampMs);
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)(want.timestampMs >> 32), (uint32_t)(got.timestampMs >> 32));
+  TEST_ASSERT_EQUAL(want.sensorId, got.sensorId);
+  TEST_ASSERT_EQUAL(want.addrLen, got.addrLen);
+  TEST_ASSERT_EQUAL_MEMORY(want.addr, got.addr, want.addrLen);
+  TEST_ASSERT_EQUAL(want.mask, got.mask);
+  for (uint8_t i = 0; i < BinaryLogRecord::kMaxValues; i++) {
+    if (!(want.mask & (1U << i))) {
+      TEST_ASSERT_FLOAT_IS_NAN(got.values[i]);
+      continue;
+    }
+    // Bit-exact, NaN payloads included.
+    TEST_ASSERT_EQUAL_MEMORY(&want.values[i], &got.values[i], sizeof(float));
+  }
+}
+
+static void decodeAll(const TsBlockEncoder &enc, std::vector<BinaryLogRecord> &out) {
+  uint8_t header[TsBlockEncoder::kHeaderBytes];
+  enc.writeHeader(header);
+  uint16_t bytes = 0;
+  uint16_t rows = 0;
+  uint64_t firstTs = 0;
+  TEST_ASSERT_TRUE(TsBlockDecoder::parseHeader(header, bytes, rows, firstTs));
+  TEST_ASSERT_EQUAL(enc.payloadBytes(), bytes);
+  TsBlockDecoder dec;
+  dec.begin(enc.payload(), bytes, rows, firstTs);
+  BinaryLogRecord record;
+  while (dec.next(record)) out.push_back(record);
+  TEST_ASSERT_EQUAL(0, dec.remaining());
+}
+
+static void test_interleaved_series_round_trip(void) {
+  TsBlockEncoder enc;
+  enc.begin();
+  std::vector<BinaryLogRecord> rows;
+  uint64_t ts = 1700000000000ULL;
+  for (int i = 0; i < 25; i++) {
+    // Jitter of a few ms, one long gap and one clock step back.
+    ts += i == 12 ? 3600000 : i == 18 ? (uint64_t)-90000 : 1000 + (i % 5);
+    rows.push_back(makeRecord(ts, 1, 0x76, 21.5f + (i % 7) * 0.01f, 1013.25f - i * 0.02f));
+    rows.push_back(makeRecord(ts + 2, 5, 0x04, 45.0f + (i % 3) * 0.1f));
+    rows.push_back(makeRecord(ts + 3, 6, 0x28, i == 10 ? NAN : 19.0625f));
+  }
+  for (const BinaryLogRecord &r : rows) TEST_ASSERT_TRUE(enc.append(r));
+  std::vector<BinaryLogRecord> decoded;
+  decodeAll(enc, decoded);
+  TEST_ASSERT_EQUAL(rows.size(), decoded.size());
+  for (size_t i = 0; i < rows.size(); i++) assertSameRecord(rows[i], decoded[i]);
+}
+
+static void test_sixteen_series_fit_and_the_seventeenth_is_refused(void) {
+  TsBlockEncoder enc;
+  enc.begin();
+  for (uint8_t probe = 0; probe < TsBlockEncoder::kMaxSeries; probe++) {
+    TEST_ASSERT_TRUE(enc.append(makeRecord(1000 + probe, 6, probe, 20.0f + probe)));
+  }
+  const size_t bytes = enc.payloadBytes();
+  TEST_ASSERT_FALSE(enc.append(makeRecord(2000, 6, 0xEE, 20.0f)));
+  TEST_ASSERT_EQUAL(bytes, enc.payloadBytes());
+  TEST_ASSERT_EQUAL(TsBlockEncoder::kMaxSeries, enc.rows());
+  // Known series still append.
+  TEST_ASSERT_TRUE(enc.append(makeRecord(2000, 6, 15, 35.0f)));
+  std::vector<BinaryLogRecord> decoded;
+  decodeAll(enc, decoded);
+  TEST_ASSERT_EQUAL(TsBlockEncoder::kMaxSeries + 1, decoded.size());
+  TEST_ASSERT_EQUAL(15, decoded.back().addr[0]);
+}
+
+static void test_refused_row_leaves_the_block_intact(void) {
+  TsBlockEncoder enc;
+  enc.begin();
+  std::mt19937 rng(3);
+  std::vector<BinaryLogRecord> rows;
+  uint64_t ts = 0;
+  for (;;) {
+    // Random values defeat the XOR coding so the payload fills quickly.
+    uint32_t bits = rng();
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    ts += 1000 + rng() % 3000;
+    const BinaryLogRecord r = makeRecord(ts, 1 + rows.size() % 3, 0x76, value, value);
+    const size_t bytes = enc.payloadBytes();
+    if (!enc.append(r)) {
+      TEST_ASSERT_EQUAL(bytes, enc.payloadBytes());
+      break;
+    }
+    rows.push_back(r);
+  }
+  TEST_ASSERT_GREATER_THAN(TsBlockEncoder::kMaxPayload - 16, enc.payloadBytes());
+  TEST_ASSERT_EQUAL(rows.size(), enc.rows());
+  std::vector<BinaryLogRecord> decoded;
+  decodeAll(enc, decoded);
+  TEST_ASSERT_EQUAL(rows.size(), decoded.size());
+  for (size_t i = 0; i < rows.size(); i++) assertSameRecord(rows[i], decoded[i]);
+}
+
+static void test_row_limit(void) {
+  TsBlockEncoder enc;
+  enc.begin();
+  for (uint16_t i = 0; i < TsBlockEncoder::kMaxRows; i++) TEST_ASSERT_TRUE(enc.append(makeRecord(i * 1000, 1, 1, 1)));
+  TEST_ASSERT_FALSE(enc.append(makeRecord(TsBlockEncoder::kMaxRows * 1000, 1, 1, 1)));
+}
+
+static void test_truncated_payload_is_rejected(void) {
+  TsBlockEncoder enc;
+  enc.begin();
+  for (int i = 0; i < 20; i++) enc.append(makeRecord(i * 1000, 1, 0x76, 21.0f + i, 1000.0f - i));
+  TsBlockDecoder dec;
+  dec.begin(enc.payload(), enc.payloadBytes() / 2, enc.rows(), 0);
+  BinaryLogRecord record;
+  uint16_t rows = 0;
+  while (dec.next(record)) rows++;
+  TEST_ASSERT_GREATER_THAN(0, rows);
+  TEST_ASSERT_LESS_THAN(enc.rows(), rows);
+}
+
+static void test_v2_file_round_trip_and_seek(void) {
+  BinaryLogger log(*storage, "/log.bin");
+  TEST_ASSERT_TRUE(log.setBuffered(1024, 15000));
+  TEST_ASSERT_TRUE(log.setBlocks(true));
+  TEST_ASSERT_TRUE(log.begin());
+  std::vector<BinaryLogRecord> rows;
+  uint32_t mark = 0;
+  size_t markRow = 0;
+  for (int i = 0; i < 2000; i++) {
+    if (i == 1234) {
+      log.anchorNext();
+      mark = log.position();
+      markRow = rows.size();
+    }
+    const BinaryLogRecord r = makeRecord(1700000000000ULL + i * 1000ULL, 1 + i % 3, 0x76, 20.0f + (i % 100) * 0.01f);
+    TEST_ASSERT_GREATER_THAN(0, log.append(r));
+    rows.push_back(r);
+  }
+  log.end();
+  TEST_ASSERT_EQUAL(BinaryLogger::kBlockVersion,
+                    BinaryLogger::headerVersion((const uint8_t *)storage->contents("/log.bin").data(), 8));
+
+  BinaryLogReader reader;
+  TEST_ASSERT_TRUE(reader.open(*storage, "/log.bin"));
+  BinaryLogRecord record;
+  size_t n = 0;
+  while (reader.next(record)) assertSameRecord(rows[n++], record);
+  TEST_ASSERT_EQUAL(rows.size(), n);
+
+  TEST_ASSERT_TRUE(reader.seek(mark));
+  TEST_ASSERT_TRUE(reader.next(record));
+  assertSameRecord(rows[markRow], record);
+  // Mid-block positions from the reader resume on the same row.
+  for (int i = 0; i < 10; i++) reader.next(record);
+  const uint32_t inside = reader.position();
+  const uint64_t lastTs = reader.lastTimestamp();
+  TEST_ASSERT_TRUE(reader.next(record));
+  TEST_ASSERT_TRUE(reader.seek(inside, lastTs));
+  BinaryLogRecord again;
+  TEST_ASSERT_TRUE(reader.next(again));
+  assertSameRecord(record, again);
+}
+
+// An hour at 1 Hz from a BMP280, a DHT22 and a DS18B20, quantised like the
+// drivers report them, stored as the firmware would for each log_format.
+static void test_benchmark_bytes_per_sample(void) {
+  static const char *HEADER =
+      "date,temperature,humidity,pressure,iaq,accuracy,voc,eqco2,gas_kohm,generic,sensor,address";
+  BinaryLogger v1(*storage, "/v1.bin");
+  BinaryLogger v2(*storage, "/v2.bin");
+  v2.setBlocks(true);
+  size_t csvBytes = strlen(HEADER) + 1;
+  std::mt19937 rng(11);
+  std::normal_distribution<float> noise(0, 1);
+  float air = 21.0f;
+  float hpa = 1013.0f;
+  const int seconds = 3600;
+  for (int s = 0; s < seconds; s++) {
+    air += noise(rng) * 0.002f;
+    hpa += noise(rng) * 0.003f;
+    const uint64_t ts = 1700000000000ULL + s * 1000ULL + rng() % 4;
+    const float bmpT = roundf((air + noise(rng) * 0.01f) * 100) / 100;
+    const float bmpP = roundf((hpa + noise(rng) * 0.01f) * 100) / 100;
+    const float dhtT = roundf(air * 10) / 10;
+    const float dhtH = roundf((48.0f + noise(rng) * 0.2f) * 10) / 10;
+    const float dsT = roundf(air * 16) / 16;
+    BinaryLogRecord rows[] = {
+        makeRecord(ts, 1, 0x76, bmpT, bmpP),
+        makeRecord(ts + 5, 5, 0x04, dhtT),
+        makeRecord(ts + 9, 6, 0x28, dsT),
+    };
+    rows[1].mask |= 1U << 1;
+    rows[1].values[1] = dhtH;
+    const uint8_t rom[8] = {0x28, 0xFF, 0x4A, 0x1D, 0x93, 0x16, 0x03, 0x02};
+    rows[2].addrLen = sizeof(rom);
+    memcpy(rows[2].addr, rom, sizeof(rom));
+    char line[160];
+    snprintf(line, sizeof(line), "14/11/23 10:00:00,%.3f,,%.3f,,,,,,,bmp280,0x76", bmpT, bmpP);
+    csvBytes += strlen(line) + 1;
+    snprintf(line, sizeof(line), "14/11/23 10:00:00,%.3f,%.3f,,,,,,,,dht22,0x04", dhtT, dhtH);
+    csvBytes += strlen(line) + 1;
+    snprintf(line, sizeof(line), "14/11/23 10:00:00,%.3f,,,,,,,,,ds18b20,28FF4A1D93160302", dsT);
+    csvBytes += strlen(line) + 1;
+    for (const BinaryLogRecord &r : rows) {
+      TEST_ASSERT_GREATER_THAN(0, v1.append(r));
+      TEST_ASSERT_GREATER_THAN(0, v2.append(r));
+    }
+  }
+  v1.end();
+  v2.end();
+  const double samples = seconds * 3.0;
+  const double csv = csvBytes / samples;
+  const double bin = storage->contents("/v1.bin").size() / samples;
+  const double tsz = storage->contents("/v2.bin").size() / samples;
+  char line[128];
+  snprintf(line, sizeof(line), "bytes/row over %d rows: csv %.1f, bin v1 %.1f, tsz %.1f", (int)samples, csv, bin,
+           tsz);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_LESS_THAN(bin / 2, tsz);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_interleaved_series_round_trip);
+  RUN_TEST(test_sixteen_series_fit_and_the_seventeenth_is_refused);
+  RUN_TEST(test_refused_row_leaves_the_block_intact);
+  RUN_TEST(test_row_limit);
+  RUN_TEST(test_truncated_payload_is_rejected);
+  RUN_TEST(test_v2_file_round_trip_and_seek);
+  RUN_TEST(test_benchmark_bytes_per_sample);
+  return UNITY_END();
+}
@@ -0,0 +1,234 @@
+// VarioFilter against synthetic flight traces: 20, 25 and 50 Hz MS5611
+// samples with 1.2 Pa noise, 1 Pa quantisation, +-1.5 ms jitter and a
+// micros() wrap. The climb rate is compared with the same Kalman filter in
+// double precision, and the last case reports the cost of an update.
+
+#include <VarioFilter.h>
+#include <unity.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+static const uint16_t kSigmaCm = 10;  // MS5611 at OSR 4096
+static const uint16_t kAccelCmS2 = 50;
+
+static double paAt(double meters) {
+  return 101325.0 * pow(1.0 - meters / 44330.77, 1.0 / 0.190263);
+}
+
+static double metersAt(double pa) {
+  return 44330.77 * (1.0 - pow(pa / 101325.0, 0.190263));
+}
+
+// The filter of VarioFilter.h in double precision, fed the same altitudes.
+struct ReferenceKalman {
+  double h = 0, v = 0, p00 = 0, p01 = 0, p11 = 0, r = 0, a2 = 0, lastS = 0;
+  bool ready = false;
+
+  ReferenceKalman(double sigmaCm, double accelCmS2) : r(sigmaCm * sigmaCm), a2(accelCmS2 * accelCmS2) {}
+
+  void update(double zCm, double tS) {
+    const double dt = tS - lastS;
+    lastS = tS;
+    if (!ready) {
+      h = zCm;
+      v = 0;
+      p00 = r;
+      p01 = 0;
+      p11 = 200.0 * 200.0;
+      ready = true;
+      return;
+    }
+    h += v * dt;
+    p00 += dt * (2 * p01 + dt * p11) + a2 * dt * dt * dt / 3;
+    p01 += dt * p11 + a2 * dt * dt / 2;
+    p11 += a2 * dt;
+    const double s = p00 + r, k0 = p00 / s, k1 = p01 / s, y = zCm - h, q = p01;
+    h += k0 * y;
+    v += k1 * y;
+    p00 -= k0 * p00;
+    p01 -= k0 * q;
+    p11 -= k1 * q;
+  }
+};
+
+struct Sample {
+  uint32_t paQ8;
+  uint32_t us;
+  double tS;
+  double meters;
+  double climbMS;
+};
+
+// Ground 10 s, climb 2 m/s for 20 s, sink 1.5 m/s for 20 s, level 10 s.
+static double climbAt(double tS) {
+  if (tS < 10) return 0;
+  if (tS < 30) return 2;
+  if (tS < 50) return -1.5;
+  return 0;
+}
+
+static std::vector<Sample> flightTrace(uint32_t hz, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> noise(0, 1.2);
+  std::uniform_int_distribution<int> jitterUs(-1500, 1500);
+  std::vector<Sample> trace;
+  double meters = 500, tS = 0;
+  uint32_t us = 0xFFF00000u;  // micros() wraps about 1 s in
+  for (uint32_t i = 0; i < 60 * hz; i++) {
+    const double dt = 1.0 / hz + jitterUs(rng) * 1e-6;
+    tS += dt;
+    meters += climbAt(tS) * dt;
+    us += (uint32_t)llround(dt * 1e6);
+    const double pa = round(paAt(meters) + noise(rng));
+    trace.push_back({(uint32_t)llround(pa * 256), us, tS, meters, climbAt(tS)});
+  }
+  return trace;
+}
+
+static VarioFilter makeFilter() {
+  VarioFilter filter;
+  filter.setNoise(kSigmaCm, kAccelCmS2);
+  return filter;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_altitude_table_follows_standard_atmosphere(void) {
+  double nearSeaCm = 0, worstCm = 0;
+  for (double hpa = 300; hpa <= 1100; hpa += 0.37) {
+    const double errCm = fabs(VarioFilter::altitudeQ8(VarioFilter::paQ8FromHpa((float)hpa)) / 256.0 -
+                              metersAt(hpa * 100) * 100);
+    if (hpa >= 1000 && errCm > nearSeaCm) nearSeaCm = errCm;
+    if (errCm > worstCm) worstCm = errCm;
+  }
+  char line[96];
+  snprintf(line, sizeof(line), "table error: %.2f cm above 1000 hPa, %.2f cm worst", nearSeaCm, worstCm);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE(nearSeaCm < 2.5);
+  TEST_ASSERT_TRUE(worstCm < 20);
+  // Clamped outside 300..1104 hPa.
+  TEST_ASSERT_EQUAL(VarioFilter::altitudeQ8(VarioFilter::paQ8FromHpa(300)), VarioFilter::altitudeQ8(0));
+  TEST_ASSERT_EQUAL(VarioFilter::altitudeQ8(VarioFilter::paQ8FromHpa(1104)),
+                    VarioFilter::altitudeQ8(VarioFilter::paQ8FromHpa(1500)));
+}
+
+static void test_pa_from_hpa(void) {
+  TEST_ASSERT_EQUAL_UINT32(101325u * 256u, VarioFilter::paQ8FromHpa(1013.25f));
+  TEST_ASSERT_EQUAL_UINT32(0, VarioFilter::paQ8FromHpa(0));
+  TEST_ASSERT_EQUAL_UINT32(0, VarioFilter::paQ8FromHpa(-5));
+  TEST_ASSERT_EQUAL_UINT32(0, VarioFilter::paQ8FromHpa(NAN));
+}
+
+static void test_flight_traces_match_double_precision(void) {
+  const uint32_t rates[] = {20, 25, 50};
+  for (const uint32_t hz : rates) {
+    const std::vector<Sample> trace = flightTrace(hz, 1);
+    VarioFilter filter = makeFilter();
+    ReferenceKalman reference(kSigmaCm, kAccelCmS2);
+    double maxDiffCmS = 0, climbErr2 = 0, altErr2 = 0;
+    uint32_t n = 0;
+    for (const Sample &s : trace) {
+      filter.update(s.paQ8, s.us);
+      reference.update(VarioFilter::altitudeQ8(s.paQ8) / 256.0, s.tS);
+      if (s.tS < 3) continue;
+      maxDiffCmS = fmax(maxDiffCmS, fabs(filter.climbCmS() - reference.v));
+      climbErr2 += pow(filter.climbCmS() / 100.0 - s.climbMS, 2);
+      altErr2 += pow(filter.altitudeCm() / 100.0 - s.meters, 2);
+      n++;
+    }
+    char line[128];
+    snprintf(line, sizeof(line), "%lu Hz: climb rms %.3f m/s, altitude rms %.3f m, max diff to double %.2f cm/s",
+             (unsigned long)hz, sqrt(climbErr2 / n), sqrt(altErr2 / n), maxDiffCmS);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(maxDiffCmS < 1.0);
+    TEST_ASSERT_TRUE(sqrt(altErr2 / n) < 0.5);
+    TEST_ASSERT_EQUAL(trace.size(), filter.updates());
+  }
+}
+
+static void test_climb_step_response(void) {
+  const uint32_t rates[] = {20, 25, 50};
+  for (const uint32_t hz : rates) {
+    VarioFilter filter = makeFilter();
+    double t90 = -1;
+    for (const Sample &s : flightTrace(hz, 3)) {
+      filter.update(s.paQ8, s.us);
+      if (s.tS > 10 && filter.climbCmS() >= 180) {
+        t90 = s.tS - 10;
+        break;
+      }
+    }
+    char line[64];
+    snprintf(line, sizeof(line), "%lu Hz: 0 to 2 m/s reaches 90%% in %.2f s", (unsigned long)hz, t90);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(t90 > 0.2 && t90 < 1.0);
+  }
+}
+
+static void test_still_air_climb_noise(void) {
+  std::mt19937 rng(7);
+  std::normal_distribution<double> noise(0, 1.2);
+  VarioFilter filter = makeFilter();
+  double climb2 = 0;
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < 30 * 50; i++) {
+    filter.update((uint32_t)llround(round(paAt(300) + noise(rng)) * 256), i * 20000);
+    if (i < 3 * 50) continue;
+    climb2 += pow(filter.climbCmS() / 100.0, 2);
+    n++;
+  }
+  char line[64];
+  snprintf(line, sizeof(line), "still air at 50 Hz: climb rms %.3f m/s", sqrt(climb2 / n));
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE(sqrt(climb2 / n) < 0.2);
+}
+
+static void test_gap_restarts_filter(void) {
+  VarioFilter filter = makeFilter();
+  TEST_ASSERT_FALSE(filter.ready());
+  filter.update(VarioFilter::paQ8FromHpa(1000), 0);
+  TEST_ASSERT_TRUE(filter.ready());
+  filter.update(VarioFilter::paQ8FromHpa(1000), 20000);
+  // A sample 3 s later restarts the filter: the 880 m jump is not a climb.
+  filter.update(VarioFilter::paQ8FromHpa(900), 3000000);
+  TEST_ASSERT_EQUAL(0, filter.climbCmS());
+  TEST_ASSERT_INT_WITHIN(5, (int)lround(metersAt(90000) * 100), filter.altitudeCm());
+  filter.reset();
+  TEST_ASSERT_FALSE(filter.ready());
+}
+
+// Host figure only; the [VARIO] serial line reports the target one.
+static void test_update_cost(void) {
+  const std::vector<Sample> trace = flightTrace(50, 1);
+  VarioFilter filter = makeFilter();
+  const uint32_t reps = 200;
+  int64_t sink = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < reps; r++) {
+    for (const Sample &s : trace) {
+      filter.update(s.paQ8, s.us + r * 61000000u);
+      sink += filter.climbCmS();
+    }
+  }
+  const double ns =
+      std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (reps * trace.size());
+  char line[64];
+  snprintf(line, sizeof(line), "host: %.1f ns per update (%lld)", ns, (long long)(sink & 1));
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE(ns < 1000);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_altitude_table_follows_standard_atmosphere);
+  RUN_TEST(test_pa_from_hpa);
+  RUN_TEST(test_flight_traces_match_double_precision);
+  RUN_TEST(test_climb_step_response);
+  RUN_TEST(test_still_air_climb_noise);
+  RUN_TEST(test_gap_restarts_filter);
+  RUN_TEST(test_update_cost);
+  return UNITY_END();
+}